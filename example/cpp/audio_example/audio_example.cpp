@@ -1,4 +1,5 @@
 #include "magic_robot.h"
+#include "magic_tts_tracker.h"
 
 #include <unistd.h>
 #include <csignal>
@@ -77,13 +78,19 @@ int main() {
 
   std::cout << "Get volume success, volume: " << std::to_string(get_volume) << std::endl;
 
+  // Track playback so we can wait for speech to finish instead of sleeping
+  audio::TtsTracker tracker(controller);
+  tracker.SubscribeTtsStatus([](const audio::TtsStatusEvent& event) {
+    std::cout << "TTS " << event.id << " state: " << static_cast<int>(event.state) << std::endl;
+  });
+
   // Play voice
   TtsCommand tts;
   tts.id = "100000000001";
   tts.content = "How's the weather today!";
   tts.priority = TtsPriority::HIGH;
   tts.mode = TtsMode::CLEARTOP;
-  status = controller.Play(tts);
+  status = tracker.Play(tts);
   if (status.code != ErrorCode::OK) {
     std::cerr << "Play TTS failed"
               << ", code: " << status.code
@@ -92,11 +99,16 @@ int main() {
     return -1;
   }
 
-  // Wait 2s
-  usleep(5000000);
+  // Wait for the sentence to finish (at most 5s); a timeout or interruption is reported but not fatal
+  status = tracker.WaitForTts(tts.id, 5000);
+  if (status.code != ErrorCode::OK) {
+    std::cerr << "Wait TTS failed"
+              << ", code: " << status.code
+              << ", message: " << status.message << std::endl;
+  }
 
   // Stop voice playback
-  status = controller.Stop();
+  status = tracker.Stop();
   if (status.code != ErrorCode::OK) {
     std::cerr << "Stop TTS failed"
               << ", code: " << status.code
@@ -0,0 +1,115 @@
+#include "magic_depth_codec.h"
+#include "magic_simd.h"
+#include "magic_type.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#if defined(MAGIC_BENCHMARK_HAVE_ZLIB)
+#include <zlib.h>
+#endif
+
+using namespace magic::dog;
+using namespace magic::dog::sensor;
+
+namespace {
+
+constexpr int kWidth = 640;
+constexpr int kHeight = 480;
+constexpr int kIterations = 100;
+
+// Indoor-like frame: floor and wall planes, a box, depth-proportional noise and clusters of invalid pixels
+Image MakeDepthImage() {
+  Image image{};
+  image.width = kWidth;
+  image.height = kHeight;
+  image.encoding = "16UC1";
+  image.is_bigendian = false;
+  image.step = kWidth * 2;
+  image.data.resize(image.step * kHeight);
+  std::mt19937 gen(42);
+  std::normal_distribution<double> noise(0.0, 1.0);
+  auto* depth = reinterpret_cast<uint16_t*>(image.data.data());
+  for (int v = 0; v < kHeight; ++v) {
+    for (int u = 0; u < kWidth; ++u) {
+      double z = v > kHeight / 2 ? 385.0 * 0.3 / ((v - kHeight / 2 + 1) / 385.0) / 385.0 : 3.0;
+      z = std::min(z, 3.0);
+      if (u > 250 && u < 400 && v > 200 && v < 330) {
+        z = 1.2 + 0.0005 * (u - 250);
+      }
+      double mm = z * 1000.0 + noise(gen) * z * z * 2.0;
+      bool invalid = (u < 24) || ((u / 16 + v / 16) % 23 == 0) || mm > 6000.0;
+      depth[v * kWidth + u] = invalid ? 0 : static_cast<uint16_t>(mm);
+    }
+  }
+  return image;
+}
+
+template <typename Func>
+double MeasureMs(Func&& func) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kIterations; ++i) {
+    func();
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count() / kIterations;
+}
+
+void Report(const char* name, double ms, size_t raw_bytes, size_t encoded_bytes) {
+  std::cout << name << ": " << ms << " ms/frame, " << raw_bytes / ms / 1000.0 << " MB/s";
+  if (encoded_bytes > 0) {
+    std::cout << ", ratio: " << static_cast<double>(raw_bytes) / encoded_bytes;
+  }
+  std::cout << std::endl;
+}
+
+}  // namespace
+
+int main() {
+  Image image = MakeDepthImage();
+  size_t raw_bytes = image.data.size();
+
+  std::cout << "SIMD backend: " << SimdBackendName() << std::endl;
+  std::cout << "Image: " << kWidth << "x" << kHeight << " 16UC1, iterations: " << kIterations << std::endl;
+
+  std::vector<uint8_t> copy(raw_bytes);
+  double memcpy_ms = MeasureMs([&] { std::memcpy(copy.data(), image.data.data(), raw_bytes); });
+  Report("memcpy              ", memcpy_ms, raw_bytes, 0);
+
+  CompressedImage compressed;
+  Image decoded;
+  double encode_ms = MeasureMs([&] { CompressDepth(image, compressed); });
+  Report("CompressDepth       ", encode_ms, raw_bytes, compressed.data.size());
+  double decode_ms = MeasureMs([&] { DecompressDepth(compressed, decoded); });
+  Report("DecompressDepth     ", decode_ms, raw_bytes, 0);
+  if (decoded.data != image.data) {
+    std::cerr << "Depth codec round trip mismatch" << std::endl;
+    return -1;
+  }
+
+#if defined(MAGIC_BENCHMARK_HAVE_ZLIB)
+  for (int level : {1, 6}) {
+    std::vector<uint8_t> deflated(compressBound(raw_bytes));
+    uLongf deflated_size = 0;
+    double zlib_encode_ms = MeasureMs([&] {
+      deflated_size = deflated.size();
+      compress2(deflated.data(), &deflated_size, image.data.data(), raw_bytes, level);
+    });
+    std::cout << "zlib level " << level << std::endl;
+    Report("  compress          ", zlib_encode_ms, raw_bytes, deflated_size);
+    double zlib_decode_ms = MeasureMs([&] {
+      uLongf size = copy.size();
+      uncompress(copy.data(), &size, deflated.data(), deflated_size);
+    });
+    Report("  uncompress        ", zlib_decode_ms, raw_bytes, 0);
+  }
+#else
+  std::cout << "zlib not found at configure time, zlib comparison skipped" << std::endl;
+#endif
+
+  return 0;
+}
@@ -0,0 +1,106 @@
+#include "magic_depth_projection.h"
+#include "magic_simd.h"
+#include "magic_type.h"
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <vector>
+
+using namespace magic::dog;
+using namespace magic::dog::sensor;
+
+namespace {
+
+constexpr int kWidth = 640;
+constexpr int kHeight = 480;
+constexpr int kIterations = 200;
+
+CameraInfo MakeCameraInfo() {
+  CameraInfo info{};
+  info.width = kWidth;
+  info.height = kHeight;
+  info.K = {385.0, 0.0, 320.0, 0.0, 385.0, 240.0, 0.0, 0.0, 1.0};
+  return info;
+}
+
+Image MakeDepthImage() {
+  Image image{};
+  image.width = kWidth;
+  image.height = kHeight;
+  image.encoding = "16UC1";
+  image.is_bigendian = false;
+  image.step = kWidth * 2;
+  image.data.resize(image.step * kHeight);
+  std::mt19937 gen(42);
+  std::uniform_int_distribution<int> dis(0, 6000);
+  auto* depth = reinterpret_cast<uint16_t*>(image.data.data());
+  for (int i = 0; i < kWidth * kHeight; ++i) {
+    // About 10% invalid pixels, as in a typical indoor frame
+    depth[i] = (i % 10 == 0) ? 0 : static_cast<uint16_t>(dis(gen));
+  }
+  return image;
+}
+
+// Per-pixel reference implementation, as commonly written by SDK users
+void NaiveProject(const Image& image, const CameraInfo& info, PointCloudSoA& cloud) {
+  cloud.clear();
+  double fx = info.K[0], fy = info.K[4], cx = info.K[2], cy = info.K[5];
+  for (int v = 0; v < image.height; ++v) {
+    for (int u = 0; u < image.width; ++u) {
+      uint16_t d;
+      std::memcpy(&d, image.data.data() + v * image.step + u * 2, 2);
+      if (d == 0) {
+        continue;
+      }
+      double z = d * 0.001;
+      cloud.x.push_back(static_cast<float>((u - cx) * z / fx));
+      cloud.y.push_back(static_cast<float>((v - cy) * z / fy));
+      cloud.z.push_back(static_cast<float>(z));
+    }
+  }
+}
+
+template <typename Func>
+double MeasureMs(Func&& func) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kIterations; ++i) {
+    func();
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::milli>(end - start).count() / kIterations;
+}
+
+}  // namespace
+
+int main() {
+  auto info = MakeCameraInfo();
+  auto image = MakeDepthImage();
+  PointCloudSoA cloud;
+
+  std::cout << "SIMD backend: " << SimdBackendName() << std::endl;
+  std::cout << "Image: " << kWidth << "x" << kHeight << ", iterations: " << kIterations << std::endl;
+
+  double naive_ms = MeasureMs([&] { NaiveProject(image, info, cloud); });
+  std::cout << "naive per-pixel loop : " << naive_ms << " ms/frame, points: " << cloud.size() << std::endl;
+
+  for (int stride : {1, 2, 4}) {
+    DepthProjector projector;
+    if (!projector.Configure(info, stride)) {
+      std::cerr << "Configure depth projector failed" << std::endl;
+      return -1;
+    }
+    double ms = MeasureMs([&] { projector.Project(image, cloud); });
+    std::cout << "DepthProjector stride " << stride << ": " << ms << " ms/frame, points: " << cloud.size()
+              << ", speedup: " << naive_ms / ms << "x" << std::endl;
+  }
+
+  DepthProjector projector;
+  PointCloud2 cloud2;
+  projector.Configure(info, 1);
+  double ms = MeasureMs([&] { projector.Project(image, cloud2); });
+  std::cout << "DepthProjector PointCloud2: " << ms << " ms/frame, points: " << cloud2.width << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,107 @@
+#include "magic_interned_string.h"
+#include "magic_type.h"
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace magic::dog;
+using namespace magic::dog::sensor;
+
+namespace {
+
+constexpr int kIterations = 1000000;
+
+// Image metadata as carried by the SDK message
+struct StringImageMeta {
+  int64_t stamp;
+  std::string frame_id;
+  std::string encoding;
+  int32_t height;
+  int32_t width;
+  int32_t step;
+};
+
+// Same metadata with interned frame id and enum encoding
+struct InternedImageMeta {
+  int64_t stamp;
+  InternedString frame_id;
+  ImageEncoding encoding;
+  int32_t height;
+  int32_t width;
+  int32_t step;
+};
+
+// Encoding dispatch as commonly written by SDK users
+int32_t PixelSizeByString(const std::string& encoding) {
+  if (encoding == "rgb8" || encoding == "bgr8") return 3;
+  if (encoding == "mono8") return 1;
+  if (encoding == "16UC1" || encoding == "mono16") return 2;
+  if (encoding == "32FC1") return 4;
+  return 0;
+}
+
+template <typename Func>
+double MeasureNs(Func&& func) {
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kIterations; ++i) {
+    func(i);
+  }
+  auto end = std::chrono::steady_clock::now();
+  return std::chrono::duration<double, std::nano>(end - start).count() / kIterations;
+}
+
+}  // namespace
+
+int main() {
+  Image image{};
+  image.header.frame_id = "rgbd_color_optical_frame";
+  image.encoding = "bgr8";
+  image.width = 640;
+  image.height = 480;
+  image.step = 640 * 3;
+
+  std::vector<StringImageMeta> string_metas(16);
+  std::vector<InternedImageMeta> interned_metas(16);
+  int64_t sink = 0;
+
+  std::cout << "Iterations: " << kIterations << std::endl;
+
+  double construct_string = MeasureNs([&](int i) {
+    string_metas[i & 15] = StringImageMeta{i, image.header.frame_id, image.encoding, image.height, image.width, image.step};
+  });
+  std::cout << "construct with std::string     : " << construct_string << " ns/message" << std::endl;
+
+  double construct_interned = MeasureNs([&](int i) {
+    interned_metas[i & 15] = InternedImageMeta{i, InternedString(image.header.frame_id), GetImageEncoding(image), image.height,
+                                               image.width, image.step};
+  });
+  std::cout << "construct with interning       : " << construct_interned << " ns/message" << std::endl;
+
+  StringImageMeta string_meta = string_metas[0];
+  InternedImageMeta interned_meta = interned_metas[0];
+  InternedString color_frame("rgbd_color_optical_frame");
+
+  double copy_string = MeasureNs([&](int i) { string_metas[i & 15] = string_meta; });
+  std::cout << "copy std::string metadata      : " << copy_string << " ns/message" << std::endl;
+
+  double copy_interned = MeasureNs([&](int i) { interned_metas[i & 15] = interned_meta; });
+  std::cout << "copy interned metadata         : " << copy_interned << " ns/message" << std::endl;
+
+  double dispatch_string = MeasureNs([&](int i) {
+    const StringImageMeta& meta = string_metas[i & 15];
+    sink += PixelSizeByString(meta.encoding) + (meta.frame_id == "rgbd_color_optical_frame");
+  });
+  std::cout << "dispatch on strings            : " << dispatch_string << " ns/message" << std::endl;
+
+  double dispatch_interned = MeasureNs([&](int i) {
+    const InternedImageMeta& meta = interned_metas[i & 15];
+    sink += ImageEncodingPixelSize(meta.encoding) + (meta.frame_id == color_frame);
+  });
+  std::cout << "dispatch on ids                : " << dispatch_interned << " ns/message" << std::endl;
+
+  std::cout << "(checksum " << sink << ")" << std::endl;
+  return 0;
+}
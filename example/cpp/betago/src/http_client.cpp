@@ -2,6 +2,8 @@
 
 #include <curl/curl.h>
 
+#include "magic_audio_encoder.h"
+
 #include <iostream>
 
 size_t WriteCallback(void* contents, size_t size, size_t nmemb, std::string* output) {
@@ -68,12 +70,24 @@ bool upload_audio(const std::shared_ptr<magic::dog::ByteMultiArray>& msg, std::s
                 return size * nmemb; });
   }
 
+  // BF 语音为 16kHz 单声道 S16 PCM，封装为带 RIFF 头的 WAV 再上传
+  std::vector<uint8_t> wav;
+  magic::dog::audio::StreamingAudioEncoder encoder({magic::dog::audio::AudioCodec::WAV, 16000, 1},
+                                                   [&wav](const uint8_t* data, size_t size) { wav.insert(wav.end(), data, data + size); });
+  if (!encoder.Write(*msg)) {
+    std::cerr << "语音数据格式错误" << std::endl;
+    return false;
+  }
+  encoder.Finish();
+  auto header = encoder.GetHeader();
+  std::copy(header.begin(), header.end(), wav.begin());
+
   curl_mime* mime = curl_mime_init(voice_curl);
   curl_mimepart* part = curl_mime_addpart(mime);
   curl_mime_name(part, "file");
   curl_mime_filename(part, "voice.wav");
-  curl_mime_data(part, reinterpret_cast<const char*>(msg->data.data()), msg->data.size());
-  curl_mime_type(part, "audio/wav");
+  curl_mime_data(part, reinterpret_cast<const char*>(wav.data()), wav.size());
+  curl_mime_type(part, encoder.GetMimeType());
 
   response.clear();
   curl_easy_setopt(voice_curl, CURLOPT_MIMEPOST, mime);
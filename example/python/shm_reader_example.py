@@ -0,0 +1,115 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+"""
+MagicDog SDK Shared-Memory Reader Example
+
+Attaches to an Image stream published by magic::dog::sensor::ShmStreamWriter (magic_shm_relay.h)
+and reads frames without opening another robot connection. Only the standard library is required;
+numpy is used to wrap the pixel data when available.
+
+Usage: python3 shm_reader_example.py /magicdog_rgbd_depth
+"""
+
+import mmap
+import os
+import struct
+import sys
+import time
+import logging
+
+logging.basicConfig(
+    level=logging.INFO,  # Minimum log level
+    format="%(asctime)s [%(levelname)s] %(message)s",
+    datefmt="%Y-%m-%d %H:%M:%S",
+)
+
+try:
+    import numpy as np
+except ImportError:
+    np = None
+
+SHM_MAGIC = 0x48534447
+SHM_VERSION = 1
+SHM_TYPE_IMAGE = 1
+
+SEGMENT_HEADER = struct.Struct("<IIIIQQ")  # magic, version, message_type, slot_count, slot_bytes, write_index
+SEGMENT_HEADER_SIZE = 64
+SLOT_HEADER = struct.Struct("<QQ")  # sequence, payload_bytes
+SLOT_HEADER_SIZE = 64
+IMAGE_META = struct.Struct("<q64s32siiiIQ")  # stamp, frame_id, encoding, height, width, step, is_bigendian, data_bytes
+
+
+def c_string(raw):
+    return raw.split(b"\0", 1)[0].decode("utf-8", "replace")
+
+
+class ShmImageReader:
+    """Python counterpart of ShmStreamReader for Image streams."""
+
+    def __init__(self, name):
+        fd = os.open("/dev/shm/" + name.lstrip("/"), os.O_RDONLY)
+        try:
+            self.buffer = mmap.mmap(fd, 0, prot=mmap.PROT_READ)
+        finally:
+            os.close(fd)
+        magic, version, message_type, self.slot_count, self.slot_bytes, write_index = SEGMENT_HEADER.unpack_from(self.buffer, 0)
+        if magic != SHM_MAGIC or version != SHM_VERSION or message_type != SHM_TYPE_IMAGE:
+            raise RuntimeError(f"unsupported shared memory: {name}")
+        self.slot_stride = SLOT_HEADER_SIZE + self.slot_bytes
+        self.next_index = write_index
+
+    def write_index(self):
+        return SEGMENT_HEADER.unpack_from(self.buffer, 0)[5]
+
+    def latest(self):
+        """Return (meta dict, bytes) of the newest unread frame, or None."""
+        published = self.write_index()
+        if published <= self.next_index:
+            return None
+        index = published - 1
+        self.next_index = published
+        offset = SEGMENT_HEADER_SIZE + (index % self.slot_count) * self.slot_stride
+        expected = 2 * index + 2
+        sequence, payload_bytes = SLOT_HEADER.unpack_from(self.buffer, offset)
+        if sequence != expected:
+            return None
+        payload = offset + SLOT_HEADER_SIZE
+        stamp, frame_id, encoding, height, width, step, is_bigendian, data_bytes = IMAGE_META.unpack_from(self.buffer, payload)
+        start = payload + IMAGE_META.size
+        data = self.buffer[start:start + data_bytes]  # copied, so the slot may be reused afterwards
+        if SLOT_HEADER.unpack_from(self.buffer, offset)[0] != expected:
+            return None  # overwritten while copying
+        meta = {
+            "stamp": stamp,
+            "frame_id": c_string(frame_id),
+            "encoding": c_string(encoding),
+            "height": height,
+            "width": width,
+            "step": step,
+            "is_bigendian": bool(is_bigendian),
+        }
+        return meta, data
+
+
+def main():
+    name = sys.argv[1] if len(sys.argv) > 1 else "/magicdog_rgbd_depth"
+    reader = ShmImageReader(name)
+    logging.info(f"Attached to {name}: {reader.slot_count} slots of {reader.slot_bytes} bytes")
+    try:
+        while True:
+            frame = reader.latest()
+            if frame is None:
+                time.sleep(0.005)
+                continue
+            meta, data = frame
+            if np is not None and meta["encoding"] in ("16UC1", "mono16"):
+                pixels = np.frombuffer(data, dtype=">u2" if meta["is_bigendian"] else "<u2")
+                logging.info(f"{meta['encoding']} {meta['width']}x{meta['height']} stamp={meta['stamp']} max={pixels.max()}")
+            else:
+                logging.info(f"{meta['encoding']} {meta['width']}x{meta['height']} stamp={meta['stamp']} bytes={len(data)}")
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,519 @@
+#pragma once
+
+#include "magic_simd.h"
+#include "magic_type.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace magic::dog::audio {
+
+/**
+ * @brief Sample format of a PCM voice stream (little endian)
+ */
+enum class AudioSampleFormat {
+  S16,  ///< Signed 16-bit
+  S32,  ///< Signed 32-bit
+};
+
+/**
+ * @brief PCM layout of a voice message, derived from its MultiArrayLayout
+ */
+struct AudioLayout {
+  int32_t channels = 1;                            ///< Number of channels
+  size_t frames = 0;                               ///< Samples per channel
+  AudioSampleFormat format = AudioSampleFormat::S16;  ///< Sample format
+  bool planar = false;                             ///< Channels stored one after another instead of interleaved
+  size_t data_offset = 0;                          ///< Byte offset of the first sample in data
+};
+
+namespace detail {
+
+inline bool IsChannelLabel(const std::string& label) {
+  std::string lower = label;
+  std::transform(lower.begin(), lower.end(), lower.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+  return lower.find("chan") != std::string::npos || lower == "ch" || lower == "mic";
+}
+
+/// planes[c][i] = src[i * channels + c] * scale for S16 or S32 input
+template <typename T>
+inline void DeinterleaveToFloat(const T* src, int32_t channels, size_t frames, float* const* planes, float scale) {
+  static_assert(std::is_same_v<T, int16_t> || std::is_same_v<T, int32_t>);
+  for (int32_t c = 0; c < channels; ++c) {
+    const T* in = src + c;
+    float* out = planes[c];
+    size_t i = 0;
+#if defined(MAGIC_SIMD_AVX2)
+    const __m256 vscale = _mm256_set1_ps(scale);
+    if (channels == 1) {
+      for (; i + 8 <= frames; i += 8) {
+        __m256i v;
+        if constexpr (std::is_same_v<T, int16_t>) {
+          v = _mm256_cvtepi16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)));
+        } else {
+          v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i));
+        }
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), vscale));
+      }
+    } else {
+      // Gather one channel of 8 frames; 16-bit gathers read 32 bits, so the last frame is left to the tail
+      const __m256i offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(channels * static_cast<int32_t>(sizeof(T))));
+      for (; i + 8 < frames; i += 8) {
+        __m256i v = _mm256_i32gather_epi32(reinterpret_cast<const int*>(in + i * channels), offsets, 1);
+        if constexpr (std::is_same_v<T, int16_t>) {
+          v = _mm256_srai_epi32(_mm256_slli_epi32(v, 16), 16);
+        }
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(_mm256_cvtepi32_ps(v), vscale));
+      }
+    }
+#elif defined(MAGIC_SIMD_NEON)
+    if constexpr (std::is_same_v<T, int16_t>) {
+      if (channels == 1) {
+        for (; i + 8 <= frames; i += 8) {
+          int16x8_t v = vld1q_s16(in + i);
+          vst1q_f32(out + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), scale));
+          vst1q_f32(out + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), scale));
+        }
+      }
+    } else {
+      if (channels == 1) {
+        for (; i + 4 <= frames; i += 4) {
+          vst1q_f32(out + i, vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(in + i)), scale));
+        }
+      }
+    }
+#endif
+    for (; i < frames; ++i) {
+      out[i] = static_cast<float>(in[i * channels]) * scale;
+    }
+  }
+}
+
+#if defined(MAGIC_SIMD_NEON)
+/// Structured-load deinterleave for 2 to 4 interleaved S16 channels; returns the number of frames done
+inline size_t DeinterleaveS16Neon(const int16_t* src, int32_t channels, size_t frames, float* const* planes, float scale) {
+  size_t i = 0;
+  auto store = [&](int32_t c, int16x8_t v) {
+    vst1q_f32(planes[c] + i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(v))), scale));
+    vst1q_f32(planes[c] + i + 4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), scale));
+  };
+  if (channels == 2) {
+    for (; i + 8 <= frames; i += 8) {
+      int16x8x2_t v = vld2q_s16(src + i * 2);
+      store(0, v.val[0]);
+      store(1, v.val[1]);
+    }
+  } else if (channels == 3) {
+    for (; i + 8 <= frames; i += 8) {
+      int16x8x3_t v = vld3q_s16(src + i * 3);
+      store(0, v.val[0]);
+      store(1, v.val[1]);
+      store(2, v.val[2]);
+    }
+  } else if (channels == 4) {
+    for (; i + 8 <= frames; i += 8) {
+      int16x8x4_t v = vld4q_s16(src + i * 4);
+      store(0, v.val[0]);
+      store(1, v.val[1]);
+      store(2, v.val[2]);
+      store(3, v.val[3]);
+    }
+  }
+  return i;
+}
+#endif
+
+/// out[i] = saturate(round(in[i] * scale)), ties to even
+inline void FloatToS16(const float* in, int16_t* out, size_t n, float scale) {
+  size_t i = 0;
+#if defined(MAGIC_SIMD_AVX2)
+  const __m256 vscale = _mm256_set1_ps(scale);
+  const __m256 lo = _mm256_set1_ps(-32768.0f);
+  const __m256 hi = _mm256_set1_ps(32767.0f);
+  for (; i + 16 <= n; i += 16) {
+    __m256 a = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(in + i), vscale), lo), hi);
+    __m256 b = _mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_loadu_ps(in + i + 8), vscale), lo), hi);
+    __m256i packed = _mm256_packs_epi32(_mm256_cvtps_epi32(a), _mm256_cvtps_epi32(b));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_permute4x64_epi64(packed, 0xD8));
+  }
+#elif defined(MAGIC_SIMD_NEON)
+  const float32x4_t lo = vdupq_n_f32(-32768.0f);
+  const float32x4_t hi = vdupq_n_f32(32767.0f);
+  for (; i + 8 <= n; i += 8) {
+    float32x4_t a = vminq_f32(vmaxq_f32(vmulq_n_f32(vld1q_f32(in + i), scale), lo), hi);
+    float32x4_t b = vminq_f32(vmaxq_f32(vmulq_n_f32(vld1q_f32(in + i + 4), scale), lo), hi);
+    vst1q_s16(out + i, vcombine_s16(vqmovn_s32(vcvtnq_s32_f32(a)), vqmovn_s32(vcvtnq_s32_f32(b))));
+  }
+#endif
+  for (; i < n; ++i) {
+    out[i] = static_cast<int16_t>(std::nearbyint(std::min(std::max(in[i] * scale, -32768.0f), 32767.0f)));
+  }
+}
+
+/// Dot product of two float arrays, n a multiple of 8
+inline float DotProduct8(const float* a, const float* b, size_t n) {
+#if defined(MAGIC_SIMD_AVX2)
+  __m256 acc = _mm256_setzero_ps();
+  for (size_t i = 0; i < n; i += 8) {
+    acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i)));
+  }
+  __m128 sum = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+  sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+  sum = _mm_add_ss(sum, _mm_movehdup_ps(sum));
+  return _mm_cvtss_f32(sum);
+#elif defined(MAGIC_SIMD_NEON)
+  float32x4_t acc0 = vdupq_n_f32(0.0f);
+  float32x4_t acc1 = vdupq_n_f32(0.0f);
+  for (size_t i = 0; i < n; i += 8) {
+    acc0 = vmlaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+    acc1 = vmlaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+  }
+  return vaddvq_f32(vaddq_f32(acc0, acc1));
+#else
+  float acc[8] = {};
+  for (size_t i = 0; i < n; i += 8) {
+    for (size_t k = 0; k < 8; ++k) {
+      acc[k] += a[i + k] * b[i + k];
+    }
+  }
+  return ((acc[0] + acc[4]) + (acc[1] + acc[5])) + ((acc[2] + acc[6]) + (acc[3] + acc[7]));
+#endif
+}
+
+/// Zeroth-order modified Bessel function of the first kind, for the Kaiser window
+inline double BesselI0(double x) {
+  double sum = 1.0;
+  double term = 1.0;
+  for (int32_t k = 1; k < 50 && term > sum * 1e-12; ++k) {
+    term *= (x / (2.0 * k)) * (x / (2.0 * k));
+    sum += term;
+  }
+  return sum;
+}
+
+}  // namespace detail
+
+/**
+ * @brief Derive the PCM layout of a voice message from its MultiArrayLayout.
+ *
+ * With two dimensions the one labelled "channel(s)" (or else the second, fastest varying one) gives the channel
+ * count; channels first means planar data. The sample width follows from the payload size when the frame count is
+ * known, otherwise default_format is assumed. Messages without dimensions use default_channels.
+ * @param msg Voice message.
+ * @param[out] layout Channel count, frame count, sample format and data offset.
+ * @param default_channels Channel count when the layout carries none.
+ * @param default_format Sample format when it cannot be derived.
+ * @return false if the layout is inconsistent with the payload.
+ */
+inline bool GetAudioLayout(const ByteMultiArray& msg, AudioLayout& layout, int32_t default_channels = 1,
+                           AudioSampleFormat default_format = AudioSampleFormat::S16) {
+  size_t offset = static_cast<size_t>(std::max(msg.layout.data_offset, 0));
+  if (offset > msg.data.size()) {
+    return false;
+  }
+  size_t payload = msg.data.size() - offset;
+  int64_t channels = default_channels;
+  int64_t frames = 0;
+  bool planar = false;
+  const auto& dims = msg.layout.dim;
+  if (dims.size() >= 2) {
+    size_t channel_dim = detail::IsChannelLabel(dims[0].label) ? 0 : 1;
+    channels = dims[channel_dim].size;
+    frames = dims[1 - channel_dim].size;
+    planar = channel_dim == 0;
+  } else if (dims.size() == 1 && detail::IsChannelLabel(dims[0].label)) {
+    channels = dims[0].size;
+  }
+  if (channels <= 0 || channels > 256) {
+    return false;
+  }
+  size_t sample_bytes = default_format == AudioSampleFormat::S32 ? 4 : 2;
+  if (frames > 0) {
+    size_t samples = static_cast<size_t>(frames) * static_cast<size_t>(channels);
+    if (payload != samples * 2 && payload != samples * 4) {
+      return false;
+    }
+    sample_bytes = payload / samples;
+  }
+  if (offset % sample_bytes != 0) {
+    return false;
+  }
+  layout.channels = static_cast<int32_t>(channels);
+  layout.frames = payload / (sample_bytes * static_cast<size_t>(channels));
+  layout.format = sample_bytes == 4 ? AudioSampleFormat::S32 : AudioSampleFormat::S16;
+  layout.planar = planar;
+  layout.data_offset = offset;
+  return true;
+}
+
+/**
+ * @brief Split a voice message into per-channel float planes.
+ * @param msg Voice message in S16 or S32, interleaved or planar (see GetAudioLayout).
+ * @param[out] planes One plane per channel scaled to [-1, 1) times gain; capacity is reused.
+ * @param gain Linear gain.
+ * @param default_channels Channel count when the layout carries none.
+ * @return false if the layout is inconsistent with the payload.
+ */
+inline bool DeinterleaveAudio(const ByteMultiArray& msg, std::vector<std::vector<float>>& planes, float gain = 1.0f, int32_t default_channels = 1) {
+  AudioLayout layout;
+  if (!GetAudioLayout(msg, layout, default_channels)) {
+    return false;
+  }
+  planes.resize(static_cast<size_t>(layout.channels));
+  std::vector<float*> outputs(planes.size());
+  for (size_t c = 0; c < planes.size(); ++c) {
+    planes[c].resize(layout.frames);
+    outputs[c] = planes[c].data();
+  }
+  const uint8_t* data = msg.data.data() + layout.data_offset;
+  if (layout.format == AudioSampleFormat::S16) {
+    const auto* src = reinterpret_cast<const int16_t*>(data);
+    float scale = gain / 32768.0f;
+    if (layout.planar) {
+      for (int32_t c = 0; c < layout.channels; ++c) {
+        detail::DeinterleaveToFloat(src + c * layout.frames, 1, layout.frames, &outputs[c], scale);
+      }
+      return true;
+    }
+#if defined(MAGIC_SIMD_NEON)
+    size_t done = detail::DeinterleaveS16Neon(src, layout.channels, layout.frames, outputs.data(), scale);
+    if (done > 0) {
+      for (float*& out : outputs) {
+        out += done;
+      }
+      detail::DeinterleaveToFloat(src + done * layout.channels, layout.channels, layout.frames - done, outputs.data(), scale);
+      return true;
+    }
+#endif
+    detail::DeinterleaveToFloat(src, layout.channels, layout.frames, outputs.data(), scale);
+  } else {
+    const auto* src = reinterpret_cast<const int32_t*>(data);
+    float scale = gain / 2147483648.0f;
+    if (layout.planar) {
+      for (int32_t c = 0; c < layout.channels; ++c) {
+        detail::DeinterleaveToFloat(src + c * layout.frames, 1, layout.frames, &outputs[c], scale);
+      }
+      return true;
+    }
+    detail::DeinterleaveToFloat(src, layout.channels, layout.frames, outputs.data(), scale);
+  }
+  return true;
+}
+
+/**
+ * @brief Convert float samples in [-1, 1) to S16 with rounding and saturation.
+ * @param in Float samples.
+ * @param[out] out S16 samples, resized to in.size().
+ * @param gain Linear gain applied before conversion.
+ */
+inline void FloatToS16(const std::vector<float>& in, std::vector<int16_t>& out, float gain = 1.0f) {
+  out.resize(in.size());
+  detail::FloatToS16(in.data(), out.data(), in.size(), gain * 32768.0f);
+}
+
+/**
+ * @class PolyphaseResampler
+ * @brief Streaming rational sample-rate converter for one channel, e.g. 48 kHz to 16 kHz.
+ *
+ * The rate ratio is reduced to L/M and a Kaiser-windowed sinc low-pass (cut off at 45% of the lower rate) is split
+ * into L phases, so each output sample costs one taps_per_phase dot product and no zero-stuffed samples are
+ * touched. For 48 kHz to 16 kHz (L = 1, M = 3) this is a decimating FIR evaluated only at every third input.
+ * State is kept across calls, so chunks of any size can be fed.
+ *
+ * Example:
+ * @code
+ *   PolyphaseResampler resampler(48000, 16000);
+ *   std::vector<float> out;
+ *   resampler.Process(planes[0].data(), planes[0].size(), out);
+ * @endcode
+ */
+class PolyphaseResampler final : public NonCopyable {
+ public:
+  /**
+   * @brief Constructor
+   * @param input_rate Input sample rate (Hz).
+   * @param output_rate Output sample rate (Hz).
+   * @param taps_per_phase Filter length per phase, rounded up to a multiple of 8; 0 picks 32 per output period.
+   */
+  PolyphaseResampler(int32_t input_rate, int32_t output_rate, int32_t taps_per_phase = 0) {
+    input_rate = std::max(input_rate, 1);
+    output_rate = std::max(output_rate, 1);
+    int32_t g = std::gcd(input_rate, output_rate);
+    up_ = output_rate / g;
+    down_ = input_rate / g;
+    if (taps_per_phase <= 0) {
+      taps_per_phase = static_cast<int32_t>(std::ceil(32.0 * std::max(1.0, static_cast<double>(down_) / static_cast<double>(up_))));
+    }
+    taps_ = (static_cast<size_t>(taps_per_phase) + 7) / 8 * 8;
+    BuildFilter(input_rate, output_rate);
+    Reset();
+  }
+
+  /**
+   * @brief Resample the next chunk of input.
+   * @param input Input samples.
+   * @param count Number of input samples.
+   * @param[out] output Output samples produced by this chunk; capacity is reused.
+   */
+  void Process(const float* input, size_t count, std::vector<float>& output) {
+    history_.insert(history_.end(), input, input + count);
+    output.clear();
+    while (next_ + taps_ <= history_.size()) {
+      output.push_back(detail::DotProduct8(coeffs_.data() + phase_ * taps_, history_.data() + next_, taps_));
+      phase_ += down_;
+      next_ += phase_ / up_;
+      phase_ %= up_;
+    }
+    size_t consumed = std::min(next_, history_.size());
+    history_.erase(history_.begin(), history_.begin() + consumed);
+    next_ -= consumed;
+  }
+
+  /// Group delay of the filter in output samples
+  double GetDelay() const { return (static_cast<double>(up_ * taps_) - 1.0) / 2.0 / static_cast<double>(down_); }
+
+  /// Forget the signal history
+  void Reset() {
+    history_.assign(taps_ - 1, 0.0f);
+    next_ = 0;
+    phase_ = 0;
+  }
+
+ private:
+  // Phase p holds h[p + j * L] for j = taps - 1 .. 0, reversed so it lines up with the input window
+  void BuildFilter(int32_t input_rate, int32_t output_rate) {
+    size_t length = up_ * taps_;
+    double cutoff = 0.45 * std::min(input_rate, output_rate) / (static_cast<double>(input_rate) * static_cast<double>(up_));
+    double center = (static_cast<double>(length) - 1.0) / 2.0;
+    constexpr double kBeta = 8.0;
+    double norm = detail::BesselI0(kBeta);
+    std::vector<double> prototype(length);
+    double sum = 0.0;
+    for (size_t k = 0; k < length; ++k) {
+      double t = static_cast<double>(k) - center;
+      double x = 2.0 * cutoff * t;
+      double sinc = std::abs(x) < 1e-12 ? 1.0 : std::sin(M_PI * x) / (M_PI * x);
+      double r = length > 1 ? t / center : 0.0;
+      double window = detail::BesselI0(kBeta * std::sqrt(std::max(0.0, 1.0 - r * r))) / norm;
+      prototype[k] = sinc * window;
+      sum += prototype[k];
+    }
+    coeffs_.assign(length, 0.0f);
+    for (size_t p = 0; p < up_; ++p) {
+      for (size_t j = 0; j < taps_; ++j) {
+        coeffs_[p * taps_ + (taps_ - 1 - j)] = static_cast<float>(prototype[p + j * up_] * static_cast<double>(up_) / sum);
+      }
+    }
+  }
+
+  size_t up_{1};
+  size_t down_{1};
+  size_t taps_{8};
+  std::vector<float> coeffs_;
+  std::vector<float> history_;
+  size_t next_{0};
+  size_t phase_{0};
+};
+
+/**
+ * @brief Voice stream conversion parameters
+ */
+struct VoiceStreamConfig {
+  int32_t input_rate = 48000;   ///< Sample rate of the incoming stream (Hz)
+  int32_t output_rate = 16000;  ///< Sample rate of the output planes (Hz), equal to input_rate to skip resampling
+  float gain = 1.0f;            ///< Linear gain
+  int32_t default_channels = 1; ///< Channel count when the message layout carries none
+};
+
+/**
+ * @class VoiceStreamConverter
+ * @brief Turns raw voice messages into per-channel float or S16 planes at the target rate.
+ *
+ * Combines GetAudioLayout, DeinterleaveAudio and one PolyphaseResampler per channel. The channel count is read from
+ * each message's layout; when it changes, the resamplers are rebuilt.
+ *
+ * Example:
+ * @code
+ *   VoiceStreamConverter converter({.input_rate = 48000, .output_rate = 16000});
+ *   controller.SubscribeOriginVoiceData([&](const std::shared_ptr<ByteMultiArray> msg) {
+ *     std::vector<std::vector<float>> planes;
+ *     if (converter.Process(*msg, planes)) { ... }
+ *   });
+ * @endcode
+ */
+class VoiceStreamConverter final : public NonCopyable {
+ public:
+  explicit VoiceStreamConverter(const VoiceStreamConfig& config = {}) : config_(config) {}
+
+  /**
+   * @brief Convert one message.
+   * @param msg Raw voice message.
+   * @param[out] planes One float plane per channel in [-1, 1) times gain at output_rate.
+   * @return false if the message layout is inconsistent.
+   */
+  bool Process(const ByteMultiArray& msg, std::vector<std::vector<float>>& planes) {
+    if (!DeinterleaveAudio(msg, input_, config_.gain, config_.default_channels)) {
+      return false;
+    }
+    channels_ = static_cast<int32_t>(input_.size());
+    if (config_.input_rate == config_.output_rate) {
+      planes.swap(input_);
+      return true;
+    }
+    if (resamplers_.size() != input_.size()) {
+      resamplers_.clear();
+      for (size_t c = 0; c < input_.size(); ++c) {
+        resamplers_.push_back(std::make_unique<PolyphaseResampler>(config_.input_rate, config_.output_rate));
+      }
+    }
+    planes.resize(input_.size());
+    for (size_t c = 0; c < input_.size(); ++c) {
+      resamplers_[c]->Process(input_[c].data(), input_[c].size(), planes[c]);
+    }
+    return true;
+  }
+
+  /**
+   * @brief Convert one message to S16 planes.
+   * @param msg Raw voice message.
+   * @param[out] planes One S16 plane per channel at output_rate, saturated.
+   * @return false if the message layout is inconsistent.
+   */
+  bool Process(const ByteMultiArray& msg, std::vector<std::vector<int16_t>>& planes) {
+    if (!Process(msg, float_planes_)) {
+      return false;
+    }
+    planes.resize(float_planes_.size());
+    for (size_t c = 0; c < float_planes_.size(); ++c) {
+      FloatToS16(float_planes_[c], planes[c]);
+    }
+    return true;
+  }
+
+  /// Channel count of the last converted message
+  int32_t GetChannels() const { return channels_; }
+
+  /// Forget the resampler history, e.g. after a gap in the stream
+  void Reset() {
+    for (auto& resampler : resamplers_) {
+      resampler->Reset();
+    }
+  }
+
+ private:
+  VoiceStreamConfig config_;
+  int32_t channels_{0};
+  std::vector<std::unique_ptr<PolyphaseResampler>> resamplers_;
+  std::vector<std::vector<float>> input_;
+  std::vector<std::vector<float>> float_planes_;
+};
+
+}  // namespace magic::dog::audio
@@ -0,0 +1,374 @@
+#pragma once
+
+#include "magic_type.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+
+namespace magic::dog::audio {
+
+/**
+ * @brief Audio ring buffer parameters
+ */
+struct AudioRingConfig {
+  int32_t sample_rate = 16000;  ///< Frame rate of the stream (Hz)
+  int32_t channels = 1;         ///< Interleaved channels per frame
+  int32_t capacity_ms = 2000;   ///< Audio kept before the oldest unread samples are overwritten (ms), rounded up
+};
+
+/**
+ * @brief Position and timing of one block returned by AudioRingBuffer::Read
+ */
+struct AudioBlockInfo {
+  uint64_t position = 0;         ///< Index of the first frame since the buffer was created or reset
+  int64_t capture_time = 0;      ///< Capture time of the first frame (ns, system clock)
+  uint64_t dropped_samples = 0;  ///< Samples lost to overruns since the previous read; non-zero means a gap before this block
+};
+
+namespace detail {
+
+/// Current system time in nanoseconds
+inline int64_t AudioNowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief Maps frame indices of an untimestamped stream to capture times.
+ *
+ * Each chunk is assumed to end at its arrival time minus an unknown, jittery delivery latency. The clock follows
+ * the earliest arrival (the least delayed chunk) and slowly leaks upward to absorb clock drift; an offset change of
+ * more than 200 ms is treated as a gap and re-anchors the clock.
+ */
+class SampleClock {
+ public:
+  explicit SampleClock(int32_t sample_rate = 16000) : sample_rate_(std::max(sample_rate, 1)) {}
+
+  /// Duration of frame_count frames (ns), exact for any stream length
+  int64_t Duration(int64_t frame_count) const {
+    return frame_count / sample_rate_ * 1000000000LL + frame_count % sample_rate_ * 1000000000LL / sample_rate_;
+  }
+
+  /**
+   * @brief Account for a chunk that ends at frame end_frame and arrived at arrival_time.
+   * @return true if the clock was (re-)anchored.
+   */
+  bool Update(int64_t end_frame, int64_t arrival_time) {
+    int64_t offset = arrival_time - Duration(end_frame);
+    if (!anchored_ || std::llabs(offset - base_) > 200000000LL) {
+      base_ = offset;
+      anchored_ = true;
+      return true;
+    }
+    if (offset < base_) {
+      base_ = offset;
+    } else {
+      base_ += (offset - base_) / 256;
+    }
+    return false;
+  }
+
+  /// Capture time of a frame (ns)
+  int64_t TimeAt(int64_t frame) const { return base_ + Duration(frame); }
+
+  /// Capture time of frame 0 (ns)
+  int64_t Base() const { return base_; }
+
+  void Reset() {
+    base_ = 0;
+    anchored_ = false;
+  }
+
+ private:
+  int64_t sample_rate_;
+  int64_t base_{0};
+  bool anchored_{false};
+};
+
+}  // namespace detail
+
+/**
+ * @class AudioRingBuffer
+ * @brief Lock-free single-producer single-consumer ring for one voice stream with pull-based, timestamped reads.
+ *
+ * The voice subscriptions push chunks of arbitrary size without timestamps. The ring stores interleaved S16 frames
+ * and lets DSP code pull fixed-size blocks, each with the capture time of its first frame. The producer never
+ * blocks: when the consumer falls behind by more than the capacity, the oldest samples are overwritten, the next
+ * Read resynchronises to the newest half of the ring and reports the loss in AudioBlockInfo::dropped_samples.
+ *
+ * Capture times come from a sample clock anchored to chunk arrival times (the stream carries none), so they are
+ * sample-accurate relative to each other and offset from the true capture time by the minimum delivery latency.
+ *
+ * Example:
+ * @code
+ *   AudioRingBuffer ring({.sample_rate = 16000, .channels = 1, .capacity_ms = 2000});
+ *   controller.SubscribeBfVoiceData(ring.Callback());
+ *   std::array<int16_t, 512> frame;
+ *   AudioBlockInfo info;
+ *   while (ring.Read(frame, std::chrono::milliseconds(100), info) > 0) { ... }
+ * @endcode
+ */
+class AudioRingBuffer final : public NonCopyable {
+ public:
+  using ByteMultiArrayCallback = std::function<void(const std::shared_ptr<ByteMultiArray>)>;
+
+  explicit AudioRingBuffer(const AudioRingConfig& config = {})
+      : sample_rate_(std::max(config.sample_rate, 1)), channels_(std::max(config.channels, 1)), clock_(sample_rate_) {
+    uint64_t wanted = static_cast<uint64_t>(sample_rate_) * channels_ * std::max(config.capacity_ms, 1) / 1000;
+    uint64_t size = 2;
+    while (size < wanted) {
+      size <<= 1;
+    }
+    mask_ = size - 1;
+    samples_ = std::make_unique<int16_t[]>(size);
+  }
+
+  /**
+   * @brief Append interleaved S16 frames (single producer).
+   * @param samples Interleaved samples; a trailing partial frame is ignored.
+   * @param count Number of samples (frames * channels).
+   * @param arrival_time Time the chunk was received (ns, system clock), 0 for now.
+   */
+  void Push(const int16_t* samples, size_t count, int64_t arrival_time = 0) {
+    count -= count % channels_;
+    if (count == 0) {
+      return;
+    }
+    uint64_t w = write_.load(std::memory_order_relaxed);
+    UpdateAnchor(w, count, arrival_time != 0 ? arrival_time : detail::AudioNowNs());
+    // Announce the overwrite before touching the samples, so a reader copying them can detect the tear
+    reserve_.store(w + count, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    uint64_t capacity = mask_ + 1;
+    if (count > capacity) {
+      samples += count - capacity;
+      w += count - capacity;
+      count = capacity;
+    }
+    size_t offset = static_cast<size_t>(w & mask_);
+    size_t first = std::min<size_t>(count, capacity - offset);
+    std::memcpy(samples_.get() + offset, samples, first * sizeof(int16_t));
+    std::memcpy(samples_.get(), samples + first, (count - first) * sizeof(int16_t));
+    write_.store(w + count, std::memory_order_release);
+    // Pairs with the fence in WaitFor: either the reader sees the new write index or we see it waiting
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (waiting_.load(std::memory_order_relaxed)) {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+      }
+      cv_.notify_all();
+    }
+  }
+
+  /// Append one voice message interpreted as interleaved S16LE
+  void Push(const ByteMultiArray& msg, int64_t arrival_time = 0) {
+    Push(reinterpret_cast<const int16_t*>(msg.data.data()), msg.data.size() / sizeof(int16_t), arrival_time);
+  }
+
+  /**
+   * @brief Callback suitable for SubscribeOriginVoiceData / SubscribeBfVoiceData.
+   * @note The buffer must outlive the subscription.
+   */
+  ByteMultiArrayCallback Callback() {
+    return [this](const std::shared_ptr<ByteMultiArray> msg) {
+      if (msg) {
+        Push(*msg);
+      }
+    };
+  }
+
+  /**
+   * @brief Read exactly out.size() samples (single consumer).
+   * @param out Destination, its size must be a multiple of the channel count and at most the capacity.
+   * @param timeout Maximum time to wait for enough samples, 0 to poll.
+   * @param[out] info Position, capture time and overrun loss of the block.
+   * @return out.size() on success, 0 on timeout, after Close() or for an invalid size; nothing is consumed then.
+   */
+  size_t Read(std::span<int16_t> out, std::chrono::milliseconds timeout, AudioBlockInfo& info) {
+    uint64_t need = out.size();
+    if (need == 0 || need % channels_ != 0 || need > mask_ + 1) {
+      return 0;
+    }
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    uint64_t r = read_.load(std::memory_order_relaxed);
+    while (true) {
+      uint64_t w = write_.load(std::memory_order_acquire);
+      if (w - r > mask_ + 1) {
+        r = Resync(r, w);
+      }
+      if (w - r < need) {
+        if (!WaitFor(r + need, deadline)) {
+          return 0;
+        }
+        continue;
+      }
+      size_t offset = static_cast<size_t>(r & mask_);
+      size_t first = std::min<size_t>(need, mask_ + 1 - offset);
+      std::memcpy(out.data(), samples_.get() + offset, first * sizeof(int16_t));
+      std::memcpy(out.data() + first, samples_.get(), (need - first) * sizeof(int16_t));
+      std::atomic_thread_fence(std::memory_order_acquire);
+      uint64_t reserved = reserve_.load(std::memory_order_relaxed);
+      if (reserved - r > mask_ + 1) {
+        // The producer lapped us while copying
+        r = Resync(r, reserved);
+        continue;
+      }
+      info.position = r / channels_;
+      info.capture_time = TimeAt(info.position);
+      info.dropped_samples = pending_dropped_;
+      pending_dropped_ = 0;
+      read_.store(r + need, std::memory_order_release);
+      return need;
+    }
+  }
+
+  /// Read without block information
+  size_t Read(std::span<int16_t> out, std::chrono::milliseconds timeout) {
+    AudioBlockInfo info;
+    return Read(out, timeout, info);
+  }
+
+  /// Capture time of a frame position (ns), as reported in AudioBlockInfo
+  int64_t TimeAt(uint64_t position) const {
+    uint64_t count = anchor_count_.load(std::memory_order_acquire);
+    for (uint64_t n = count; n > 0 && count - n < kAnchorSlots; --n) {
+      const Anchor& anchor = anchors_[(n - 1) % kAnchorSlots];
+      uint64_t seq, frame;
+      int64_t base;
+      do {
+        seq = anchor.seq.load(std::memory_order_acquire);
+        frame = anchor.position.load(std::memory_order_relaxed);
+        base = anchor.base.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+      } while ((seq & 1) != 0 || seq != anchor.seq.load(std::memory_order_relaxed));
+      // Positions older than every retained anchor use the oldest one
+      if (position >= frame || n == 1 || count - n + 1 == kAnchorSlots) {
+        return base + clock_.Duration(static_cast<int64_t>(position));
+      }
+    }
+    return 0;
+  }
+
+  /// Unread samples, including samples that an overrun will discard
+  size_t Available() const {
+    return static_cast<size_t>(std::min<uint64_t>(write_.load(std::memory_order_acquire) - read_.load(std::memory_order_acquire), mask_ + 1));
+  }
+
+  /// Capacity in samples (frames * channels)
+  size_t Capacity() const { return mask_ + 1; }
+
+  int32_t GetSampleRate() const { return sample_rate_; }
+
+  int32_t GetChannels() const { return channels_; }
+
+  /// Number of overruns detected by Read
+  uint64_t GetOverrunCount() const { return overruns_.load(std::memory_order_relaxed); }
+
+  /// Total samples lost to overruns
+  uint64_t GetDroppedSamples() const { return dropped_.load(std::memory_order_relaxed); }
+
+  /// Wake a blocked Read and make further reads fail until Reset
+  void Close() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      closed_ = true;
+    }
+    cv_.notify_all();
+  }
+
+  /// Drop all samples, counters and timing (must not race with Push or Read)
+  void Reset() {
+    write_.store(0, std::memory_order_relaxed);
+    reserve_.store(0, std::memory_order_relaxed);
+    read_.store(0, std::memory_order_relaxed);
+    anchor_count_.store(0, std::memory_order_relaxed);
+    overruns_.store(0, std::memory_order_relaxed);
+    dropped_.store(0, std::memory_order_relaxed);
+    pending_dropped_ = 0;
+    clock_.Reset();
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_ = false;
+  }
+
+ private:
+  static constexpr uint64_t kAnchorSlots = 16;
+
+  struct Anchor {
+    std::atomic<uint64_t> seq{0};
+    std::atomic<uint64_t> position{0};
+    std::atomic<int64_t> base{0};
+  };
+
+  // Producer side: a re-anchor starts a new time segment at the chunk, otherwise the current segment is refined
+  void UpdateAnchor(uint64_t w, size_t count, int64_t arrival_time) {
+    uint64_t start_frame = w / channels_;
+    bool reanchored = clock_.Update(static_cast<int64_t>(start_frame + count / channels_), arrival_time);
+    uint64_t n = anchor_count_.load(std::memory_order_relaxed);
+    Anchor& anchor = anchors_[(reanchored || n == 0 ? n : n - 1) % kAnchorSlots];
+    if (!reanchored && n > 0 && anchor.base.load(std::memory_order_relaxed) == clock_.Base()) {
+      return;
+    }
+    uint64_t seq = anchor.seq.load(std::memory_order_relaxed);
+    anchor.seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    if (reanchored || n == 0) {
+      anchor.position.store(start_frame, std::memory_order_relaxed);
+    }
+    anchor.base.store(clock_.Base(), std::memory_order_relaxed);
+    anchor.seq.store(seq + 2, std::memory_order_release);
+    if (reanchored || n == 0) {
+      anchor_count_.store(n + 1, std::memory_order_release);
+    }
+  }
+
+  // Consumer side: skip to the newest half of the ring after being lapped
+  uint64_t Resync(uint64_t r, uint64_t w) {
+    uint64_t keep = (mask_ + 1) / 2 / channels_ * channels_;
+    uint64_t next = w - keep;
+    if (next <= r) {
+      return r;
+    }
+    pending_dropped_ += next - r;
+    dropped_.fetch_add(next - r, std::memory_order_relaxed);
+    overruns_.fetch_add(1, std::memory_order_relaxed);
+    read_.store(next, std::memory_order_release);
+    return next;
+  }
+
+  bool WaitFor(uint64_t target, std::chrono::steady_clock::time_point deadline) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    waiting_.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    bool ready = cv_.wait_until(lock, deadline, [&] { return closed_ || write_.load(std::memory_order_acquire) >= target; });
+    waiting_.store(false, std::memory_order_relaxed);
+    return ready && !closed_;
+  }
+
+  int32_t sample_rate_;
+  int32_t channels_;
+  uint64_t mask_{0};
+  std::unique_ptr<int16_t[]> samples_;
+  std::atomic<uint64_t> write_{0};
+  std::atomic<uint64_t> reserve_{0};
+  std::atomic<uint64_t> read_{0};
+  detail::SampleClock clock_;
+  Anchor anchors_[kAnchorSlots];
+  std::atomic<uint64_t> anchor_count_{0};
+  std::atomic<uint64_t> overruns_{0};
+  std::atomic<uint64_t> dropped_{0};
+  uint64_t pending_dropped_{0};
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::atomic<bool> waiting_{false};
+  bool closed_{false};
+};
+
+}  // namespace magic::dog::audio
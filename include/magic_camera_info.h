@@ -0,0 +1,132 @@
+#pragma once
+
+#include "magic_type.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+namespace magic::dog::sensor {
+
+/**
+ * @brief Camera streams that publish CameraInfo
+ */
+enum class CameraStream : int8_t {
+  RGBD_DEPTH = 0,  ///< SubscribeRgbDepthCameraInfo / SubscribeRgbdDepthImage
+  RGBD_COLOR = 1,  ///< SubscribeRgbdColorCameraInfo / SubscribeRgbdColorImage
+};
+
+/**
+ * @brief Whether two CameraInfo messages carry the same calibration (header is ignored)
+ */
+inline bool IsSameCalibration(const CameraInfo& a, const CameraInfo& b) {
+  return a.height == b.height && a.width == b.width && a.K == b.K && a.R == b.R && a.P == b.P &&
+         a.binning_x == b.binning_x && a.binning_y == b.binning_y && a.roi_x_offset == b.roi_x_offset &&
+         a.roi_y_offset == b.roi_y_offset && a.roi_height == b.roi_height && a.roi_width == b.roi_width &&
+         a.roi_do_rectify == b.roi_do_rectify && a.D == b.D && a.distortion_model == b.distortion_model;
+}
+
+/**
+ * @class CameraInfoCache
+ * @brief Keeps the latest CameraInfo per stream and forwards it only when the calibration changes.
+ *
+ * The SDK publishes CameraInfo with every frame; this cache compares each message with the stored one and
+ * bumps a per-stream intrinsics version only on change. Images can be tagged with that version so consumers
+ * re-parse calibration only when it differs from the version they last saw.
+ *
+ * Example:
+ * @code
+ *   CameraInfoCache cache;
+ *   controller.SubscribeRgbDepthCameraInfo(cache.Callback(CameraStream::RGBD_DEPTH, on_calibration_changed));
+ *   controller.SubscribeRgbdDepthImage(cache.WrapImageCallback(CameraStream::RGBD_DEPTH,
+ *       [](const std::shared_ptr<Image> image, uint32_t intrinsics_version) { ... }));
+ * @endcode
+ */
+class CameraInfoCache final : public NonCopyable {
+ public:
+  using CameraInfoPtr = std::shared_ptr<const CameraInfo>;
+  using CameraInfoCallback = std::function<void(const CameraInfoPtr)>;
+  using VersionedImageCallback = std::function<void(const std::shared_ptr<Image>, uint32_t)>;
+
+  CameraInfoCache() = default;
+
+  /**
+   * @brief Feed a received CameraInfo.
+   * @param stream Stream the message belongs to.
+   * @param info Received message.
+   * @return true if the calibration changed (or is the first one) and the cache was updated.
+   */
+  bool Update(CameraStream stream, const std::shared_ptr<CameraInfo>& info) {
+    if (!info) {
+      return false;
+    }
+    Entry& entry = entries_[Index(stream)];
+    std::lock_guard<std::mutex> lock(entry.mutex);
+    if (entry.info && IsSameCalibration(*entry.info, *info)) {
+      return false;
+    }
+    // A private copy: the SDK message stays mutable through the subscriber's non-const pointer
+    entry.info = std::make_shared<const CameraInfo>(*info);
+    entry.version.fetch_add(1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Callback for SubscribeRgbDepthCameraInfo / SubscribeRgbdColorCameraInfo.
+   * @param stream Stream the subscription belongs to.
+   * @param on_change Optional, invoked only when the calibration changes.
+   * @note The cache must outlive the subscription.
+   */
+  std::function<void(const std::shared_ptr<CameraInfo>)> Callback(CameraStream stream, CameraInfoCallback on_change = nullptr) {
+    return [this, stream, on_change = std::move(on_change)](const std::shared_ptr<CameraInfo> info) {
+      if (Update(stream, info) && on_change) {
+        on_change(GetCameraInfo(stream));
+      }
+    };
+  }
+
+  /**
+   * @brief Wrap an image consumer so each image is delivered with the current intrinsics version of its stream.
+   * @param stream Stream the image subscription belongs to.
+   * @param callback Consumer, receives the image and the intrinsics version (0 if no CameraInfo was received yet).
+   */
+  std::function<void(const std::shared_ptr<Image>)> WrapImageCallback(CameraStream stream, VersionedImageCallback callback) {
+    return [this, stream, callback = std::move(callback)](const std::shared_ptr<Image> image) {
+      callback(image, GetIntrinsicsVersion(stream));
+    };
+  }
+
+  /**
+   * @brief Get the cached calibration of a stream.
+   * @return Read-only copy shared by all readers, nullptr if no CameraInfo was received yet.
+   */
+  CameraInfoPtr GetCameraInfo(CameraStream stream) const {
+    const Entry& entry = entries_[Index(stream)];
+    std::lock_guard<std::mutex> lock(entry.mutex);
+    return entry.info;
+  }
+
+  /**
+   * @brief Get the intrinsics version of a stream, incremented on every calibration change.
+   * @return 0 if no CameraInfo was received yet.
+   */
+  uint32_t GetIntrinsicsVersion(CameraStream stream) const {
+    return entries_[Index(stream)].version.load(std::memory_order_acquire);
+  }
+
+ private:
+  struct Entry {
+    mutable std::mutex mutex;
+    CameraInfoPtr info;
+    std::atomic<uint32_t> version{0};
+  };
+
+  static size_t Index(CameraStream stream) { return static_cast<size_t>(stream); }
+
+  std::array<Entry, 2> entries_;
+};
+
+}  // namespace magic::dog::sensor
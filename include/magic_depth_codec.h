@@ -0,0 +1,401 @@
+#pragma once
+
+#include "magic_interned_string.h"
+#include "magic_simd.h"
+#include "magic_type.h"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace magic::dog::sensor {
+
+/// CompressedImage::format suffix of depth frames produced by CompressDepth, e.g. "16UC1; grvl"
+inline constexpr std::string_view kDepthCodecFormat = "grvl";
+
+namespace detail {
+
+constexpr uint32_t kDepthCodecMagic = 0x4C565247;  // "GRVL"
+constexpr uint16_t kDepthCodecVersion = 1;
+constexpr uint16_t kDepthCodecMono16 = 1;  // flags bit: source encoding was mono16 rather than 16UC1
+constexpr uint32_t kDepthCodecMaxDimension = 8192;  // width / height limit, bounds the decoder allocation
+
+// Payload header, followed by the run-length stream, the group width codes and the packed deltas
+struct DepthCodecHeader {
+  uint32_t magic;
+  uint16_t version;
+  uint16_t flags;
+  uint32_t width;
+  uint32_t height;
+  uint32_t value_count;  // number of non-zero pixels
+  uint32_t run_bytes;    // size of the run-length stream
+};
+static_assert(sizeof(DepthCodecHeader) == 24, "DepthCodecHeader layout");
+
+/// Bytes of one group of 8 deltas for each width code (0, 4, 8 or 16 bits per delta)
+constexpr size_t kDepthGroupBytes[4] = {0, 4, 8, 16};
+
+/// First index in [i, n) where a zero run (zero_run) or a non-zero run ends
+inline size_t FindRunEnd(const uint16_t* pixels, size_t i, size_t n, bool zero_run) {
+#if defined(MAGIC_SIMD_AVX2)
+  const __m256i zero = _mm256_setzero_si256();
+  for (; i + 16 <= n; i += 16) {
+    uint32_t zeros = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(pixels + i)), zero)));
+    uint32_t ends = zero_run ? ~zeros : zeros;
+    if (ends != 0) {
+      return i + __builtin_ctz(ends) / 2;
+    }
+  }
+#elif defined(MAGIC_SIMD_NEON)
+  for (; i + 8 <= n; i += 8) {
+    uint8x8_t zeros = vshrn_n_u16(vceqq_u16(vld1q_u16(pixels + i), vdupq_n_u16(0)), 4);
+    uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(zeros), 0);
+    uint64_t ends = zero_run ? ~mask : mask;
+    if (ends != 0) {
+      return i + __builtin_ctzll(ends) / 8;
+    }
+  }
+#endif
+  for (; i < n && (pixels[i] == 0) == zero_run; ++i) {
+  }
+  return i;
+}
+
+inline void WriteVarint(std::vector<uint8_t>& out, uint32_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<uint8_t>(value));
+}
+
+inline bool ReadVarint(const uint8_t*& p, const uint8_t* end, uint32_t& value) {
+  value = 0;
+  for (int32_t shift = 0; shift < 35 && p < end; shift += 7) {
+    uint8_t byte = *p++;
+    value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Zigzag deltas of values[1..8 * groups] against their predecessor (values[0] is a zero sentinel), packed per group
+ * of 8 at the narrowest of 0/4/8/16 bits. Width codes go 2 bits per group into control, low bits first.
+ */
+inline size_t EncodeDepthGroups(const uint16_t* values, size_t groups, uint8_t* control, uint8_t* out) {
+  uint8_t* start = out;
+  std::memset(control, 0, (groups + 3) / 4);
+  for (size_t g = 0; g < groups; ++g) {
+    const uint16_t* v = values + 1 + 8 * g;
+    uint32_t code = 0;
+#if defined(MAGIC_SIMD_AVX2)
+    __m128i delta = _mm_sub_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(v)), _mm_loadu_si128(reinterpret_cast<const __m128i*>(v - 1)));
+    __m128i zz = _mm_xor_si128(_mm_slli_epi16(delta, 1), _mm_srai_epi16(delta, 15));
+    if (!_mm_testz_si128(zz, _mm_set1_epi16(static_cast<int16_t>(0xFF00)))) {
+      code = 3;
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out), zz);
+    } else if (!_mm_testz_si128(zz, _mm_set1_epi16(0x00F0))) {
+      code = 2;
+      _mm_storel_epi64(reinterpret_cast<__m128i*>(out), _mm_packus_epi16(zz, zz));
+    } else if (!_mm_testz_si128(zz, zz)) {
+      code = 1;
+      // Adjacent deltas merge into one byte: even index in the low nibble
+      __m128i nibbles = _mm_packus_epi16(_mm_maddubs_epi16(_mm_packus_epi16(zz, zz), _mm_set1_epi16(0x1001)), _mm_setzero_si128());
+      uint32_t packed = static_cast<uint32_t>(_mm_cvtsi128_si32(nibbles));
+      std::memcpy(out, &packed, 4);
+    }
+#elif defined(MAGIC_SIMD_NEON)
+    int16x8_t delta = vreinterpretq_s16_u16(vsubq_u16(vld1q_u16(v), vld1q_u16(v - 1)));
+    uint16x8_t zz = vreinterpretq_u16_s16(veorq_s16(vshlq_n_s16(delta, 1), vshrq_n_s16(delta, 15)));
+    uint16_t max = vmaxvq_u16(zz);
+    if (max > 0xFF) {
+      code = 3;
+      vst1q_u16(reinterpret_cast<uint16_t*>(out), zz);
+    } else if (max > 0x0F) {
+      code = 2;
+      vst1_u8(out, vmovn_u16(zz));
+    } else if (max > 0) {
+      code = 1;
+      uint8x8_t bytes = vmovn_u16(zz);
+      uint16x4_t pairs = vreinterpret_u16_u8(bytes);
+      uint8x8_t merged = vmovn_u16(vcombine_u16(vorr_u16(vand_u16(pairs, vdup_n_u16(0x0F)), vshr_n_u16(pairs, 4)), vdup_n_u16(0)));
+      uint32_t packed = vget_lane_u32(vreinterpret_u32_u8(merged), 0);
+      std::memcpy(out, &packed, 4);
+    }
+#else
+    uint16_t zz[8];
+    uint16_t max = 0;
+    for (int32_t i = 0; i < 8; ++i) {
+      uint16_t delta = static_cast<uint16_t>(v[i] - v[i - 1]);
+      zz[i] = static_cast<uint16_t>((delta << 1) ^ (static_cast<int16_t>(delta) < 0 ? 0xFFFF : 0));
+      max = zz[i] > max ? zz[i] : max;
+    }
+    if (max > 0xFF) {
+      code = 3;
+      std::memcpy(out, zz, 16);
+    } else if (max > 0x0F) {
+      code = 2;
+      for (int32_t i = 0; i < 8; ++i) {
+        out[i] = static_cast<uint8_t>(zz[i]);
+      }
+    } else if (max > 0) {
+      code = 1;
+      for (int32_t i = 0; i < 4; ++i) {
+        out[i] = static_cast<uint8_t>(zz[2 * i] | (zz[2 * i + 1] << 4));
+      }
+    }
+#endif
+    control[g / 4] |= static_cast<uint8_t>(code << (2 * (g % 4)));
+    out += kDepthGroupBytes[code];
+  }
+  return static_cast<size_t>(out - start);
+}
+
+/// Inverse of EncodeDepthGroups; values receives 8 * groups values, the data size must have been validated
+inline void DecodeDepthGroups(const uint8_t* control, const uint8_t* data, size_t groups, uint16_t* values) {
+  uint16_t previous = 0;
+  for (size_t g = 0; g < groups; ++g) {
+    uint32_t code = (control[g / 4] >> (2 * (g % 4))) & 3;
+    uint16_t* v = values + 8 * g;
+#if defined(MAGIC_SIMD_AVX2)
+    __m128i zz;
+    if (code == 3) {
+      zz = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+    } else if (code == 2) {
+      zz = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(data)));
+    } else if (code == 1) {
+      int32_t packed;
+      std::memcpy(&packed, data, 4);
+      __m128i bytes = _mm_cvtsi32_si128(packed);
+      const __m128i low = _mm_set1_epi8(0x0F);
+      zz = _mm_cvtepu8_epi16(_mm_unpacklo_epi8(_mm_and_si128(bytes, low), _mm_and_si128(_mm_srli_epi16(bytes, 4), low)));
+    } else {
+      zz = _mm_setzero_si128();
+    }
+    __m128i delta = _mm_xor_si128(_mm_srli_epi16(zz, 1), _mm_sub_epi16(_mm_setzero_si128(), _mm_and_si128(zz, _mm_set1_epi16(1))));
+    // Inclusive prefix sum of the 8 deltas on top of the previous value
+    delta = _mm_add_epi16(delta, _mm_slli_si128(delta, 2));
+    delta = _mm_add_epi16(delta, _mm_slli_si128(delta, 4));
+    delta = _mm_add_epi16(delta, _mm_slli_si128(delta, 8));
+    __m128i result = _mm_add_epi16(delta, _mm_set1_epi16(static_cast<int16_t>(previous)));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(v), result);
+    previous = static_cast<uint16_t>(_mm_extract_epi16(result, 7));
+#elif defined(MAGIC_SIMD_NEON)
+    uint16x8_t zz;
+    if (code == 3) {
+      zz = vld1q_u16(reinterpret_cast<const uint16_t*>(data));
+    } else if (code == 2) {
+      zz = vmovl_u8(vld1_u8(data));
+    } else if (code == 1) {
+      uint32_t packed;
+      std::memcpy(&packed, data, 4);
+      uint8x8_t bytes = vreinterpret_u8_u32(vdup_n_u32(packed));
+      zz = vmovl_u8(vzip1_u8(vand_u8(bytes, vdup_n_u8(0x0F)), vshr_n_u8(bytes, 4)));
+    } else {
+      zz = vdupq_n_u16(0);
+    }
+    uint16x8_t sign = vreinterpretq_u16_s16(vnegq_s16(vreinterpretq_s16_u16(vandq_u16(zz, vdupq_n_u16(1)))));
+    uint16x8_t delta = veorq_u16(vshrq_n_u16(zz, 1), sign);
+    const uint16x8_t zero = vdupq_n_u16(0);
+    delta = vaddq_u16(delta, vextq_u16(zero, delta, 7));
+    delta = vaddq_u16(delta, vextq_u16(zero, delta, 6));
+    delta = vaddq_u16(delta, vextq_u16(zero, delta, 4));
+    uint16x8_t result = vaddq_u16(delta, vdupq_n_u16(previous));
+    vst1q_u16(v, result);
+    previous = vgetq_lane_u16(result, 7);
+#else
+    for (int32_t i = 0; i < 8; ++i) {
+      uint16_t zz = 0;
+      if (code == 3) {
+        std::memcpy(&zz, data + 2 * i, 2);
+      } else if (code == 2) {
+        zz = data[i];
+      } else if (code == 1) {
+        zz = static_cast<uint16_t>((data[i / 2] >> (4 * (i & 1))) & 0x0F);
+      }
+      uint16_t delta = static_cast<uint16_t>((zz >> 1) ^ (0 - (zz & 1)));
+      previous = static_cast<uint16_t>(previous + delta);
+      v[i] = previous;
+    }
+#endif
+    data += kDepthGroupBytes[code];
+  }
+}
+
+}  // namespace detail
+
+/// Whether a CompressedImage carries a depth frame produced by CompressDepth
+inline bool IsCompressedDepth(const CompressedImage& compressed) {
+  std::string_view format = compressed.format;
+  size_t suffix = kDepthCodecFormat.size() + 2;
+  return format.size() > suffix && format.ends_with(kDepthCodecFormat) && format.substr(format.size() - suffix, 2) == "; ";
+}
+
+/**
+ * @brief Lossless compression of a 16-bit depth image (grouped RVL).
+ *
+ * As in RVL, runs of invalid (zero) pixels are run-length coded and valid pixels are coded as zigzag deltas from the
+ * previous valid pixel. Instead of RVL's serial nibble code, deltas are packed in groups of 8 at a common width of
+ * 0, 4, 8 or 16 bits, so encoding and decoding of the deltas are vectorised (AVX2 / NEON) and independent of the
+ * delta values. The payload is little-endian.
+ * @param depth Depth image, "16UC1" or "mono16", either endianness, any row step.
+ * @param[out] compressed Header copied from the image, format "<encoding>; grvl"; buffer capacity is reused.
+ * @return false on unsupported encodings, images wider or taller than 8192 pixels or a malformed image.
+ */
+inline bool CompressDepth(const Image& depth, CompressedImage& compressed) {
+  ImageEncoding encoding = GetImageEncoding(depth);
+  if ((encoding != ImageEncoding::TYPE_16UC1 && encoding != ImageEncoding::MONO16) || depth.width <= 0 || depth.height <= 0 ||
+      static_cast<uint32_t>(depth.width) > detail::kDepthCodecMaxDimension ||
+      static_cast<uint32_t>(depth.height) > detail::kDepthCodecMaxDimension ||
+      depth.step < depth.width * 2 || depth.data.size() < static_cast<size_t>(depth.step) * depth.height) {
+    return false;
+  }
+  size_t width = static_cast<size_t>(depth.width);
+  size_t pixel_count = width * depth.height;
+  const uint16_t* pixels = reinterpret_cast<const uint16_t*>(depth.data.data());
+  // Padded rows and big-endian frames are normalised first; packed little-endian frames are read in place
+  thread_local std::vector<uint16_t> packed;
+  if (depth.is_bigendian || static_cast<size_t>(depth.step) != width * 2 || reinterpret_cast<uintptr_t>(pixels) % 2 != 0) {
+    packed.resize(pixel_count);
+    for (int32_t row = 0; row < depth.height; ++row) {
+      std::memcpy(packed.data() + row * width, depth.data.data() + static_cast<size_t>(row) * depth.step, width * 2);
+      if (depth.is_bigendian) {
+        for (size_t i = row * width; i < (row + 1) * width; ++i) {
+          packed[i] = static_cast<uint16_t>((packed[i] >> 8) | (packed[i] << 8));
+        }
+      }
+    }
+    pixels = packed.data();
+  }
+
+  thread_local std::vector<uint8_t> runs;
+  thread_local std::vector<uint16_t> values;
+  runs.clear();
+  values.resize(pixel_count + 9);
+  uint16_t* v = values.data();
+  size_t value_count = 0;
+  v[0] = 0;
+  for (size_t i = 0; i < pixel_count;) {
+    size_t zero_end = detail::FindRunEnd(pixels, i, pixel_count, true);
+    detail::WriteVarint(runs, static_cast<uint32_t>(zero_end - i));
+    size_t valid_end = detail::FindRunEnd(pixels, zero_end, pixel_count, false);
+    detail::WriteVarint(runs, static_cast<uint32_t>(valid_end - zero_end));
+    std::memcpy(v + 1 + value_count, pixels + zero_end, (valid_end - zero_end) * 2);
+    value_count += valid_end - zero_end;
+    i = valid_end;
+  }
+  // Pad the last group by repeating the last value, which costs zero-width deltas
+  size_t groups = (value_count + 7) / 8;
+  for (size_t i = value_count; i < groups * 8; ++i) {
+    v[1 + i] = v[i];
+  }
+
+  size_t control_bytes = (groups + 3) / 4;
+  size_t offset = sizeof(detail::DepthCodecHeader) + runs.size();
+  compressed.data.resize(offset + control_bytes + groups * 16);
+  uint8_t* out = compressed.data.data();
+  size_t data_bytes = detail::EncodeDepthGroups(v, groups, out + offset, out + offset + control_bytes);
+  compressed.data.resize(offset + control_bytes + data_bytes);
+
+  detail::DepthCodecHeader header{detail::kDepthCodecMagic,
+                                  detail::kDepthCodecVersion,
+                                  static_cast<uint16_t>(encoding == ImageEncoding::MONO16 ? detail::kDepthCodecMono16 : 0),
+                                  static_cast<uint32_t>(depth.width),
+                                  static_cast<uint32_t>(depth.height),
+                                  static_cast<uint32_t>(value_count),
+                                  static_cast<uint32_t>(runs.size())};
+  std::memcpy(out, &header, sizeof(header));
+  std::memcpy(out + sizeof(header), runs.data(), runs.size());
+  compressed.header = depth.header;
+  compressed.format.assign(ImageEncodingName(encoding));
+  compressed.format.append("; ");
+  compressed.format.append(kDepthCodecFormat);
+  return true;
+}
+
+/**
+ * @brief Decode a depth frame produced by CompressDepth.
+ * @param compressed Compressed frame.
+ * @param[out] depth Little-endian image with packed rows in the original encoding; buffer capacity is reused.
+ * @return false if the frame is not a compressed depth frame or is corrupt.
+ */
+inline bool DecompressDepth(const CompressedImage& compressed, Image& depth) {
+  if (!IsCompressedDepth(compressed) || compressed.data.size() < sizeof(detail::DepthCodecHeader)) {
+    return false;
+  }
+  detail::DepthCodecHeader header;
+  std::memcpy(&header, compressed.data.data(), sizeof(header));
+  size_t pixel_count = static_cast<size_t>(header.width) * header.height;
+  if (header.magic != detail::kDepthCodecMagic || header.version != detail::kDepthCodecVersion || header.width == 0 ||
+      header.height == 0 || header.width > detail::kDepthCodecMaxDimension || header.height > detail::kDepthCodecMaxDimension ||
+      header.value_count > pixel_count) {
+    return false;
+  }
+  const uint8_t* begin = compressed.data.data();
+  const uint8_t* end = begin + compressed.data.size();
+  const uint8_t* runs = begin + sizeof(header);
+  size_t groups = (static_cast<size_t>(header.value_count) + 7) / 8;
+  size_t control_bytes = (groups + 3) / 4;
+  if (static_cast<size_t>(end - runs) < static_cast<size_t>(header.run_bytes) + control_bytes) {
+    return false;
+  }
+  const uint8_t* control = runs + header.run_bytes;
+  const uint8_t* data = control + control_bytes;
+  size_t data_bytes = 0;
+  for (size_t g = 0; g < groups; ++g) {
+    data_bytes += detail::kDepthGroupBytes[(control[g / 4] >> (2 * (g % 4))) & 3];
+  }
+  if (static_cast<size_t>(end - data) != data_bytes) {
+    return false;
+  }
+  // The header sizes are untrusted: check that the runs cover the frame exactly before allocating anything
+  size_t pixel = 0;
+  size_t value = 0;
+  for (const uint8_t* run = runs; pixel < pixel_count;) {
+    uint32_t zeros = 0;
+    uint32_t valid = 0;
+    if (!detail::ReadVarint(run, control, zeros) || !detail::ReadVarint(run, control, valid) || zeros > pixel_count - pixel ||
+        valid > pixel_count - pixel - zeros || valid > header.value_count - value) {
+      return false;
+    }
+    pixel += static_cast<size_t>(zeros) + valid;
+    value += valid;
+    if (pixel == pixel_count && (value != header.value_count || run != control)) {
+      return false;
+    }
+  }
+  thread_local std::vector<uint16_t> values;
+  values.resize(groups * 8);
+  detail::DecodeDepthGroups(control, data, groups, values.data());
+
+  depth.header = compressed.header;
+  depth.width = static_cast<int32_t>(header.width);
+  depth.height = static_cast<int32_t>(header.height);
+  depth.step = depth.width * 2;
+  depth.is_bigendian = false;
+  depth.encoding.assign(ImageEncodingName((header.flags & detail::kDepthCodecMono16) ? ImageEncoding::MONO16 : ImageEncoding::TYPE_16UC1));
+  depth.data.resize(pixel_count * 2);
+  uint8_t* out = depth.data.data();
+  const uint8_t* run = runs;
+  pixel = 0;
+  value = 0;
+  while (pixel < pixel_count) {
+    uint32_t zeros = 0;
+    uint32_t valid = 0;
+    detail::ReadVarint(run, control, zeros);
+    detail::ReadVarint(run, control, valid);
+    std::memset(out + pixel * 2, 0, static_cast<size_t>(zeros) * 2);
+    pixel += zeros;
+    std::memcpy(out + pixel * 2, values.data() + value, static_cast<size_t>(valid) * 2);
+    pixel += valid;
+    value += valid;
+  }
+  return true;
+}
+
+}  // namespace magic::dog::sensor
@@ -0,0 +1,324 @@
+#pragma once
+
+#include "magic_interned_string.h"
+#include "magic_simd.h"
+#include "magic_type.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace magic::dog::sensor {
+
+/**
+ * @brief Region of interest on the depth image, zero width/height means up to the image border
+ */
+struct DepthRoi {
+  int32_t x_offset = 0;  ///< ROI start column
+  int32_t y_offset = 0;  ///< ROI start row
+  int32_t width = 0;     ///< ROI width (pixels)
+  int32_t height = 0;    ///< ROI height (pixels)
+};
+
+/**
+ * @brief Point cloud in structure-of-arrays layout, coordinates in meters in the camera optical frame
+ */
+struct PointCloudSoA {
+  std::vector<float> x;
+  std::vector<float> y;
+  std::vector<float> z;
+
+  size_t size() const { return z.size(); }
+
+  void clear() {
+    x.clear();
+    y.clear();
+    z.clear();
+  }
+};
+
+/**
+ * @class DepthProjector
+ * @brief Back-projects depth images into 3D points using pinhole intrinsics from CameraInfo::K.
+ *
+ * Ray directions ((u - cx) / fx, (v - cy) / fy) are computed once per configuration for every sampled column
+ * and row, so the per-frame work is one multiply per coordinate. Supported encodings are "16UC1"/"mono16"
+ * (millimeters by default, see SetDepthScale) and "32FC1" (meters). Pixels outside the depth range are dropped.
+ *
+ * Example:
+ * @code
+ *   DepthProjector projector;
+ *   projector.Configure(*camera_info, 2);  // every second row and column
+ *   PointCloudSoA cloud;
+ *   projector.Project(*depth_image, cloud);
+ * @endcode
+ */
+class DepthProjector final {
+ public:
+  DepthProjector() = default;
+
+  /**
+   * @brief Precompute the ray tables.
+   * @param info Intrinsics of the depth stream (SubscribeRgbDepthCameraInfo).
+   * @param stride Sample every stride-th row and column, >= 1.
+   * @param roi Region of the image to project.
+   * @return false if the intrinsics or the ROI are invalid.
+   */
+  bool Configure(const CameraInfo& info, int32_t stride = 1, const DepthRoi& roi = {}) {
+    configured_ = false;
+    double fx = info.K[0];
+    double fy = info.K[4];
+    double cx = info.K[2];
+    double cy = info.K[5];
+    if (fx <= 0.0 || fy <= 0.0 || stride < 1 || info.width <= 0 || info.height <= 0) {
+      return false;
+    }
+    int32_t x_end = roi.width > 0 ? roi.x_offset + roi.width : info.width;
+    int32_t y_end = roi.height > 0 ? roi.y_offset + roi.height : info.height;
+    if (roi.x_offset < 0 || roi.y_offset < 0 || x_end > info.width || y_end > info.height ||
+        roi.x_offset >= x_end || roi.y_offset >= y_end) {
+      return false;
+    }
+
+    width_ = info.width;
+    height_ = info.height;
+    stride_ = stride;
+    x_offset_ = roi.x_offset;
+    y_offset_ = roi.y_offset;
+    column_rays_.clear();
+    row_rays_.clear();
+    for (int32_t u = roi.x_offset; u < x_end; u += stride) {
+      column_rays_.push_back(static_cast<float>((u - cx) / fx));
+    }
+    for (int32_t v = roi.y_offset; v < y_end; v += stride) {
+      row_rays_.push_back(static_cast<float>((v - cy) / fy));
+    }
+    configured_ = true;
+    return true;
+  }
+
+  /// Whether Configure has succeeded
+  bool IsConfigured() const { return configured_; }
+
+  /// Meters per unit of 16-bit depth images, default 0.001 (millimeters)
+  void SetDepthScale(float scale) { depth_scale_ = scale; }
+
+  /// Valid depth range in meters, points outside are dropped
+  void SetDepthRange(float min_depth, float max_depth) {
+    min_depth_ = min_depth;
+    max_depth_ = max_depth;
+  }
+
+  /// Number of sampled points per frame before range filtering
+  size_t MaxPoints() const { return column_rays_.size() * row_rays_.size(); }
+
+  /**
+   * @brief Back-project a depth image into SoA buffers.
+   * @param depth Depth image, must match the configured resolution.
+   * @param[out] cloud Valid points, capacity is reused across calls.
+   * @return false on unsupported encoding or resolution mismatch.
+   */
+  bool Project(const Image& depth, PointCloudSoA& cloud) const {
+    if (!CheckImage(depth)) {
+      return false;
+    }
+    cloud.x.resize(MaxPoints());
+    cloud.y.resize(MaxPoints());
+    cloud.z.resize(MaxPoints());
+    size_t count = ProjectImage(depth, SoaWriter{cloud.x.data(), cloud.y.data(), cloud.z.data()});
+    cloud.x.resize(count);
+    cloud.y.resize(count);
+    cloud.z.resize(count);
+    return true;
+  }
+
+  /**
+   * @brief Back-project a depth image into an unorganized PointCloud2 with float32 x, y, z fields.
+   * @param depth Depth image, must match the configured resolution.
+   * @param[out] cloud Output cloud, header is copied from the image.
+   * @return false on unsupported encoding or resolution mismatch.
+   */
+  bool Project(const Image& depth, PointCloud2& cloud) const {
+    if (!CheckImage(depth)) {
+      return false;
+    }
+    cloud.data.resize(MaxPoints() * 3 * sizeof(float));
+    size_t count = ProjectImage(depth, AosWriter{reinterpret_cast<float*>(cloud.data.data())});
+    cloud.header = depth.header;
+    cloud.height = 1;
+    cloud.width = static_cast<int32_t>(count);
+    cloud.fields = {{"x", 0, POINT_FIELD_FLOAT32, 1}, {"y", 4, POINT_FIELD_FLOAT32, 1}, {"z", 8, POINT_FIELD_FLOAT32, 1}};
+    cloud.is_bigendian = false;
+    cloud.point_step = 12;
+    cloud.row_step = cloud.point_step * cloud.width;
+    cloud.is_dense = true;
+    cloud.data.resize(static_cast<size_t>(cloud.row_step));
+    return true;
+  }
+
+ private:
+  /// Writes points into separate x, y, z arrays
+  struct SoaWriter {
+    float* x;
+    float* y;
+    float* z;
+    void operator()(size_t i, float px, float py, float pz) const {
+      x[i] = px;
+      y[i] = py;
+      z[i] = pz;
+    }
+  };
+
+  /// Writes points as packed x, y, z triplets
+  struct AosWriter {
+    float* xyz;
+    void operator()(size_t i, float px, float py, float pz) const {
+      xyz[3 * i] = px;
+      xyz[3 * i + 1] = py;
+      xyz[3 * i + 2] = pz;
+    }
+  };
+
+  static bool IsFloatDepth(const Image& depth) { return GetImageEncoding(depth) == ImageEncoding::TYPE_32FC1; }
+
+  bool CheckImage(const Image& depth) const {
+    ImageEncoding encoding = GetImageEncoding(depth);
+    bool is_u16 = encoding == ImageEncoding::TYPE_16UC1 || encoding == ImageEncoding::MONO16;
+    size_t pixel_size = IsFloatDepth(depth) ? 4 : 2;
+    return configured_ && (IsFloatDepth(depth) || is_u16) && depth.width == width_ && depth.height == height_ &&
+           depth.step >= static_cast<int32_t>(width_ * pixel_size) && depth.data.size() >= static_cast<size_t>(depth.step) * height_;
+  }
+
+  /// Project every sampled row of a checked image, returns the number of valid points written
+  template <typename Writer>
+  size_t ProjectImage(const Image& depth, const Writer& writer) const {
+    bool is_float = IsFloatDepth(depth);
+    size_t pixel_size = is_float ? 4 : 2;
+    size_t cols = column_rays_.size();
+    std::vector<float> row_depth(cols);
+    std::vector<uint16_t> row_raw(cols);
+    size_t count = 0;
+
+    for (size_t r = 0; r < row_rays_.size(); ++r) {
+      const uint8_t* row = depth.data.data() + static_cast<size_t>(y_offset_ + r * stride_) * depth.step + x_offset_ * pixel_size;
+      if (is_float) {
+        for (size_t c = 0; c < cols; ++c) {
+          uint32_t bits;
+          std::memcpy(&bits, row + c * stride_ * 4, 4);
+          if (depth.is_bigendian) {
+            bits = __builtin_bswap32(bits);
+          }
+          std::memcpy(&row_depth[c], &bits, 4);
+        }
+      } else if (stride_ == 1 && !depth.is_bigendian) {
+        ConvertDepth(reinterpret_cast<const uint16_t*>(row), depth_scale_, row_depth.data(), cols);
+      } else {
+        for (size_t c = 0; c < cols; ++c) {
+          uint16_t d;
+          std::memcpy(&d, row + c * stride_ * 2, 2);
+          row_raw[c] = depth.is_bigendian ? __builtin_bswap16(d) : d;
+        }
+        ConvertDepth(row_raw.data(), depth_scale_, row_depth.data(), cols);
+      }
+      count = ProjectRow(row_depth.data(), column_rays_.data(), row_rays_[r], cols, writer, count);
+    }
+    return count;
+  }
+  /// Convert raw 16-bit depth to meters
+  static void ConvertDepth(const uint16_t* src, float scale, float* dst, size_t n) {
+    size_t i = 0;
+#if defined(MAGIC_SIMD_AVX2)
+    __m256 vscale = _mm256_set1_ps(scale);
+    for (; i + 8 <= n; i += 8) {
+      __m128i raw = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+      __m256 d = _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(raw));
+      _mm256_storeu_ps(dst + i, _mm256_mul_ps(d, vscale));
+    }
+#elif defined(MAGIC_SIMD_NEON)
+    float32x4_t vscale = vdupq_n_f32(scale);
+    for (; i + 8 <= n; i += 8) {
+      uint16x8_t raw = vld1q_u16(src + i);
+      vst1q_f32(dst + i, vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_low_u16(raw))), vscale));
+      vst1q_f32(dst + i + 4, vmulq_f32(vcvtq_f32_u32(vmovl_u16(vget_high_u16(raw))), vscale));
+    }
+#endif
+    for (; i < n; ++i) {
+      dst[i] = static_cast<float>(src[i]) * scale;
+    }
+  }
+
+  /// Project one row of depths and append the valid points at index count, returns the new count
+  template <typename Writer>
+  size_t ProjectRow(const float* z, const float* column_rays, float row_ray, size_t n, const Writer& writer, size_t count) const {
+    size_t i = 0;
+#if defined(MAGIC_SIMD_AVX2)
+    __m256 vmin = _mm256_set1_ps(min_depth_);
+    __m256 vmax = _mm256_set1_ps(max_depth_);
+    __m256 vrow = _mm256_set1_ps(row_ray);
+    for (; i + 8 <= n; i += 8) {
+      __m256 vz = _mm256_loadu_ps(z + i);
+      __m256 valid = _mm256_and_ps(_mm256_cmp_ps(vz, vmin, _CMP_GE_OQ), _mm256_cmp_ps(vz, vmax, _CMP_LE_OQ));
+      int mask = _mm256_movemask_ps(valid);
+      if (mask == 0) {
+        continue;
+      }
+      alignas(32) float px[8], py[8], pz[8];
+      _mm256_store_ps(px, _mm256_mul_ps(vz, _mm256_loadu_ps(column_rays + i)));
+      _mm256_store_ps(py, _mm256_mul_ps(vz, vrow));
+      _mm256_store_ps(pz, vz);
+      count = Compact(px, py, pz, mask, 8, writer, count);
+    }
+#elif defined(MAGIC_SIMD_NEON)
+    float32x4_t vmin = vdupq_n_f32(min_depth_);
+    float32x4_t vmax = vdupq_n_f32(max_depth_);
+    for (; i + 4 <= n; i += 4) {
+      float32x4_t vz = vld1q_f32(z + i);
+      uint32x4_t valid = vandq_u32(vcgeq_f32(vz, vmin), vcleq_f32(vz, vmax));
+      if (vmaxvq_u32(valid) == 0) {
+        continue;
+      }
+      float px[4], py[4], pz[4];
+      uint32_t lanes[4];
+      vst1q_f32(px, vmulq_f32(vz, vld1q_f32(column_rays + i)));
+      vst1q_f32(py, vmulq_n_f32(vz, row_ray));
+      vst1q_f32(pz, vz);
+      vst1q_u32(lanes, valid);
+      int mask = (lanes[0] & 1) | (lanes[1] & 2) | (lanes[2] & 4) | (lanes[3] & 8);
+      count = Compact(px, py, pz, mask, 4, writer, count);
+    }
+#endif
+    for (; i < n; ++i) {
+      float d = z[i];
+      writer(count, d * column_rays[i], d * row_ray, d);
+      count += (d >= min_depth_ && d <= max_depth_) ? 1 : 0;
+    }
+    return count;
+  }
+
+  /// Branchless stream compaction of one SIMD block
+  template <typename Writer>
+  static size_t Compact(const float* px, const float* py, const float* pz, int mask, int lanes, const Writer& writer, size_t count) {
+    for (int k = 0; k < lanes; ++k) {
+      writer(count, px[k], py[k], pz[k]);
+      count += (mask >> k) & 1;
+    }
+    return count;
+  }
+
+  bool configured_{false};
+  int32_t width_{0};
+  int32_t height_{0};
+  int32_t stride_{1};
+  int32_t x_offset_{0};
+  int32_t y_offset_{0};
+  float depth_scale_{0.001f};
+  float min_depth_{1e-3f};
+  float max_depth_{std::numeric_limits<float>::max()};
+  std::vector<float> column_rays_;  // (u - cx) / fx for every sampled column
+  std::vector<float> row_rays_;     // (v - cy) / fy for every sampled row
+};
+
+}  // namespace magic::dog::sensor
@@ -0,0 +1,695 @@
+#pragma once
+
+#include "magic_interned_string.h"
+#include "magic_simd.h"
+#include "magic_type.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace magic::dog::sensor {
+
+/**
+ * @brief Region of interest of an image, zero width/height means up to the image border
+ */
+struct ImageRoi {
+  int32_t x_offset = 0;  ///< ROI start column
+  int32_t y_offset = 0;  ///< ROI start row
+  int32_t width = 0;     ///< ROI width (pixels)
+  int32_t height = 0;    ///< ROI height (pixels)
+};
+
+namespace detail {
+
+/// Channel count and bytes per channel of an encoding
+struct PixelFormat {
+  int32_t channels = 0;
+  int32_t depth = 0;
+
+  int32_t size() const { return channels * depth; }
+};
+
+inline PixelFormat GetPixelFormat(ImageEncoding encoding) {
+  switch (encoding) {
+    case ImageEncoding::MONO8:
+      return {1, 1};
+    case ImageEncoding::RGB8:
+    case ImageEncoding::BGR8:
+      return {3, 1};
+    case ImageEncoding::RGBA8:
+    case ImageEncoding::BGRA8:
+      return {4, 1};
+    case ImageEncoding::MONO16:
+    case ImageEncoding::TYPE_16UC1:
+      return {1, 2};
+    case ImageEncoding::TYPE_32FC1:
+      return {1, 4};
+    default:
+      return {};
+  }
+}
+
+inline bool IsValidImage(const Image& image, int32_t pixel_size) {
+  return pixel_size > 0 && image.width > 0 && image.height > 0 && image.step >= image.width * pixel_size &&
+         image.data.size() >= static_cast<size_t>(image.step) * static_cast<size_t>(image.height);
+}
+
+/**
+ * Run fill(out, out_step) into a packed width x height buffer and store it in dst with src's metadata.
+ * When src and dst are the same object the output goes to a thread-local buffer that is swapped in,
+ * so the old pixel buffer is kept for the next in-place call instead of being freed.
+ */
+template <typename Fill>
+void WriteImage(const Image& src, ImageEncoding encoding, int32_t width, int32_t height, int32_t pixel_size, Image& dst, Fill&& fill) {
+  thread_local std::vector<uint8_t> scratch;
+  bool aliased = &src == &dst;
+  std::vector<uint8_t>& out = aliased ? scratch : dst.data;
+  size_t step = static_cast<size_t>(width) * static_cast<size_t>(pixel_size);
+  out.resize(step * static_cast<size_t>(height));
+  fill(out.data(), step);
+  if (aliased) {
+    dst.data.swap(scratch);
+  } else {
+    dst.header = src.header;
+    dst.is_bigendian = src.is_bigendian;
+  }
+  if (encoding != GetImageEncoding(src)) {
+    dst.encoding = ImageEncodingName(encoding);
+  } else if (!aliased) {
+    dst.encoding = src.encoding;
+  }
+  dst.width = width;
+  dst.height = height;
+  dst.step = static_cast<int32_t>(step);
+}
+
+/// Swap the first and third channel of packed 3-channel pixels, src may equal dst
+inline void SwapRedBlue(const uint8_t* src, uint8_t* dst, size_t pixels) {
+  size_t i = 0;
+#if defined(MAGIC_SIMD_AVX2)
+  const __m128i mask = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15);
+  // 5 pixels per 16-byte block, the 16th byte is written back unchanged
+  for (; i + 6 <= pixels; i += 5) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 3 * i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + 3 * i), _mm_shuffle_epi8(v, mask));
+  }
+#elif defined(MAGIC_SIMD_NEON)
+  for (; i + 16 <= pixels; i += 16) {
+    uint8x16x3_t v = vld3q_u8(src + 3 * i);
+    std::swap(v.val[0], v.val[2]);
+    vst3q_u8(dst + 3 * i, v);
+  }
+#endif
+  for (; i < pixels; ++i) {
+    uint8_t r = src[3 * i];
+    uint8_t g = src[3 * i + 1];
+    uint8_t b = src[3 * i + 2];
+    dst[3 * i] = b;
+    dst[3 * i + 1] = g;
+    dst[3 * i + 2] = r;
+  }
+}
+
+/// BT.601 luma with 8-bit weights summing to 256; weights are given in memory channel order
+inline void ThreeChannelToGray(const uint8_t* src, uint8_t* dst, size_t pixels, uint16_t w0, uint16_t w1, uint16_t w2) {
+  size_t i = 0;
+#if defined(MAGIC_SIMD_AVX2)
+  const __m128i c0a = _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+  const __m128i c0b = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1, -1);
+  const __m128i c0c = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10, 13);
+  const __m128i c1a = _mm_setr_epi8(1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+  const __m128i c1b = _mm_setr_epi8(-1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1);
+  const __m128i c1c = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14);
+  const __m128i c2a = _mm_setr_epi8(2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+  const __m128i c2b = _mm_setr_epi8(-1, -1, -1, -1, -1, 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1);
+  const __m128i c2c = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15);
+  const __m256i vw0 = _mm256_set1_epi16(static_cast<int16_t>(w0));
+  const __m256i vw1 = _mm256_set1_epi16(static_cast<int16_t>(w1));
+  const __m256i vw2 = _mm256_set1_epi16(static_cast<int16_t>(w2));
+  const __m256i round = _mm256_set1_epi16(128);
+  for (; i + 16 <= pixels; i += 16) {
+    const uint8_t* p = src + 3 * i;
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16));
+    __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 32));
+    __m128i ch0 = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, c0a), _mm_shuffle_epi8(b, c0b)), _mm_shuffle_epi8(c, c0c));
+    __m128i ch1 = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, c1a), _mm_shuffle_epi8(b, c1b)), _mm_shuffle_epi8(c, c1c));
+    __m128i ch2 = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, c2a), _mm_shuffle_epi8(b, c2b)), _mm_shuffle_epi8(c, c2c));
+    __m256i sum = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_cvtepu8_epi16(ch0), vw0), round);
+    sum = _mm256_add_epi16(sum, _mm256_mullo_epi16(_mm256_cvtepu8_epi16(ch1), vw1));
+    sum = _mm256_add_epi16(sum, _mm256_mullo_epi16(_mm256_cvtepu8_epi16(ch2), vw2));
+    sum = _mm256_srli_epi16(sum, 8);
+    __m128i gray = _mm_packus_epi16(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), gray);
+  }
+#elif defined(MAGIC_SIMD_NEON)
+  const uint8x8_t vw0 = vdup_n_u8(static_cast<uint8_t>(w0));
+  const uint8x8_t vw1 = vdup_n_u8(static_cast<uint8_t>(w1));
+  const uint8x8_t vw2 = vdup_n_u8(static_cast<uint8_t>(w2));
+  for (; i + 16 <= pixels; i += 16) {
+    uint8x16x3_t v = vld3q_u8(src + 3 * i);
+    uint16x8_t lo = vmull_u8(vget_low_u8(v.val[0]), vw0);
+    lo = vmlal_u8(lo, vget_low_u8(v.val[1]), vw1);
+    lo = vmlal_u8(lo, vget_low_u8(v.val[2]), vw2);
+    uint16x8_t hi = vmull_u8(vget_high_u8(v.val[0]), vw0);
+    hi = vmlal_u8(hi, vget_high_u8(v.val[1]), vw1);
+    hi = vmlal_u8(hi, vget_high_u8(v.val[2]), vw2);
+    vst1q_u8(dst + i, vcombine_u8(vrshrn_n_u16(lo, 8), vrshrn_n_u16(hi, 8)));
+  }
+#endif
+  for (; i < pixels; ++i) {
+    const uint8_t* p = src + 3 * i;
+    dst[i] = static_cast<uint8_t>((p[0] * w0 + p[1] * w1 + p[2] * w2 + 128) >> 8);
+  }
+}
+
+/// Replicate gray values into 3 channels
+inline void GrayToThreeChannel(const uint8_t* src, uint8_t* dst, size_t pixels) {
+  size_t i = 0;
+#if defined(MAGIC_SIMD_AVX2)
+  const __m128i m0 = _mm_setr_epi8(0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 4, 5);
+  const __m128i m1 = _mm_setr_epi8(5, 5, 6, 6, 6, 7, 7, 7, 8, 8, 8, 9, 9, 9, 10, 10);
+  const __m128i m2 = _mm_setr_epi8(10, 11, 11, 11, 12, 12, 12, 13, 13, 13, 14, 14, 14, 15, 15, 15);
+  for (; i + 16 <= pixels; i += 16) {
+    __m128i g = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    uint8_t* p = dst + 3 * i;
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm_shuffle_epi8(g, m0));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p + 16), _mm_shuffle_epi8(g, m1));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(p + 32), _mm_shuffle_epi8(g, m2));
+  }
+#elif defined(MAGIC_SIMD_NEON)
+  for (; i + 16 <= pixels; i += 16) {
+    uint8x16_t g = vld1q_u8(src + i);
+    uint8x16x3_t v = {{g, g, g}};
+    vst3q_u8(dst + 3 * i, v);
+  }
+#endif
+  for (; i < pixels; ++i) {
+    dst[3 * i] = dst[3 * i + 1] = dst[3 * i + 2] = src[i];
+  }
+}
+
+/// acc[i] += row[i], widening 8-bit samples to 16 bits
+inline void AccumulateRow(const uint8_t* row, uint16_t* acc, size_t n) {
+  size_t i = 0;
+#if defined(MAGIC_SIMD_AVX2)
+  for (; i + 16 <= n; i += 16) {
+    __m256i v = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i)));
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc + i), _mm256_add_epi16(a, v));
+  }
+#elif defined(MAGIC_SIMD_NEON)
+  for (; i + 8 <= n; i += 8) {
+    vst1q_u16(acc + i, vaddw_u8(vld1q_u16(acc + i), vld1_u8(row + i)));
+  }
+#endif
+  for (; i < n; ++i) {
+    acc[i] = static_cast<uint16_t>(acc[i] + row[i]);
+  }
+}
+
+/// out[i] = (h0[i] * (128 - w) + h1[i] * w + 8192) >> 14, inputs hold 7-bit fixed-point samples
+inline void BlendRows(const uint16_t* h0, const uint16_t* h1, uint16_t w, uint8_t* out, size_t n) {
+  size_t i = 0;
+  uint16_t w0 = static_cast<uint16_t>(128 - w);
+#if defined(MAGIC_SIMD_AVX2)
+  const __m256i weights = _mm256_set1_epi32(static_cast<int32_t>(w0) | (static_cast<int32_t>(w) << 16));
+  const __m256i round = _mm256_set1_epi32(8192);
+  for (; i + 16 <= n; i += 16) {
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(h0 + i));
+    __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(h1 + i));
+    __m256i lo = _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), weights);
+    __m256i hi = _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), weights);
+    lo = _mm256_srai_epi32(_mm256_add_epi32(lo, round), 14);
+    hi = _mm256_srai_epi32(_mm256_add_epi32(hi, round), 14);
+    __m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(lo, hi), _mm256_setzero_si256());
+    packed = _mm256_permute4x64_epi64(packed, 0x08);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm256_castsi256_si128(packed));
+  }
+#elif defined(MAGIC_SIMD_NEON)
+  const uint16x4_t vw0 = vdup_n_u16(w0);
+  const uint16x4_t vw1 = vdup_n_u16(w);
+  for (; i + 8 <= n; i += 8) {
+    uint16x8_t a = vld1q_u16(h0 + i);
+    uint16x8_t b = vld1q_u16(h1 + i);
+    uint32x4_t lo = vmlal_u16(vmull_u16(vget_low_u16(a), vw0), vget_low_u16(b), vw1);
+    uint32x4_t hi = vmlal_u16(vmull_u16(vget_high_u16(a), vw0), vget_high_u16(b), vw1);
+    vst1_u8(out + i, vqmovn_u16(vcombine_u16(vrshrn_n_u32(lo, 14), vrshrn_n_u32(hi, 14))));
+  }
+#endif
+  for (; i < n; ++i) {
+    out[i] = static_cast<uint8_t>((h0[i] * w0 + h1[i] * w + 8192) >> 14);
+  }
+}
+
+/// Sum groups of fx pixels per channel and scale to the box average, specialised for the common channel counts
+template <int32_t kChannels>
+inline void BoxReduceRow(const uint16_t* sums, int32_t width, int32_t fx, int32_t count, uint8_t* out) {
+  if (fx == 2 && (count & (count - 1)) == 0) {
+    // 2x2 and 2x4 boxes: power-of-two counts round with a shift
+    int32_t shift = __builtin_ctz(static_cast<uint32_t>(count));
+    uint32_t half = static_cast<uint32_t>(count) / 2;
+    for (int32_t x = 0; x < width; ++x) {
+      const uint16_t* a = sums + static_cast<size_t>(x) * 2 * kChannels;
+      for (int32_t c = 0; c < kChannels; ++c) {
+        out[x * kChannels + c] = static_cast<uint8_t>((a[c] + a[kChannels + c] + half) >> shift);
+      }
+    }
+    return;
+  }
+  // Sums are integers, so scaling by the reciprocal never lands on a rounding tie it would misjudge
+  float inv_count = 1.0f / static_cast<float>(count);
+  for (int32_t x = 0; x < width; ++x) {
+    const uint16_t* a = sums + static_cast<size_t>(x) * fx * kChannels;
+    for (int32_t c = 0; c < kChannels; ++c) {
+      uint32_t sum = 0;
+      for (int32_t k = 0; k < fx; ++k) {
+        sum += a[k * kChannels + c];
+      }
+      out[x * kChannels + c] = static_cast<uint8_t>(static_cast<float>(sum) * inv_count + 0.5f);
+    }
+  }
+}
+
+/// Horizontal bilinear pass of one 8-bit row into 7-bit fixed-point samples
+template <int32_t kChannels>
+inline void LerpRow(const uint8_t* in, const int32_t* x0, const int32_t* x1, const uint16_t* wx, int32_t width, uint16_t* out) {
+  for (int32_t x = 0; x < width; ++x) {
+    const uint8_t* a = in + x0[x] * kChannels;
+    const uint8_t* b = in + x1[x] * kChannels;
+    uint16_t w1 = wx[x];
+    uint16_t w0 = static_cast<uint16_t>(128 - w1);
+    for (int32_t c = 0; c < kChannels; ++c) {
+      out[x * kChannels + c] = static_cast<uint16_t>(a[c] * w0 + b[c] * w1);
+    }
+  }
+}
+
+/// Sample loader for 16-bit and float images honoring is_bigendian
+inline float LoadSample(const uint8_t* p, int32_t depth, bool swap) {
+  if (depth == 2) {
+    uint16_t v;
+    std::memcpy(&v, p, 2);
+    return static_cast<float>(swap ? __builtin_bswap16(v) : v);
+  }
+  uint32_t bits;
+  std::memcpy(&bits, p, 4);
+  if (swap) {
+    bits = __builtin_bswap32(bits);
+  }
+  float v;
+  std::memcpy(&v, &bits, 4);
+  return v;
+}
+
+inline void StoreSample(uint8_t* p, int32_t depth, bool swap, float value) {
+  if (depth == 2) {
+    float clamped = std::min(65535.0f, std::max(0.0f, value + 0.5f));
+    uint16_t v = static_cast<uint16_t>(clamped);
+    v = swap ? __builtin_bswap16(v) : v;
+    std::memcpy(p, &v, 2);
+    return;
+  }
+  uint32_t bits;
+  std::memcpy(&bits, &value, 4);
+  if (swap) {
+    bits = __builtin_bswap32(bits);
+  }
+  std::memcpy(p, &bits, 4);
+}
+
+/// Area weights of one axis: output i covers source [i * scale, (i + 1) * scale)
+struct AreaTap {
+  int32_t index;
+  float weight;
+};
+
+inline void BuildAreaTaps(int32_t src_size, int32_t dst_size, std::vector<int32_t>& begin, std::vector<AreaTap>& taps) {
+  double scale = static_cast<double>(src_size) / dst_size;
+  begin.resize(static_cast<size_t>(dst_size) + 1);
+  taps.clear();
+  for (int32_t i = 0; i < dst_size; ++i) {
+    begin[i] = static_cast<int32_t>(taps.size());
+    double lo = i * scale;
+    double hi = std::min<double>(src_size, (i + 1) * scale);
+    double total = hi - lo;
+    for (int32_t s = static_cast<int32_t>(lo); s < src_size && s < hi; ++s) {
+      double overlap = std::min<double>(hi, s + 1) - std::max<double>(lo, s);
+      if (overlap > 1e-9) {
+        taps.push_back({s, static_cast<float>(overlap / total)});
+      }
+    }
+  }
+  begin[dst_size] = static_cast<int32_t>(taps.size());
+}
+
+/// Pixel-center aligned bilinear source coordinate: integer part and fractional weight in [0, 1]
+inline void BilinearCoordinate(int32_t i, double scale, int32_t src_size, int32_t& i0, int32_t& i1, float& frac) {
+  double s = (i + 0.5) * scale - 0.5;
+  s = std::max(0.0, std::min(s, static_cast<double>(src_size - 1)));
+  i0 = static_cast<int32_t>(s);
+  i1 = std::min(i0 + 1, src_size - 1);
+  frac = static_cast<float>(s - i0);
+}
+
+}  // namespace detail
+
+/**
+ * @brief Crop an uncompressed image.
+ * @param src Source image.
+ * @param roi Region to keep, clipped to the image.
+ * @param[out] dst Cropped image, may be src itself; buffer capacity is reused.
+ * @return false if the ROI does not intersect the image, the encoding is not an ImageEncoding or the image is malformed.
+ */
+inline bool CropImage(const Image& src, const ImageRoi& roi, Image& dst) {
+  // Taken from the encoding, the step may include row padding
+  int32_t pixel_size = ImageEncodingPixelSize(GetImageEncoding(src));
+  if (!detail::IsValidImage(src, pixel_size)) {
+    return false;
+  }
+  int32_t x0 = std::max(roi.x_offset, 0);
+  int32_t y0 = std::max(roi.y_offset, 0);
+  int32_t x1 = roi.width > 0 ? std::min(src.width, roi.x_offset + roi.width) : src.width;
+  int32_t y1 = roi.height > 0 ? std::min(src.height, roi.y_offset + roi.height) : src.height;
+  if (x0 >= x1 || y0 >= y1) {
+    return false;
+  }
+  size_t src_step = static_cast<size_t>(src.step);
+  size_t dst_step = static_cast<size_t>(x1 - x0) * pixel_size;
+  size_t offset = static_cast<size_t>(x0) * pixel_size;
+  if (&src == &dst) {
+    // Rows only move towards the buffer start, so copying them in order never overwrites unread data
+    for (int32_t row = 0; row < y1 - y0; ++row) {
+      std::memmove(dst.data.data() + row * dst_step, dst.data.data() + (y0 + row) * src_step + offset, dst_step);
+    }
+    dst.data.resize(dst_step * (y1 - y0));
+  } else {
+    dst.header = src.header;
+    dst.encoding = src.encoding;
+    dst.is_bigendian = src.is_bigendian;
+    dst.data.resize(dst_step * (y1 - y0));
+    for (int32_t row = 0; row < y1 - y0; ++row) {
+      std::memcpy(dst.data.data() + row * dst_step, src.data.data() + (y0 + row) * src_step + offset, dst_step);
+    }
+  }
+  dst.width = x1 - x0;
+  dst.height = y1 - y0;
+  dst.step = static_cast<int32_t>(dst_step);
+  return true;
+}
+
+/**
+ * @brief Convert between rgb8, bgr8 and mono8.
+ * @param src Source image in rgb8, bgr8 or mono8.
+ * @param encoding Target encoding, one of RGB8, BGR8, MONO8.
+ * @param[out] dst Converted image with packed rows, may be src itself; buffer capacity is reused.
+ * @return false on unsupported encodings or a malformed image.
+ */
+inline bool ConvertColor(const Image& src, ImageEncoding encoding, Image& dst) {
+  ImageEncoding from = GetImageEncoding(src);
+  bool from_color = from == ImageEncoding::RGB8 || from == ImageEncoding::BGR8;
+  bool to_color = encoding == ImageEncoding::RGB8 || encoding == ImageEncoding::BGR8;
+  if ((!from_color && from != ImageEncoding::MONO8) || (!to_color && encoding != ImageEncoding::MONO8)) {
+    return false;
+  }
+  int32_t src_pixel = detail::GetPixelFormat(from).size();
+  int32_t dst_pixel = detail::GetPixelFormat(encoding).size();
+  if (!detail::IsValidImage(src, src_pixel)) {
+    return false;
+  }
+  size_t width = static_cast<size_t>(src.width);
+  size_t src_step = static_cast<size_t>(src.step);
+  detail::WriteImage(src, encoding, src.width, src.height, dst_pixel, dst, [&](uint8_t* out, size_t out_step) {
+    for (int32_t row = 0; row < src.height; ++row) {
+      const uint8_t* in = src.data.data() + row * src_step;
+      uint8_t* o = out + row * out_step;
+      if (from == encoding) {
+        std::memcpy(o, in, out_step);
+      } else if (from_color && to_color) {
+        detail::SwapRedBlue(in, o, width);
+      } else if (from == ImageEncoding::RGB8) {
+        detail::ThreeChannelToGray(in, o, width, 77, 150, 29);
+      } else if (from == ImageEncoding::BGR8) {
+        detail::ThreeChannelToGray(in, o, width, 29, 150, 77);
+      } else {
+        detail::GrayToThreeChannel(in, o, width);
+      }
+    }
+  });
+  return true;
+}
+
+/**
+ * @brief Resize with area averaging, the usual choice for downscaling.
+ *
+ * Integer factors on 8-bit images take a vectorised box-filter path; other factors and 16-bit/float images
+ * use exact fractional coverage weights.
+ * @param src Source image: mono8, rgb8, bgr8, rgba8, bgra8, mono16, 16UC1 or 32FC1, either endianness.
+ * @param width Target width.
+ * @param height Target height.
+ * @param[out] dst Resized image with packed rows, may be src itself; buffer capacity is reused.
+ * @return false on unsupported encodings, invalid sizes or a malformed image.
+ */
+inline bool ResizeArea(const Image& src, int32_t width, int32_t height, Image& dst) {
+  ImageEncoding encoding = GetImageEncoding(src);
+  detail::PixelFormat format = detail::GetPixelFormat(encoding);
+  if (width <= 0 || height <= 0 || !detail::IsValidImage(src, format.size())) {
+    return false;
+  }
+  int32_t channels = format.channels;
+  size_t src_step = static_cast<size_t>(src.step);
+  bool integer_factor = src.width % width == 0 && src.height % height == 0;
+  int32_t fx = src.width / width;
+  int32_t fy = src.height / height;
+
+  if (format.depth == 1 && integer_factor && fy <= 257) {
+    detail::WriteImage(src, encoding, width, height, format.size(), dst, [&](uint8_t* out, size_t out_step) {
+      thread_local std::vector<uint16_t> acc;
+      size_t row_bytes = static_cast<size_t>(src.width) * channels;
+      acc.resize(row_bytes);
+      uint16_t* sums = acc.data();
+      int32_t count = fx * fy;
+      for (int32_t y = 0; y < height; ++y) {
+        std::fill(sums, sums + row_bytes, 0);
+        for (int32_t k = 0; k < fy; ++k) {
+          detail::AccumulateRow(src.data.data() + (static_cast<size_t>(y) * fy + k) * src_step, sums, row_bytes);
+        }
+        uint8_t* o = out + y * out_step;
+        if (channels == 1) {
+          detail::BoxReduceRow<1>(sums, width, fx, count, o);
+        } else if (channels == 3) {
+          detail::BoxReduceRow<3>(sums, width, fx, count, o);
+        } else {
+          detail::BoxReduceRow<4>(sums, width, fx, count, o);
+        }
+      }
+    });
+    return true;
+  }
+
+  thread_local std::vector<int32_t> x_begin, y_begin;
+  thread_local std::vector<detail::AreaTap> x_taps, y_taps;
+  detail::BuildAreaTaps(src.width, width, x_begin, x_taps);
+  detail::BuildAreaTaps(src.height, height, y_begin, y_taps);
+  bool swap = src.is_bigendian && format.depth > 1;
+  detail::WriteImage(src, encoding, width, height, format.size(), dst, [&](uint8_t* out, size_t out_step) {
+    thread_local std::vector<float> row;
+    row.resize(static_cast<size_t>(width) * channels);
+    for (int32_t y = 0; y < height; ++y) {
+      std::fill(row.begin(), row.end(), 0.0f);
+      for (int32_t ty = y_begin[y]; ty < y_begin[y + 1]; ++ty) {
+        const uint8_t* in = src.data.data() + static_cast<size_t>(y_taps[ty].index) * src_step;
+        float wy = y_taps[ty].weight;
+        for (int32_t x = 0; x < width; ++x) {
+          for (int32_t tx = x_begin[x]; tx < x_begin[x + 1]; ++tx) {
+            float w = wy * x_taps[tx].weight;
+            const uint8_t* p = in + static_cast<size_t>(x_taps[tx].index) * format.size();
+            for (int32_t c = 0; c < channels; ++c) {
+              float v = format.depth == 1 ? p[c] : detail::LoadSample(p + c * format.depth, format.depth, swap);
+              row[x * channels + c] += w * v;
+            }
+          }
+        }
+      }
+      uint8_t* o = out + y * out_step;
+      for (size_t i = 0; i < row.size(); ++i) {
+        if (format.depth == 1) {
+          o[i] = static_cast<uint8_t>(std::min(255.0f, row[i] + 0.5f));
+        } else {
+          detail::StoreSample(o + i * format.depth, format.depth, swap, row[i]);
+        }
+      }
+    }
+  });
+  return true;
+}
+
+/**
+ * @brief Resize with bilinear interpolation, pixel centers aligned as in OpenCV INTER_LINEAR.
+ *
+ * 8-bit images use 7-bit fixed-point weights with a vectorised vertical pass; each source row is
+ * interpolated horizontally once and reused by consecutive output rows.
+ * @param src Source image: mono8, rgb8, bgr8, rgba8, bgra8, mono16, 16UC1 or 32FC1, either endianness.
+ * @param width Target width.
+ * @param height Target height.
+ * @param[out] dst Resized image with packed rows, may be src itself; buffer capacity is reused.
+ * @return false on unsupported encodings, invalid sizes or a malformed image.
+ */
+inline bool ResizeBilinear(const Image& src, int32_t width, int32_t height, Image& dst) {
+  ImageEncoding encoding = GetImageEncoding(src);
+  detail::PixelFormat format = detail::GetPixelFormat(encoding);
+  if (width <= 0 || height <= 0 || !detail::IsValidImage(src, format.size())) {
+    return false;
+  }
+  int32_t channels = format.channels;
+  size_t src_step = static_cast<size_t>(src.step);
+  double scale_x = static_cast<double>(src.width) / width;
+  double scale_y = static_cast<double>(src.height) / height;
+  thread_local std::vector<int32_t> x0, x1;
+  thread_local std::vector<float> wx;
+  x0.resize(width);
+  x1.resize(width);
+  wx.resize(width);
+  for (int32_t x = 0; x < width; ++x) {
+    detail::BilinearCoordinate(x, scale_x, src.width, x0[x], x1[x], wx[x]);
+  }
+
+  if (format.depth == 1) {
+    thread_local std::vector<uint16_t> wxq;
+    thread_local std::vector<uint16_t> rows[2];
+    wxq.resize(width);
+    for (int32_t x = 0; x < width; ++x) {
+      wxq[x] = static_cast<uint16_t>(std::lround(wx[x] * 128.0f));
+    }
+    size_t row_size = static_cast<size_t>(width) * channels;
+    rows[0].resize(row_size);
+    rows[1].resize(row_size);
+    // Plain pointers, thread_local accesses inside the loops would go through the TLS wrapper every time
+    const int32_t* px0 = x0.data();
+    const int32_t* px1 = x1.data();
+    const uint16_t* pwx = wxq.data();
+    uint16_t* row_buffers[2] = {rows[0].data(), rows[1].data()};
+    auto horizontal = [&](int32_t sy, uint16_t* h) {
+      const uint8_t* in = src.data.data() + static_cast<size_t>(sy) * src_step;
+      if (channels == 1) {
+        detail::LerpRow<1>(in, px0, px1, pwx, width, h);
+      } else if (channels == 3) {
+        detail::LerpRow<3>(in, px0, px1, pwx, width, h);
+      } else {
+        detail::LerpRow<4>(in, px0, px1, pwx, width, h);
+      }
+    };
+    detail::WriteImage(src, encoding, width, height, format.size(), dst, [&](uint8_t* out, size_t out_step) {
+      int32_t cached[2] = {-1, -1};  // Source row held by rows[0] / rows[1]
+      for (int32_t y = 0; y < height; ++y) {
+        int32_t y0, y1;
+        float wy;
+        detail::BilinearCoordinate(y, scale_y, src.height, y0, y1, wy);
+        if (cached[0] != y0) {
+          if (cached[1] == y0) {
+            std::swap(row_buffers[0], row_buffers[1]);
+            std::swap(cached[0], cached[1]);
+          } else {
+            horizontal(y0, row_buffers[0]);
+            cached[0] = y0;
+          }
+        }
+        if (cached[1] != y1) {
+          horizontal(y1, row_buffers[1]);
+          cached[1] = y1;
+        }
+        detail::BlendRows(row_buffers[0], row_buffers[1], static_cast<uint16_t>(std::lround(wy * 128.0f)), out + y * out_step, row_size);
+      }
+    });
+    return true;
+  }
+
+  bool swap = src.is_bigendian;
+  int32_t pixel = format.size();
+  detail::WriteImage(src, encoding, width, height, pixel, dst, [&](uint8_t* out, size_t out_step) {
+    for (int32_t y = 0; y < height; ++y) {
+      int32_t y0, y1;
+      float wy;
+      detail::BilinearCoordinate(y, scale_y, src.height, y0, y1, wy);
+      const uint8_t* r0 = src.data.data() + static_cast<size_t>(y0) * src_step;
+      const uint8_t* r1 = src.data.data() + static_cast<size_t>(y1) * src_step;
+      uint8_t* o = out + y * out_step;
+      for (int32_t x = 0; x < width; ++x) {
+        float v00 = detail::LoadSample(r0 + x0[x] * pixel, format.depth, swap);
+        float v01 = detail::LoadSample(r0 + x1[x] * pixel, format.depth, swap);
+        float v10 = detail::LoadSample(r1 + x0[x] * pixel, format.depth, swap);
+        float v11 = detail::LoadSample(r1 + x1[x] * pixel, format.depth, swap);
+        float top = v00 + (v01 - v00) * wx[x];
+        float bottom = v10 + (v11 - v10) * wx[x];
+        detail::StoreSample(o + x * pixel, format.depth, swap, top + (bottom - top) * wy);
+      }
+    }
+  });
+  return true;
+}
+
+/**
+ * @class ImagePool
+ * @brief Recycles Image objects together with their pixel buffers.
+ *
+ * Combined with the in-place imaging functions, a steady pipeline stops allocating once the pool is warm.
+ *
+ * Example:
+ * @code
+ *   ImagePool pool;
+ *   auto small = pool.Acquire();
+ *   ResizeArea(*image, image->width / 2, image->height / 2, *small);
+ *   ConvertColor(*small, ImageEncoding::MONO8, *small);
+ * @endcode
+ */
+class ImagePool final : public NonCopyable {
+ public:
+  /// @param max_pooled Maximum number of idle images kept for reuse
+  explicit ImagePool(size_t max_pooled = 8) : state_(std::make_shared<State>()) { state_->max_pooled = max_pooled; }
+
+  /// Get an image, returned to the pool when the last reference is released
+  std::shared_ptr<Image> Acquire() {
+    std::unique_ptr<Image> image;
+    {
+      std::lock_guard<std::mutex> lock(state_->mutex);
+      if (!state_->idle.empty()) {
+        image = std::move(state_->idle.back());
+        state_->idle.pop_back();
+      }
+    }
+    if (!image) {
+      image = std::make_unique<Image>();
+    }
+    std::shared_ptr<State> state = state_;
+    return std::shared_ptr<Image>(image.release(), [state](Image* released) { state->Release(std::unique_ptr<Image>(released)); });
+  }
+
+  /// Number of idle images currently pooled
+  size_t IdleCount() const {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    return state_->idle.size();
+  }
+
+ private:
+  struct State {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<Image>> idle;
+    size_t max_pooled = 8;
+
+    void Release(std::unique_ptr<Image> image) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (idle.size() < max_pooled) {
+        idle.push_back(std::move(image));
+      }
+    }
+  };
+
+  std::shared_ptr<State> state_;
+};
+
+}  // namespace magic::dog::sensor
@@ -0,0 +1,346 @@
+#pragma once
+
+#include "magic_type.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+namespace magic::dog::sensor {
+
+/**
+ * @brief Preintegrated IMU motion between two timestamps.
+ *
+ * All deltas are expressed in the body frame at start_time and do not contain gravity compensation,
+ * i.e. the caller adds the gravity term (g * dt, 0.5 * g * dt^2) in its own world frame.
+ */
+struct ImuPreintegration {
+  int64_t start_time;                     ///< Start of the integration window (ns)
+  int64_t end_time;                       ///< End of the integration window (ns)
+  std::array<double, 4> delta_rotation;   ///< Attitude of body(end) relative to body(start), quaternion (w, x, y, z)
+  std::array<double, 3> delta_velocity;   ///< Velocity change (m/s)
+  std::array<double, 3> delta_position;   ///< Position change (m)
+  int32_t sample_count;                   ///< Number of IMU samples involved
+};
+
+namespace detail {
+
+using Quat = std::array<double, 4>;  // (w, x, y, z)
+using Vec3 = std::array<double, 3>;
+
+inline Quat QuatMultiply(const Quat& a, const Quat& b) {
+  return {a[0] * b[0] - a[1] * b[1] - a[2] * b[2] - a[3] * b[3],
+          a[0] * b[1] + a[1] * b[0] + a[2] * b[3] - a[3] * b[2],
+          a[0] * b[2] - a[1] * b[3] + a[2] * b[0] + a[3] * b[1],
+          a[0] * b[3] + a[1] * b[2] - a[2] * b[1] + a[3] * b[0]};
+}
+
+inline Quat QuatNormalize(const Quat& q) {
+  double n = std::sqrt(q[0] * q[0] + q[1] * q[1] + q[2] * q[2] + q[3] * q[3]);
+  if (n <= 0.0) {
+    return {1.0, 0.0, 0.0, 0.0};
+  }
+  return {q[0] / n, q[1] / n, q[2] / n, q[3] / n};
+}
+
+/// Rotate vector v by unit quaternion q
+inline Vec3 QuatRotate(const Quat& q, const Vec3& v) {
+  // t = 2 * cross(q.xyz, v); v' = v + w * t + cross(q.xyz, t)
+  Vec3 t = {2.0 * (q[2] * v[2] - q[3] * v[1]),
+            2.0 * (q[3] * v[0] - q[1] * v[2]),
+            2.0 * (q[1] * v[1] - q[2] * v[0])};
+  return {v[0] + q[0] * t[0] + (q[2] * t[2] - q[3] * t[1]),
+          v[1] + q[0] * t[1] + (q[3] * t[0] - q[1] * t[2]),
+          v[2] + q[0] * t[2] + (q[1] * t[1] - q[2] * t[0])};
+}
+
+/// Quaternion exponential map of a rotation vector (rad)
+inline Quat QuatExp(const Vec3& rv) {
+  double angle = std::sqrt(rv[0] * rv[0] + rv[1] * rv[1] + rv[2] * rv[2]);
+  if (angle < 1e-12) {
+    return QuatNormalize({1.0, 0.5 * rv[0], 0.5 * rv[1], 0.5 * rv[2]});
+  }
+  double s = std::sin(0.5 * angle) / angle;
+  return {std::cos(0.5 * angle), rv[0] * s, rv[1] * s, rv[2] * s};
+}
+
+/// Spherical linear interpolation along the shortest arc, ratio in [0, 1]
+inline Quat QuatSlerp(const Quat& a, Quat b, double ratio) {
+  double cos_theta = a[0] * b[0] + a[1] * b[1] + a[2] * b[2] + a[3] * b[3];
+  if (cos_theta < 0.0) {
+    cos_theta = -cos_theta;
+    b = {-b[0], -b[1], -b[2], -b[3]};
+  }
+  double wa = 1.0 - ratio;
+  double wb = ratio;
+  if (cos_theta < 0.9995) {
+    double theta = std::acos(cos_theta);
+    double sin_theta = std::sin(theta);
+    wa = std::sin((1.0 - ratio) * theta) / sin_theta;
+    wb = std::sin(ratio * theta) / sin_theta;
+  }
+  return QuatNormalize({wa * a[0] + wb * b[0], wa * a[1] + wb * b[1], wa * a[2] + wb * b[2], wa * a[3] + wb * b[3]});
+}
+
+}  // namespace detail
+
+/**
+ * @class ImuHistoryBuffer
+ * @brief Lock-free ring of recent IMU samples with time-indexed queries.
+ *
+ * One producer (usually the SubscribeImu callback) pushes samples, any number of threads can query concurrently.
+ * Each slot is guarded by a sequence counter, so readers never block the producer; a reader that races with an
+ * overwrite of the slot it is copying simply sees that sample as expired.
+ *
+ * Example:
+ * @code
+ *   ImuHistoryBuffer imu_history(4096);
+ *   controller.SubscribeImu(imu_history.Callback());
+ *   Imu imu;
+ *   if (imu_history.GetImuAt(image->header.stamp, imu)) { ... }
+ * @endcode
+ */
+class ImuHistoryBuffer final : public NonCopyable {
+ public:
+  /**
+   * @brief Constructor
+   * @param capacity Number of samples kept, rounded up to a power of two.
+   */
+  explicit ImuHistoryBuffer(size_t capacity = 2048) {
+    size_t size = 2;
+    while (size < capacity) {
+      size <<= 1;
+    }
+    mask_ = size - 1;
+    slots_ = std::make_unique<Slot[]>(size);
+  }
+
+  /**
+   * @brief Append a sample (single producer).
+   * @param imu IMU sample, timestamps must be strictly increasing.
+   * @return false if the sample is older than or equal to the newest stored sample and was dropped.
+   */
+  bool Push(const Imu& imu) {
+    uint64_t n = head_.load(std::memory_order_relaxed);
+    if (n > 0 && imu.timestamp <= last_timestamp_) {
+      return false;
+    }
+    Slot& slot = slots_[n & mask_];
+    slot.seq.store(2 * n + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(&slot.imu, &imu, sizeof(Imu));
+    slot.seq.store(2 * n + 2, std::memory_order_release);
+    head_.store(n + 1, std::memory_order_release);
+    last_timestamp_ = imu.timestamp;
+    return true;
+  }
+
+  /**
+   * @brief Callback suitable for SensorController::SubscribeImu.
+   * @note The buffer must outlive the subscription.
+   */
+  auto Callback() {
+    return [this](const std::shared_ptr<Imu> msg) {
+      if (msg) {
+        Push(*msg);
+      }
+    };
+  }
+
+  /// Number of samples currently retrievable
+  size_t Size() const {
+    uint64_t head = head_.load(std::memory_order_acquire);
+    return static_cast<size_t>(std::min<uint64_t>(head, mask_ + 1));
+  }
+
+  /// Maximum number of samples kept
+  size_t Capacity() const { return mask_ + 1; }
+
+  /// Clear all samples (must not race with Push)
+  void Clear() {
+    head_.store(0, std::memory_order_release);
+    last_timestamp_ = 0;
+  }
+
+  /**
+   * @brief Get the interpolated IMU state at time t.
+   *
+   * Orientation is interpolated with quaternion slerp, angular velocity, linear acceleration and temperature linearly.
+   * @param timestamp Query time (ns).
+   * @param[out] imu Interpolated sample, its timestamp equals the query time.
+   * @return false if t is outside the buffered time range.
+   */
+  bool GetImuAt(int64_t timestamp, Imu& imu) const {
+    Imu before, after;
+    if (!FindBracket(timestamp, before, after)) {
+      return false;
+    }
+    if (after.timestamp == before.timestamp) {
+      imu = before;
+      return true;
+    }
+    double ratio = static_cast<double>(timestamp - before.timestamp) / static_cast<double>(after.timestamp - before.timestamp);
+    imu = Interpolate(before, after, ratio);
+    imu.timestamp = timestamp;
+    return true;
+  }
+
+  /**
+   * @brief Preintegrate gyroscope and accelerometer between t0 and t1.
+   *
+   * Uses midpoint integration on the interpolated samples; the window edges are interpolated so the result
+   * covers exactly [t0, t1].
+   * @param start_time Start time t0 (ns).
+   * @param end_time End time t1 (ns), must be greater than t0.
+   * @param[out] result Preintegrated deltas.
+   * @return false if the window is not fully covered by the buffer.
+   */
+  bool Integrate(int64_t start_time, int64_t end_time, ImuPreintegration& result) const {
+    if (end_time <= start_time) {
+      return false;
+    }
+    std::vector<Imu> samples;
+    Imu first, last;
+    if (!GetImuAt(start_time, first) || !GetImuAt(end_time, last)) {
+      return false;
+    }
+    samples.push_back(first);
+    ReadRange(start_time + 1, end_time - 1, samples);
+    samples.push_back(last);
+
+    detail::Quat dq = {1.0, 0.0, 0.0, 0.0};
+    detail::Vec3 dv = {0.0, 0.0, 0.0};
+    detail::Vec3 dp = {0.0, 0.0, 0.0};
+    for (size_t i = 1; i < samples.size(); ++i) {
+      const Imu& a = samples[i - 1];
+      const Imu& b = samples[i];
+      double dt = static_cast<double>(b.timestamp - a.timestamp) * 1e-9;
+      if (dt <= 0.0) {
+        continue;
+      }
+      detail::Vec3 w, acc;
+      for (int k = 0; k < 3; ++k) {
+        w[k] = 0.5 * (a.angular_velocity[k] + b.angular_velocity[k]);
+        acc[k] = 0.5 * (a.linear_acceleration[k] + b.linear_acceleration[k]);
+      }
+      // Rotate the mean acceleration with the attitude at the middle of the step
+      detail::Quat dq_mid = detail::QuatMultiply(dq, detail::QuatExp({0.5 * w[0] * dt, 0.5 * w[1] * dt, 0.5 * w[2] * dt}));
+      detail::Vec3 acc_rotated = detail::QuatRotate(dq_mid, acc);
+      for (int k = 0; k < 3; ++k) {
+        dp[k] += dv[k] * dt + 0.5 * acc_rotated[k] * dt * dt;
+        dv[k] += acc_rotated[k] * dt;
+      }
+      dq = detail::QuatNormalize(detail::QuatMultiply(dq, detail::QuatExp({w[0] * dt, w[1] * dt, w[2] * dt})));
+    }
+
+    result.start_time = start_time;
+    result.end_time = end_time;
+    result.delta_rotation = dq;
+    result.delta_velocity = dv;
+    result.delta_position = dp;
+    result.sample_count = static_cast<int32_t>(samples.size());
+    return true;
+  }
+
+  /**
+   * @brief Copy all buffered samples with timestamp in [t0, t1] into a contiguous array.
+   * @param start_time Window start (ns), inclusive.
+   * @param end_time Window end (ns), inclusive.
+   * @param[out] out Samples are appended in time order.
+   * @return Number of samples appended.
+   */
+  size_t ReadRange(int64_t start_time, int64_t end_time, std::vector<Imu>& out) const {
+    if (end_time < start_time) {
+      return 0;
+    }
+    uint64_t head = head_.load(std::memory_order_acquire);
+    uint64_t index = LowerBound(start_time, head);
+    size_t count = 0;
+    Imu imu;
+    for (; index < head; ++index) {
+      if (!ReadSample(index, imu)) {
+        continue;  // overwritten meanwhile, samples before the new tail are gone
+      }
+      if (imu.timestamp > end_time) {
+        break;
+      }
+      out.push_back(imu);
+      ++count;
+    }
+    return count;
+  }
+
+ private:
+  struct Slot {
+    std::atomic<uint64_t> seq{0};
+    Imu imu{};
+  };
+
+  /// Copy sample n; false if it has not been written yet or was overwritten during the copy
+  bool ReadSample(uint64_t n, Imu& imu) const {
+    const Slot& slot = slots_[n & mask_];
+    uint64_t seq = slot.seq.load(std::memory_order_acquire);
+    if (seq != 2 * n + 2) {
+      return false;
+    }
+    std::memcpy(&imu, &slot.imu, sizeof(Imu));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot.seq.load(std::memory_order_relaxed) == seq;
+  }
+
+  /// First index in [tail, head) whose timestamp is >= t; expired slots count as older than t
+  uint64_t LowerBound(int64_t timestamp, uint64_t head) const {
+    uint64_t lo = head > mask_ + 1 ? head - (mask_ + 1) : 0;
+    uint64_t hi = head;
+    Imu imu;
+    while (lo < hi) {
+      uint64_t mid = lo + (hi - lo) / 2;
+      if (!ReadSample(mid, imu) || imu.timestamp < timestamp) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+    return lo;
+  }
+
+  bool FindBracket(int64_t timestamp, Imu& before, Imu& after) const {
+    uint64_t head = head_.load(std::memory_order_acquire);
+    if (head == 0) {
+      return false;
+    }
+    uint64_t index = LowerBound(timestamp, head);
+    if (index >= head || !ReadSample(index, after)) {
+      return false;
+    }
+    if (after.timestamp == timestamp) {
+      before = after;
+      return true;
+    }
+    return index > 0 && ReadSample(index - 1, before) && before.timestamp <= timestamp;
+  }
+
+  static Imu Interpolate(const Imu& a, const Imu& b, double ratio) {
+    Imu imu;
+    imu.timestamp = a.timestamp + static_cast<int64_t>(ratio * static_cast<double>(b.timestamp - a.timestamp));
+    imu.orientation = detail::QuatSlerp(a.orientation, b.orientation, ratio);
+    for (int k = 0; k < 3; ++k) {
+      imu.angular_velocity[k] = a.angular_velocity[k] + ratio * (b.angular_velocity[k] - a.angular_velocity[k]);
+      imu.linear_acceleration[k] = a.linear_acceleration[k] + ratio * (b.linear_acceleration[k] - a.linear_acceleration[k]);
+    }
+    imu.temperature = static_cast<float>(a.temperature + ratio * (b.temperature - a.temperature));
+    return imu;
+  }
+
+  std::unique_ptr<Slot[]> slots_;
+  uint64_t mask_{0};
+  std::atomic<uint64_t> head_{0};  // Total number of samples pushed
+  int64_t last_timestamp_{0};      // Producer-side only
+};
+
+}  // namespace magic::dog::sensor
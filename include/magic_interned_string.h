@@ -0,0 +1,238 @@
+#pragma once
+
+#include "magic_type.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace magic::dog::sensor {
+
+/**
+ * @brief Image encodings known to the SDK helpers, see ParseImageEncoding
+ */
+enum class ImageEncoding : uint8_t {
+  UNKNOWN = 0,
+  RGB8 = 1,       ///< "rgb8"
+  BGR8 = 2,       ///< "bgr8"
+  RGBA8 = 3,      ///< "rgba8"
+  BGRA8 = 4,      ///< "bgra8"
+  MONO8 = 5,      ///< "mono8" / "8UC1"
+  MONO16 = 6,     ///< "mono16"
+  TYPE_16UC1 = 7, ///< "16UC1"
+  TYPE_32FC1 = 8, ///< "32FC1"
+};
+
+/**
+ * @brief Map an encoding string to ImageEncoding without allocating; dispatches on length first.
+ * @return ImageEncoding::UNKNOWN for encodings not listed in the enum.
+ */
+inline ImageEncoding ParseImageEncoding(std::string_view encoding) {
+  switch (encoding.size()) {
+    case 4:
+      if (encoding == "rgb8") return ImageEncoding::RGB8;
+      if (encoding == "bgr8") return ImageEncoding::BGR8;
+      if (encoding == "8UC1") return ImageEncoding::MONO8;
+      break;
+    case 5:
+      if (encoding == "mono8") return ImageEncoding::MONO8;
+      if (encoding == "16UC1") return ImageEncoding::TYPE_16UC1;
+      if (encoding == "32FC1") return ImageEncoding::TYPE_32FC1;
+      if (encoding == "rgba8") return ImageEncoding::RGBA8;
+      if (encoding == "bgra8") return ImageEncoding::BGRA8;
+      break;
+    case 6:
+      if (encoding == "mono16") return ImageEncoding::MONO16;
+      break;
+    default:
+      break;
+  }
+  return ImageEncoding::UNKNOWN;
+}
+
+/// Canonical string of an encoding, empty for UNKNOWN
+inline std::string_view ImageEncodingName(ImageEncoding encoding) {
+  switch (encoding) {
+    case ImageEncoding::RGB8:
+      return "rgb8";
+    case ImageEncoding::BGR8:
+      return "bgr8";
+    case ImageEncoding::RGBA8:
+      return "rgba8";
+    case ImageEncoding::BGRA8:
+      return "bgra8";
+    case ImageEncoding::MONO8:
+      return "mono8";
+    case ImageEncoding::MONO16:
+      return "mono16";
+    case ImageEncoding::TYPE_16UC1:
+      return "16UC1";
+    case ImageEncoding::TYPE_32FC1:
+      return "32FC1";
+    default:
+      return "";
+  }
+}
+
+/// Bytes per pixel of an encoding, 0 for UNKNOWN
+inline int32_t ImageEncodingPixelSize(ImageEncoding encoding) {
+  switch (encoding) {
+    case ImageEncoding::MONO8:
+      return 1;
+    case ImageEncoding::MONO16:
+    case ImageEncoding::TYPE_16UC1:
+      return 2;
+    case ImageEncoding::RGB8:
+    case ImageEncoding::BGR8:
+      return 3;
+    case ImageEncoding::RGBA8:
+    case ImageEncoding::BGRA8:
+    case ImageEncoding::TYPE_32FC1:
+      return 4;
+    default:
+      return 0;
+  }
+}
+
+/// Encoding of an image message
+inline ImageEncoding GetImageEncoding(const Image& image) { return ParseImageEncoding(image.encoding); }
+
+namespace detail {
+
+/// Process-wide append-only string table; id 0 is the empty string
+class StringTable {
+ public:
+  static constexpr size_t kChunkBits = 10;
+  static constexpr size_t kChunkSize = size_t{1} << kChunkBits;
+  static constexpr size_t kMaxChunks = 4096;
+  /// Returned by Intern once the table is full; resolves to the empty string
+  static constexpr uint32_t kInvalidId = UINT32_MAX;
+
+  static StringTable& Instance() {
+    static StringTable table;
+    return table;
+  }
+
+  uint32_t Intern(std::string_view value) {
+    if (value.empty()) {
+      return 0;
+    }
+    // Thread-local cache, so repeated lookups take no lock and allocate nothing
+    thread_local std::unordered_map<std::string, uint32_t, Hash, std::equal_to<>> cache;
+    auto it = cache.find(value);
+    if (it != cache.end()) {
+      return it->second;
+    }
+    uint32_t id = InternShared(value);
+    if (id != kInvalidId) {
+      cache.emplace(std::string(value), id);
+    }
+    return id;
+  }
+
+  /// Lock-free, ids must come from Intern
+  const std::string& Name(uint32_t id) const {
+    if (id == kInvalidId) {
+      static const std::string empty;
+      return empty;
+    }
+    const std::string* chunk = chunks_[id >> kChunkBits].load(std::memory_order_acquire);
+    return chunk[id & (kChunkSize - 1)];
+  }
+
+ private:
+  struct Hash {
+    using is_transparent = void;
+    size_t operator()(std::string_view value) const { return std::hash<std::string_view>{}(value); }
+  };
+
+  StringTable() {
+    owned_[0] = std::make_unique<std::string[]>(kChunkSize);
+    chunks_[0].store(owned_[0].get(), std::memory_order_release);
+    next_id_ = 1;
+  }
+
+  uint32_t InternShared(std::string_view value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = ids_.find(value);
+    if (it != ids_.end()) {
+      return it->second;
+    }
+    size_t chunk = next_id_ >> kChunkBits;
+    if (chunk >= kMaxChunks) {
+      return kInvalidId;
+    }
+    if (!owned_[chunk]) {
+      owned_[chunk] = std::make_unique<std::string[]>(kChunkSize);
+      chunks_[chunk].store(owned_[chunk].get(), std::memory_order_release);
+    }
+    uint32_t id = static_cast<uint32_t>(next_id_++);
+    owned_[chunk][id & (kChunkSize - 1)] = std::string(value);
+    ids_.emplace(std::string(value), id);
+    return id;
+  }
+
+  std::mutex mutex_;
+  std::unordered_map<std::string, uint32_t, Hash, std::equal_to<>> ids_;
+  std::array<std::unique_ptr<std::string[]>, kMaxChunks> owned_;
+  std::array<std::atomic<const std::string*>, kMaxChunks> chunks_{};
+  size_t next_id_{0};
+};
+
+}  // namespace detail
+
+/**
+ * @class InternedString
+ * @brief Process-wide interned string: a 32-bit id compared and copied like an integer.
+ *
+ * Interning a string the calling thread has seen before is a lock-free hash lookup without allocation;
+ * str() resolves the id back to the stored string, also lock-free. Interned strings are never released,
+ * so intern only bounded sets such as frame ids, encodings and point field names.
+ *
+ * Example:
+ * @code
+ *   static const InternedString kDepthFrame("rgbd_depth_optical_frame");
+ *   if (InternedString(image->header.frame_id) == kDepthFrame) { ... }
+ * @endcode
+ */
+class InternedString final {
+ public:
+  InternedString() = default;
+
+  explicit InternedString(std::string_view value) : id_(detail::StringTable::Instance().Intern(value)) {}
+
+  /// Stored string, valid for the lifetime of the process
+  const std::string& str() const { return detail::StringTable::Instance().Name(id_); }
+
+  /// Stored string as a view
+  std::string_view view() const { return str(); }
+
+  /// Process-wide id, 0 for the empty string
+  uint32_t id() const { return id_; }
+
+  bool empty() const { return id_ == 0; }
+
+  /// False if the string could not be interned because the table is full (about 4 million strings); str() is
+  /// then empty and all such values compare equal
+  bool valid() const { return id_ != detail::StringTable::kInvalidId; }
+
+  friend bool operator==(InternedString a, InternedString b) { return a.id_ == b.id_; }
+  friend bool operator!=(InternedString a, InternedString b) { return a.id_ != b.id_; }
+  friend bool operator<(InternedString a, InternedString b) { return a.id_ < b.id_; }
+
+ private:
+  uint32_t id_{0};
+};
+
+}  // namespace magic::dog::sensor
+
+template <>
+struct std::hash<magic::dog::sensor::InternedString> {
+  size_t operator()(magic::dog::sensor::InternedString value) const { return std::hash<uint32_t>{}(value.id()); }
+};
@@ -0,0 +1,711 @@
+#pragma once
+
+#include "magic_audio_ops.h"
+#include "magic_audio_ring.h"
+#include "magic_simd.h"
+#include "magic_sound_localization.h"
+#include "magic_type.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace magic::dog::audio {
+
+/**
+ * @brief Log-mel / MFCC front end parameters; must match the ones the model was trained with
+ */
+struct LogMelConfig {
+  int32_t sample_rate = 16000;  ///< Input sample rate (Hz)
+  int32_t window_ms = 25;       ///< Analysis window (Hann)
+  int32_t hop_ms = 10;          ///< Frame shift
+  int32_t fft_size = 512;       ///< FFT length, a power of two >= the window
+  int32_t num_mel = 40;         ///< Mel bands
+  float low_hz = 20.0f;         ///< Lowest band edge (Hz)
+  float high_hz = 7600.0f;      ///< Highest band edge (Hz)
+  int32_t num_ceps = 0;         ///< MFCC coefficients (DCT-II of the log-mel energies); 0 outputs log-mel
+  float pre_emphasis = 0.97f;   ///< First-order pre-emphasis coefficient, 0 to disable
+};
+
+namespace detail {
+
+/// out[i] = re[i]^2 + im[i]^2
+inline void PowerSpectrum(const float* re, const float* im, float* out, size_t n) {
+  size_t i = 0;
+#if defined(MAGIC_SIMD_AVX2)
+  for (; i + 8 <= n; i += 8) {
+    __m256 r = _mm256_loadu_ps(re + i);
+    __m256 m = _mm256_loadu_ps(im + i);
+    _mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_mul_ps(r, r), _mm256_mul_ps(m, m)));
+  }
+#elif defined(MAGIC_SIMD_NEON)
+  for (; i + 4 <= n; i += 4) {
+    float32x4_t r = vld1q_f32(re + i);
+    float32x4_t m = vld1q_f32(im + i);
+    vst1q_f32(out + i, vaddq_f32(vmulq_f32(r, r), vmulq_f32(m, m)));
+  }
+#endif
+  for (; i < n; ++i) {
+    out[i] = re[i] * re[i] + im[i] * im[i];
+  }
+}
+
+inline double HzToMel(double hz) { return 2595.0 * std::log10(1.0 + hz / 700.0); }
+
+inline double MelToHz(double mel) { return 700.0 * (std::pow(10.0, mel / 2595.0) - 1.0); }
+
+}  // namespace detail
+
+/**
+ * @class LogMelExtractor
+ * @brief Streaming log-mel / MFCC feature extraction.
+ *
+ * Each hop, the last window of samples is pre-emphasised, Hann-windowed and transformed with the real FFT from
+ * the sound localization kernels; the power spectrum goes through triangular mel filters stored as padded
+ * sparse rows, so every band and every cepstral coefficient is one DotProduct8.
+ */
+class LogMelExtractor final : public NonCopyable {
+ public:
+  explicit LogMelExtractor(const LogMelConfig& config = {}) : config_(config) {
+    config_.sample_rate = std::max(config_.sample_rate, 1000);
+    window_ = std::max<size_t>(static_cast<size_t>(config_.sample_rate) * config_.window_ms / 1000, 16);
+    hop_ = std::max<size_t>(static_cast<size_t>(config_.sample_rate) * config_.hop_ms / 1000, 1);
+    size_t fft = 16;
+    while (fft < window_ || fft < static_cast<size_t>(config_.fft_size)) {
+      fft <<= 1;
+    }
+    fft_ = detail::RealFft(fft);
+    bins_ = fft / 2 + 1;
+    config_.num_mel = std::max(config_.num_mel, 1);
+    config_.num_ceps = std::clamp(config_.num_ceps, 0, config_.num_mel);
+    BuildTables();
+    Reset();
+  }
+
+  /// Features per frame
+  size_t GetDims() const { return config_.num_ceps > 0 ? static_cast<size_t>(config_.num_ceps) : static_cast<size_t>(config_.num_mel); }
+
+  /// Samples between frames
+  size_t GetHop() const { return hop_; }
+
+  /// Samples per analysis window
+  size_t GetWindow() const { return window_; }
+
+  /**
+   * @brief Feed samples and append the features of every completed frame.
+   * @param samples Mono S16 samples following the previously fed ones.
+   * @param count Number of samples.
+   * @param[out] features GetDims() values appended per frame.
+   * @return Number of frames appended.
+   */
+  size_t Process(const int16_t* samples, size_t count, std::vector<float>& features) {
+    size_t frames = 0;
+    for (size_t i = 0; i < count; ++i) {
+      float x = static_cast<float>(samples[i]) * (1.0f / 32768.0f);
+      buffer_.push_back(x - config_.pre_emphasis * previous_);
+      previous_ = x;
+      if (buffer_.size() == window_) {
+        size_t offset = features.size();
+        features.resize(offset + GetDims());
+        ComputeFrame(features.data() + offset);
+        buffer_.erase(buffer_.begin(), buffer_.begin() + static_cast<std::ptrdiff_t>(hop_));
+        ++frames;
+      }
+    }
+    return frames;
+  }
+
+  /// Forget buffered samples
+  void Reset() {
+    buffer_.clear();
+    // The first frame completes once a full window has been fed
+    buffer_.reserve(window_);
+    previous_ = 0.0f;
+  }
+
+ private:
+  void BuildTables() {
+    size_t fft = fft_.Size();
+    hann_.resize(window_);
+    for (size_t i = 0; i < window_; ++i) {
+      hann_[i] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * M_PI * i / window_));
+    }
+    double nyquist = config_.sample_rate / 2.0;
+    double low = detail::HzToMel(std::clamp<double>(config_.low_hz, 0.0, nyquist));
+    double high = detail::HzToMel(std::clamp<double>(config_.high_hz, 0.0, nyquist));
+    size_t bands = static_cast<size_t>(config_.num_mel);
+    mel_start_.assign(bands, 0);
+    mel_weights_.assign(bands, {});
+    for (size_t m = 0; m < bands; ++m) {
+      double left = detail::MelToHz(low + (high - low) * m / (bands + 1));
+      double center = detail::MelToHz(low + (high - low) * (m + 1) / (bands + 1));
+      double right = detail::MelToHz(low + (high - low) * (m + 2) / (bands + 1));
+      std::vector<float> row;
+      size_t first = bins_;
+      for (size_t k = 0; k < bins_; ++k) {
+        double hz = static_cast<double>(k) * config_.sample_rate / fft;
+        double w = hz <= left || hz >= right ? 0.0 : hz <= center ? (hz - left) / (center - left) : (right - hz) / (right - center);
+        if (w > 0.0) {
+          if (first == bins_) {
+            first = k;
+          }
+          row.resize(k - first + 1, 0.0f);
+          row[k - first] = static_cast<float>(w);
+        }
+      }
+      mel_start_[m] = first == bins_ ? 0 : first;
+      row.resize(std::max<size_t>((row.size() + 7) / 8 * 8, 8), 0.0f);
+      mel_weights_[m] = std::move(row);
+    }
+    size_t ceps = static_cast<size_t>(config_.num_ceps);
+    mel_stride_ = (bands + 7) / 8 * 8;
+    dct_.assign(ceps * mel_stride_, 0.0f);
+    for (size_t c = 0; c < ceps; ++c) {
+      double scale = std::sqrt((c == 0 ? 1.0 : 2.0) / bands);
+      for (size_t m = 0; m < bands; ++m) {
+        dct_[c * mel_stride_ + m] = static_cast<float>(scale * std::cos(M_PI * c * (m + 0.5) / bands));
+      }
+    }
+    frame_.assign(fft, 0.0f);
+    re_.assign(bins_, 0.0f);
+    im_.assign(bins_, 0.0f);
+    // Slack so a padded filter row starting near Nyquist can read past the last bin
+    size_t widest = 0;
+    for (const auto& row : mel_weights_) {
+      widest = std::max(widest, row.size());
+    }
+    power_.assign(bins_ + widest, 0.0f);
+    log_mel_.assign(mel_stride_, 0.0f);
+  }
+
+  void ComputeFrame(float* out) {
+    for (size_t i = 0; i < window_; ++i) {
+      frame_[i] = buffer_[i] * hann_[i];
+    }
+    fft_.Forward(frame_.data(), re_.data(), im_.data());
+    detail::PowerSpectrum(re_.data(), im_.data(), power_.data(), bins_);
+    size_t bands = mel_weights_.size();
+    for (size_t m = 0; m < bands; ++m) {
+      float energy = detail::DotProduct8(mel_weights_[m].data(), power_.data() + mel_start_[m], mel_weights_[m].size());
+      log_mel_[m] = std::log(std::max(energy, 1e-10f));
+    }
+    if (config_.num_ceps == 0) {
+      std::copy(log_mel_.begin(), log_mel_.begin() + static_cast<std::ptrdiff_t>(bands), out);
+      return;
+    }
+    for (int32_t c = 0; c < config_.num_ceps; ++c) {
+      out[c] = detail::DotProduct8(dct_.data() + static_cast<size_t>(c) * mel_stride_, log_mel_.data(), mel_stride_);
+    }
+  }
+
+  LogMelConfig config_;
+  size_t window_{400};
+  size_t hop_{160};
+  size_t bins_{257};
+  detail::RealFft fft_;
+  std::vector<float> hann_;
+  std::vector<size_t> mel_start_;
+  std::vector<std::vector<float>> mel_weights_;
+  size_t mel_stride_{8};
+  std::vector<float> dct_;
+  std::vector<float> buffer_;
+  float previous_{0.0f};
+  std::vector<float> frame_;
+  std::vector<float> re_;
+  std::vector<float> im_;
+  std::vector<float> power_;
+  std::vector<float> log_mel_;
+};
+
+/**
+ * @brief Keyword classifier run on a sliding window of feature frames.
+ *
+ * Implement this to plug in another inference engine; DenseKeywordModel is the built-in one.
+ */
+class KeywordModel : public NonCopyable {
+ public:
+  virtual ~KeywordModel() = default;
+
+  /// Feature frames per inference
+  virtual size_t GetContextFrames() const = 0;
+
+  /// Features per frame; must equal LogMelExtractor::GetDims
+  virtual size_t GetFeatureDims() const = 0;
+
+  /// Output labels; label 0 is the filler class (no keyword)
+  virtual const std::vector<std::string>& GetLabels() const = 0;
+
+  /**
+   * @brief Classify one window.
+   * @param features GetContextFrames() frames of GetFeatureDims() values, oldest first.
+   * @param[out] posteriors One probability per label.
+   * @return False on failure.
+   */
+  virtual bool Infer(const float* features, std::vector<float>& posteriors) = 0;
+};
+
+/**
+ * @class DenseKeywordModel
+ * @brief Fully connected network over a stacked feature window with a softmax output, evaluated with SIMD GEMV.
+ *
+ * Model file (little endian): "MKWS", uint32 version = 1, uint32 context_frames, uint32 feature_dims,
+ * uint32 label_count followed by (uint32 length, UTF-8 bytes) per label, uint32 has_normalization followed by
+ * float mean[feature_dims] and float inv_std[feature_dims] if 1, uint32 layer_count followed per layer by
+ * uint32 inputs, uint32 outputs, uint32 activation (0 linear, 1 ReLU), float weights[outputs][inputs] and
+ * float bias[outputs]. The first layer takes context_frames * feature_dims inputs and the last produces
+ * label_count outputs.
+ */
+class DenseKeywordModel final : public KeywordModel {
+ public:
+  DenseKeywordModel() = default;
+
+  /**
+   * @brief Describe the input window and labels of a model built with AddLayer.
+   * @param context_frames Feature frames per inference.
+   * @param feature_dims Features per frame.
+   * @param labels Output labels, filler first.
+   */
+  DenseKeywordModel(size_t context_frames, size_t feature_dims, std::vector<std::string> labels)
+      : context_frames_(context_frames), feature_dims_(feature_dims), labels_(std::move(labels)) {}
+
+  /**
+   * @brief Load a model file.
+   * @param path File in the format described above.
+   * @return False if missing or malformed; the model is left empty.
+   */
+  bool Load(const std::string& path) {
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+      return false;
+    }
+    std::vector<uint8_t> bytes;
+    uint8_t buffer[1 << 16];
+    size_t n;
+    while ((n = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+      bytes.insert(bytes.end(), buffer, buffer + n);
+    }
+    std::fclose(file);
+    Clear();
+    if (!Parse(bytes)) {
+      Clear();
+      return false;
+    }
+    return true;
+  }
+
+  /**
+   * @brief Append a layer.
+   * @param inputs Inputs; the previous layer's outputs or context_frames * feature_dims.
+   * @param outputs Outputs.
+   * @param weights outputs x inputs, row-major.
+   * @param bias outputs values.
+   * @param relu Apply ReLU, otherwise linear.
+   * @return False if the shapes do not chain.
+   */
+  bool AddLayer(size_t inputs, size_t outputs, const std::vector<float>& weights, const std::vector<float>& bias, bool relu) {
+    size_t expected = layers_.empty() ? context_frames_ * feature_dims_ : layers_.back().outputs;
+    if (inputs != expected || outputs == 0 || weights.size() != inputs * outputs || bias.size() != outputs) {
+      return false;
+    }
+    Layer layer;
+    layer.inputs = inputs;
+    layer.outputs = outputs;
+    layer.stride = (inputs + 7) / 8 * 8;
+    layer.relu = relu;
+    layer.weights.assign(outputs * layer.stride, 0.0f);
+    for (size_t o = 0; o < outputs; ++o) {
+      std::copy(weights.begin() + o * inputs, weights.begin() + (o + 1) * inputs, layer.weights.begin() + o * layer.stride);
+    }
+    layer.bias = bias;
+    layers_.push_back(std::move(layer));
+    return true;
+  }
+
+  /**
+   * @brief Per-feature input normalization (x - mean) * inv_std, applied to every frame.
+   */
+  bool SetNormalization(const std::vector<float>& mean, const std::vector<float>& inv_std) {
+    if (mean.size() != feature_dims_ || inv_std.size() != feature_dims_) {
+      return false;
+    }
+    mean_ = mean;
+    inv_std_ = inv_std;
+    return true;
+  }
+
+  /// Whether the layers form a complete network ending in one output per label
+  bool IsValid() const { return !layers_.empty() && !labels_.empty() && layers_.back().outputs == labels_.size(); }
+
+  size_t GetContextFrames() const override { return context_frames_; }
+  size_t GetFeatureDims() const override { return feature_dims_; }
+  const std::vector<std::string>& GetLabels() const override { return labels_; }
+
+  bool Infer(const float* features, std::vector<float>& posteriors) override {
+    if (!IsValid()) {
+      return false;
+    }
+    size_t inputs = context_frames_ * feature_dims_;
+    input_.assign(layers_.front().stride, 0.0f);
+    for (size_t i = 0; i < inputs; ++i) {
+      size_t d = i % feature_dims_;
+      input_[i] = mean_.empty() ? features[i] : (features[i] - mean_[d]) * inv_std_[d];
+    }
+    for (const auto& layer : layers_) {
+      // Pad the output to the next layer's stride so it can be used as a DotProduct8 operand directly
+      output_.assign((layer.outputs + 7) / 8 * 8, 0.0f);
+      for (size_t o = 0; o < layer.outputs; ++o) {
+        float y = detail::DotProduct8(layer.weights.data() + o * layer.stride, input_.data(), layer.stride) + layer.bias[o];
+        output_[o] = layer.relu ? std::max(y, 0.0f) : y;
+      }
+      input_.swap(output_);
+    }
+    size_t labels = labels_.size();
+    posteriors.resize(labels);
+    float peak = *std::max_element(input_.begin(), input_.begin() + static_cast<std::ptrdiff_t>(labels));
+    float sum = 0.0f;
+    for (size_t k = 0; k < labels; ++k) {
+      posteriors[k] = std::exp(input_[k] - peak);
+      sum += posteriors[k];
+    }
+    for (auto& p : posteriors) {
+      p /= sum;
+    }
+    return true;
+  }
+
+ private:
+  struct Layer {
+    size_t inputs = 0;
+    size_t outputs = 0;
+    size_t stride = 0;
+    bool relu = false;
+    std::vector<float> weights;
+    std::vector<float> bias;
+  };
+
+  void Clear() {
+    context_frames_ = 0;
+    feature_dims_ = 0;
+    labels_.clear();
+    mean_.clear();
+    inv_std_.clear();
+    layers_.clear();
+  }
+
+  bool Parse(const std::vector<uint8_t>& bytes) {
+    size_t pos = 0;
+    auto read_le = [&](size_t at) {
+      const uint8_t* p = bytes.data() + at;
+      return static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8 | static_cast<uint32_t>(p[2]) << 16 |
+             static_cast<uint32_t>(p[3]) << 24;
+    };
+    auto u32 = [&](uint32_t& value) {
+      if (pos + 4 > bytes.size()) {
+        return false;
+      }
+      value = read_le(pos);
+      pos += 4;
+      return true;
+    };
+    auto floats = [&](std::vector<float>& out, size_t count) {
+      if (count > (bytes.size() - pos) / 4) {
+        return false;
+      }
+      out.resize(count);
+      for (size_t i = 0; i < count; ++i) {
+        uint32_t bits = read_le(pos + 4 * i);
+        std::memcpy(&out[i], &bits, 4);
+      }
+      pos += 4 * count;
+      return true;
+    };
+    uint32_t version = 0, context = 0, dims = 0, label_count = 0;
+    if (bytes.size() < 4 || std::memcmp(bytes.data(), "MKWS", 4) != 0) {
+      return false;
+    }
+    pos = 4;
+    if (!u32(version) || version != 1 || !u32(context) || !u32(dims) || !u32(label_count) || context == 0 || dims == 0 ||
+        label_count < 2) {
+      return false;
+    }
+    context_frames_ = context;
+    feature_dims_ = dims;
+    for (uint32_t k = 0; k < label_count; ++k) {
+      uint32_t length = 0;
+      if (!u32(length) || length > bytes.size() - pos) {
+        return false;
+      }
+      labels_.emplace_back(reinterpret_cast<const char*>(bytes.data() + pos), length);
+      pos += length;
+    }
+    uint32_t has_normalization = 0;
+    if (!u32(has_normalization)) {
+      return false;
+    }
+    if (has_normalization != 0) {
+      std::vector<float> mean, inv_std;
+      if (!floats(mean, dims) || !floats(inv_std, dims) || !SetNormalization(mean, inv_std)) {
+        return false;
+      }
+    }
+    uint32_t layer_count = 0;
+    if (!u32(layer_count) || layer_count == 0) {
+      return false;
+    }
+    for (uint32_t l = 0; l < layer_count; ++l) {
+      uint32_t inputs = 0, outputs = 0, activation = 0;
+      std::vector<float> weights, bias;
+      if (!u32(inputs) || !u32(outputs) || !u32(activation) || activation > 1 ||
+          !floats(weights, static_cast<size_t>(inputs) * outputs) || !floats(bias, outputs) ||
+          !AddLayer(inputs, outputs, weights, bias, activation == 1)) {
+        return false;
+      }
+    }
+    return pos == bytes.size() && IsValid();
+  }
+
+  size_t context_frames_{0};
+  size_t feature_dims_{0};
+  std::vector<std::string> labels_;
+  std::vector<float> mean_;
+  std::vector<float> inv_std_;
+  std::vector<Layer> layers_;
+  std::vector<float> input_;
+  std::vector<float> output_;
+};
+
+/**
+ * @brief Keyword spotting parameters
+ */
+struct KeywordSpotterConfig {
+  LogMelConfig features;                   ///< Front end, as used in training
+  int32_t stride_frames = 3;               ///< Feature frames between inferences
+  int32_t smooth_frames = 4;               ///< Inferences averaged before thresholding
+  float threshold = 0.8f;                  ///< Smoothed posterior that triggers a keyword
+  std::map<std::string, float> thresholds; ///< Per-keyword overrides of threshold
+  int32_t refractory_ms = 1000;            ///< Minimum gap between two events of the same keyword
+  int32_t history_ms = 10000;              ///< How long events are kept for HasKeywordBetween
+};
+
+/**
+ * @brief One detected keyword
+ */
+struct KeywordEvent {
+  std::string keyword;      ///< Model label
+  size_t label = 0;         ///< Label index
+  float confidence = 0.0f;  ///< Smoothed posterior at detection
+  int64_t start_time = 0;   ///< Capture time of the first sample in the detecting window (ns)
+  int64_t end_time = 0;     ///< Capture time of the last sample seen at detection (ns)
+};
+
+/**
+ * @class KeywordSpotter
+ * @brief On-device keyword spotting on the BF voice stream.
+ *
+ * Features from LogMelExtractor feed a sliding window; every stride_frames the KeywordModel classifies the
+ * window, posteriors are averaged over smooth_frames inferences and a keyword fires when its average reaches
+ * its threshold (then stays quiet for refractory_ms). Detection runs in the subscription callback and takes
+ * tens of milliseconds after the word ends instead of a cloud ASR round trip. Recent events are kept so the
+ * cloud path can be limited to speech that matched nothing (HasKeywordBetween).
+ *
+ * Example:
+ * @code
+ *   auto model = std::make_shared<DenseKeywordModel>();
+ *   model->Load("/opt/models/kws_dance_handshake.mkws");
+ *   KeywordSpotter spotter(model);
+ *   spotter.SetKeywordCallback([](const KeywordEvent& e) { if (e.keyword == "跳舞") Dancing(); });
+ *   segmenter.SetUtteranceCallback([&](const UtteranceSegmenter::UtterancePtr u) {
+ *     if (!spotter.HasKeywordBetween(u->start_time, u->end_time)) { UploadToCloudAsr(*u); }
+ *   });
+ *   controller.SubscribeBfVoiceData([&](const std::shared_ptr<ByteMultiArray> msg) {
+ *     spotter.Process(*msg);
+ *     segmenter.Process(*msg);
+ *   });
+ * @endcode
+ */
+class KeywordSpotter final : public NonCopyable {
+ public:
+  using KeywordCallback = std::function<void(const KeywordEvent& event)>;
+  using ByteMultiArrayCallback = std::function<void(const std::shared_ptr<ByteMultiArray>)>;
+
+  /**
+   * @brief Constructor
+   * @param model Classifier; its GetFeatureDims must match the configured front end.
+   * @param config Spotting parameters.
+   */
+  explicit KeywordSpotter(std::shared_ptr<KeywordModel> model, const KeywordSpotterConfig& config = {})
+      : config_(config), extractor_(config.features), model_(std::move(model)) {
+    config_.stride_frames = std::max(config_.stride_frames, 1);
+    config_.smooth_frames = std::max(config_.smooth_frames, 1);
+    clock_ = detail::SampleClock(std::max(config_.features.sample_rate, 1000));
+    if (model_) {
+      context_ = model_->GetContextFrames();
+      dims_ = extractor_.GetDims();
+      ready_ = context_ > 0 && model_->GetFeatureDims() == dims_ && model_->GetLabels().size() >= 2;
+    }
+    Reset();
+  }
+
+  /// Whether the model matches the front end; Process does nothing otherwise
+  bool IsReady() const { return ready_; }
+
+  /// Set the callback receiving keyword events; it runs on the thread calling Process
+  void SetKeywordCallback(const KeywordCallback callback) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    callback_ = callback;
+  }
+
+  /**
+   * @brief Feed mono S16 samples.
+   * @param samples Samples following the previously fed ones.
+   * @param count Number of samples.
+   * @param arrival_time Time the chunk was received (ns, system clock), 0 for now.
+   */
+  void Process(const int16_t* samples, size_t count, int64_t arrival_time = 0) {
+    if (!ready_) {
+      return;
+    }
+    std::vector<KeywordEvent> detected;
+    KeywordCallback callback;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      clock_.Update(samples_total_ + static_cast<int64_t>(count), arrival_time != 0 ? arrival_time : detail::AudioNowNs());
+      size_t hop = extractor_.GetHop();
+      features_.clear();
+      size_t frames = extractor_.Process(samples, count, features_);
+      for (size_t f = 0; f < frames; ++f) {
+        // Frame f of this chunk ends at the window's last sample
+        ++frames_total_;
+        int64_t end_sample = static_cast<int64_t>(frames_total_ - 1) * static_cast<int64_t>(hop) + static_cast<int64_t>(extractor_.GetWindow());
+        window_.insert(window_.end(), features_.begin() + f * dims_, features_.begin() + (f + 1) * dims_);
+        if (window_.size() > context_ * dims_) {
+          window_.erase(window_.begin(), window_.begin() + static_cast<std::ptrdiff_t>(dims_));
+        }
+        if (window_.size() == context_ * dims_ && ++since_inference_ >= static_cast<size_t>(config_.stride_frames)) {
+          since_inference_ = 0;
+          Infer(end_sample, detected);
+        }
+      }
+      samples_total_ += static_cast<int64_t>(count);
+      callback = callback_;
+    }
+    if (callback) {
+      for (const auto& event : detected) {
+        callback(event);
+      }
+    }
+  }
+
+  /// Feed one BF voice message (S16LE mono bytes)
+  void Process(const ByteMultiArray& msg, int64_t arrival_time = 0) {
+    thread_local std::vector<int16_t> samples;
+    samples.resize(msg.data.size() / 2);
+    if (!samples.empty()) {
+      std::memcpy(samples.data(), msg.data.data(), samples.size() * 2);
+    }
+    Process(samples.data(), samples.size(), arrival_time);
+  }
+
+  /// Callback for SubscribeBfVoiceData; the spotter must outlive the subscription
+  ByteMultiArrayCallback Callback() {
+    return [this](const std::shared_ptr<ByteMultiArray> msg) {
+      if (msg) {
+        Process(*msg);
+      }
+    };
+  }
+
+  /**
+   * @brief Whether a keyword was detected overlapping a time span, e.g. an utterance from UtteranceSegmenter.
+   * @param start_time Span start (ns).
+   * @param end_time Span end (ns).
+   */
+  bool HasKeywordBetween(int64_t start_time, int64_t end_time) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& event : history_) {
+      if (event.start_time <= end_time && event.end_time >= start_time) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  /// Drop buffered audio, smoothing state and event history
+  void Reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    extractor_.Reset();
+    window_.clear();
+    recent_.clear();
+    history_.clear();
+    last_fired_.assign(ready_ ? model_->GetLabels().size() : 0, INT64_MIN);
+    since_inference_ = 0;
+    frames_total_ = 0;
+    samples_total_ = 0;
+    clock_.Reset();
+  }
+
+ private:
+  void Infer(int64_t end_sample, std::vector<KeywordEvent>& detected) {
+    if (!model_->Infer(window_.data(), posteriors_)) {
+      return;
+    }
+    const auto& labels = model_->GetLabels();
+    recent_.push_back(posteriors_);
+    if (recent_.size() > static_cast<size_t>(config_.smooth_frames)) {
+      recent_.pop_front();
+    }
+    int64_t start_sample = end_sample - static_cast<int64_t>((context_ - 1) * extractor_.GetHop() + extractor_.GetWindow());
+    int64_t end_time = clock_.TimeAt(end_sample);
+    for (size_t k = 1; k < labels.size() && k < posteriors_.size(); ++k) {
+      float sum = 0.0f;
+      for (const auto& p : recent_) {
+        sum += p[k];
+      }
+      float confidence = sum / static_cast<float>(recent_.size());
+      auto it = config_.thresholds.find(labels[k]);
+      float threshold = it != config_.thresholds.end() ? it->second : config_.threshold;
+      if (confidence < threshold ||
+          (last_fired_[k] != INT64_MIN && end_time - last_fired_[k] < static_cast<int64_t>(config_.refractory_ms) * 1000000)) {
+        continue;
+      }
+      last_fired_[k] = end_time;
+      KeywordEvent event{labels[k], k, confidence, clock_.TimeAt(std::max<int64_t>(start_sample, 0)), end_time};
+      history_.push_back(event);
+      detected.push_back(std::move(event));
+    }
+    while (!history_.empty() && end_time - history_.front().end_time > static_cast<int64_t>(config_.history_ms) * 1000000) {
+      history_.pop_front();
+    }
+  }
+
+  KeywordSpotterConfig config_;
+  LogMelExtractor extractor_;
+  std::shared_ptr<KeywordModel> model_;
+  size_t context_{0};
+  size_t dims_{0};
+  bool ready_{false};
+
+  mutable std::mutex mutex_;
+  KeywordCallback callback_;
+  detail::SampleClock clock_{16000};
+  std::vector<float> features_;
+  std::vector<float> window_;
+  std::vector<float> posteriors_;
+  std::deque<std::vector<float>> recent_;
+  std::deque<KeywordEvent> history_;
+  std::vector<int64_t> last_fired_;
+  size_t since_inference_{0};
+  uint64_t frames_total_{0};
+  int64_t samples_total_{0};
+};
+
+}  // namespace magic::dog::audio
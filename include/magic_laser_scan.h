@@ -0,0 +1,251 @@
+#pragma once
+
+#include "magic_simd.h"
+#include "magic_type.h"
+
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace magic::dog::sensor {
+
+/**
+ * @brief Float32 laser scan, half the memory and bandwidth of LaserScan
+ *
+ * Angles in radians, times in seconds, ranges in meters, as delivered in LaserScan.
+ */
+struct CompactLaserScan {
+  Header header;
+
+  float angle_min;
+  float angle_max;
+  float angle_increment;
+  float time_increment;
+  float scan_time;
+  float range_min;
+  float range_max;
+  std::vector<float> ranges;
+  std::vector<float> intensities;
+};
+
+/**
+ * @brief 2D points of a scan in the laser frame, structure-of-arrays layout
+ */
+struct ScanPoints2D {
+  std::vector<float> x;
+  std::vector<float> y;
+
+  size_t size() const { return x.size(); }
+};
+
+namespace detail {
+
+/// Narrow doubles to floats
+inline void NarrowToFloat(const double* src, float* dst, size_t n) {
+  size_t i = 0;
+#if defined(MAGIC_SIMD_AVX2)
+  for (; i + 8 <= n; i += 8) {
+    __m128 lo = _mm256_cvtpd_ps(_mm256_loadu_pd(src + i));
+    __m128 hi = _mm256_cvtpd_ps(_mm256_loadu_pd(src + i + 4));
+    _mm256_storeu_ps(dst + i, _mm256_set_m128(hi, lo));
+  }
+#elif defined(MAGIC_SIMD_NEON)
+  for (; i + 4 <= n; i += 4) {
+    float32x2_t lo = vcvt_f32_f64(vld1q_f64(src + i));
+    float32x2_t hi = vcvt_f32_f64(vld1q_f64(src + i + 2));
+    vst1q_f32(dst + i, vcombine_f32(lo, hi));
+  }
+#endif
+  for (; i < n; ++i) {
+    dst[i] = static_cast<float>(src[i]);
+  }
+}
+
+}  // namespace detail
+
+/**
+ * @brief Convert a LaserScan into its float32 representation.
+ * @param scan Source scan.
+ * @param[out] compact Destination, vector capacity is reused.
+ */
+inline void ToCompactLaserScan(const LaserScan& scan, CompactLaserScan& compact) {
+  compact.header = scan.header;
+  compact.angle_min = static_cast<float>(scan.angle_min);
+  compact.angle_max = static_cast<float>(scan.angle_max);
+  compact.angle_increment = static_cast<float>(scan.angle_increment);
+  compact.time_increment = static_cast<float>(scan.time_increment);
+  compact.scan_time = static_cast<float>(scan.scan_time);
+  compact.range_min = static_cast<float>(scan.range_min);
+  compact.range_max = static_cast<float>(scan.range_max);
+  compact.ranges.resize(scan.ranges.size());
+  detail::NarrowToFloat(scan.ranges.data(), compact.ranges.data(), scan.ranges.size());
+  compact.intensities.resize(scan.intensities.size());
+  detail::NarrowToFloat(scan.intensities.data(), compact.intensities.data(), scan.intensities.size());
+}
+
+/**
+ * @brief Wrap a CompactLaserScan consumer into a callback for SensorController::SubscribeLaserScan.
+ *
+ * Opt-in float32 mode: the double buffers of each received scan are narrowed once, and the consumer
+ * only ever touches the float32 copy.
+ * @param callback Consumer of compact scans.
+ * @return Callback to pass to SubscribeLaserScan.
+ */
+inline std::function<void(const std::shared_ptr<LaserScan>)> MakeCompactLaserScanCallback(
+    std::function<void(const std::shared_ptr<CompactLaserScan>)> callback) {
+  return [callback = std::move(callback)](const std::shared_ptr<LaserScan> msg) {
+    if (!msg) {
+      return;
+    }
+    auto compact = std::make_shared<CompactLaserScan>();
+    ToCompactLaserScan(*msg, *compact);
+    callback(compact);
+  };
+}
+
+/**
+ * @class LaserScanTrigTable
+ * @brief Per-configuration cos/sin table of the beam angles of a scan.
+ *
+ * The table is keyed by (angle_min, angle_increment, beam count) and only rebuilt when one of them changes,
+ * which for a given lidar happens once.
+ */
+class LaserScanTrigTable final {
+ public:
+  LaserScanTrigTable() = default;
+
+  /**
+   * @brief Make sure the table matches a scan configuration.
+   * @return true if the table was rebuilt.
+   */
+  bool Update(float angle_min, float angle_increment, size_t beam_count) {
+    if (beam_count == cos_.size() && angle_min == angle_min_ && angle_increment == angle_increment_) {
+      return false;
+    }
+    angle_min_ = angle_min;
+    angle_increment_ = angle_increment;
+    cos_.resize(beam_count);
+    sin_.resize(beam_count);
+    for (size_t i = 0; i < beam_count; ++i) {
+      double angle = static_cast<double>(angle_min) + static_cast<double>(angle_increment) * static_cast<double>(i);
+      cos_[i] = static_cast<float>(std::cos(angle));
+      sin_[i] = static_cast<float>(std::sin(angle));
+    }
+    return true;
+  }
+
+  /// Number of beams of the current configuration
+  size_t size() const { return cos_.size(); }
+
+  const float* cos() const { return cos_.data(); }
+  const float* sin() const { return sin_.data(); }
+
+ private:
+  float angle_min_{0.0f};
+  float angle_increment_{0.0f};
+  std::vector<float> cos_;
+  std::vector<float> sin_;
+};
+
+/**
+ * @class LaserScanProjector
+ * @brief Converts scans into 2D cartesian points with a cached trig table and vectorised kernels.
+ *
+ * Beams whose range is outside [range_min, range_max] (or NaN/inf) are masked out, the remaining points
+ * are stored contiguously in beam order. Not thread-safe, use one projector per consumer thread.
+ */
+class LaserScanProjector final {
+ public:
+  LaserScanProjector() = default;
+
+  /**
+   * @brief Convert a compact scan to xy points.
+   * @param scan Source scan.
+   * @param[out] points Valid points, capacity is reused across calls.
+   */
+  void ToCartesian(const CompactLaserScan& scan, ScanPoints2D& points) {
+    table_.Update(scan.angle_min, scan.angle_increment, scan.ranges.size());
+    Project(scan.ranges.data(), scan.ranges.size(), scan.range_min, scan.range_max, points);
+  }
+
+  /**
+   * @brief Convert a double precision scan to xy points.
+   * @param scan Source scan.
+   * @param[out] points Valid points, capacity is reused across calls.
+   */
+  void ToCartesian(const LaserScan& scan, ScanPoints2D& points) {
+    table_.Update(static_cast<float>(scan.angle_min), static_cast<float>(scan.angle_increment), scan.ranges.size());
+    ranges_.resize(scan.ranges.size());
+    detail::NarrowToFloat(scan.ranges.data(), ranges_.data(), scan.ranges.size());
+    Project(ranges_.data(), ranges_.size(), static_cast<float>(scan.range_min), static_cast<float>(scan.range_max), points);
+  }
+
+  /// Trig table of the last converted scan
+  const LaserScanTrigTable& Table() const { return table_; }
+
+ private:
+  void Project(const float* ranges, size_t n, float range_min, float range_max, ScanPoints2D& points) const {
+    points.x.resize(n);
+    points.y.resize(n);
+    const float* cos_table = table_.cos();
+    const float* sin_table = table_.sin();
+    float* out_x = points.x.data();
+    float* out_y = points.y.data();
+    size_t count = 0;
+    size_t i = 0;
+#if defined(MAGIC_SIMD_AVX2)
+    __m256 vmin = _mm256_set1_ps(range_min);
+    __m256 vmax = _mm256_set1_ps(range_max);
+    for (; i + 8 <= n; i += 8) {
+      __m256 r = _mm256_loadu_ps(ranges + i);
+      int mask = _mm256_movemask_ps(_mm256_and_ps(_mm256_cmp_ps(r, vmin, _CMP_GE_OQ), _mm256_cmp_ps(r, vmax, _CMP_LE_OQ)));
+      if (mask == 0) {
+        continue;
+      }
+      alignas(32) float px[8], py[8];
+      _mm256_store_ps(px, _mm256_mul_ps(r, _mm256_loadu_ps(cos_table + i)));
+      _mm256_store_ps(py, _mm256_mul_ps(r, _mm256_loadu_ps(sin_table + i)));
+      for (int k = 0; k < 8; ++k) {
+        out_x[count] = px[k];
+        out_y[count] = py[k];
+        count += (mask >> k) & 1;
+      }
+    }
+#elif defined(MAGIC_SIMD_NEON)
+    float32x4_t vmin = vdupq_n_f32(range_min);
+    float32x4_t vmax = vdupq_n_f32(range_max);
+    for (; i + 4 <= n; i += 4) {
+      float32x4_t r = vld1q_f32(ranges + i);
+      uint32x4_t valid = vandq_u32(vcgeq_f32(r, vmin), vcleq_f32(r, vmax));
+      if (vmaxvq_u32(valid) == 0) {
+        continue;
+      }
+      float px[4], py[4];
+      uint32_t lanes[4];
+      vst1q_f32(px, vmulq_f32(r, vld1q_f32(cos_table + i)));
+      vst1q_f32(py, vmulq_f32(r, vld1q_f32(sin_table + i)));
+      vst1q_u32(lanes, valid);
+      for (int k = 0; k < 4; ++k) {
+        out_x[count] = px[k];
+        out_y[count] = py[k];
+        count += lanes[k] & 1;
+      }
+    }
+#endif
+    for (; i < n; ++i) {
+      float r = ranges[i];
+      out_x[count] = r * cos_table[i];
+      out_y[count] = r * sin_table[i];
+      count += (r >= range_min && r <= range_max) ? 1 : 0;
+    }
+    points.x.resize(count);
+    points.y.resize(count);
+  }
+
+  LaserScanTrigTable table_;
+  std::vector<float> ranges_;  // Scratch for double precision scans
+};
+
+}  // namespace magic::dog::sensor
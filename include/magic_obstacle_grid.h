@@ -0,0 +1,588 @@
+#pragma once
+
+#include "magic_laser_scan.h"
+#include "magic_type.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace magic::dog::sensor {
+
+/**
+ * @brief Obstacle grid parameters, distances in meters
+ */
+struct ObstacleGridConfig {
+  float resolution = 0.05f;               ///< Cell size
+  int32_t size = 128;                     ///< Cells per side, rounded up to a multiple of 64; the robot is at the center
+  float min_obstacle_height = 0.05f;      ///< TOF returns below this height (robot frame) are treated as ground
+  float max_obstacle_height = 0.60f;      ///< TOF returns above this height are treated as overhead
+  int64_t obstacle_ttl_ns = 500000000;    ///< Time after which an obstacle not seen again is forgotten
+  float footprint_half_length = 0.35f;    ///< Robot footprint half extent along x
+  float footprint_half_width = 0.20f;     ///< Robot footprint half extent along y
+  float safety_margin = 0.05f;            ///< Added to the footprint by IsPathClear
+};
+
+/**
+ * @brief Planar mounting pose of a sensor in the robot frame
+ */
+struct SensorMount {
+  float x = 0.0f;    ///< Position x (m)
+  float y = 0.0f;    ///< Position y (m)
+  float yaw = 0.0f;  ///< Heading (rad)
+};
+
+/**
+ * @brief Mounting and geometry of a TOF sensor whose zones form a rows x cols matrix
+ */
+struct TofMount {
+  float x = 0.0f;                ///< Position x (m)
+  float y = 0.0f;                ///< Position y (m)
+  float z = 0.0f;                ///< Height above ground (m)
+  float yaw = 0.0f;              ///< Heading (rad)
+  float pitch = 0.0f;            ///< Pitch, positive looks up (rad)
+  float horizontal_fov = 0.79f;  ///< Horizontal field of view (rad)
+  float vertical_fov = 0.79f;    ///< Vertical field of view (rad)
+  float min_range = 0.02f;       ///< Returns closer than this are ignored (m)
+  float max_range = 4.0f;        ///< Returns farther than this are ignored (m)
+  float range_scale = 1.0f;      ///< Multiplier converting array values to meters
+};
+
+/**
+ * @brief Mounting and geometry of a single-beam range sensor such as an ultrasonic transducer
+ */
+struct RangeSensorMount {
+  float x = 0.0f;            ///< Position x (m)
+  float y = 0.0f;            ///< Position y (m)
+  float yaw = 0.0f;          ///< Heading (rad)
+  float fov = 0.5f;          ///< Cone opening angle (rad)
+  float min_range = 0.03f;   ///< Returns closer than this are ignored (m)
+  float max_range = 2.0f;    ///< Returns at or beyond this mean "nothing seen" (m)
+  float range_scale = 1.0f;  ///< Multiplier converting array values to meters
+};
+
+namespace detail {
+
+/**
+ * @brief Test whether a footprint translated along (vx, vy) for horizon seconds overlaps an occupied cell.
+ *        The area outside the grid is unknown and counts as occupied.
+ * @param load_word Returns the 64-bit occupancy word w of row iy.
+ */
+template <typename LoadWord>
+bool SweptFootprintClear(const LoadWord& load_word, int32_t size, float resolution, float half_length, float half_width,
+                         float vx, float vy, float horizon) {
+  int32_t half = size / 2;
+  float inv_res = 1.0f / resolution;
+  // Cell centers within half a cell of the footprint border count as overlapping
+  float hx = half_length + 0.5f * resolution;
+  float hy = half_width + 0.5f * resolution;
+  horizon = std::max(horizon, 0.0f);
+  float y_lo = std::min(0.0f, vy * horizon) - hy;
+  float y_hi = std::max(0.0f, vy * horizon) + hy;
+  // Bounds are checked in float before the casts, which also rejects huge or NaN velocities
+  float row_lo = std::ceil(y_lo * inv_res - 0.5f) + static_cast<float>(half);
+  float row_hi = std::floor(y_hi * inv_res - 0.5f) + static_cast<float>(half);
+  if (!(row_lo >= 0.0f && row_hi <= static_cast<float>(size - 1))) {
+    return false;
+  }
+  int32_t row_begin = static_cast<int32_t>(row_lo);
+  int32_t row_end = static_cast<int32_t>(row_hi);
+  for (int32_t iy = row_begin; iy <= row_end; ++iy) {
+    float yc = (static_cast<float>(iy - half) + 0.5f) * resolution;
+    // Times at which the footprint covers this row
+    float t0 = 0.0f;
+    float t1 = horizon;
+    if (vy != 0.0f) {
+      float a = (yc - hy) / vy;
+      float b = (yc + hy) / vy;
+      t0 = std::max(t0, std::min(a, b));
+      t1 = std::min(t1, std::max(a, b));
+    } else if (std::fabs(yc) > hy) {
+      continue;
+    }
+    if (t0 > t1) {
+      continue;
+    }
+    float x_lo = std::min(vx * t0, vx * t1) - hx;
+    float x_hi = std::max(vx * t0, vx * t1) + hx;
+    float col_lo = std::ceil(x_lo * inv_res - 0.5f) + static_cast<float>(half);
+    float col_hi = std::floor(x_hi * inv_res - 0.5f) + static_cast<float>(half);
+    if (!(col_lo >= 0.0f && col_hi <= static_cast<float>(size - 1))) {
+      return false;
+    }
+    int32_t col_begin = static_cast<int32_t>(col_lo);
+    int32_t col_end = static_cast<int32_t>(col_hi);
+    for (int32_t w = col_begin >> 6; col_begin <= col_end && w <= (col_end >> 6); ++w) {
+      uint64_t mask = ~0ull;
+      if (w == (col_begin >> 6)) {
+        mask &= ~0ull << (col_begin & 63);
+      }
+      if (w == (col_end >> 6) && (col_end & 63) != 63) {
+        mask &= (1ull << ((col_end & 63) + 1)) - 1;
+      }
+      if (load_word(iy, w) & mask) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+}  // namespace detail
+
+/**
+ * @brief Immutable copy of the obstacle grid, row-major bitmap with one bit per cell
+ */
+struct ObstacleGridSnapshot {
+  float resolution = 0.05f;
+  int32_t size = 0;                ///< Cells per side
+  int64_t update_time = 0;         ///< Steady clock time of the last update (ns)
+  std::vector<uint64_t> bits;      ///< size / 64 words per row
+
+  /// Whether the cell containing robot-frame point (x, y) is occupied; points outside the grid are unknown and count as occupied
+  bool IsOccupied(float x, float y) const {
+    float half = static_cast<float>(size / 2);
+    float fx = std::floor(x / resolution) + half;
+    float fy = std::floor(y / resolution) + half;
+    if (!(fx >= 0.0f && fy >= 0.0f && fx < static_cast<float>(size) && fy < static_cast<float>(size))) {
+      return true;
+    }
+    int32_t ix = static_cast<int32_t>(fx);
+    int32_t iy = static_cast<int32_t>(fy);
+    return (bits[static_cast<size_t>(iy) * (size / 64) + (ix >> 6)] >> (ix & 63)) & 1;
+  }
+
+  /// See ObstacleGrid::IsPathClear
+  bool IsPathClear(float vx, float vy, float horizon, float half_length, float half_width) const {
+    size_t words_per_row = static_cast<size_t>(size / 64);
+    return detail::SweptFootprintClear([&](int32_t iy, int32_t w) { return bits[static_cast<size_t>(iy) * words_per_row + w]; },
+                                       size, resolution, half_length, half_width, vx, vy, horizon);
+  }
+};
+
+/**
+ * @class ObstacleGrid
+ * @brief Robot-centric occupancy grid updated incrementally from TOF, ultrasonic and laser scan messages.
+ *
+ * Each update marks the cells hit by the sensor and clears the cells its rays passed through; an obstacle that
+ * is not seen again expires after obstacle_ttl_ns. Sources keep separate layers, so a laser ray passing over a
+ * low obstacle seen by the TOF does not erase it. The grid is not moved with odometry; the short TTL bounds the
+ * error while the robot moves.
+ *
+ * Updates are serialized internally and may come from any SDK callback thread. Queries never block them: the
+ * occupancy bitmap is guarded by a sequence counter and readers retry if an update raced with them.
+ *
+ * Example:
+ * @code
+ *   ObstacleGrid grid;
+ *   grid.SetTofMounts({front_tof});
+ *   grid.SetUltraMounts({left_ultra, right_ultra});
+ *   grid.SetLaserMount({0.2f, 0.0f, 0.0f});
+ *   controller.SubscribeTof(grid.TofCallback());
+ *   controller.SubscribeUltra(grid.UltraCallback());
+ *   controller.SubscribeLaserScan(grid.LaserScanCallback());
+ *   if (!grid.IsPathClear(vx, vy, 1.0f)) { Stop(); }
+ * @endcode
+ */
+class ObstacleGrid final : public NonCopyable {
+ public:
+  explicit ObstacleGrid(const ObstacleGridConfig& config = {}) : config_(config) {
+    config_.size = std::max<int32_t>(64, (config_.size + 63) / 64 * 64);
+    words_per_row_ = static_cast<size_t>(config_.size / 64);
+    size_t cells = static_cast<size_t>(config_.size) * static_cast<size_t>(config_.size);
+    bits_ = std::make_unique<std::atomic<uint64_t>[]>(words_per_row_ * static_cast<size_t>(config_.size));
+    for (auto& layer : layers_) {
+      layer.assign(cells, 0);
+    }
+  }
+
+  /// Grid parameters, size already rounded
+  const ObstacleGridConfig& GetConfig() const { return config_; }
+
+  /// Set the TOF sensors, in the order of the first array dimension when the message holds several
+  void SetTofMounts(const std::vector<TofMount>& mounts) {
+    std::lock_guard<std::mutex> lock(update_mutex_);
+    tof_mounts_ = mounts;
+    tof_rows_ = 0;
+    tof_cols_ = 0;
+  }
+
+  /// Set the ultrasonic sensors, one per array element
+  void SetUltraMounts(const std::vector<RangeSensorMount>& mounts) {
+    std::lock_guard<std::mutex> lock(update_mutex_);
+    ultra_mounts_ = mounts;
+  }
+
+  /// Set the laser mounting pose
+  void SetLaserMount(const SensorMount& mount) {
+    std::lock_guard<std::mutex> lock(update_mutex_);
+    laser_mount_ = mount;
+  }
+
+  /**
+   * @brief Integrate a TOF message.
+   *
+   * The layout is read as [sensor x] rows x cols (1 or 2 dimensions mean a single sensor); zone (r, c) looks
+   * at the center of its cell in the field of view, row 0 at the top and column 0 on the left.
+   */
+  void UpdateTof(const Float32MultiArray& msg) {
+    std::lock_guard<std::mutex> lock(update_mutex_);
+    if (tof_mounts_.empty()) {
+      return;
+    }
+    const auto& dims = msg.layout.dim;
+    size_t sensors = dims.size() >= 3 ? static_cast<size_t>(std::max(0, dims[0].size)) : 1;
+    size_t rows = dims.size() >= 2 ? static_cast<size_t>(std::max(0, dims[dims.size() - 2].size)) : 1;
+    size_t cols = !dims.empty() ? static_cast<size_t>(std::max(0, dims.back().size)) : msg.data.size();
+    size_t offset = static_cast<size_t>(std::max(0, msg.layout.data_offset));
+    sensors = std::min(sensors, tof_mounts_.size());
+    if (rows == 0 || cols == 0 || msg.data.size() < offset + sensors * rows * cols) {
+      return;
+    }
+    if (rows != tof_rows_ || cols != tof_cols_) {
+      BuildTofTable(rows, cols);
+    }
+    int64_t now = Now();
+    BeginWrite();
+    for (size_t s = 0; s < sensors; ++s) {
+      const TofMount& mount = tof_mounts_[s];
+      const float* zones = msg.data.data() + offset + s * rows * cols;
+      const ZoneRay* rays = &tof_rays_[s * rows * cols];
+      for (size_t i = 0; i < rows * cols; ++i) {
+        float range = zones[i] * mount.range_scale;
+        if (!(range >= mount.min_range && range <= mount.max_range)) {
+          continue;
+        }
+        float horizontal = range * rays[i].horizontal;
+        float x = mount.x + horizontal * rays[i].cos_azimuth;
+        float y = mount.y + horizontal * rays[i].sin_azimuth;
+        float z = mount.z + range * rays[i].vertical;
+        bool obstacle = z >= config_.min_obstacle_height && z <= config_.max_obstacle_height;
+        TraceRay(kTofLayer, mount.x, mount.y, x, y, obstacle, now);
+      }
+    }
+    EndWrite(now);
+  }
+
+  /// Integrate an ultrasonic message, element i belongs to the i-th mount
+  void UpdateUltra(const Float32MultiArray& msg) {
+    std::lock_guard<std::mutex> lock(update_mutex_);
+    size_t offset = static_cast<size_t>(std::max(0, msg.layout.data_offset));
+    if (msg.data.size() <= offset) {
+      return;
+    }
+    size_t count = std::min(ultra_mounts_.size(), msg.data.size() - offset);
+    int64_t now = Now();
+    BeginWrite();
+    for (size_t i = 0; i < count; ++i) {
+      const RangeSensorMount& mount = ultra_mounts_[i];
+      float range = msg.data[offset + i] * mount.range_scale;
+      if (!(range >= mount.min_range)) {
+        continue;
+      }
+      bool obstacle = range < mount.max_range;
+      range = std::min(range, mount.max_range);
+      // Sample the cone so that neighbouring rays are about one cell apart at the measured range
+      int32_t steps = std::max(1, static_cast<int32_t>(std::ceil(mount.fov * range / config_.resolution)));
+      for (int32_t k = 0; k <= steps; ++k) {
+        float angle = mount.yaw + mount.fov * (static_cast<float>(k) / static_cast<float>(steps) - 0.5f);
+        TraceRay(kUltraLayer, mount.x, mount.y, mount.x + range * std::cos(angle), mount.y + range * std::sin(angle), obstacle, now);
+      }
+    }
+    EndWrite(now);
+  }
+
+  /// Integrate a laser scan, only beams within [range_min, range_max] are used
+  void UpdateLaserScan(const LaserScan& scan) {
+    std::lock_guard<std::mutex> lock(update_mutex_);
+    projector_.ToCartesian(scan, scan_points_);
+    float c = std::cos(laser_mount_.yaw);
+    float s = std::sin(laser_mount_.yaw);
+    int64_t now = Now();
+    BeginWrite();
+    for (size_t i = 0; i < scan_points_.size(); ++i) {
+      float x = laser_mount_.x + c * scan_points_.x[i] - s * scan_points_.y[i];
+      float y = laser_mount_.y + s * scan_points_.x[i] + c * scan_points_.y[i];
+      TraceRay(kLaserLayer, laser_mount_.x, laser_mount_.y, x, y, true, now);
+    }
+    EndWrite(now);
+  }
+
+  /// Callback for SensorController::SubscribeTof, the grid must outlive the subscription
+  std::function<void(const std::shared_ptr<Float32MultiArray>)> TofCallback() {
+    return [this](const std::shared_ptr<Float32MultiArray> msg) {
+      if (msg) {
+        UpdateTof(*msg);
+      }
+    };
+  }
+
+  /// Callback for SensorController::SubscribeUltra, the grid must outlive the subscription
+  std::function<void(const std::shared_ptr<Float32MultiArray>)> UltraCallback() {
+    return [this](const std::shared_ptr<Float32MultiArray> msg) {
+      if (msg) {
+        UpdateUltra(*msg);
+      }
+    };
+  }
+
+  /// Callback for SensorController::SubscribeLaserScan, the grid must outlive the subscription
+  std::function<void(const std::shared_ptr<LaserScan>)> LaserScanCallback() {
+    return [this](const std::shared_ptr<LaserScan> msg) {
+      if (msg) {
+        UpdateLaserScan(*msg);
+      }
+    };
+  }
+
+  /**
+   * @brief Check whether the robot footprint (plus safety margin) can translate at (vx, vy) for horizon seconds
+   *        without touching an obstacle. Lock-free, a few microseconds for typical speeds.
+   * @param vx Velocity along the robot x axis (m/s).
+   * @param vy Velocity along the robot y axis (m/s).
+   * @param horizon Look-ahead time (s).
+   * @return true if no occupied cell lies in the swept area; false also if the swept area leaves the grid, since
+   *         nothing is known there.
+   */
+  bool IsPathClear(float vx, float vy, float horizon) const {
+    float half_length = config_.footprint_half_length + config_.safety_margin;
+    float half_width = config_.footprint_half_width + config_.safety_margin;
+    auto load_word = [this](int32_t iy, int32_t w) {
+      return bits_[static_cast<size_t>(iy) * words_per_row_ + static_cast<size_t>(w)].load(std::memory_order_relaxed);
+    };
+    while (true) {
+      uint64_t seq = seq_.load(std::memory_order_acquire);
+      if (seq & 1) {
+        // An update is in progress; it holds the writer for at most one message
+        std::this_thread::yield();
+        continue;
+      }
+      bool clear = detail::SweptFootprintClear(load_word, config_.size, config_.resolution, half_length, half_width, vx, vy, horizon);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (seq_.load(std::memory_order_relaxed) == seq) {
+        return clear;
+      }
+    }
+  }
+
+  /**
+   * @brief Copy the occupancy bitmap. Lock-free, retries if an update raced with the copy.
+   * @param[out] snapshot Destination, buffer capacity is reused.
+   */
+  void GetSnapshot(ObstacleGridSnapshot& snapshot) const {
+    size_t words = words_per_row_ * static_cast<size_t>(config_.size);
+    snapshot.resolution = config_.resolution;
+    snapshot.size = config_.size;
+    snapshot.bits.resize(words);
+    while (true) {
+      uint64_t seq = seq_.load(std::memory_order_acquire);
+      if (seq & 1) {
+        // An update is in progress; it holds the writer for at most one message
+        std::this_thread::yield();
+        continue;
+      }
+      for (size_t i = 0; i < words; ++i) {
+        snapshot.bits[i] = bits_[i].load(std::memory_order_relaxed);
+      }
+      snapshot.update_time = update_time_.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (seq_.load(std::memory_order_relaxed) == seq) {
+        return;
+      }
+    }
+  }
+
+  /// Forget all obstacles
+  void Clear() {
+    std::lock_guard<std::mutex> lock(update_mutex_);
+    BeginWrite();
+    for (auto& layer : layers_) {
+      std::fill(layer.begin(), layer.end(), 0);
+    }
+    for (size_t i = 0; i < words_per_row_ * static_cast<size_t>(config_.size); ++i) {
+      bits_[i].store(0, std::memory_order_relaxed);
+    }
+    EndWrite(Now());
+  }
+
+ private:
+  enum Layer : size_t { kLaserLayer = 0, kTofLayer = 1, kUltraLayer = 2, kLayerCount = 3 };
+
+  struct ZoneRay {
+    float cos_azimuth;
+    float sin_azimuth;
+    float horizontal;  // cos(elevation)
+    float vertical;    // sin(elevation)
+  };
+
+  static int64_t Now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  void BuildTofTable(size_t rows, size_t cols) {
+    tof_rows_ = rows;
+    tof_cols_ = cols;
+    tof_rays_.resize(tof_mounts_.size() * rows * cols);
+    for (size_t s = 0; s < tof_mounts_.size(); ++s) {
+      const TofMount& mount = tof_mounts_[s];
+      for (size_t r = 0; r < rows; ++r) {
+        float elevation = mount.pitch + mount.vertical_fov * (0.5f - (static_cast<float>(r) + 0.5f) / static_cast<float>(rows));
+        for (size_t c = 0; c < cols; ++c) {
+          float azimuth = mount.yaw + mount.horizontal_fov * (0.5f - (static_cast<float>(c) + 0.5f) / static_cast<float>(cols));
+          tof_rays_[(s * rows + r) * cols + c] = {std::cos(azimuth), std::sin(azimuth), std::cos(elevation), std::sin(elevation)};
+        }
+      }
+    }
+  }
+
+  void BeginWrite() {
+    seq_.store(seq_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+
+  void EndWrite(int64_t now) {
+    ExpireRows(now);
+    update_time_.store(now, std::memory_order_relaxed);
+    seq_.store(seq_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  }
+
+  bool IsFresh(size_t cell, int64_t now) const {
+    for (const auto& layer : layers_) {
+      if (layer[cell] != 0 && now - layer[cell] <= config_.obstacle_ttl_ns) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void SetBit(size_t cell, bool value) {
+    std::atomic<uint64_t>& word = bits_[cell >> 6];
+    uint64_t bit = 1ull << (cell & 63);
+    uint64_t old = word.load(std::memory_order_relaxed);
+    word.store(value ? (old | bit) : (old & ~bit), std::memory_order_relaxed);
+  }
+
+  void Mark(size_t layer, size_t cell, int64_t now) {
+    layers_[layer][cell] = now;
+    SetBit(cell, true);
+  }
+
+  void Free(size_t layer, size_t cell, int64_t now) {
+    if (layers_[layer][cell] == 0) {
+      return;
+    }
+    layers_[layer][cell] = 0;
+    if ((bits_[cell >> 6].load(std::memory_order_relaxed) >> (cell & 63)) & 1) {
+      SetBit(cell, IsFresh(cell, now));
+    }
+  }
+
+  /// Clear the cells from (x0, y0) up to (x1, y1) and mark the end cell if hit, Bresenham over cells
+  void TraceRay(size_t layer, float x0, float y0, float x1, float y1, bool hit, int64_t now) {
+    int32_t size = config_.size;
+    int32_t half = size / 2;
+    float inv_res = 1.0f / config_.resolution;
+    // Clip the ray one cell beyond the grid so the cell casts below stay in range; a clipped ray ends in free space
+    float extent = static_cast<float>(half + 1) * config_.resolution;
+    if (!(std::fabs(x0) < extent && std::fabs(y0) < extent && std::isfinite(x1) && std::isfinite(y1))) {
+      return;
+    }
+    float t = 1.0f;
+    if (std::fabs(x1) > extent) {
+      t = std::min(t, (std::copysign(extent, x1) - x0) / (x1 - x0));
+    }
+    if (std::fabs(y1) > extent) {
+      t = std::min(t, (std::copysign(extent, y1) - y0) / (y1 - y0));
+    }
+    if (t < 1.0f) {
+      x1 = x0 + t * (x1 - x0);
+      y1 = y0 + t * (y1 - y0);
+      hit = false;
+    }
+    int32_t cx = static_cast<int32_t>(std::floor(x0 * inv_res)) + half;
+    int32_t cy = static_cast<int32_t>(std::floor(y0 * inv_res)) + half;
+    int32_t ex = static_cast<int32_t>(std::floor(x1 * inv_res)) + half;
+    int32_t ey = static_cast<int32_t>(std::floor(y1 * inv_res)) + half;
+    int32_t dx = std::abs(ex - cx);
+    int32_t dy = -std::abs(ey - cy);
+    int32_t sx = cx < ex ? 1 : -1;
+    int32_t sy = cy < ey ? 1 : -1;
+    int32_t err = dx + dy;
+    while (cx != ex || cy != ey) {
+      if (cx >= 0 && cy >= 0 && cx < size && cy < size) {
+        Free(layer, static_cast<size_t>(cy) * size + cx, now);
+      }
+      int32_t e2 = 2 * err;
+      if (e2 >= dy) {
+        err += dy;
+        cx += sx;
+      }
+      if (e2 <= dx) {
+        err += dx;
+        cy += sy;
+      }
+    }
+    if (ex >= 0 && ey >= 0 && ex < size && ey < size) {
+      size_t cell = static_cast<size_t>(ey) * size + ex;
+      if (hit) {
+        Mark(layer, cell, now);
+      } else {
+        Free(layer, cell, now);
+      }
+    }
+  }
+
+  /// Expire stale obstacles in a slice of rows per update, so the cost stays proportional to the update
+  void ExpireRows(int64_t now) {
+    int32_t rows = std::max(1, config_.size / 16);
+    for (int32_t k = 0; k < rows; ++k) {
+      size_t row = static_cast<size_t>(expire_row_);
+      expire_row_ = (expire_row_ + 1) % config_.size;
+      for (size_t w = 0; w < words_per_row_; ++w) {
+        size_t index = row * words_per_row_ + w;
+        uint64_t word = bits_[index].load(std::memory_order_relaxed);
+        uint64_t kept = word;
+        for (uint64_t pending = word; pending != 0; pending &= pending - 1) {
+          size_t bit = static_cast<size_t>(__builtin_ctzll(pending));
+          if (!IsFresh(index * 64 + bit, now)) {
+            kept &= ~(1ull << bit);
+          }
+        }
+        if (kept != word) {
+          bits_[index].store(kept, std::memory_order_relaxed);
+        }
+      }
+    }
+  }
+
+  ObstacleGridConfig config_;
+  size_t words_per_row_{0};
+
+  // Writer state, guarded by update_mutex_
+  std::mutex update_mutex_;
+  std::array<std::vector<int64_t>, kLayerCount> layers_;  // Last hit time per cell and source, 0 if free
+  std::vector<TofMount> tof_mounts_;
+  std::vector<ZoneRay> tof_rays_;
+  size_t tof_rows_{0};
+  size_t tof_cols_{0};
+  std::vector<RangeSensorMount> ultra_mounts_;
+  SensorMount laser_mount_;
+  LaserScanProjector projector_;
+  ScanPoints2D scan_points_;
+  int32_t expire_row_{0};
+
+  // Reader-visible state, guarded by seq_
+  std::atomic<uint64_t> seq_{0};
+  std::unique_ptr<std::atomic<uint64_t>[]> bits_;
+  std::atomic<int64_t> update_time_{0};
+};
+
+}  // namespace magic::dog::sensor
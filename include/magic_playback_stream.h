@@ -0,0 +1,569 @@
+#pragma once
+
+#include "magic_audio_ops.h"
+#include "magic_simd.h"
+#include "magic_type.h"
+
+#if defined(MAGIC_PLAYBACK_ALSA)
+  #include <alsa/asoundlib.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace magic::dog::audio {
+
+/**
+ * @brief Output format and mixing behaviour of a PlaybackMixer
+ */
+struct PlaybackConfig {
+  int32_t sample_rate = 48000;  ///< Device sample rate (Hz)
+  int32_t channels = 2;         ///< Device channels (interleaved)
+  int32_t period_ms = 10;       ///< Mixing period; lower means lower latency and more wake-ups
+  float duck_gain = 0.25f;      ///< Gain applied to streams while a higher-priority stream is playing
+  int32_t duck_ramp_ms = 30;    ///< Time to fade between full and ducked gain
+};
+
+/**
+ * @brief Counters and latency of one playback stream
+ */
+struct PlaybackStats {
+  uint64_t frames_written = 0;  ///< Input frames accepted by Write
+  uint64_t dropped_frames = 0;  ///< Input frames rejected because the buffer was full
+  uint64_t frames_played = 0;   ///< Device frames handed to the device
+  uint64_t underruns = 0;       ///< Times the buffer ran dry while playing
+  double buffered_ms = 0.0;     ///< Audio waiting in the stream buffer
+  double latency_ms = 0.0;      ///< Write-to-speaker latency of a sample written now
+};
+
+/**
+ * @brief Audio output the mixer writes to.
+ *
+ * Write must block until the device can take more audio: it paces the mixing thread.
+ */
+class PlaybackDevice : public NonCopyable {
+ public:
+  virtual ~PlaybackDevice() = default;
+
+  /**
+   * @brief Prepare the device.
+   * @param sample_rate Sample rate (Hz).
+   * @param channels Interleaved channels.
+   * @param period_frames Frames passed to each Write.
+   * @return True on success.
+   */
+  virtual bool Open(int32_t sample_rate, int32_t channels, size_t period_frames) = 0;
+
+  /**
+   * @brief Play interleaved S16 frames, blocking while the device buffer is full.
+   * @return False if the device failed.
+   */
+  virtual bool Write(const int16_t* interleaved, size_t frames) = 0;
+
+  /// Frames written but not yet audible
+  virtual int64_t GetDelayFrames() { return 0; }
+};
+
+#if defined(MAGIC_PLAYBACK_ALSA)
+/**
+ * @brief ALSA PCM output (define MAGIC_PLAYBACK_ALSA and link libasound)
+ */
+class AlsaPlaybackDevice final : public PlaybackDevice {
+ public:
+  /**
+   * @brief Constructor
+   * @param name PCM name, e.g. "default" or "hw:0,0".
+   * @param buffer_periods Device buffer length in mixing periods.
+   */
+  explicit AlsaPlaybackDevice(std::string name = "default", int32_t buffer_periods = 3)
+      : name_(std::move(name)), buffer_periods_(std::max(buffer_periods, 2)) {}
+
+  ~AlsaPlaybackDevice() override {
+    if (pcm_ != nullptr) {
+      snd_pcm_drain(pcm_);
+      snd_pcm_close(pcm_);
+    }
+  }
+
+  bool Open(int32_t sample_rate, int32_t channels, size_t period_frames) override {
+    if (snd_pcm_open(&pcm_, name_.c_str(), SND_PCM_STREAM_PLAYBACK, 0) < 0) {
+      pcm_ = nullptr;
+      return false;
+    }
+    auto latency_us = static_cast<unsigned int>(1000000.0 * period_frames * buffer_periods_ / sample_rate);
+    if (snd_pcm_set_params(pcm_, SND_PCM_FORMAT_S16_LE, SND_PCM_ACCESS_RW_INTERLEAVED, static_cast<unsigned int>(channels),
+                           static_cast<unsigned int>(sample_rate), 1, latency_us) < 0) {
+      snd_pcm_close(pcm_);
+      pcm_ = nullptr;
+      return false;
+    }
+    channels_ = channels;
+    return true;
+  }
+
+  bool Write(const int16_t* interleaved, size_t frames) override {
+    while (frames > 0) {
+      snd_pcm_sframes_t n = snd_pcm_writei(pcm_, interleaved, frames);
+      if (n < 0) {
+        // Device xrun or suspend: recover and retry the same period
+        if (snd_pcm_recover(pcm_, static_cast<int>(n), 1) < 0) {
+          return false;
+        }
+        continue;
+      }
+      interleaved += static_cast<size_t>(n) * channels_;
+      frames -= static_cast<size_t>(n);
+    }
+    return true;
+  }
+
+  int64_t GetDelayFrames() override {
+    snd_pcm_sframes_t delay = 0;
+    return snd_pcm_delay(pcm_, &delay) < 0 ? 0 : static_cast<int64_t>(delay);
+  }
+
+ private:
+  std::string name_;
+  int32_t buffer_periods_;
+  int32_t channels_{1};
+  snd_pcm_t* pcm_{nullptr};
+};
+#endif
+
+namespace detail {
+
+/// out[i] += in[i] * (gain + step * i)
+inline void MixRamp(const float* in, float* out, size_t n, float gain, float step) {
+  size_t i = 0;
+#if defined(MAGIC_SIMD_AVX2)
+  const __m256 lanes = _mm256_setr_ps(0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f, 7.0f);
+  const __m256 vgain = _mm256_set1_ps(gain);
+  const __m256 vstep = _mm256_set1_ps(step);
+  for (; i + 8 <= n; i += 8) {
+    __m256 index = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(i)), lanes);
+    __m256 g = _mm256_add_ps(vgain, _mm256_mul_ps(vstep, index));
+    _mm256_storeu_ps(out + i, _mm256_add_ps(_mm256_loadu_ps(out + i), _mm256_mul_ps(_mm256_loadu_ps(in + i), g)));
+  }
+#elif defined(MAGIC_SIMD_NEON)
+  static const float kLanes[4] = {0.0f, 1.0f, 2.0f, 3.0f};
+  const float32x4_t lanes = vld1q_f32(kLanes);
+  const float32x4_t vgain = vdupq_n_f32(gain);
+  for (; i + 4 <= n; i += 4) {
+    float32x4_t index = vaddq_f32(vdupq_n_f32(static_cast<float>(i)), lanes);
+    float32x4_t g = vaddq_f32(vgain, vmulq_n_f32(index, step));
+    vst1q_f32(out + i, vaddq_f32(vld1q_f32(out + i), vmulq_f32(vld1q_f32(in + i), g)));
+  }
+#endif
+  for (; i < n; ++i) {
+    out[i] += in[i] * (gain + step * static_cast<float>(i));
+  }
+}
+
+}  // namespace detail
+
+class PlaybackMixer;
+
+/**
+ * @class PlaybackStream
+ * @brief Writer end of one PCM stream mixed by a PlaybackMixer.
+ *
+ * Audio is converted to the device rate and channel count on the writing thread and queued in a jitter buffer.
+ * Playback starts once the buffer holds the jitter target, so a bursty producer does not click; if the buffer
+ * runs dry mid-stream an underrun is counted and the stream re-buffers. Write has a single producer.
+ */
+class PlaybackStream final : public NonCopyable {
+ public:
+  /**
+   * @brief Queue interleaved S16 frames.
+   * @param interleaved Samples in the rate and channel count the stream was opened with.
+   * @param frames Number of frames.
+   * @return Frames actually queued; fewer than frames when the buffer is full (the rest is counted as dropped).
+   */
+  size_t Write(const int16_t* interleaved, size_t frames) {
+    if (frames == 0) {
+      return 0;
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (closed_) {
+        return 0;
+      }
+      // Admit only what fits after conversion; a resampled chunk may carry one frame more than the rate ratio
+      // (filter start-up, phase carry), so that frame is reserved
+      size_t room = capacity_frames_ - size_frames_;
+      size_t reserve = resamplers_.empty() ? 0 : 1;
+      size_t admit = room > reserve ? static_cast<size_t>(static_cast<double>(room - reserve) * input_rate_ / output_rate_) : 0;
+      if (admit < frames) {
+        dropped_frames_ += frames - admit;
+        frames = admit;
+      }
+      frames_written_ += frames;
+      draining_ = false;
+    }
+    if (frames == 0) {
+      return 0;
+    }
+    for (size_t c = 0; c < planes_.size(); ++c) {
+      planes_[c].resize(frames);
+      plane_pointers_[c] = planes_[c].data();
+    }
+    detail::DeinterleaveToFloat(interleaved, input_channels_, frames, plane_pointers_.data(), 1.0f / 32768.0f);
+    size_t out_frames = frames;
+    if (!resamplers_.empty()) {
+      for (size_t c = 0; c < planes_.size(); ++c) {
+        resamplers_[c]->Process(planes_[c].data(), frames, resampled_[c]);
+      }
+      out_frames = resampled_[0].size();
+    }
+    interleaved_.resize(out_frames * output_channels_);
+    for (int32_t c = 0; c < output_channels_; ++c) {
+      for (size_t i = 0; i < out_frames; ++i) {
+        interleaved_[i * output_channels_ + c] = Source(c, i);
+      }
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t n = std::min(out_frames, capacity_frames_ - size_frames_);
+    size_t tail = (head_ + size_frames_) % capacity_frames_;
+    size_t first = std::min(n, capacity_frames_ - tail);
+    std::memcpy(ring_.data() + tail * output_channels_, interleaved_.data(), first * output_channels_ * sizeof(float));
+    std::memcpy(ring_.data(), interleaved_.data() + first * output_channels_, (n - first) * output_channels_ * sizeof(float));
+    size_frames_ += n;
+    if (n < out_frames) {
+      // Should not happen with the reserve above, but never report truncated audio as queued
+      size_t lost = std::min(frames, static_cast<size_t>(std::ceil(static_cast<double>(out_frames - n) * input_rate_ / output_rate_)));
+      dropped_frames_ += lost;
+      frames_written_ -= lost;
+      frames -= lost;
+    }
+    return frames;
+  }
+
+  /**
+   * @brief Mark the end of a burst: buffered audio plays out without waiting for the jitter target and running
+   *        dry afterwards is not an underrun.
+   * @param timeout_ms Time to wait for the buffer to empty; 0 returns immediately.
+   * @return True if the buffer is empty.
+   */
+  bool Drain(int timeout_ms) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    draining_ = true;
+    return drained_cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms), [this] { return size_frames_ == 0; });
+  }
+
+  /// Discard buffered audio
+  void Flush() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    head_ = 0;
+    size_frames_ = 0;
+    buffering_ = true;
+    drained_cv_.notify_all();
+  }
+
+  /// Stop accepting audio; the stream leaves the mixer once its buffer has played out
+  void Close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_ = true;
+    draining_ = true;
+  }
+
+  /**
+   * @brief Scale this stream's output.
+   * @param gain Linear gain.
+   */
+  void SetGain(float gain) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    gain_ = gain;
+  }
+
+  /**
+   * @brief Stream counters and current latency.
+   */
+  PlaybackStats GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    PlaybackStats stats;
+    stats.frames_written = frames_written_;
+    stats.dropped_frames = dropped_frames_;
+    stats.frames_played = frames_played_;
+    stats.underruns = underruns_;
+    stats.buffered_ms = 1000.0 * static_cast<double>(size_frames_) / output_rate_;
+    // A sample written now waits for the buffered audio (at least the jitter target), one mixing period
+    // and whatever the device still holds
+    double queued = static_cast<double>(std::max(size_frames_, jitter_frames_) + period_frames_ + device_delay_->load(std::memory_order_relaxed));
+    stats.latency_ms = 1000.0 * queued / output_rate_ + (resamplers_.empty() ? 0.0 : 1000.0 * resampler_delay_ / output_rate_);
+    return stats;
+  }
+
+  TtsPriority GetPriority() const { return priority_; }
+
+ private:
+  friend class PlaybackMixer;
+
+  PlaybackStream(int32_t input_rate, int32_t input_channels, TtsPriority priority, int32_t jitter_ms, int32_t capacity_ms,
+                 const PlaybackConfig& config, size_t period_frames, std::shared_ptr<std::atomic<int64_t>> device_delay)
+      : input_rate_(input_rate),
+        input_channels_(input_channels),
+        output_rate_(config.sample_rate),
+        output_channels_(config.channels),
+        priority_(priority),
+        period_frames_(period_frames),
+        device_delay_(std::move(device_delay)),
+        planes_(input_channels),
+        plane_pointers_(input_channels),
+        resampled_(input_channels) {
+    jitter_frames_ = static_cast<size_t>(static_cast<int64_t>(output_rate_) * std::max(jitter_ms, 0) / 1000);
+    capacity_frames_ = std::max<size_t>(static_cast<size_t>(static_cast<int64_t>(output_rate_) * capacity_ms / 1000), jitter_frames_ + 2 * period_frames_);
+    ring_.assign(capacity_frames_ * output_channels_, 0.0f);
+    if (input_rate_ != output_rate_) {
+      for (int32_t c = 0; c < input_channels_; ++c) {
+        resamplers_.push_back(std::make_unique<PolyphaseResampler>(input_rate_, output_rate_));
+      }
+      resampler_delay_ = resamplers_[0]->GetDelay();
+    }
+  }
+
+  /// Output channel c of frame i from the converted input planes
+  float Source(int32_t c, size_t i) const {
+    const auto& planes = resamplers_.empty() ? planes_ : resampled_;
+    if (output_channels_ == 1 && input_channels_ > 1) {
+      float sum = 0.0f;
+      for (const auto& plane : planes) {
+        sum += plane[i];
+      }
+      return sum / static_cast<float>(input_channels_);
+    }
+    return planes[static_cast<size_t>(c % input_channels_)][i];
+  }
+
+  /// Whether the stream will contribute audio this period
+  bool IsAudible() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return size_frames_ > 0 && (!buffering_ || draining_ || size_frames_ >= jitter_frames_);
+  }
+
+  /// Whether the stream can be removed: closed (or abandoned by its writer) and played out
+  bool IsFinished() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return closed_ && size_frames_ == 0;
+  }
+
+  /**
+   * @brief Add up to frames of buffered audio into the mix, ramping the duck gain from start to end.
+   */
+  void MixInto(float* mix, size_t frames, float duck_start, float duck_end, std::vector<float>& scratch) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (buffering_) {
+      if (size_frames_ == 0 || (size_frames_ < jitter_frames_ && !draining_)) {
+        return;
+      }
+      buffering_ = false;
+    }
+    size_t n = std::min(frames, size_frames_);
+    size_t first = std::min(n, capacity_frames_ - head_);
+    scratch.resize(n * output_channels_);
+    std::memcpy(scratch.data(), ring_.data() + head_ * output_channels_, first * output_channels_ * sizeof(float));
+    std::memcpy(scratch.data() + first * output_channels_, ring_.data(), (n - first) * output_channels_ * sizeof(float));
+    head_ = (head_ + n) % capacity_frames_;
+    size_frames_ -= n;
+    frames_played_ += n;
+    float start = gain_ * duck_start;
+    float step = gain_ * (duck_end - duck_start) / static_cast<float>(frames * output_channels_);
+    detail::MixRamp(scratch.data(), mix, scratch.size(), start, step);
+    if (size_frames_ == 0) {
+      if (n < frames && !draining_ && !closed_) {
+        ++underruns_;
+      }
+      buffering_ = true;
+      drained_cv_.notify_all();
+    }
+  }
+
+  const int32_t input_rate_;
+  const int32_t input_channels_;
+  const int32_t output_rate_;
+  const int32_t output_channels_;
+  const TtsPriority priority_;
+  const size_t period_frames_;
+  std::shared_ptr<std::atomic<int64_t>> device_delay_;
+  size_t jitter_frames_{0};
+  size_t capacity_frames_{0};
+  double resampler_delay_{0.0};
+
+  // Writer-side scratch
+  std::vector<std::vector<float>> planes_;
+  std::vector<float*> plane_pointers_;
+  std::vector<std::vector<float>> resampled_;
+  std::vector<std::unique_ptr<PolyphaseResampler>> resamplers_;
+  std::vector<float> interleaved_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable drained_cv_;
+  std::vector<float> ring_;
+  size_t head_{0};
+  size_t size_frames_{0};
+  bool buffering_{true};
+  bool draining_{false};
+  bool closed_{false};
+  float gain_{1.0f};
+  uint64_t frames_written_{0};
+  uint64_t dropped_frames_{0};
+  uint64_t frames_played_{0};
+  uint64_t underruns_{0};
+
+  // Mixer-side state
+  float duck_{1.0f};
+};
+
+/**
+ * @class PlaybackMixer
+ * @brief Mixes PCM streams written by the application onto a local audio output.
+ *
+ * AudioController::Play only accepts TTS text or a local_music: path on the robot, so PCM has no route through
+ * the voice service. PlaybackMixer instead drives a PlaybackDevice (ALSA with MAGIC_PLAYBACK_ALSA, or any
+ * user implementation) from a mixing thread. Each stream carries a TtsPriority: while a stream of a higher
+ * priority is audible, lower-priority streams fade to PlaybackConfig::duck_gain. SetExternalPlayback lets the
+ * voice service's own speech take part in the same ordering, e.g. from TtsTracker events.
+ *
+ * Example:
+ * @code
+ *   PlaybackMixer mixer(std::make_unique<AlsaPlaybackDevice>());
+ *   auto stream = mixer.OpenPlaybackStream(16000, 1, TtsPriority::MIDDLE);
+ *   stream->Write(clip->samples.data(), clip->samples.size());
+ *   stream->Drain(5000);
+ * @endcode
+ */
+class PlaybackMixer final : public NonCopyable {
+ public:
+  /**
+   * @brief Open the device and start mixing.
+   * @param device Output device.
+   * @param config Output format and ducking.
+   */
+  explicit PlaybackMixer(std::unique_ptr<PlaybackDevice> device, PlaybackConfig config = {})
+      : device_(std::move(device)), config_(config), device_delay_(std::make_shared<std::atomic<int64_t>>(0)) {
+    config_.sample_rate = std::max(config_.sample_rate, 1);
+    config_.channels = std::max(config_.channels, 1);
+    period_frames_ = std::max<size_t>(static_cast<size_t>(static_cast<int64_t>(config_.sample_rate) * config_.period_ms / 1000), 1);
+    if (device_ && device_->Open(config_.sample_rate, config_.channels, period_frames_)) {
+      open_ = true;
+      thread_ = std::thread([this] { Run(); });
+    }
+  }
+
+  ~PlaybackMixer() {
+    stop_ = true;
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+  }
+
+  /// Whether the device opened
+  bool IsOpen() const { return open_; }
+
+  /**
+   * @brief Open a stream.
+   * @param sample_rate Rate of the audio that will be written (Hz).
+   * @param channels Interleaved channels of the audio that will be written.
+   * @param priority Mixing priority.
+   * @param jitter_ms Audio buffered before playback starts; absorbs producer scheduling jitter.
+   * @param capacity_ms Maximum buffered audio; writes beyond it are dropped.
+   * @return Stream, or nullptr if the device is not open or the format is invalid.
+   */
+  std::shared_ptr<PlaybackStream> OpenPlaybackStream(int32_t sample_rate, int32_t channels, TtsPriority priority = TtsPriority::LOW,
+                                                     int32_t jitter_ms = 40, int32_t capacity_ms = 2000) {
+    if (!open_ || sample_rate <= 0 || channels <= 0 || channels > 8) {
+      return nullptr;
+    }
+    std::shared_ptr<PlaybackStream> stream(
+        new PlaybackStream(sample_rate, channels, priority, jitter_ms, capacity_ms, config_, period_frames_, device_delay_));
+    std::lock_guard<std::mutex> lock(mutex_);
+    streams_.push_back(stream);
+    return stream;
+  }
+
+  /**
+   * @brief Report speech the voice service is playing, so lower-priority streams duck under it.
+   * @param active Whether it is playing.
+   * @param priority Priority of the command being played.
+   */
+  void SetExternalPlayback(bool active, TtsPriority priority = TtsPriority::LOW) {
+    external_level_ = active ? static_cast<int>(priority) : kNoLevel;
+  }
+
+  /// Audio held by the device (ms)
+  double GetDeviceDelayMs() const { return 1000.0 * static_cast<double>(device_delay_->load(std::memory_order_relaxed)) / config_.sample_rate; }
+
+  /// Device writes that failed
+  uint64_t GetDeviceErrors() const { return device_errors_; }
+
+ private:
+  static constexpr int kNoLevel = 1 << 10;
+
+  void Run() {
+    size_t samples = period_frames_ * config_.channels;
+    std::vector<float> mix(samples);
+    std::vector<int16_t> output(samples);
+    std::vector<float> scratch;
+    std::vector<std::shared_ptr<PlaybackStream>> streams;
+    float ramp = config_.duck_ramp_ms > 0 ? static_cast<float>(config_.period_ms) / static_cast<float>(config_.duck_ramp_ms) : 1.0f;
+    while (!stop_) {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        // A stream whose writer dropped its handle without Close is closed for it
+        for (auto& stream : streams_) {
+          if (stream.use_count() == 1) {
+            stream->Close();
+          }
+        }
+        streams_.erase(std::remove_if(streams_.begin(), streams_.end(), [](const auto& s) { return s->IsFinished(); }), streams_.end());
+        streams = streams_;
+      }
+      int top = external_level_.load();
+      for (const auto& stream : streams) {
+        if (stream->IsAudible()) {
+          top = std::min(top, static_cast<int>(stream->GetPriority()));
+        }
+      }
+      std::fill(mix.begin(), mix.end(), 0.0f);
+      for (const auto& stream : streams) {
+        float target = static_cast<int>(stream->GetPriority()) > top ? config_.duck_gain : 1.0f;
+        float start = stream->duck_;
+        float end = target > start ? std::min(target, start + ramp) : std::max(target, start - ramp);
+        stream->MixInto(mix.data(), period_frames_, start, end, scratch);
+        stream->duck_ = end;
+      }
+      streams.clear();
+      detail::FloatToS16(mix.data(), output.data(), samples, 32768.0f);
+      if (!device_->Write(output.data(), period_frames_)) {
+        ++device_errors_;
+        std::this_thread::sleep_for(std::chrono::milliseconds(config_.period_ms));
+      }
+      device_delay_->store(device_->GetDelayFrames(), std::memory_order_relaxed);
+    }
+  }
+
+  std::unique_ptr<PlaybackDevice> device_;
+  PlaybackConfig config_;
+  size_t period_frames_{1};
+  std::shared_ptr<std::atomic<int64_t>> device_delay_;
+  bool open_{false};
+  std::atomic<bool> stop_{false};
+  std::atomic<int> external_level_{kNoLevel};
+  std::atomic<uint64_t> device_errors_{0};
+
+  std::mutex mutex_;
+  std::vector<std::shared_ptr<PlaybackStream>> streams_;
+  std::thread thread_;
+};
+
+}  // namespace magic::dog::audio
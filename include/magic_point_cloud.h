@@ -0,0 +1,382 @@
+#pragma once
+
+#include "magic_type.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace magic::dog::sensor {
+
+/**
+ * @brief Point with x, y, z coordinates (m)
+ */
+struct XYZ {
+  static constexpr std::array<std::string_view, 3> kFieldNames = {"x", "y", "z"};
+
+  float x;
+  float y;
+  float z;
+};
+
+/**
+ * @brief Point with x, y, z coordinates (m) and intensity
+ */
+struct XYZI {
+  static constexpr std::array<std::string_view, 4> kFieldNames = {"x", "y", "z", "intensity"};
+
+  float x;
+  float y;
+  float z;
+  float intensity;
+};
+
+namespace detail {
+
+/// Size in bytes of a PointField datatype, 0 if unknown
+inline size_t PointFieldSize(int8_t datatype) {
+  switch (datatype) {
+    case POINT_FIELD_INT8:
+    case POINT_FIELD_UINT8:
+      return 1;
+    case POINT_FIELD_INT16:
+    case POINT_FIELD_UINT16:
+      return 2;
+    case POINT_FIELD_INT32:
+    case POINT_FIELD_UINT32:
+    case POINT_FIELD_FLOAT32:
+      return 4;
+    case POINT_FIELD_FLOAT64:
+      return 8;
+    default:
+      return 0;
+  }
+}
+
+template <typename T>
+inline float LoadAs(const uint8_t* p) {
+  T value;
+  std::memcpy(&value, p, sizeof(T));
+  return static_cast<float>(value);
+}
+
+/// Read one little-endian field value as float
+inline float ReadPointField(const uint8_t* p, int8_t datatype) {
+  switch (datatype) {
+    case POINT_FIELD_FLOAT32:
+      return LoadAs<float>(p);
+    case POINT_FIELD_FLOAT64:
+      return LoadAs<double>(p);
+    case POINT_FIELD_UINT8:
+      return LoadAs<uint8_t>(p);
+    case POINT_FIELD_INT8:
+      return LoadAs<int8_t>(p);
+    case POINT_FIELD_UINT16:
+      return LoadAs<uint16_t>(p);
+    case POINT_FIELD_INT16:
+      return LoadAs<int16_t>(p);
+    case POINT_FIELD_UINT32:
+      return LoadAs<uint32_t>(p);
+    case POINT_FIELD_INT32:
+      return LoadAs<int32_t>(p);
+    default:
+      return 0.0f;
+  }
+}
+
+}  // namespace detail
+
+/**
+ * @class PointView
+ * @brief Zero-copy typed view over the packed data of a PointCloud2.
+ *
+ * The field layout required by PointT (e.g. XYZ, XYZI) is resolved against PointCloud2::fields once in Bind.
+ * Rebinding to a cloud with the same layout, the usual case for a sensor stream, only compares offsets and
+ * datatypes, no field names. Points are read in place from the message buffer; the view must not outlive it.
+ *
+ * Example:
+ * @code
+ *   PointView<XYZI> view;
+ *   if (view.Bind(*cloud)) {
+ *     view.ForEach([](const XYZI& p) { ... });
+ *   }
+ * @endcode
+ */
+template <typename PointT>
+class PointView final {
+  static constexpr size_t kFieldCount = PointT::kFieldNames.size();
+  static_assert(sizeof(PointT) == kFieldCount * sizeof(float), "PointT must consist of float fields only");
+
+ public:
+  PointView() = default;
+
+  /// Construct and bind, check IsValid afterwards
+  explicit PointView(const PointCloud2& cloud) { Bind(cloud); }
+
+  /**
+   * @brief Bind the view to a cloud.
+   * @return false if the cloud misses a field of PointT, is big-endian or its buffer is too small.
+   */
+  bool Bind(const PointCloud2& cloud) { return Bind(cloud, cloud.data.data(), cloud.data.size()); }
+
+  /**
+   * @brief Bind the view to point data stored outside the cloud, e.g. in a shared-memory slot.
+   * @param cloud Supplies header and layout, cloud.data is ignored.
+   * @param data Packed point data.
+   * @param size Size of data in bytes.
+   * @return false if the cloud misses a field of PointT, is big-endian or the buffer is too small.
+   */
+  bool Bind(const PointCloud2& cloud, const uint8_t* data, size_t size) {
+    cloud_ = nullptr;
+    if (cloud.is_bigendian || cloud.point_step <= 0 || cloud.width < 0 || cloud.height < 0 ||
+        cloud.row_step < cloud.point_step * cloud.width ||
+        size < static_cast<size_t>(cloud.row_step) * static_cast<size_t>(cloud.height)) {
+      return false;
+    }
+    if (!MatchesCachedLayout(cloud) && !ResolveLayout(cloud)) {
+      return false;
+    }
+    cloud_ = &cloud;
+    data_ = data;
+    packed_ = cloud.row_step == cloud.point_step * cloud.width;
+    return true;
+  }
+
+  /// Whether the view is bound to a valid cloud
+  bool IsValid() const { return cloud_ != nullptr; }
+
+  /// Number of points (width * height)
+  size_t size() const { return cloud_ ? static_cast<size_t>(cloud_->width) * static_cast<size_t>(cloud_->height) : 0; }
+
+  /// Header of the bound cloud
+  const Header& header() const { return cloud_->header; }
+
+  /// Read point i (row-major index)
+  PointT operator[](size_t i) const {
+    const uint8_t* p;
+    if (packed_) {
+      p = data_ + i * static_cast<size_t>(cloud_->point_step);
+    } else {
+      size_t row = i / static_cast<size_t>(cloud_->width);
+      size_t col = i % static_cast<size_t>(cloud_->width);
+      p = data_ + row * static_cast<size_t>(cloud_->row_step) + col * static_cast<size_t>(cloud_->point_step);
+    }
+    return Load(p);
+  }
+
+  /// Call func(const PointT&) for every point, in row-major order
+  template <typename Func>
+  void ForEach(Func&& func) const {
+    if (!cloud_) {
+      return;
+    }
+    for (int32_t row = 0; row < cloud_->height; ++row) {
+      const uint8_t* p = data_ + static_cast<size_t>(row) * static_cast<size_t>(cloud_->row_step);
+      for (int32_t col = 0; col < cloud_->width; ++col, p += cloud_->point_step) {
+        func(Load(p));
+      }
+    }
+  }
+
+ private:
+  bool MatchesCachedLayout(const PointCloud2& cloud) const {
+    if (!has_layout_ || cloud.point_step != point_step_ || cloud.fields.size() != field_count_) {
+      return false;
+    }
+    for (size_t k = 0; k < kFieldCount; ++k) {
+      const PointField& field = cloud.fields[field_index_[k]];
+      if (field.offset != offsets_[k] || field.datatype != datatypes_[k]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  bool ResolveLayout(const PointCloud2& cloud) {
+    has_layout_ = false;
+    all_float32_ = true;
+    for (size_t k = 0; k < kFieldCount; ++k) {
+      auto it = std::find_if(cloud.fields.begin(), cloud.fields.end(),
+                             [&](const PointField& field) { return field.name == PointT::kFieldNames[k]; });
+      if (it == cloud.fields.end()) {
+        return false;
+      }
+      size_t field_size = detail::PointFieldSize(it->datatype);
+      if (field_size == 0 || it->offset < 0 || static_cast<size_t>(it->offset) + field_size > static_cast<size_t>(cloud.point_step)) {
+        return false;
+      }
+      field_index_[k] = static_cast<size_t>(it - cloud.fields.begin());
+      offsets_[k] = it->offset;
+      datatypes_[k] = it->datatype;
+      all_float32_ = all_float32_ && it->datatype == POINT_FIELD_FLOAT32;
+    }
+    point_step_ = cloud.point_step;
+    field_count_ = cloud.fields.size();
+    has_layout_ = true;
+    return true;
+  }
+
+  PointT Load(const uint8_t* p) const {
+    float values[kFieldCount];
+    if (all_float32_) {
+      for (size_t k = 0; k < kFieldCount; ++k) {
+        std::memcpy(&values[k], p + offsets_[k], sizeof(float));
+      }
+    } else {
+      for (size_t k = 0; k < kFieldCount; ++k) {
+        values[k] = detail::ReadPointField(p + offsets_[k], datatypes_[k]);
+      }
+    }
+    PointT point;
+    std::memcpy(&point, values, sizeof(PointT));
+    return point;
+  }
+
+  const PointCloud2* cloud_{nullptr};
+  const uint8_t* data_{nullptr};
+  bool packed_{false};
+
+  // Cached layout of the last resolved cloud
+  bool has_layout_{false};
+  bool all_float32_{true};
+  int32_t point_step_{0};
+  size_t field_count_{0};
+  std::array<size_t, kFieldCount> field_index_{};
+  std::array<int32_t, kFieldCount> offsets_{};
+  std::array<int8_t, kFieldCount> datatypes_{};
+};
+
+/**
+ * @brief Write points into an unorganized PointCloud2 with packed float32 fields of PointT.
+ * @param header Header of the output cloud.
+ * @param points Points to write.
+ * @param[out] cloud Destination, buffer capacity is reused.
+ */
+template <typename PointT>
+inline void WritePointCloud(const Header& header, const std::vector<PointT>& points, PointCloud2& cloud) {
+  constexpr size_t kFieldCount = PointT::kFieldNames.size();
+  cloud.header = header;
+  cloud.height = 1;
+  cloud.width = static_cast<int32_t>(points.size());
+  cloud.fields.resize(kFieldCount);
+  for (size_t k = 0; k < kFieldCount; ++k) {
+    cloud.fields[k] = {std::string(PointT::kFieldNames[k]), static_cast<int32_t>(k * sizeof(float)), POINT_FIELD_FLOAT32, 1};
+  }
+  cloud.is_bigendian = false;
+  cloud.point_step = static_cast<int32_t>(sizeof(PointT));
+  cloud.row_step = cloud.point_step * cloud.width;
+  cloud.is_dense = true;
+  cloud.data.resize(points.size() * sizeof(PointT));
+  if (!points.empty()) {
+    std::memcpy(cloud.data.data(), points.data(), cloud.data.size());
+  }
+}
+
+/**
+ * @brief Keep the points whose distance to the sensor origin is within [min_range, max_range].
+ *
+ * Non-finite points are dropped as well.
+ * @param view Bound input view.
+ * @param min_range Minimum range (m).
+ * @param max_range Maximum range (m).
+ * @param[out] points Kept points, cleared first.
+ */
+template <typename PointT>
+inline void CropRange(const PointView<PointT>& view, float min_range, float max_range, std::vector<PointT>& points) {
+  points.clear();
+  points.reserve(view.size());
+  float min_sq = min_range * min_range;
+  float max_sq = max_range * max_range;
+  view.ForEach([&](const PointT& p) {
+    float range_sq = p.x * p.x + p.y * p.y + p.z * p.z;
+    if (range_sq >= min_sq && range_sq <= max_sq) {
+      points.push_back(p);
+    }
+  });
+}
+
+/**
+ * @brief Keep the points inside an axis-aligned box.
+ * @param view Bound input view.
+ * @param min_corner Box minimum (x, y, z).
+ * @param max_corner Box maximum (x, y, z).
+ * @param[out] points Kept points, cleared first.
+ */
+template <typename PointT>
+inline void CropBox(const PointView<PointT>& view, const std::array<float, 3>& min_corner, const std::array<float, 3>& max_corner,
+                    std::vector<PointT>& points) {
+  points.clear();
+  points.reserve(view.size());
+  view.ForEach([&](const PointT& p) {
+    if (p.x >= min_corner[0] && p.x <= max_corner[0] && p.y >= min_corner[1] && p.y <= max_corner[1] &&
+        p.z >= min_corner[2] && p.z <= max_corner[2]) {
+      points.push_back(p);
+    }
+  });
+}
+
+/**
+ * @brief Voxel-grid downsampling: every occupied voxel is replaced by the centroid of its points.
+ *
+ * Voxel keys are sorted instead of hashed, so memory use is one key per input point and the output is
+ * deterministic. Coordinates are limited to +-2^20 voxels per axis, points beyond and non-finite points are dropped.
+ * @param view Bound input view.
+ * @param leaf_size Voxel edge length (m), > 0.
+ * @param[out] points One averaged point per occupied voxel, cleared first.
+ */
+template <typename PointT>
+inline void VoxelGridDownsample(const PointView<PointT>& view, float leaf_size, std::vector<PointT>& points) {
+  constexpr size_t kFieldCount = PointT::kFieldNames.size();
+  constexpr int64_t kAxisLimit = 1 << 20;
+  points.clear();
+  if (!view.IsValid() || !(leaf_size > 0.0f)) {
+    return;
+  }
+
+  float inverse_leaf = 1.0f / leaf_size;
+  std::vector<std::pair<uint64_t, uint32_t>> keys;
+  keys.reserve(view.size());
+  uint32_t index = 0;
+  view.ForEach([&](const PointT& p) {
+    float fx = std::floor(p.x * inverse_leaf);
+    float fy = std::floor(p.y * inverse_leaf);
+    float fz = std::floor(p.z * inverse_leaf);
+    if (std::fabs(fx) < kAxisLimit && std::fabs(fy) < kAxisLimit && std::fabs(fz) < kAxisLimit) {
+      uint64_t key = (static_cast<uint64_t>(static_cast<int64_t>(fx) + kAxisLimit) << 42) |
+                     (static_cast<uint64_t>(static_cast<int64_t>(fy) + kAxisLimit) << 21) |
+                     static_cast<uint64_t>(static_cast<int64_t>(fz) + kAxisLimit);
+      keys.emplace_back(key, index);
+    }
+    ++index;
+  });
+  std::sort(keys.begin(), keys.end());
+
+  for (size_t begin = 0; begin < keys.size();) {
+    size_t end = begin;
+    double sum[kFieldCount] = {};
+    while (end < keys.size() && keys[end].first == keys[begin].first) {
+      PointT p = view[keys[end].second];
+      float values[kFieldCount];
+      std::memcpy(values, &p, sizeof(PointT));
+      for (size_t k = 0; k < kFieldCount; ++k) {
+        sum[k] += values[k];
+      }
+      ++end;
+    }
+    float values[kFieldCount];
+    for (size_t k = 0; k < kFieldCount; ++k) {
+      values[k] = static_cast<float>(sum[k] / static_cast<double>(end - begin));
+    }
+    PointT centroid;
+    std::memcpy(&centroid, values, sizeof(PointT));
+    points.push_back(centroid);
+    begin = end;
+  }
+}
+
+}  // namespace magic::dog::sensor
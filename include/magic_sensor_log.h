@@ -0,0 +1,980 @@
+#pragma once
+
+#include "magic_type.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace magic::dog::sensor {
+
+/**
+ * @brief Streams that can be recorded, one per SensorController / AudioController subscription
+ */
+enum class LogTopic : uint16_t {
+  TOF = 0,
+  ULTRA = 1,
+  HEAD_TOUCH = 2,
+  LASER_SCAN = 3,
+  RGBD_DEPTH_CAMERA_INFO = 4,
+  RGBD_DEPTH_IMAGE = 5,
+  RGBD_COLOR_CAMERA_INFO = 6,
+  RGBD_COLOR_IMAGE = 7,
+  IMU = 8,
+  LEFT_BINOCULAR_HIGH_IMG = 9,
+  LEFT_BINOCULAR_LOW_IMG = 10,
+  RIGHT_BINOCULAR_LOW_IMG = 11,
+  DEPTH_IMAGE = 12,
+  POINT_CLOUD = 13,
+  ORIGIN_VOICE = 14,
+  BF_VOICE = 15,
+  COUNT = 16,
+};
+
+/**
+ * @brief Message types stored in a sensor log
+ */
+enum class LogMessageType : uint16_t {
+  NONE = 0,
+  IMU = 1,
+  LASER_SCAN = 2,
+  IMAGE = 3,
+  CAMERA_INFO = 4,
+  COMPRESSED_IMAGE = 5,
+  POINT_CLOUD2 = 6,
+  FLOAT32_MULTI_ARRAY = 7,
+  BYTE_MULTI_ARRAY = 8,
+  INT8 = 9,
+};
+
+/**
+ * @brief Message type carried by a topic
+ */
+inline LogMessageType LogTopicMessageType(LogTopic topic) {
+  switch (topic) {
+    case LogTopic::TOF:
+    case LogTopic::ULTRA:
+      return LogMessageType::FLOAT32_MULTI_ARRAY;
+    case LogTopic::HEAD_TOUCH:
+      return LogMessageType::INT8;
+    case LogTopic::LASER_SCAN:
+      return LogMessageType::LASER_SCAN;
+    case LogTopic::RGBD_DEPTH_CAMERA_INFO:
+    case LogTopic::RGBD_COLOR_CAMERA_INFO:
+      return LogMessageType::CAMERA_INFO;
+    case LogTopic::RGBD_DEPTH_IMAGE:
+    case LogTopic::RGBD_COLOR_IMAGE:
+    case LogTopic::DEPTH_IMAGE:
+      return LogMessageType::IMAGE;
+    case LogTopic::IMU:
+      return LogMessageType::IMU;
+    case LogTopic::LEFT_BINOCULAR_HIGH_IMG:
+    case LogTopic::LEFT_BINOCULAR_LOW_IMG:
+    case LogTopic::RIGHT_BINOCULAR_LOW_IMG:
+      return LogMessageType::COMPRESSED_IMAGE;
+    case LogTopic::POINT_CLOUD:
+      return LogMessageType::POINT_CLOUD2;
+    case LogTopic::ORIGIN_VOICE:
+    case LogTopic::BF_VOICE:
+      return LogMessageType::BYTE_MULTI_ARRAY;
+    default:
+      return LogMessageType::NONE;
+  }
+}
+
+namespace detail {
+
+/************************************************************
+ *                   Log file layout                        *
+ ************************************************************/
+// [LogFileHeader] ([LogChunkHeader] ([LogRecordHeader][payload, 8-byte padded])*)* [LogIndexHeader][LogIndexEntry]* [LogFooter]
+// The index and footer are written on Close; a log without them is re-indexed by walking the chunks.
+
+constexpr char kLogFileMagic[8] = {'M', 'D', 'S', 'D', 'K', 'L', 'O', 'G'};
+constexpr char kLogFooterMagic[8] = {'M', 'D', 'L', 'O', 'G', 'E', 'N', 'D'};
+constexpr uint32_t kLogVersion = 1;
+constexpr uint32_t kLogChunkMagic = 0x4B4E4843;  // "CHNK"
+constexpr uint32_t kLogIndexMagic = 0x58444E49;  // "INDX"
+
+struct LogFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+};
+
+struct LogChunkHeader {
+  uint32_t magic;
+  uint32_t record_count;
+  uint64_t bytes;  // Size of the records following this header
+};
+
+struct LogRecordHeader {
+  int64_t timestamp;  // Receipt time (ns)
+  uint16_t topic;
+  uint16_t type;
+  uint32_t size;  // Payload size without padding
+};
+
+struct LogIndexHeader {
+  uint32_t magic;
+  uint32_t reserved;
+  uint64_t entry_count;
+};
+
+struct LogIndexEntry {
+  int64_t timestamp;
+  uint64_t offset;  // File offset of the LogRecordHeader
+  uint32_t size;
+  uint16_t topic;
+  uint16_t type;
+};
+
+struct LogFooter {
+  uint64_t index_offset;
+  char magic[8];
+};
+
+inline size_t LogPadded(size_t size) { return (size + 7) & ~static_cast<size_t>(7); }
+
+/************************************************************
+ *                   Serialization                          *
+ ************************************************************/
+
+class LogEncoder {
+ public:
+  explicit LogEncoder(std::vector<uint8_t>& buffer) : buffer_(buffer) {}
+
+  template <typename T>
+  void Put(const T& value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    PutBytes(&value, sizeof(T));
+  }
+
+  void PutBytes(const void* data, size_t size) {
+    size_t offset = buffer_.size();
+    buffer_.resize(offset + size);
+    if (size > 0) {
+      std::memcpy(buffer_.data() + offset, data, size);
+    }
+  }
+
+  void PutString(const std::string& value) {
+    Put(static_cast<uint32_t>(value.size()));
+    PutBytes(value.data(), value.size());
+  }
+
+  template <typename T>
+  void PutVector(const std::vector<T>& values) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    Put(static_cast<uint32_t>(values.size()));
+    PutBytes(values.data(), values.size() * sizeof(T));
+  }
+
+ private:
+  std::vector<uint8_t>& buffer_;
+};
+
+class LogDecoder {
+ public:
+  LogDecoder(const uint8_t* data, size_t size) : cursor_(data), end_(data + size) {}
+
+  bool ok() const { return ok_; }
+
+  template <typename T>
+  void Get(T& value) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    GetBytes(&value, sizeof(T));
+  }
+
+  void GetBytes(void* data, size_t size) {
+    if (!ok_ || static_cast<size_t>(end_ - cursor_) < size) {
+      ok_ = false;
+      return;
+    }
+    if (size > 0) {
+      std::memcpy(data, cursor_, size);
+    }
+    cursor_ += size;
+  }
+
+  void GetString(std::string& value) {
+    uint32_t size = 0;
+    Get(size);
+    if (!ok_ || static_cast<size_t>(end_ - cursor_) < size) {
+      ok_ = false;
+      return;
+    }
+    value.assign(reinterpret_cast<const char*>(cursor_), size);
+    cursor_ += size;
+  }
+
+  template <typename T>
+  void GetVector(std::vector<T>& values) {
+    static_assert(std::is_trivially_copyable_v<T>);
+    uint32_t count = 0;
+    Get(count);
+    if (!ok_ || static_cast<size_t>(end_ - cursor_) / sizeof(T) < count) {
+      ok_ = false;
+      return;
+    }
+    values.resize(count);
+    GetBytes(values.data(), count * sizeof(T));
+  }
+
+ private:
+  const uint8_t* cursor_;
+  const uint8_t* end_;
+  bool ok_{true};
+};
+
+inline void Encode(LogEncoder& out, const Header& header) {
+  out.Put(header.stamp);
+  out.PutString(header.frame_id);
+}
+
+inline void Decode(LogDecoder& in, Header& header) {
+  in.Get(header.stamp);
+  in.GetString(header.frame_id);
+}
+
+inline void Encode(LogEncoder& out, const MultiArrayLayout& layout) {
+  out.Put(layout.dim_size);
+  out.Put(static_cast<uint32_t>(layout.dim.size()));
+  for (const auto& dim : layout.dim) {
+    out.PutString(dim.label);
+    out.Put(dim.size);
+    out.Put(dim.stride);
+  }
+  out.Put(layout.data_offset);
+}
+
+inline void Decode(LogDecoder& in, MultiArrayLayout& layout) {
+  uint32_t count = 0;
+  in.Get(layout.dim_size);
+  in.Get(count);
+  layout.dim.clear();
+  for (uint32_t i = 0; i < count && in.ok(); ++i) {
+    MultiArrayDimension dim;
+    in.GetString(dim.label);
+    in.Get(dim.size);
+    in.Get(dim.stride);
+    layout.dim.push_back(std::move(dim));
+  }
+  in.Get(layout.data_offset);
+}
+
+inline void Encode(LogEncoder& out, const Imu& msg) { out.Put(msg); }
+inline void Decode(LogDecoder& in, Imu& msg) { in.Get(msg); }
+
+inline void Encode(LogEncoder& out, const Int8& msg) { out.Put(msg.data); }
+inline void Decode(LogDecoder& in, Int8& msg) { in.Get(msg.data); }
+
+inline void Encode(LogEncoder& out, const LaserScan& msg) {
+  Encode(out, msg.header);
+  out.Put(msg.angle_min);
+  out.Put(msg.angle_max);
+  out.Put(msg.angle_increment);
+  out.Put(msg.time_increment);
+  out.Put(msg.scan_time);
+  out.Put(msg.range_min);
+  out.Put(msg.range_max);
+  out.PutVector(msg.ranges);
+  out.PutVector(msg.intensities);
+}
+
+inline void Decode(LogDecoder& in, LaserScan& msg) {
+  Decode(in, msg.header);
+  in.Get(msg.angle_min);
+  in.Get(msg.angle_max);
+  in.Get(msg.angle_increment);
+  in.Get(msg.time_increment);
+  in.Get(msg.scan_time);
+  in.Get(msg.range_min);
+  in.Get(msg.range_max);
+  in.GetVector(msg.ranges);
+  in.GetVector(msg.intensities);
+}
+
+inline void Encode(LogEncoder& out, const Image& msg) {
+  Encode(out, msg.header);
+  out.Put(msg.height);
+  out.Put(msg.width);
+  out.PutString(msg.encoding);
+  out.Put(static_cast<uint8_t>(msg.is_bigendian));
+  out.Put(msg.step);
+  out.PutVector(msg.data);
+}
+
+inline void Decode(LogDecoder& in, Image& msg) {
+  uint8_t is_bigendian = 0;
+  Decode(in, msg.header);
+  in.Get(msg.height);
+  in.Get(msg.width);
+  in.GetString(msg.encoding);
+  in.Get(is_bigendian);
+  in.Get(msg.step);
+  in.GetVector(msg.data);
+  msg.is_bigendian = is_bigendian != 0;
+}
+
+inline void Encode(LogEncoder& out, const CameraInfo& msg) {
+  Encode(out, msg.header);
+  out.Put(msg.height);
+  out.Put(msg.width);
+  out.PutString(msg.distortion_model);
+  out.PutVector(msg.D);
+  out.Put(msg.K);
+  out.Put(msg.R);
+  out.Put(msg.P);
+  out.Put(msg.binning_x);
+  out.Put(msg.binning_y);
+  out.Put(msg.roi_x_offset);
+  out.Put(msg.roi_y_offset);
+  out.Put(msg.roi_height);
+  out.Put(msg.roi_width);
+  out.Put(static_cast<uint8_t>(msg.roi_do_rectify));
+}
+
+inline void Decode(LogDecoder& in, CameraInfo& msg) {
+  uint8_t roi_do_rectify = 0;
+  Decode(in, msg.header);
+  in.Get(msg.height);
+  in.Get(msg.width);
+  in.GetString(msg.distortion_model);
+  in.GetVector(msg.D);
+  in.Get(msg.K);
+  in.Get(msg.R);
+  in.Get(msg.P);
+  in.Get(msg.binning_x);
+  in.Get(msg.binning_y);
+  in.Get(msg.roi_x_offset);
+  in.Get(msg.roi_y_offset);
+  in.Get(msg.roi_height);
+  in.Get(msg.roi_width);
+  in.Get(roi_do_rectify);
+  msg.roi_do_rectify = roi_do_rectify != 0;
+}
+
+inline void Encode(LogEncoder& out, const CompressedImage& msg) {
+  Encode(out, msg.header);
+  out.PutString(msg.format);
+  out.PutVector(msg.data);
+}
+
+inline void Decode(LogDecoder& in, CompressedImage& msg) {
+  Decode(in, msg.header);
+  in.GetString(msg.format);
+  in.GetVector(msg.data);
+}
+
+inline void Encode(LogEncoder& out, const PointCloud2& msg) {
+  Encode(out, msg.header);
+  out.Put(msg.height);
+  out.Put(msg.width);
+  out.Put(static_cast<uint32_t>(msg.fields.size()));
+  for (const auto& field : msg.fields) {
+    out.PutString(field.name);
+    out.Put(field.offset);
+    out.Put(field.datatype);
+    out.Put(field.count);
+  }
+  out.Put(static_cast<uint8_t>(msg.is_bigendian));
+  out.Put(msg.point_step);
+  out.Put(msg.row_step);
+  out.PutVector(msg.data);
+  out.Put(static_cast<uint8_t>(msg.is_dense));
+}
+
+inline void Decode(LogDecoder& in, PointCloud2& msg) {
+  uint32_t count = 0;
+  uint8_t is_bigendian = 0;
+  uint8_t is_dense = 0;
+  Decode(in, msg.header);
+  in.Get(msg.height);
+  in.Get(msg.width);
+  in.Get(count);
+  msg.fields.clear();
+  for (uint32_t i = 0; i < count && in.ok(); ++i) {
+    PointField field;
+    in.GetString(field.name);
+    in.Get(field.offset);
+    in.Get(field.datatype);
+    in.Get(field.count);
+    msg.fields.push_back(std::move(field));
+  }
+  in.Get(is_bigendian);
+  in.Get(msg.point_step);
+  in.Get(msg.row_step);
+  in.GetVector(msg.data);
+  in.Get(is_dense);
+  msg.is_bigendian = is_bigendian != 0;
+  msg.is_dense = is_dense != 0;
+}
+
+inline void Encode(LogEncoder& out, const Float32MultiArray& msg) {
+  Encode(out, msg.layout);
+  out.PutVector(msg.data);
+}
+
+inline void Decode(LogDecoder& in, Float32MultiArray& msg) {
+  Decode(in, msg.layout);
+  in.GetVector(msg.data);
+}
+
+inline void Encode(LogEncoder& out, const ByteMultiArray& msg) {
+  Encode(out, msg.layout);
+  out.PutVector(msg.data);
+}
+
+inline void Decode(LogDecoder& in, ByteMultiArray& msg) {
+  Decode(in, msg.layout);
+  in.GetVector(msg.data);
+}
+
+template <typename T>
+struct LogMessageTraits;
+template <>
+struct LogMessageTraits<Imu> {
+  static constexpr LogMessageType kType = LogMessageType::IMU;
+};
+template <>
+struct LogMessageTraits<LaserScan> {
+  static constexpr LogMessageType kType = LogMessageType::LASER_SCAN;
+};
+template <>
+struct LogMessageTraits<Image> {
+  static constexpr LogMessageType kType = LogMessageType::IMAGE;
+};
+template <>
+struct LogMessageTraits<CameraInfo> {
+  static constexpr LogMessageType kType = LogMessageType::CAMERA_INFO;
+};
+template <>
+struct LogMessageTraits<CompressedImage> {
+  static constexpr LogMessageType kType = LogMessageType::COMPRESSED_IMAGE;
+};
+template <>
+struct LogMessageTraits<PointCloud2> {
+  static constexpr LogMessageType kType = LogMessageType::POINT_CLOUD2;
+};
+template <>
+struct LogMessageTraits<Float32MultiArray> {
+  static constexpr LogMessageType kType = LogMessageType::FLOAT32_MULTI_ARRAY;
+};
+template <>
+struct LogMessageTraits<ByteMultiArray> {
+  static constexpr LogMessageType kType = LogMessageType::BYTE_MULTI_ARRAY;
+};
+template <>
+struct LogMessageTraits<Int8> {
+  static constexpr LogMessageType kType = LogMessageType::INT8;
+};
+
+inline int64_t LogNowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+}  // namespace detail
+
+/**
+ * @class SensorLogRecorder
+ * @brief Records sensor and audio streams into an indexed, chunked log file.
+ *
+ * Records are buffered into chunks of chunk_bytes and written with one syscall per chunk; the time/topic index
+ * is written on Close. Write and the callbacks returned by Callback are thread-safe, so one recorder can be
+ * attached to every subscription at once.
+ *
+ * Example:
+ * @code
+ *   SensorLogRecorder recorder;
+ *   recorder.Open("/tmp/run.mdlog");
+ *   controller.SubscribeImu(recorder.Callback<Imu>(LogTopic::IMU));
+ *   audio.SubscribeBfVoiceData(recorder.Callback<ByteMultiArray>(LogTopic::BF_VOICE));
+ *   ...
+ *   recorder.Close();
+ * @endcode
+ */
+class SensorLogRecorder final : public NonCopyable {
+ public:
+  SensorLogRecorder() = default;
+
+  ~SensorLogRecorder() { Close(); }
+
+  /**
+   * @brief Create the log file.
+   * @param path File path, truncated if it exists.
+   * @param chunk_bytes Records are flushed to disk once a chunk reaches this size.
+   * @return Operation status.
+   */
+  Status Open(const std::string& path, size_t chunk_bytes = 4 << 20) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (file_) {
+      return {ErrorCode::INTERNAL_ERROR, "recorder is already open"};
+    }
+    file_ = std::fopen(path.c_str(), "wb");
+    if (!file_) {
+      return {ErrorCode::INTERNAL_ERROR, "cannot create log file: " + path};
+    }
+    detail::LogFileHeader header{};
+    std::memcpy(header.magic, detail::kLogFileMagic, sizeof(header.magic));
+    header.version = detail::kLogVersion;
+    std::fwrite(&header, sizeof(header), 1, file_);
+    file_offset_ = sizeof(header);
+    chunk_bytes_ = chunk_bytes;
+    chunk_.clear();
+    chunk_.reserve(chunk_bytes + (1 << 16));
+    chunk_records_ = 0;
+    index_.clear();
+    write_failed_ = false;
+    return {ErrorCode::OK, ""};
+  }
+
+  /// Whether a log file is open
+  bool IsOpen() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return file_ != nullptr;
+  }
+
+  /**
+   * @brief Append a message.
+   * @param topic Topic of the message, its type must match LogTopicMessageType(topic).
+   * @param msg Message to record.
+   * @param timestamp Receipt time (ns), defaults to now.
+   * @return false if the recorder is closed, the message type does not match the topic or writing the file failed.
+   */
+  template <typename T>
+  bool Write(LogTopic topic, const T& msg, int64_t timestamp = 0) {
+    constexpr LogMessageType kType = detail::LogMessageTraits<T>::kType;
+    if (LogTopicMessageType(topic) != kType) {
+      return false;
+    }
+    if (timestamp == 0) {
+      timestamp = detail::LogNowNs();
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!file_ || write_failed_) {
+      return false;
+    }
+    size_t record_offset = chunk_.size();
+    chunk_.resize(record_offset + sizeof(detail::LogRecordHeader));
+    detail::LogEncoder encoder(chunk_);
+    detail::Encode(encoder, msg);
+    size_t size = chunk_.size() - record_offset - sizeof(detail::LogRecordHeader);
+    chunk_.resize(record_offset + sizeof(detail::LogRecordHeader) + detail::LogPadded(size), 0);
+
+    detail::LogRecordHeader header{timestamp, static_cast<uint16_t>(topic), static_cast<uint16_t>(kType), static_cast<uint32_t>(size)};
+    std::memcpy(chunk_.data() + record_offset, &header, sizeof(header));
+    uint64_t file_offset = file_offset_ + sizeof(detail::LogChunkHeader) + record_offset;
+    index_.push_back({timestamp, file_offset, header.size, header.topic, header.type});
+    ++chunk_records_;
+    if (chunk_.size() >= chunk_bytes_) {
+      FlushChunk();
+    }
+    return !write_failed_;
+  }
+
+  /**
+   * @brief Callback recording every received message of a topic.
+   * @note The recorder must outlive the subscription.
+   */
+  template <typename T>
+  std::function<void(const std::shared_ptr<T>)> Callback(LogTopic topic) {
+    return [this, topic](const std::shared_ptr<T> msg) {
+      if (msg) {
+        Write(topic, *msg);
+      }
+    };
+  }
+
+  /**
+   * @brief Flush the pending chunk, write the index and close the file.
+   * @return Operation status.
+   */
+  Status Close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!file_) {
+      return {ErrorCode::OK, ""};
+    }
+    FlushChunk();
+    detail::LogIndexHeader index_header{detail::kLogIndexMagic, 0, index_.size()};
+    detail::LogFooter footer{file_offset_, {}};
+    std::memcpy(footer.magic, detail::kLogFooterMagic, sizeof(footer.magic));
+    bool ok = !write_failed_ && std::fwrite(&index_header, sizeof(index_header), 1, file_) == 1 &&
+              (index_.empty() || std::fwrite(index_.data(), sizeof(detail::LogIndexEntry), index_.size(), file_) == index_.size()) &&
+              std::fwrite(&footer, sizeof(footer), 1, file_) == 1;
+    ok = std::fclose(file_) == 0 && ok;
+    file_ = nullptr;
+    index_.clear();
+    if (!ok) {
+      return {ErrorCode::INTERNAL_ERROR, "failed to write log file"};
+    }
+    return {ErrorCode::OK, ""};
+  }
+
+ private:
+  void FlushChunk() {
+    if (chunk_records_ == 0) {
+      return;
+    }
+    detail::LogChunkHeader header{detail::kLogChunkMagic, chunk_records_, chunk_.size()};
+    if (std::fwrite(&header, sizeof(header), 1, file_) != 1 || std::fwrite(chunk_.data(), 1, chunk_.size(), file_) != chunk_.size()) {
+      write_failed_ = true;
+    }
+    file_offset_ += sizeof(header) + chunk_.size();
+    chunk_.clear();
+    chunk_records_ = 0;
+  }
+
+  mutable std::mutex mutex_;
+  std::FILE* file_{nullptr};
+  uint64_t file_offset_{0};
+  size_t chunk_bytes_{0};
+  std::vector<uint8_t> chunk_;
+  uint32_t chunk_records_{0};
+  std::vector<detail::LogIndexEntry> index_;
+  bool write_failed_{false};
+};
+
+/**
+ * @brief Zero-copy view of one log record, valid while the player keeps the file open
+ */
+struct LogRecordView {
+  int64_t timestamp;          ///< Receipt time (ns)
+  LogTopic topic;             ///< Topic
+  LogMessageType type;        ///< Message type
+  const uint8_t* payload;     ///< Serialized message inside the mapped file
+  size_t size;                ///< Payload size
+};
+
+/**
+ * @class SensorLogPlayer
+ * @brief Replays a sensor log through the same callback signatures as SensorController and AudioController.
+ *
+ * The file is memory-mapped, no read() copies are made: messages are decoded straight from the mapping into the
+ * shared_ptr delivered to the callback, and GetRecord exposes the raw mapped payload for consumers that parse
+ * it themselves. Playback can run at real time (rate 1), scaled (rate > 1 is faster) or as fast as possible (rate <= 0).
+ *
+ * Example:
+ * @code
+ *   SensorLogPlayer player;
+ *   player.Open("/tmp/run.mdlog");
+ *   player.SubscribeImu(on_imu);                 // same callback as passed to SensorController::SubscribeImu
+ *   player.SubscribeRgbdDepthImage(on_depth);
+ *   player.Play(0);                              // as fast as possible
+ * @endcode
+ */
+class SensorLogPlayer final : public NonCopyable {
+  using TofCallback = std::function<void(const std::shared_ptr<Float32MultiArray>)>;
+  using UltraCallback = std::function<void(const std::shared_ptr<Float32MultiArray>)>;
+  using HeadTouchCallback = std::function<void(const std::shared_ptr<HeadTouch>)>;
+  using LaserScanCallback = std::function<void(const std::shared_ptr<LaserScan>)>;
+  using ImageCallback = std::function<void(const std::shared_ptr<Image>)>;
+  using CameraInfoCallback = std::function<void(const std::shared_ptr<CameraInfo>)>;
+  using CompressedImageCallback = std::function<void(const std::shared_ptr<CompressedImage>)>;
+  using ImuCallback = std::function<void(const std::shared_ptr<Imu>)>;
+  using PointCloudCallback = std::function<void(const std::shared_ptr<PointCloud2>)>;
+  using ByteMultiArrayCallback = std::function<void(const std::shared_ptr<ByteMultiArray>)>;
+
+ public:
+  SensorLogPlayer() = default;
+
+  ~SensorLogPlayer() { Close(); }
+
+  /**
+   * @brief Map a log file and load its index, rebuilding it from the chunks if the log was not closed cleanly.
+   * @param path Log file path.
+   * @return Operation status.
+   */
+  Status Open(const std::string& path) {
+    Close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return {ErrorCode::INTERNAL_ERROR, "cannot open log file: " + path};
+    }
+    struct stat st {};
+    if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(detail::LogFileHeader)) {
+      ::close(fd);
+      return {ErrorCode::INTERNAL_ERROR, "invalid log file: " + path};
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    void* data = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+      size_ = 0;
+      return {ErrorCode::INTERNAL_ERROR, "cannot map log file: " + path};
+    }
+    data_ = static_cast<const uint8_t*>(data);
+    ::madvise(data, size_, MADV_SEQUENTIAL);
+
+    detail::LogFileHeader header;
+    std::memcpy(&header, data_, sizeof(header));
+    if (std::memcmp(header.magic, detail::kLogFileMagic, sizeof(header.magic)) != 0 || header.version != detail::kLogVersion) {
+      Close();
+      return {ErrorCode::INTERNAL_ERROR, "unsupported log file: " + path};
+    }
+    if (!LoadIndex()) {
+      RebuildIndex();
+    }
+    std::stable_sort(index_.begin(), index_.end(),
+                     [](const detail::LogIndexEntry& a, const detail::LogIndexEntry& b) { return a.timestamp < b.timestamp; });
+    return {ErrorCode::OK, ""};
+  }
+
+  /// Unmap the file
+  void Close() {
+    if (data_) {
+      ::munmap(const_cast<uint8_t*>(data_), size_);
+    }
+    data_ = nullptr;
+    size_ = 0;
+    index_.clear();
+  }
+
+  /// Number of records in the log
+  size_t RecordCount() const { return index_.size(); }
+
+  /// Receipt time of the first record (ns), 0 if empty
+  int64_t StartTime() const { return index_.empty() ? 0 : index_.front().timestamp; }
+
+  /// Receipt time of the last record (ns), 0 if empty
+  int64_t EndTime() const { return index_.empty() ? 0 : index_.back().timestamp; }
+
+  /**
+   * @brief Zero-copy access to a record, in time order.
+   * @param i Record index in [0, RecordCount()).
+   * @param[out] record View into the mapped file.
+   * @return false if the index is out of range.
+   */
+  bool GetRecord(size_t i, LogRecordView& record) const {
+    if (i >= index_.size()) {
+      return false;
+    }
+    const detail::LogIndexEntry& entry = index_[i];
+    record.timestamp = entry.timestamp;
+    record.topic = static_cast<LogTopic>(entry.topic);
+    record.type = static_cast<LogMessageType>(entry.type);
+    record.payload = data_ + entry.offset + sizeof(detail::LogRecordHeader);
+    record.size = entry.size;
+    return true;
+  }
+
+  /**
+   * @brief Decode a record into a message.
+   * @return false if the record type does not match T or the payload is corrupted.
+   */
+  template <typename T>
+  static bool Decode(const LogRecordView& record, T& msg) {
+    if (record.type != detail::LogMessageTraits<T>::kType) {
+      return false;
+    }
+    detail::LogDecoder decoder(record.payload, record.size);
+    detail::Decode(decoder, msg);
+    return decoder.ok();
+  }
+
+  // Subscription interfaces, same callback signatures as SensorController and AudioController
+
+  void SubscribeTof(const TofCallback callback) { tof_ = callback; }
+  void SubscribeUltra(const UltraCallback callback) { ultra_ = callback; }
+  void SubscribeHeadTouch(const HeadTouchCallback callback) { head_touch_ = callback; }
+  void SubscribeLaserScan(const LaserScanCallback callback) { laser_scan_ = callback; }
+  void SubscribeRgbDepthCameraInfo(const CameraInfoCallback callback) { rgbd_depth_camera_info_ = callback; }
+  void SubscribeRgbdDepthImage(const ImageCallback callback) { rgbd_depth_image_ = callback; }
+  void SubscribeRgbdColorCameraInfo(const CameraInfoCallback callback) { rgbd_color_camera_info_ = callback; }
+  void SubscribeRgbdColorImage(const ImageCallback callback) { rgbd_color_image_ = callback; }
+  void SubscribeImu(const ImuCallback callback) { imu_ = callback; }
+  void SubscribeLeftBinocularHighImg(const CompressedImageCallback callback) { left_binocular_high_img_ = callback; }
+  void SubscribeLeftBinocularLowImg(const CompressedImageCallback callback) { left_binocular_low_img_ = callback; }
+  void SubscribeRightBinocularLowImg(const CompressedImageCallback callback) { right_binocular_low_img_ = callback; }
+  void SubscribeDepthImage(const ImageCallback callback) { depth_image_ = callback; }
+  void SubscribePointCloud(const PointCloudCallback callback) { point_cloud_ = callback; }
+  void SubscribeOriginVoiceData(const ByteMultiArrayCallback callback) { origin_voice_ = callback; }
+  void SubscribeBfVoiceData(const ByteMultiArrayCallback callback) { bf_voice_ = callback; }
+
+  /**
+   * @brief Replay the log on the calling thread, blocking until the end, the time window end or Stop.
+   * @param rate Playback speed, 1 is real time, 2 twice as fast, <= 0 as fast as possible.
+   * @param start_time Skip records received before this time (ns).
+   * @param end_time Stop at records received after this time (ns).
+   * @return Number of records delivered to a callback.
+   */
+  size_t Play(double rate = 1.0, int64_t start_time = 0, int64_t end_time = std::numeric_limits<int64_t>::max()) {
+    stop_.store(false);
+    auto begin = std::lower_bound(index_.begin(), index_.end(), start_time,
+                                  [](const detail::LogIndexEntry& entry, int64_t t) { return entry.timestamp < t; });
+    if (begin == index_.end()) {
+      return 0;
+    }
+    auto wall_start = std::chrono::steady_clock::now();
+    int64_t log_start = begin->timestamp;
+    size_t delivered = 0;
+    LogRecordView record;
+    for (auto it = begin; it != index_.end() && it->timestamp <= end_time; ++it) {
+      if (stop_.load(std::memory_order_relaxed)) {
+        break;
+      }
+      if (rate > 0.0) {
+        auto offset = std::chrono::nanoseconds(static_cast<int64_t>(static_cast<double>(it->timestamp - log_start) / rate));
+        std::this_thread::sleep_until(wall_start + offset);
+      }
+      GetRecord(static_cast<size_t>(it - index_.begin()), record);
+      delivered += Dispatch(record) ? 1 : 0;
+    }
+    return delivered;
+  }
+
+  /// Request Play to return, callable from any thread or from a callback
+  void Stop() { stop_.store(true); }
+
+ private:
+  bool LoadIndex() {
+    if (size_ < sizeof(detail::LogFileHeader) + sizeof(detail::LogIndexHeader) + sizeof(detail::LogFooter)) {
+      return false;
+    }
+    detail::LogFooter footer;
+    std::memcpy(&footer, data_ + size_ - sizeof(footer), sizeof(footer));
+    // Offsets come from the file, so bounds are checked in subtraction form to rule out wrap-around
+    uint64_t index_end = size_ - sizeof(footer);
+    if (std::memcmp(footer.magic, detail::kLogFooterMagic, sizeof(footer.magic)) != 0 || footer.index_offset > index_end ||
+        sizeof(detail::LogIndexHeader) > index_end - footer.index_offset) {
+      return false;
+    }
+    detail::LogIndexHeader header;
+    std::memcpy(&header, data_ + footer.index_offset, sizeof(header));
+    uint64_t available = (index_end - footer.index_offset - sizeof(header)) / sizeof(detail::LogIndexEntry);
+    if (header.magic != detail::kLogIndexMagic || header.entry_count > available) {
+      return false;
+    }
+    index_.resize(header.entry_count);
+    if (header.entry_count > 0) {
+      std::memcpy(index_.data(), data_ + footer.index_offset + sizeof(header), header.entry_count * sizeof(detail::LogIndexEntry));
+    }
+    for (const auto& entry : index_) {
+      if (entry.offset > footer.index_offset || sizeof(detail::LogRecordHeader) > footer.index_offset - entry.offset ||
+          entry.size > footer.index_offset - entry.offset - sizeof(detail::LogRecordHeader)) {
+        index_.clear();
+        return false;
+      }
+    }
+    return true;
+  }
+
+  /// Walk the chunks of a log that was not closed cleanly, stops at the first incomplete chunk
+  void RebuildIndex() {
+    index_.clear();
+    uint64_t offset = sizeof(detail::LogFileHeader);
+    // Sizes come from the file, so bounds are checked in subtraction form to rule out wrap-around
+    while (offset <= size_ && sizeof(detail::LogChunkHeader) <= size_ - offset) {
+      detail::LogChunkHeader chunk;
+      std::memcpy(&chunk, data_ + offset, sizeof(chunk));
+      if (chunk.magic != detail::kLogChunkMagic || chunk.bytes > size_ - offset - sizeof(chunk)) {
+        break;
+      }
+      uint64_t chunk_end = offset + sizeof(chunk) + chunk.bytes;
+      uint64_t record_offset = offset + sizeof(chunk);
+      for (uint32_t i = 0; i < chunk.record_count && record_offset <= chunk_end && sizeof(detail::LogRecordHeader) <= chunk_end - record_offset; ++i) {
+        detail::LogRecordHeader record;
+        std::memcpy(&record, data_ + record_offset, sizeof(record));
+        if (record.size > chunk_end - record_offset - sizeof(record)) {
+          break;
+        }
+        index_.push_back({record.timestamp, record_offset, record.size, record.topic, record.type});
+        record_offset += sizeof(record) + detail::LogPadded(record.size);
+      }
+      offset = chunk_end;
+    }
+  }
+
+  template <typename T>
+  static bool Deliver(const LogRecordView& record, const std::function<void(const std::shared_ptr<T>)>& callback) {
+    if (!callback) {
+      return false;
+    }
+    auto msg = std::make_shared<T>();
+    if (!Decode(record, *msg)) {
+      return false;
+    }
+    callback(msg);
+    return true;
+  }
+
+  bool Dispatch(const LogRecordView& record) const {
+    switch (record.topic) {
+      case LogTopic::TOF:
+        return Deliver(record, tof_);
+      case LogTopic::ULTRA:
+        return Deliver(record, ultra_);
+      case LogTopic::HEAD_TOUCH:
+        return Deliver(record, head_touch_);
+      case LogTopic::LASER_SCAN:
+        return Deliver(record, laser_scan_);
+      case LogTopic::RGBD_DEPTH_CAMERA_INFO:
+        return Deliver(record, rgbd_depth_camera_info_);
+      case LogTopic::RGBD_DEPTH_IMAGE:
+        return Deliver(record, rgbd_depth_image_);
+      case LogTopic::RGBD_COLOR_CAMERA_INFO:
+        return Deliver(record, rgbd_color_camera_info_);
+      case LogTopic::RGBD_COLOR_IMAGE:
+        return Deliver(record, rgbd_color_image_);
+      case LogTopic::IMU:
+        return Deliver(record, imu_);
+      case LogTopic::LEFT_BINOCULAR_HIGH_IMG:
+        return Deliver(record, left_binocular_high_img_);
+      case LogTopic::LEFT_BINOCULAR_LOW_IMG:
+        return Deliver(record, left_binocular_low_img_);
+      case LogTopic::RIGHT_BINOCULAR_LOW_IMG:
+        return Deliver(record, right_binocular_low_img_);
+      case LogTopic::DEPTH_IMAGE:
+        return Deliver(record, depth_image_);
+      case LogTopic::POINT_CLOUD:
+        return Deliver(record, point_cloud_);
+      case LogTopic::ORIGIN_VOICE:
+        return Deliver(record, origin_voice_);
+      case LogTopic::BF_VOICE:
+        return Deliver(record, bf_voice_);
+      default:
+        return false;
+    }
+  }
+
+  const uint8_t* data_{nullptr};
+  size_t size_{0};
+  std::vector<detail::LogIndexEntry> index_;
+  std::atomic_bool stop_{false};
+
+  TofCallback tof_;
+  UltraCallback ultra_;
+  HeadTouchCallback head_touch_;
+  LaserScanCallback laser_scan_;
+  CameraInfoCallback rgbd_depth_camera_info_;
+  ImageCallback rgbd_depth_image_;
+  CameraInfoCallback rgbd_color_camera_info_;
+  ImageCallback rgbd_color_image_;
+  ImuCallback imu_;
+  CompressedImageCallback left_binocular_high_img_;
+  CompressedImageCallback left_binocular_low_img_;
+  CompressedImageCallback right_binocular_low_img_;
+  ImageCallback depth_image_;
+  PointCloudCallback point_cloud_;
+  ByteMultiArrayCallback origin_voice_;
+  ByteMultiArrayCallback bf_voice_;
+};
+
+}  // namespace magic::dog::sensor
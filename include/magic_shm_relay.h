@@ -0,0 +1,727 @@
+#pragma once
+
+#include "magic_type.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <type_traits>
+
+namespace magic::dog::sensor {
+
+/**
+ * @brief Message type carried by a shared-memory stream
+ */
+enum class ShmMessageType : uint32_t {
+  IMAGE = 1,             ///< Image
+  COMPRESSED_IMAGE = 2,  ///< CompressedImage
+  LASER_SCAN = 3,        ///< LaserScan
+  POINT_CLOUD = 4,       ///< PointCloud2
+};
+
+/**
+ * @brief Zero-copy view of an Image stored in a shared-memory slot
+ */
+struct ShmImageView {
+  Header header;
+  int32_t height = 0;
+  int32_t width = 0;
+  std::string encoding;
+  bool is_bigendian = false;
+  int32_t step = 0;
+  const uint8_t* data = nullptr;  ///< Pixel data in shared memory
+  size_t size = 0;                ///< Size of data in bytes
+};
+
+/**
+ * @brief Zero-copy view of a CompressedImage stored in a shared-memory slot
+ */
+struct ShmCompressedImageView {
+  Header header;
+  std::string format;
+  const uint8_t* data = nullptr;  ///< Compressed data in shared memory
+  size_t size = 0;                ///< Size of data in bytes
+};
+
+/**
+ * @brief Zero-copy view of a LaserScan stored in a shared-memory slot
+ */
+struct ShmLaserScanView {
+  Header header;
+  int32_t angle_min = 0;
+  int32_t angle_max = 0;
+  int32_t angle_increment = 0;
+  int32_t time_increment = 0;
+  int32_t scan_time = 0;
+  int32_t range_min = 0;
+  int32_t range_max = 0;
+  const double* ranges = nullptr;  ///< Ranges in shared memory
+  size_t range_count = 0;
+  const double* intensities = nullptr;  ///< Intensities in shared memory
+  size_t intensity_count = 0;
+};
+
+/**
+ * @brief Zero-copy view of a PointCloud2 stored in a shared-memory slot
+ *
+ * layout holds header and field layout with an empty data vector; bind a PointView with
+ * view.Bind(layout, data, size) to read the points in place.
+ */
+struct ShmPointCloudView {
+  PointCloud2 layout;
+  const uint8_t* data = nullptr;  ///< Packed point data in shared memory
+  size_t size = 0;                ///< Size of data in bytes
+};
+
+namespace detail {
+
+constexpr uint32_t kShmMagic = 0x48534447;  // "GDSH"
+constexpr uint32_t kShmVersion = 1;
+constexpr size_t kShmAlign = 64;
+constexpr size_t kShmMaxPointFields = 8;
+
+// All structs below are part of the shared-memory layout, also read by example/python/shm_reader_example.py
+
+struct alignas(64) ShmSegmentHeader {
+  std::atomic<uint32_t> magic;  // Stored last by the writer, readers attach only once it is set
+  uint32_t version;
+  uint32_t message_type;
+  uint32_t slot_count;
+  uint64_t slot_bytes;                 // Payload capacity of a slot
+  std::atomic<uint64_t> write_index;   // Number of published messages
+};
+
+struct alignas(64) ShmSlotHeader {
+  std::atomic<uint64_t> sequence;  // 2n+1 while message n is written, 2n+2 once published
+  uint64_t payload_bytes;
+};
+
+struct ShmMessageMeta {
+  int64_t stamp;
+  char frame_id[64];
+};
+
+struct ShmImageMeta {
+  ShmMessageMeta base;
+  char encoding[32];
+  int32_t height;
+  int32_t width;
+  int32_t step;
+  uint32_t is_bigendian;
+  uint64_t data_bytes;
+};
+
+struct ShmCompressedImageMeta {
+  ShmMessageMeta base;
+  char format[32];
+  uint64_t data_bytes;
+};
+
+struct ShmLaserScanMeta {
+  ShmMessageMeta base;
+  int32_t angle_min;
+  int32_t angle_max;
+  int32_t angle_increment;
+  int32_t time_increment;
+  int32_t scan_time;
+  int32_t range_min;
+  int32_t range_max;
+  uint32_t reserved;
+  uint64_t range_count;
+  uint64_t intensity_count;
+};
+
+struct ShmPointField {
+  char name[16];
+  int32_t offset;
+  int32_t count;
+  int32_t datatype;
+  uint32_t reserved;
+};
+
+struct ShmPointCloudMeta {
+  ShmMessageMeta base;
+  int32_t height;
+  int32_t width;
+  int32_t point_step;
+  int32_t row_step;
+  uint32_t is_bigendian;
+  uint32_t is_dense;
+  uint32_t field_count;
+  uint32_t reserved;
+  ShmPointField fields[kShmMaxPointFields];
+  uint64_t data_bytes;
+};
+
+static_assert(sizeof(ShmSegmentHeader) == 64 && sizeof(ShmSlotHeader) == 64, "shared-memory headers must stay one cache line");
+static_assert(sizeof(ShmImageMeta) % 8 == 0 && sizeof(ShmCompressedImageMeta) % 8 == 0 && sizeof(ShmLaserScanMeta) % 8 == 0 &&
+                  sizeof(ShmPointCloudMeta) % 8 == 0,
+              "payload data must stay 8-byte aligned");
+
+inline size_t ShmAlignUp(size_t n) { return (n + kShmAlign - 1) & ~(kShmAlign - 1); }
+
+inline void ShmCopyString(char* dst, size_t capacity, const std::string& src) {
+  size_t n = std::min(src.size(), capacity - 1);
+  std::memcpy(dst, src.data(), n);
+  std::memset(dst + n, 0, capacity - n);
+}
+
+/// Whether src fits a fixed-size field including its terminating zero
+inline bool ShmFits(const std::string& src, size_t capacity) { return src.size() < capacity; }
+
+inline void ShmReadString(const char* src, size_t capacity, std::string& dst) { dst.assign(src, ::strnlen(src, capacity)); }
+
+inline void ShmEncodeBase(const Header& header, ShmMessageMeta& meta) {
+  meta.stamp = header.stamp;
+  ShmCopyString(meta.frame_id, sizeof(meta.frame_id), header.frame_id);
+}
+
+inline void ShmDecodeBase(const ShmMessageMeta& meta, Header& header) {
+  header.stamp = meta.stamp;
+  ShmReadString(meta.frame_id, sizeof(meta.frame_id), header.frame_id);
+}
+
+template <typename T>
+struct ShmTraits;
+
+template <>
+struct ShmTraits<Image> {
+  static constexpr ShmMessageType kType = ShmMessageType::IMAGE;
+  using View = ShmImageView;
+
+  static size_t PayloadSize(const Image& msg) { return sizeof(ShmImageMeta) + msg.data.size(); }
+
+  static bool Fits(const Image& msg) {
+    return ShmFits(msg.header.frame_id, sizeof(ShmMessageMeta::frame_id)) && ShmFits(msg.encoding, sizeof(ShmImageMeta::encoding));
+  }
+
+  static void Encode(const Image& msg, uint8_t* out) {
+    ShmImageMeta meta{};
+    ShmEncodeBase(msg.header, meta.base);
+    ShmCopyString(meta.encoding, sizeof(meta.encoding), msg.encoding);
+    meta.height = msg.height;
+    meta.width = msg.width;
+    meta.step = msg.step;
+    meta.is_bigendian = msg.is_bigendian;
+    meta.data_bytes = msg.data.size();
+    std::memcpy(out, &meta, sizeof(meta));
+    std::memcpy(out + sizeof(meta), msg.data.data(), msg.data.size());
+  }
+
+  static bool Decode(const uint8_t* in, size_t size, View& view) {
+    ShmImageMeta meta;
+    if (size < sizeof(meta)) {
+      return false;
+    }
+    std::memcpy(&meta, in, sizeof(meta));
+    if (meta.data_bytes > size - sizeof(meta)) {
+      return false;
+    }
+    ShmDecodeBase(meta.base, view.header);
+    ShmReadString(meta.encoding, sizeof(meta.encoding), view.encoding);
+    view.height = meta.height;
+    view.width = meta.width;
+    view.step = meta.step;
+    view.is_bigendian = meta.is_bigendian != 0;
+    view.data = in + sizeof(meta);
+    view.size = meta.data_bytes;
+    return true;
+  }
+};
+
+template <>
+struct ShmTraits<CompressedImage> {
+  static constexpr ShmMessageType kType = ShmMessageType::COMPRESSED_IMAGE;
+  using View = ShmCompressedImageView;
+
+  static size_t PayloadSize(const CompressedImage& msg) { return sizeof(ShmCompressedImageMeta) + msg.data.size(); }
+
+  static bool Fits(const CompressedImage& msg) {
+    return ShmFits(msg.header.frame_id, sizeof(ShmMessageMeta::frame_id)) && ShmFits(msg.format, sizeof(ShmCompressedImageMeta::format));
+  }
+
+  static void Encode(const CompressedImage& msg, uint8_t* out) {
+    ShmCompressedImageMeta meta{};
+    ShmEncodeBase(msg.header, meta.base);
+    ShmCopyString(meta.format, sizeof(meta.format), msg.format);
+    meta.data_bytes = msg.data.size();
+    std::memcpy(out, &meta, sizeof(meta));
+    std::memcpy(out + sizeof(meta), msg.data.data(), msg.data.size());
+  }
+
+  static bool Decode(const uint8_t* in, size_t size, View& view) {
+    ShmCompressedImageMeta meta;
+    if (size < sizeof(meta)) {
+      return false;
+    }
+    std::memcpy(&meta, in, sizeof(meta));
+    if (meta.data_bytes > size - sizeof(meta)) {
+      return false;
+    }
+    ShmDecodeBase(meta.base, view.header);
+    ShmReadString(meta.format, sizeof(meta.format), view.format);
+    view.data = in + sizeof(meta);
+    view.size = meta.data_bytes;
+    return true;
+  }
+};
+
+template <>
+struct ShmTraits<LaserScan> {
+  static constexpr ShmMessageType kType = ShmMessageType::LASER_SCAN;
+  using View = ShmLaserScanView;
+
+  static size_t PayloadSize(const LaserScan& msg) {
+    return sizeof(ShmLaserScanMeta) + (msg.ranges.size() + msg.intensities.size()) * sizeof(double);
+  }
+
+  static bool Fits(const LaserScan& msg) { return ShmFits(msg.header.frame_id, sizeof(ShmMessageMeta::frame_id)); }
+
+  static void Encode(const LaserScan& msg, uint8_t* out) {
+    ShmLaserScanMeta meta{};
+    ShmEncodeBase(msg.header, meta.base);
+    meta.angle_min = msg.angle_min;
+    meta.angle_max = msg.angle_max;
+    meta.angle_increment = msg.angle_increment;
+    meta.time_increment = msg.time_increment;
+    meta.scan_time = msg.scan_time;
+    meta.range_min = msg.range_min;
+    meta.range_max = msg.range_max;
+    meta.range_count = msg.ranges.size();
+    meta.intensity_count = msg.intensities.size();
+    std::memcpy(out, &meta, sizeof(meta));
+    out += sizeof(meta);
+    std::memcpy(out, msg.ranges.data(), msg.ranges.size() * sizeof(double));
+    std::memcpy(out + msg.ranges.size() * sizeof(double), msg.intensities.data(), msg.intensities.size() * sizeof(double));
+  }
+
+  static bool Decode(const uint8_t* in, size_t size, View& view) {
+    ShmLaserScanMeta meta;
+    if (size < sizeof(meta)) {
+      return false;
+    }
+    std::memcpy(&meta, in, sizeof(meta));
+    size_t available = (size - sizeof(meta)) / sizeof(double);
+    if (meta.range_count > available || meta.intensity_count > available - meta.range_count) {
+      return false;
+    }
+    ShmDecodeBase(meta.base, view.header);
+    view.angle_min = meta.angle_min;
+    view.angle_max = meta.angle_max;
+    view.angle_increment = meta.angle_increment;
+    view.time_increment = meta.time_increment;
+    view.scan_time = meta.scan_time;
+    view.range_min = meta.range_min;
+    view.range_max = meta.range_max;
+    // Slot payloads are cache-line aligned and the meta size is a multiple of 8, so the arrays are double-aligned
+    view.ranges = reinterpret_cast<const double*>(in + sizeof(meta));
+    view.range_count = meta.range_count;
+    view.intensities = view.ranges + meta.range_count;
+    view.intensity_count = meta.intensity_count;
+    return true;
+  }
+};
+
+template <>
+struct ShmTraits<PointCloud2> {
+  static constexpr ShmMessageType kType = ShmMessageType::POINT_CLOUD;
+  using View = ShmPointCloudView;
+
+  static size_t PayloadSize(const PointCloud2& msg) { return sizeof(ShmPointCloudMeta) + msg.data.size(); }
+
+  static bool Fits(const PointCloud2& msg) {
+    if (!ShmFits(msg.header.frame_id, sizeof(ShmMessageMeta::frame_id)) || msg.fields.size() > kShmMaxPointFields) {
+      return false;
+    }
+    return std::all_of(msg.fields.begin(), msg.fields.end(), [](const auto& field) { return ShmFits(field.name, sizeof(ShmPointField::name)); });
+  }
+
+  static void Encode(const PointCloud2& msg, uint8_t* out) {
+    ShmPointCloudMeta meta{};
+    ShmEncodeBase(msg.header, meta.base);
+    meta.height = msg.height;
+    meta.width = msg.width;
+    meta.point_step = msg.point_step;
+    meta.row_step = msg.row_step;
+    meta.is_bigendian = msg.is_bigendian;
+    meta.is_dense = msg.is_dense;
+    meta.field_count = static_cast<uint32_t>(msg.fields.size());
+    for (size_t i = 0; i < msg.fields.size(); ++i) {
+      ShmCopyString(meta.fields[i].name, sizeof(meta.fields[i].name), msg.fields[i].name);
+      meta.fields[i].offset = msg.fields[i].offset;
+      meta.fields[i].count = msg.fields[i].count;
+      meta.fields[i].datatype = msg.fields[i].datatype;
+    }
+    meta.data_bytes = msg.data.size();
+    std::memcpy(out, &meta, sizeof(meta));
+    std::memcpy(out + sizeof(meta), msg.data.data(), msg.data.size());
+  }
+
+  static bool Decode(const uint8_t* in, size_t size, View& view) {
+    ShmPointCloudMeta meta;
+    if (size < sizeof(meta)) {
+      return false;
+    }
+    std::memcpy(&meta, in, sizeof(meta));
+    if (meta.data_bytes > size - sizeof(meta) || meta.field_count > kShmMaxPointFields) {
+      return false;
+    }
+    PointCloud2& layout = view.layout;
+    ShmDecodeBase(meta.base, layout.header);
+    layout.height = meta.height;
+    layout.width = meta.width;
+    layout.point_step = meta.point_step;
+    layout.row_step = meta.row_step;
+    layout.is_bigendian = meta.is_bigendian != 0;
+    layout.is_dense = meta.is_dense != 0;
+    layout.fields.resize(meta.field_count);
+    for (uint32_t i = 0; i < meta.field_count; ++i) {
+      ShmReadString(meta.fields[i].name, sizeof(meta.fields[i].name), layout.fields[i].name);
+      layout.fields[i].offset = meta.fields[i].offset;
+      layout.fields[i].count = meta.fields[i].count;
+      layout.fields[i].datatype = static_cast<int8_t>(meta.fields[i].datatype);
+    }
+    layout.data.clear();
+    view.data = in + sizeof(meta);
+    view.size = meta.data_bytes;
+    return true;
+  }
+};
+
+}  // namespace detail
+
+/**
+ * @class ShmStreamWriter
+ * @brief Publishes one sensor stream into a POSIX shared-memory ring of fixed-size slots.
+ *
+ * A relay process subscribes to each stream once and publishes it here; other local processes attach
+ * with ShmStreamReader instead of opening their own robot connection. Each message costs one copy into
+ * the ring. A stream has a single writer; SDK callbacks of one stream are already serialized.
+ *
+ * Example:
+ * @code
+ *   ShmStreamWriter depth;
+ *   depth.Open("/magicdog_rgbd_depth", ShmMessageType::IMAGE, 4, 640 * 480 * 2 + 4096);
+ *   controller.SubscribeRgbdDepthImage(depth.Callback<Image>());
+ * @endcode
+ */
+class ShmStreamWriter final : public NonCopyable {
+ public:
+  ShmStreamWriter() = default;
+
+  ~ShmStreamWriter() { Close(); }
+
+  /**
+   * @brief Create the shared-memory segment.
+   * @param name Segment name, starting with '/', e.g. "/magicdog_rgbd_depth".
+   * @param type Message type of the stream.
+   * @param slot_count Number of slots; readers lagging by more than slot_count - 1 messages skip ahead.
+   * @param slot_bytes Payload capacity of a slot, must hold the message data plus about 400 bytes of metadata.
+   * @param overwrite Replace an existing segment with the same name, e.g. one left behind by a crashed relay.
+   *                  Any writer still using it is silently cut off from its readers.
+   * @return Operation status; an error if the segment exists and overwrite is false.
+   */
+  Status Open(const std::string& name, ShmMessageType type, uint32_t slot_count, size_t slot_bytes, bool overwrite = false) {
+    Close();
+    if (slot_count < 2 || slot_bytes == 0) {
+      return {ErrorCode::INTERNAL_ERROR, "invalid shared-memory ring size"};
+    }
+    slot_stride_ = sizeof(detail::ShmSlotHeader) + detail::ShmAlignUp(slot_bytes);
+    size_ = sizeof(detail::ShmSegmentHeader) + slot_stride_ * slot_count;
+    if (overwrite) {
+      ::shm_unlink(name.c_str());
+    }
+    int fd = ::shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0 && errno == EEXIST) {
+      return {ErrorCode::SERVICE_ERROR, "shared memory already exists (open with overwrite to replace it): " + name};
+    }
+    if (fd < 0) {
+      return {ErrorCode::INTERNAL_ERROR, "cannot create shared memory: " + name};
+    }
+    if (::ftruncate(fd, static_cast<off_t>(size_)) != 0) {
+      ::close(fd);
+      ::shm_unlink(name.c_str());
+      return {ErrorCode::INTERNAL_ERROR, "cannot resize shared memory: " + name};
+    }
+    void* data = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+      ::shm_unlink(name.c_str());
+      return {ErrorCode::INTERNAL_ERROR, "cannot map shared memory: " + name};
+    }
+    base_ = static_cast<uint8_t*>(data);
+    name_ = name;
+    header_ = reinterpret_cast<detail::ShmSegmentHeader*>(base_);
+    header_->version = detail::kShmVersion;
+    header_->message_type = static_cast<uint32_t>(type);
+    header_->slot_count = slot_count;
+    header_->slot_bytes = slot_stride_ - sizeof(detail::ShmSlotHeader);
+    header_->write_index.store(0, std::memory_order_relaxed);
+    header_->magic.store(detail::kShmMagic, std::memory_order_release);
+    type_ = type;
+    return {ErrorCode::OK, ""};
+  }
+
+  /// Unmap and remove the segment; attached readers keep their mapping until they close
+  void Close() {
+    if (base_) {
+      ::munmap(base_, size_);
+      ::shm_unlink(name_.c_str());
+    }
+    base_ = nullptr;
+    header_ = nullptr;
+    size_ = 0;
+    name_.clear();
+  }
+
+  /// Whether the segment is open
+  bool IsOpen() const { return base_ != nullptr; }
+
+  /**
+   * @brief Copy a message into the next slot.
+   * @return false if the writer is closed, the type does not match the stream, the message exceeds the slot size or
+   *         a string field (frame_id, encoding, format, field name) exceeds its fixed size.
+   */
+  template <typename T>
+  bool Publish(const T& msg) {
+    using Traits = detail::ShmTraits<T>;
+    if (!base_ || Traits::kType != type_) {
+      return false;
+    }
+    if (!Traits::Fits(msg)) {
+      ++rejected_;
+      return false;
+    }
+    size_t payload = Traits::PayloadSize(msg);
+    if (payload > header_->slot_bytes) {
+      ++dropped_;
+      return false;
+    }
+    uint64_t index = header_->write_index.load(std::memory_order_relaxed);
+    uint8_t* slot_base = base_ + sizeof(detail::ShmSegmentHeader) + (index % header_->slot_count) * slot_stride_;
+    auto* slot = reinterpret_cast<detail::ShmSlotHeader*>(slot_base);
+    slot->sequence.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    Traits::Encode(msg, slot_base + sizeof(detail::ShmSlotHeader));
+    slot->payload_bytes = payload;
+    slot->sequence.store(2 * index + 2, std::memory_order_release);
+    header_->write_index.store(index + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Subscription callback publishing every received message.
+   * @note The writer must outlive the subscription.
+   */
+  template <typename T>
+  std::function<void(const std::shared_ptr<T>)> Callback() {
+    return [this](const std::shared_ptr<T> msg) {
+      if (msg) {
+        Publish(*msg);
+      }
+    };
+  }
+
+  /// Number of published messages
+  uint64_t PublishedCount() const { return header_ ? header_->write_index.load(std::memory_order_relaxed) : 0; }
+
+  /// Number of messages dropped because they did not fit in a slot
+  uint64_t DroppedCount() const { return dropped_; }
+
+  /// Number of messages rejected because a string field would have been truncated
+  uint64_t RejectedCount() const { return rejected_; }
+
+ private:
+  uint8_t* base_{nullptr};
+  detail::ShmSegmentHeader* header_{nullptr};
+  size_t size_{0};
+  size_t slot_stride_{0};
+  std::string name_;
+  ShmMessageType type_{ShmMessageType::IMAGE};
+  uint64_t dropped_{0};
+  uint64_t rejected_{0};
+};
+
+/**
+ * @class ShmStreamReader
+ * @brief Attaches to a ShmStreamWriter segment and reads messages in place.
+ *
+ * Views returned by Next/Latest point into the ring. The writer may reuse the slot once slot_count - 1 newer
+ * messages are published, so check IsCurrent() after processing a view and discard the result if it fails.
+ *
+ * Example:
+ * @code
+ *   ShmStreamReader reader;
+ *   reader.Open("/magicdog_rgbd_depth");
+ *   ShmImageView image;
+ *   while (reader.Next(image)) {
+ *     Process(image.data, image.size);
+ *     if (!reader.IsCurrent()) { ... }  // overwritten while processing
+ *   }
+ * @endcode
+ */
+class ShmStreamReader final : public NonCopyable {
+ public:
+  ShmStreamReader() = default;
+
+  ~ShmStreamReader() { Close(); }
+
+  /**
+   * @brief Map an existing segment read-only. Reading starts with the next message published after Open.
+   * @param name Segment name used by the writer.
+   * @return Operation status.
+   */
+  Status Open(const std::string& name) {
+    Close();
+    int fd = ::shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) {
+      return {ErrorCode::INTERNAL_ERROR, "cannot open shared memory: " + name};
+    }
+    struct stat st {};
+    if (::fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(detail::ShmSegmentHeader)) {
+      ::close(fd);
+      return {ErrorCode::INTERNAL_ERROR, "shared memory not initialized: " + name};
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    void* data = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+      size_ = 0;
+      return {ErrorCode::INTERNAL_ERROR, "cannot map shared memory: " + name};
+    }
+    base_ = static_cast<const uint8_t*>(data);
+    header_ = reinterpret_cast<const detail::ShmSegmentHeader*>(base_);
+    if (header_->magic.load(std::memory_order_acquire) != detail::kShmMagic || header_->version != detail::kShmVersion ||
+        header_->slot_count < 2 ||
+        size_ < sizeof(detail::ShmSegmentHeader) + (sizeof(detail::ShmSlotHeader) + header_->slot_bytes) * header_->slot_count) {
+      Close();
+      return {ErrorCode::INTERNAL_ERROR, "unsupported shared memory: " + name};
+    }
+    slot_stride_ = sizeof(detail::ShmSlotHeader) + header_->slot_bytes;
+    next_index_ = header_->write_index.load(std::memory_order_acquire);
+    return {ErrorCode::OK, ""};
+  }
+
+  /// Unmap the segment
+  void Close() {
+    if (base_) {
+      ::munmap(const_cast<uint8_t*>(base_), size_);
+    }
+    base_ = nullptr;
+    header_ = nullptr;
+    current_slot_ = nullptr;
+    size_ = 0;
+  }
+
+  /// Whether the segment is mapped
+  bool IsOpen() const { return base_ != nullptr; }
+
+  /// Message type of the stream
+  ShmMessageType GetMessageType() const { return static_cast<ShmMessageType>(header_->message_type); }
+
+  /**
+   * @brief Read the next unread message, skipping ahead if the reader fell behind the ring.
+   * @param[out] view View of the message, valid until the slot is reused.
+   * @return false if no new message is available or the view type does not match the stream.
+   */
+  template <typename View>
+  bool Next(View& view) {
+    using T = MessageOf<View>;
+    if (!base_ || detail::ShmTraits<T>::kType != GetMessageType()) {
+      return false;
+    }
+    while (true) {
+      uint64_t published = header_->write_index.load(std::memory_order_acquire);
+      if (next_index_ >= published) {
+        return false;
+      }
+      uint64_t oldest = published >= header_->slot_count ? published - header_->slot_count + 1 : 0;
+      if (next_index_ < oldest) {
+        overruns_ += oldest - next_index_;
+        next_index_ = oldest;
+      }
+      uint64_t index = next_index_++;
+      if (TryRead<T>(index, view)) {
+        return true;
+      }
+      ++overruns_;
+    }
+  }
+
+  /**
+   * @brief Read the newest published message, dropping any older unread ones.
+   * @return false if nothing was published since the last read or the view type does not match the stream.
+   */
+  template <typename View>
+  bool Latest(View& view) {
+    if (!base_) {
+      return false;
+    }
+    uint64_t published = header_->write_index.load(std::memory_order_acquire);
+    if (published > next_index_ + 1) {
+      next_index_ = published - 1;
+    }
+    return Next(view);
+  }
+
+  /// Whether the slot behind the last returned view has not been overwritten yet
+  bool IsCurrent() const {
+    if (!current_slot_) {
+      return false;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return current_slot_->sequence.load(std::memory_order_relaxed) == 2 * current_index_ + 2;
+  }
+
+  /// Number of messages the reader missed because the writer lapped it
+  uint64_t OverrunCount() const { return overruns_; }
+
+ private:
+  template <typename View>
+  using MessageOf = std::conditional_t<
+      std::is_same_v<View, ShmImageView>, Image,
+      std::conditional_t<std::is_same_v<View, ShmCompressedImageView>, CompressedImage,
+                         std::conditional_t<std::is_same_v<View, ShmLaserScanView>, LaserScan, PointCloud2>>>;
+
+  template <typename T, typename View>
+  bool TryRead(uint64_t index, View& view) {
+    const uint8_t* slot_base = base_ + sizeof(detail::ShmSegmentHeader) + (index % header_->slot_count) * slot_stride_;
+    const auto* slot = reinterpret_cast<const detail::ShmSlotHeader*>(slot_base);
+    uint64_t expected = 2 * index + 2;
+    if (slot->sequence.load(std::memory_order_acquire) != expected) {
+      return false;
+    }
+    size_t payload = std::min<uint64_t>(slot->payload_bytes, header_->slot_bytes);
+    if (!detail::ShmTraits<T>::Decode(slot_base + sizeof(detail::ShmSlotHeader), payload, view)) {
+      return false;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot->sequence.load(std::memory_order_relaxed) != expected) {
+      return false;
+    }
+    current_slot_ = slot;
+    current_index_ = index;
+    return true;
+  }
+
+  const uint8_t* base_{nullptr};
+  const detail::ShmSegmentHeader* header_{nullptr};
+  size_t size_{0};
+  size_t slot_stride_{0};
+  uint64_t next_index_{0};
+  uint64_t overruns_{0};
+  const detail::ShmSlotHeader* current_slot_{nullptr};
+  uint64_t current_index_{0};
+};
+
+}  // namespace magic::dog::sensor
@@ -0,0 +1,32 @@
+#pragma once
+
+// SIMD backend selection shared by the header-only processing kernels.
+// AVX2 is used when the translation unit is compiled with -mavx2 (x86_64),
+// NEON is always available on aarch64; everything else, including 32-bit ARM,
+// falls back to scalar code because the kernels use AArch64-only intrinsics.
+
+#if defined(__AVX2__)
+  #define MAGIC_SIMD_AVX2 1
+  #include <immintrin.h>
+#elif (defined(__ARM_NEON) || defined(__ARM_NEON__)) && defined(__aarch64__)
+  #define MAGIC_SIMD_NEON 1
+  #include <arm_neon.h>
+#endif
+
+namespace magic::dog {
+
+/**
+ * @brief Name of the SIMD backend the kernels were compiled with.
+ * @return "avx2", "neon" or "scalar".
+ */
+inline const char* SimdBackendName() {
+#if defined(MAGIC_SIMD_AVX2)
+  return "avx2";
+#elif defined(MAGIC_SIMD_NEON)
+  return "neon";
+#else
+  return "scalar";
+#endif
+}
+
+}  // namespace magic::dog
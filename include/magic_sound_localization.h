@@ -0,0 +1,563 @@
+#pragma once
+
+#include "magic_audio_ops.h"
+#include "magic_audio_ring.h"
+#include "magic_simd.h"
+#include "magic_type.h"
+#include "magic_worker_pool.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace magic::dog::audio {
+
+/**
+ * @brief Direction-of-arrival estimator parameters
+ */
+struct DoaConfig {
+  int32_t sample_rate = 48000;                      ///< Sample rate of the microphone planes (Hz)
+  std::vector<std::array<float, 3>> mic_positions;  ///< Microphone positions in the array frame (m), one per channel
+  int32_t frame_size = 1024;                        ///< FFT size (power of two)
+  float update_rate = 25.0f;                        ///< Estimates per second (Hz), 20 to 50 is typical
+  float min_frequency = 300.0f;                     ///< Lowest frequency used for GCC-PHAT (Hz)
+  float max_frequency = 5000.0f;                    ///< Highest frequency used for GCC-PHAT (Hz)
+  int32_t interpolation = 4;                        ///< Cross-correlation upsampling factor for sub-sample delays
+  float azimuth_step_deg = 2.0f;                    ///< Azimuth search grid step (deg)
+  float sound_speed = 343.0f;                       ///< Speed of sound (m/s)
+  float min_energy_db = -65.0f;                     ///< Below this input level (dBFS) the confidence is 0
+  int32_t threads = 0;                              ///< Worker threads including the caller, 0 for the hardware concurrency
+};
+
+/**
+ * @brief One direction-of-arrival estimate
+ */
+struct DoaEstimate {
+  int64_t timestamp = 0;    ///< Capture time of the middle of the analysed window (ns, system clock)
+  float azimuth = 0.0f;     ///< Source azimuth in the array frame (rad, [-pi, pi), counter-clockwise from +x)
+  float confidence = 0.0f;  ///< Mean GCC-PHAT coherence at the azimuth over all microphone pairs, [0, 1]
+  float energy_db = -120.0f;  ///< Input level of the window (dBFS)
+};
+
+/**
+ * @brief Microphone positions of a uniform circular array in the horizontal plane.
+ * @param count Number of microphones.
+ * @param radius Array radius (m).
+ * @param first_angle Azimuth of the first microphone (rad); the others follow counter-clockwise.
+ */
+inline std::vector<std::array<float, 3>> MakeCircularMicArray(int32_t count, float radius, float first_angle = 0.0f) {
+  std::vector<std::array<float, 3>> positions;
+  for (int32_t i = 0; i < count; ++i) {
+    double angle = first_angle + 2.0 * M_PI * i / count;
+    positions.push_back({static_cast<float>(radius * std::cos(angle)), static_cast<float>(radius * std::sin(angle)), 0.0f});
+  }
+  return positions;
+}
+
+namespace detail {
+
+/// b' = a - w * b, a' = a + w * b over n split-complex elements
+inline void FftButterfly(float* ar, float* ai, float* br, float* bi, const float* wr, const float* wi, size_t n) {
+  size_t k = 0;
+#if defined(MAGIC_SIMD_AVX2)
+  for (; k + 8 <= n; k += 8) {
+    __m256 xr = _mm256_loadu_ps(br + k);
+    __m256 xi = _mm256_loadu_ps(bi + k);
+    __m256 vwr = _mm256_loadu_ps(wr + k);
+    __m256 vwi = _mm256_loadu_ps(wi + k);
+    __m256 tr = _mm256_sub_ps(_mm256_mul_ps(vwr, xr), _mm256_mul_ps(vwi, xi));
+    __m256 ti = _mm256_add_ps(_mm256_mul_ps(vwr, xi), _mm256_mul_ps(vwi, xr));
+    __m256 yr = _mm256_loadu_ps(ar + k);
+    __m256 yi = _mm256_loadu_ps(ai + k);
+    _mm256_storeu_ps(br + k, _mm256_sub_ps(yr, tr));
+    _mm256_storeu_ps(bi + k, _mm256_sub_ps(yi, ti));
+    _mm256_storeu_ps(ar + k, _mm256_add_ps(yr, tr));
+    _mm256_storeu_ps(ai + k, _mm256_add_ps(yi, ti));
+  }
+#elif defined(MAGIC_SIMD_NEON)
+  for (; k + 4 <= n; k += 4) {
+    float32x4_t xr = vld1q_f32(br + k);
+    float32x4_t xi = vld1q_f32(bi + k);
+    float32x4_t vwr = vld1q_f32(wr + k);
+    float32x4_t vwi = vld1q_f32(wi + k);
+    float32x4_t tr = vsubq_f32(vmulq_f32(vwr, xr), vmulq_f32(vwi, xi));
+    float32x4_t ti = vaddq_f32(vmulq_f32(vwr, xi), vmulq_f32(vwi, xr));
+    float32x4_t yr = vld1q_f32(ar + k);
+    float32x4_t yi = vld1q_f32(ai + k);
+    vst1q_f32(br + k, vsubq_f32(yr, tr));
+    vst1q_f32(bi + k, vsubq_f32(yi, ti));
+    vst1q_f32(ar + k, vaddq_f32(yr, tr));
+    vst1q_f32(ai + k, vaddq_f32(yi, ti));
+  }
+#endif
+  for (; k < n; ++k) {
+    float tr = wr[k] * br[k] - wi[k] * bi[k];
+    float ti = wr[k] * bi[k] + wi[k] * br[k];
+    br[k] = ar[k] - tr;
+    bi[k] = ai[k] - ti;
+    ar[k] += tr;
+    ai[k] += ti;
+  }
+}
+
+/// In-place radix-2 complex FFT on split real/imaginary arrays
+class ComplexFft {
+ public:
+  explicit ComplexFft(size_t size = 2) : size_(size), reverse_(size), twiddle_re_(size), twiddle_im_(size) {
+    size_t bits = 0;
+    while ((size_t{1} << bits) < size) {
+      ++bits;
+    }
+    for (size_t i = 0; i < size; ++i) {
+      size_t r = 0;
+      for (size_t b = 0; b < bits; ++b) {
+        r |= ((i >> b) & 1) << (bits - 1 - b);
+      }
+      reverse_[i] = static_cast<uint32_t>(r);
+    }
+    // Stage with half-size h keeps exp(-i pi k / h), k < h, at offset h - 1
+    for (size_t h = 1; h < size; h <<= 1) {
+      for (size_t k = 0; k < h; ++k) {
+        twiddle_re_[h - 1 + k] = static_cast<float>(std::cos(M_PI * static_cast<double>(k) / static_cast<double>(h)));
+        twiddle_im_[h - 1 + k] = static_cast<float>(-std::sin(M_PI * static_cast<double>(k) / static_cast<double>(h)));
+      }
+    }
+  }
+
+  size_t Size() const { return size_; }
+
+  /// Forward transform (unscaled); the inverse is obtained by conjugating input and output
+  void Forward(float* re, float* im) const {
+    for (size_t i = 0; i < size_; ++i) {
+      size_t r = reverse_[i];
+      if (r > i) {
+        std::swap(re[i], re[r]);
+        std::swap(im[i], im[r]);
+      }
+    }
+    for (size_t h = 1; h < size_; h <<= 1) {
+      for (size_t j = 0; j < size_; j += 2 * h) {
+        FftButterfly(re + j, im + j, re + j + h, im + j + h, twiddle_re_.data() + h - 1, twiddle_im_.data() + h - 1, h);
+      }
+    }
+  }
+
+ private:
+  size_t size_;
+  std::vector<uint32_t> reverse_;
+  std::vector<float> twiddle_re_;
+  std::vector<float> twiddle_im_;
+};
+
+/// Real FFT of size n through a complex FFT of size n / 2; spectra hold n / 2 + 1 bins
+class RealFft {
+ public:
+  explicit RealFft(size_t size = 4) : size_(size), half_(size / 2), fft_(size / 2), work_re_(size / 2), work_im_(size / 2), w_re_(size / 2), w_im_(size / 2) {
+    for (size_t k = 0; k < half_; ++k) {
+      w_re_[k] = static_cast<float>(std::cos(2.0 * M_PI * static_cast<double>(k) / static_cast<double>(size)));
+      w_im_[k] = static_cast<float>(-std::sin(2.0 * M_PI * static_cast<double>(k) / static_cast<double>(size)));
+    }
+  }
+
+  size_t Size() const { return size_; }
+
+  /// Spectrum of x[0, n) into re/im[0, n / 2]
+  void Forward(const float* x, float* re, float* im) {
+    for (size_t k = 0; k < half_; ++k) {
+      work_re_[k] = x[2 * k];
+      work_im_[k] = x[2 * k + 1];
+    }
+    fft_.Forward(work_re_.data(), work_im_.data());
+    for (size_t k = 0; k <= half_; ++k) {
+      size_t a = k % half_;
+      size_t b = (half_ - k) % half_;
+      // Even part E = (A + conj(B)) / 2, odd part O = (A - conj(B)) / (2i)
+      float er = 0.5f * (work_re_[a] + work_re_[b]);
+      float ei = 0.5f * (work_im_[a] - work_im_[b]);
+      float or_ = 0.5f * (work_im_[a] + work_im_[b]);
+      float oi = -0.5f * (work_re_[a] - work_re_[b]);
+      float wr = k < half_ ? w_re_[k] : -1.0f;
+      float wi = k < half_ ? w_im_[k] : 0.0f;
+      re[k] = er + (wr * or_ - wi * oi);
+      im[k] = ei + (wr * oi + wi * or_);
+    }
+  }
+
+  /// Real signal x[0, n) from re/im[0, n / 2], scaled by 1 / n
+  void Inverse(const float* re, const float* im, float* x) {
+    for (size_t k = 0; k < half_; ++k) {
+      size_t b = half_ - k;
+      float er = 0.5f * (re[k] + re[b]);
+      float ei = 0.5f * (im[k] - im[b]);
+      float dr = 0.5f * (re[k] - re[b]);
+      float di = 0.5f * (im[k] + im[b]);
+      // O = D * conj(W^k), Z = E + i O; conjugated for the inverse through the forward transform
+      float or_ = dr * w_re_[k] + di * w_im_[k];
+      float oi = di * w_re_[k] - dr * w_im_[k];
+      work_re_[k] = er - oi;
+      work_im_[k] = -(ei + or_);
+    }
+    fft_.Forward(work_re_.data(), work_im_.data());
+    float scale = 1.0f / static_cast<float>(half_);
+    for (size_t k = 0; k < half_; ++k) {
+      x[2 * k] = work_re_[k] * scale;
+      x[2 * k + 1] = -work_im_[k] * scale;
+    }
+  }
+
+ private:
+  size_t size_;
+  size_t half_;
+  ComplexFft fft_;
+  std::vector<float> work_re_;
+  std::vector<float> work_im_;
+  std::vector<float> w_re_;
+  std::vector<float> w_im_;
+};
+
+/// acc += X * conj(Y) / |X * conj(Y)| over bins [begin, end)
+inline void PhatAccumulate(const float* xr, const float* xi, const float* yr, const float* yi, float* acc_re, float* acc_im, size_t begin, size_t end) {
+  size_t k = begin;
+#if defined(MAGIC_SIMD_AVX2)
+  const __m256 eps = _mm256_set1_ps(1e-20f);
+  for (; k + 8 <= end; k += 8) {
+    __m256 ar = _mm256_loadu_ps(xr + k);
+    __m256 ai = _mm256_loadu_ps(xi + k);
+    __m256 br = _mm256_loadu_ps(yr + k);
+    __m256 bi = _mm256_loadu_ps(yi + k);
+    __m256 cr = _mm256_add_ps(_mm256_mul_ps(ar, br), _mm256_mul_ps(ai, bi));
+    __m256 ci = _mm256_sub_ps(_mm256_mul_ps(ai, br), _mm256_mul_ps(ar, bi));
+    __m256 mag = _mm256_max_ps(_mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(cr, cr), _mm256_mul_ps(ci, ci))), eps);
+    _mm256_storeu_ps(acc_re + k, _mm256_add_ps(_mm256_loadu_ps(acc_re + k), _mm256_div_ps(cr, mag)));
+    _mm256_storeu_ps(acc_im + k, _mm256_add_ps(_mm256_loadu_ps(acc_im + k), _mm256_div_ps(ci, mag)));
+  }
+#elif defined(MAGIC_SIMD_NEON)
+  const float32x4_t eps = vdupq_n_f32(1e-20f);
+  for (; k + 4 <= end; k += 4) {
+    float32x4_t ar = vld1q_f32(xr + k);
+    float32x4_t ai = vld1q_f32(xi + k);
+    float32x4_t br = vld1q_f32(yr + k);
+    float32x4_t bi = vld1q_f32(yi + k);
+    float32x4_t cr = vaddq_f32(vmulq_f32(ar, br), vmulq_f32(ai, bi));
+    float32x4_t ci = vsubq_f32(vmulq_f32(ai, br), vmulq_f32(ar, bi));
+    float32x4_t mag = vmaxq_f32(vsqrtq_f32(vaddq_f32(vmulq_f32(cr, cr), vmulq_f32(ci, ci))), eps);
+    vst1q_f32(acc_re + k, vaddq_f32(vld1q_f32(acc_re + k), vdivq_f32(cr, mag)));
+    vst1q_f32(acc_im + k, vaddq_f32(vld1q_f32(acc_im + k), vdivq_f32(ci, mag)));
+  }
+#endif
+  for (; k < end; ++k) {
+    float cr = xr[k] * yr[k] + xi[k] * yi[k];
+    float ci = xi[k] * yr[k] - xr[k] * yi[k];
+    float mag = std::max(std::sqrt(cr * cr + ci * ci), 1e-20f);
+    acc_re[k] += cr / mag;
+    acc_im[k] += ci / mag;
+  }
+}
+
+}  // namespace detail
+
+/**
+ * @class DoaEstimator
+ * @brief Continuous sound source direction estimation from the raw microphone array with GCC-PHAT.
+ *
+ * Every update period the incoming planes are cut into overlapping Hann-windowed frames. All frames of all
+ * channels are transformed in one batch, the PHAT-weighted cross-spectra of every microphone pair are averaged
+ * over the batch and transformed back to upsampled cross-correlations, and a steered response search over the
+ * azimuth grid picks the direction whose far-field pair delays best match. Channel FFTs and pair correlations run
+ * on a worker pool. Estimates are published at update_rate with the capture time of the analysed window.
+ *
+ * The microphone geometry of the array has to be supplied; the channel order of the planes must match it.
+ *
+ * Example:
+ * @code
+ *   DoaConfig config;
+ *   config.mic_positions = MakeCircularMicArray(6, 0.035f);
+ *   DoaEstimator doa;
+ *   doa.Configure(config);
+ *   doa.SetDoaCallback([](const DoaEstimate& estimate) {
+ *     if (estimate.confidence > 0.3f) { TurnToward(estimate.azimuth); }
+ *   });
+ *   controller.SubscribeOriginVoiceData(doa.Callback());
+ * @endcode
+ */
+class DoaEstimator final : public NonCopyable {
+ public:
+  using DoaCallback = std::function<void(const DoaEstimate&)>;
+  using ByteMultiArrayCallback = std::function<void(const std::shared_ptr<ByteMultiArray>)>;
+
+  DoaEstimator() = default;
+
+  /**
+   * @brief Apply parameters and precompute FFT plans and delay tables (must not race with Process).
+   * @return false if fewer than two microphones are given or a parameter is out of range.
+   */
+  bool Configure(const DoaConfig& config) {
+    size_t mics = config.mic_positions.size();
+    int32_t n = config.frame_size;
+    if (mics < 2 || n < 64 || (n & (n - 1)) != 0 || config.sample_rate <= 0 || config.update_rate <= 0.0f ||
+        config.interpolation < 1 || (config.interpolation & (config.interpolation - 1)) != 0 || config.azimuth_step_deg <= 0.0f) {
+      return false;
+    }
+    config_ = config;
+    bins_ = static_cast<size_t>(n) / 2 + 1;
+    int64_t period = std::max<int64_t>(1, std::llround(static_cast<float>(config.sample_rate) / config.update_rate));
+    frames_per_update_ = std::max<int64_t>(1, std::llround(static_cast<double>(period) / static_cast<double>(n / 2)));
+    hop_ = std::max<int64_t>(1, period / frames_per_update_);
+    band_begin_ = std::clamp<size_t>(static_cast<size_t>(std::ceil(config.min_frequency * static_cast<float>(n) / static_cast<float>(config.sample_rate))), 1, bins_ - 1);
+    band_end_ = std::clamp<size_t>(static_cast<size_t>(std::floor(config.max_frequency * static_cast<float>(n) / static_cast<float>(config.sample_rate))) + 1, band_begin_ + 1, bins_ - 1);
+
+    window_.resize(static_cast<size_t>(n));
+    for (int32_t i = 0; i < n; ++i) {
+      window_[i] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * M_PI * i / n));
+    }
+    forward_.clear();
+    for (size_t c = 0; c < mics; ++c) {
+      forward_.push_back(std::make_unique<detail::RealFft>(static_cast<size_t>(n)));
+    }
+    pairs_.clear();
+    for (size_t i = 0; i < mics; ++i) {
+      for (size_t j = i + 1; j < mics; ++j) {
+        pairs_.push_back({i, j});
+      }
+    }
+    correlation_size_ = static_cast<size_t>(n) * config.interpolation;
+    inverse_.clear();
+    for (size_t p = 0; p < pairs_.size(); ++p) {
+      inverse_.push_back(std::make_unique<detail::RealFft>(correlation_size_));
+    }
+    BuildDelayTable();
+
+    spectra_re_.assign(mics, std::vector<float>(frames_per_update_ * bins_));
+    spectra_im_.assign(mics, std::vector<float>(frames_per_update_ * bins_));
+    frame_buffers_.assign(mics, std::vector<float>(static_cast<size_t>(n)));
+    correlations_.assign(pairs_.size(), std::vector<float>(correlation_size_));
+    pair_re_.assign(pairs_.size(), std::vector<float>(correlation_size_ / 2 + 1));
+    pair_im_.assign(pairs_.size(), std::vector<float>(correlation_size_ / 2 + 1));
+    converter_ = std::make_unique<VoiceStreamConverter>(VoiceStreamConfig{config.sample_rate, config.sample_rate, 1.0f, static_cast<int32_t>(mics)});
+    pool_ = std::make_unique<WorkerPool>(config.threads > 0 ? static_cast<size_t>(config.threads) : std::min<size_t>(mics, std::max(1u, std::thread::hardware_concurrency())));
+    clock_ = detail::SampleClock(config.sample_rate);
+    Reset();
+    return true;
+  }
+
+  /// Set the callback receiving estimates; it runs on the thread calling Process
+  void SetDoaCallback(const DoaCallback callback) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    callback_ = callback;
+  }
+
+  /**
+   * @brief Feed the next block of per-channel samples.
+   * @param planes One float plane per microphone at the configured sample rate, all of the same length.
+   * @param arrival_time Time the block was received (ns, system clock), 0 for now.
+   * @return false if not configured or the channel count does not match the geometry.
+   */
+  bool Process(const std::vector<std::vector<float>>& planes, int64_t arrival_time = 0) {
+    if (pending_.empty() || planes.size() != pending_.size()) {
+      return false;
+    }
+    size_t count = planes[0].size();
+    for (size_t c = 0; c < planes.size(); ++c) {
+      if (planes[c].size() != count) {
+        return false;
+      }
+      pending_[c].insert(pending_[c].end(), planes[c].begin(), planes[c].end());
+    }
+    received_ += static_cast<int64_t>(count);
+    clock_.Update(received_, arrival_time != 0 ? arrival_time : detail::AudioNowNs());
+    size_t window = static_cast<size_t>(config_.frame_size) + static_cast<size_t>((frames_per_update_ - 1) * hop_);
+    size_t period = static_cast<size_t>(frames_per_update_ * hop_);
+    while (pending_[0].size() >= window) {
+      DoaEstimate estimate = Estimate();
+      estimate.timestamp = clock_.TimeAt(consumed_ + static_cast<int64_t>(window / 2));
+      for (auto& plane : pending_) {
+        plane.erase(plane.begin(), plane.begin() + period);
+      }
+      consumed_ += static_cast<int64_t>(period);
+      Publish(estimate);
+    }
+    return true;
+  }
+
+  /// Feed one raw voice message; its layout must carry one channel per microphone
+  bool Process(const ByteMultiArray& msg, int64_t arrival_time = 0) {
+    if (!converter_ || !converter_->Process(msg, planes_)) {
+      return false;
+    }
+    return Process(planes_, arrival_time);
+  }
+
+  /**
+   * @brief Callback suitable for SubscribeOriginVoiceData.
+   * @note The estimator must be configured and outlive the subscription.
+   */
+  ByteMultiArrayCallback Callback() {
+    return [this](const std::shared_ptr<ByteMultiArray> msg) {
+      if (msg) {
+        Process(*msg);
+      }
+    };
+  }
+
+  /// Latest estimate, false if none has been produced yet
+  bool GetLatestEstimate(DoaEstimate& estimate) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    estimate = latest_;
+    return has_latest_;
+  }
+
+  /// Drop buffered audio and the sample clock
+  void Reset() {
+    pending_.assign(config_.mic_positions.size(), {});
+    received_ = 0;
+    consumed_ = 0;
+    clock_.Reset();
+    std::lock_guard<std::mutex> lock(mutex_);
+    has_latest_ = false;
+  }
+
+ private:
+  // Nearest upsampled correlation index of every pair delay for every grid azimuth
+  void BuildDelayTable() {
+    azimuths_ = std::max<size_t>(1, static_cast<size_t>(std::lround(360.0 / config_.azimuth_step_deg)));
+    delay_index_.resize(pairs_.size() * azimuths_);
+    double samples_per_meter = static_cast<double>(config_.sample_rate) * config_.interpolation / config_.sound_speed;
+    for (size_t a = 0; a < azimuths_; ++a) {
+      double angle = 2.0 * M_PI * static_cast<double>(a) / static_cast<double>(azimuths_);
+      double ux = std::cos(angle);
+      double uy = std::sin(angle);
+      for (size_t p = 0; p < pairs_.size(); ++p) {
+        const auto& pi = config_.mic_positions[pairs_[p].first];
+        const auto& pj = config_.mic_positions[pairs_[p].second];
+        // Microphone i hears a source in direction u (pj - pi) . u / c later than microphone j
+        double lag = ((pj[0] - pi[0]) * ux + (pj[1] - pi[1]) * uy) * samples_per_meter;
+        int64_t index = std::llround(lag) % static_cast<int64_t>(correlation_size_);
+        delay_index_[p * azimuths_ + a] = static_cast<uint32_t>(index < 0 ? index + static_cast<int64_t>(correlation_size_) : index);
+      }
+    }
+  }
+
+  DoaEstimate Estimate() {
+    size_t n = static_cast<size_t>(config_.frame_size);
+    size_t channels = pending_.size();
+    double energy = 0.0;
+    pool_->ParallelFor(channels, [&](size_t c) {
+      std::vector<float>& frame = frame_buffers_[c];
+      for (int64_t f = 0; f < frames_per_update_; ++f) {
+        const float* in = pending_[c].data() + f * hop_;
+        for (size_t i = 0; i < n; ++i) {
+          frame[i] = in[i] * window_[i];
+        }
+        forward_[c]->Forward(frame.data(), spectra_re_[c].data() + f * bins_, spectra_im_[c].data() + f * bins_);
+      }
+      if (c == 0) {
+        size_t length = static_cast<size_t>(frames_per_update_ * hop_);
+        double sum = 0.0;
+        for (size_t i = 0; i < length; ++i) {
+          sum += static_cast<double>(pending_[0][i]) * pending_[0][i];
+        }
+        energy = sum / static_cast<double>(length);
+      }
+    });
+
+    // Band-limited PHAT cross-spectra averaged over the batch, normalised so a fully coherent pair peaks at 1
+    float scale = static_cast<float>(correlation_size_) / (2.0f * static_cast<float>(band_end_ - band_begin_) * static_cast<float>(frames_per_update_));
+    pool_->ParallelFor(pairs_.size(), [&](size_t p) {
+      std::vector<float>& re = pair_re_[p];
+      std::vector<float>& im = pair_im_[p];
+      std::fill(re.begin(), re.end(), 0.0f);
+      std::fill(im.begin(), im.end(), 0.0f);
+      size_t i = pairs_[p].first;
+      size_t j = pairs_[p].second;
+      for (int64_t f = 0; f < frames_per_update_; ++f) {
+        size_t offset = static_cast<size_t>(f) * bins_;
+        detail::PhatAccumulate(spectra_re_[i].data() + offset, spectra_im_[i].data() + offset, spectra_re_[j].data() + offset,
+                               spectra_im_[j].data() + offset, re.data(), im.data(), band_begin_, band_end_);
+      }
+      for (size_t k = band_begin_; k < band_end_; ++k) {
+        re[k] *= scale;
+        im[k] *= scale;
+      }
+      inverse_[p]->Inverse(re.data(), im.data(), correlations_[p].data());
+    });
+
+    DoaEstimate estimate;
+    estimate.energy_db = static_cast<float>(10.0 * std::log10(std::max(energy, 1e-12)));
+    std::vector<float>& scores = scores_;
+    scores.assign(azimuths_, 0.0f);
+    for (size_t p = 0; p < pairs_.size(); ++p) {
+      const float* correlation = correlations_[p].data();
+      const uint32_t* index = delay_index_.data() + p * azimuths_;
+      for (size_t a = 0; a < azimuths_; ++a) {
+        scores[a] += correlation[index[a]];
+      }
+    }
+    size_t best = static_cast<size_t>(std::max_element(scores.begin(), scores.end()) - scores.begin());
+    // Parabolic refinement on the circular grid
+    float left = scores[(best + azimuths_ - 1) % azimuths_];
+    float right = scores[(best + 1) % azimuths_];
+    float denom = left - 2.0f * scores[best] + right;
+    double offset = std::abs(denom) > 1e-12f ? std::clamp(0.5f * (left - right) / denom, -0.5f, 0.5f) : 0.0f;
+    double azimuth = 2.0 * M_PI * (static_cast<double>(best) + offset) / static_cast<double>(azimuths_);
+    estimate.azimuth = static_cast<float>(std::remainder(azimuth, 2.0 * M_PI));
+    if (estimate.azimuth >= static_cast<float>(M_PI)) {
+      estimate.azimuth = -static_cast<float>(M_PI);
+    }
+    estimate.confidence = estimate.energy_db < config_.min_energy_db ? 0.0f : std::clamp(scores[best] / static_cast<float>(pairs_.size()), 0.0f, 1.0f);
+    return estimate;
+  }
+
+  void Publish(const DoaEstimate& estimate) {
+    DoaCallback callback;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      latest_ = estimate;
+      has_latest_ = true;
+      callback = callback_;
+    }
+    if (callback) {
+      callback(estimate);
+    }
+  }
+
+  DoaConfig config_;
+  size_t bins_{0};
+  int64_t frames_per_update_{1};
+  int64_t hop_{1};
+  size_t band_begin_{1};
+  size_t band_end_{2};
+  size_t correlation_size_{0};
+  size_t azimuths_{0};
+  std::vector<float> window_;
+  std::vector<std::pair<size_t, size_t>> pairs_;
+  std::vector<uint32_t> delay_index_;
+  std::vector<std::unique_ptr<detail::RealFft>> forward_;
+  std::vector<std::unique_ptr<detail::RealFft>> inverse_;
+  std::vector<std::vector<float>> frame_buffers_;
+  std::vector<std::vector<float>> spectra_re_;
+  std::vector<std::vector<float>> spectra_im_;
+  std::vector<std::vector<float>> pair_re_;
+  std::vector<std::vector<float>> pair_im_;
+  std::vector<std::vector<float>> correlations_;
+  std::vector<float> scores_;
+  std::vector<std::vector<float>> pending_;
+  std::vector<std::vector<float>> planes_;
+  std::unique_ptr<VoiceStreamConverter> converter_;
+  std::unique_ptr<WorkerPool> pool_;
+  detail::SampleClock clock_;
+  int64_t received_{0};
+  int64_t consumed_{0};
+  mutable std::mutex mutex_;
+  DoaCallback callback_;
+  DoaEstimate latest_;
+  bool has_latest_{false};
+};
+
+}  // namespace magic::dog::audio
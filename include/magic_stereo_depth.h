@@ -0,0 +1,785 @@
+#pragma once
+
+#include "magic_image_ops.h"
+#include "magic_simd.h"
+#include "magic_topic_stats.h"
+#include "magic_type.h"
+#include "magic_worker_pool.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace magic::dog::sensor {
+
+/**
+ * @brief Matching cost used by StereoMatcher
+ */
+enum class StereoCost : uint8_t {
+  SAD = 0,     ///< Sum of absolute intensity differences, cheapest, sensitive to exposure differences
+  CENSUS = 1,  ///< Hamming distance of 5x5 census signatures, robust to gain and exposure differences
+};
+
+/**
+ * @brief Content of the image produced by StereoMatcher
+ */
+enum class StereoOutput : uint8_t {
+  DISPARITY = 0,  ///< "32FC1" disparity in pixels
+  DEPTH = 1,      ///< "32FC1" depth in meters along the rectified left optical axis, requires calibration
+};
+
+/**
+ * @brief Block matching parameters
+ */
+struct StereoConfig {
+  int32_t num_disparities = 64;             ///< Disparity search range, rounded up to a multiple of 16, at most 256
+  int32_t block_size = 9;                   ///< Odd matching window side, 3 to 15
+  StereoCost cost = StereoCost::CENSUS;     ///< Matching cost
+  int32_t uniqueness_ratio = 10;            ///< Percent by which the best cost must beat any non-adjacent disparity
+  StereoOutput output = StereoOutput::DISPARITY;
+  size_t threads = 0;                       ///< Worker threads including the caller, 0 for the hardware concurrency
+};
+
+/**
+ * @brief Processing time of the last stereo frame
+ */
+struct StereoTiming {
+  double rectify_ms = 0.0;  ///< Grayscale conversion and rectification of both images
+  double match_ms = 0.0;    ///< Cost computation, aggregation and disparity selection
+  double total_ms = 0.0;    ///< Whole Compute call
+};
+
+namespace detail {
+
+/// Bilinear remap of one row; offsets index the top-left source pixel, weights are 5-bit x/y fractions, -1 marks
+/// destinations outside the source image
+inline void RemapRow(const uint8_t* src, int32_t src_step, const int32_t* offsets, const uint8_t* weights, int32_t width, uint8_t* dst) {
+  for (int32_t x = 0; x < width; ++x) {
+    int32_t offset = offsets[x];
+    if (offset < 0) {
+      dst[x] = 0;
+      continue;
+    }
+    const uint8_t* p = src + offset;
+    uint32_t fx = weights[2 * x];
+    uint32_t fy = weights[2 * x + 1];
+    uint32_t top = p[0] * (32 - fx) + p[1] * fx;
+    uint32_t bottom = p[src_step] * (32 - fx) + p[src_step + 1] * fx;
+    dst[x] = static_cast<uint8_t>((top * (32 - fy) + bottom * fy + 512) >> 10);
+  }
+}
+
+/// 5x5 census signature of row y (2 <= y < height - 2); bit k is set when the k-th neighbour in row-major order
+/// is darker than the centre. Border columns get 0.
+inline void CensusRow(const uint8_t* image, int32_t width, int32_t y, uint32_t* out) {
+  const uint8_t* rows[5];
+  for (int32_t i = 0; i < 5; ++i) {
+    rows[i] = image + static_cast<size_t>(y - 2 + i) * width;
+  }
+  out[0] = out[1] = 0;
+  int32_t x = 2;
+#if defined(MAGIC_SIMD_AVX2)
+  const __m128i zero = _mm_setzero_si128();
+  for (; x + 18 <= width; x += 16) {
+    const __m128i center = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[2] + x));
+    __m128i planes[3] = {zero, zero, zero};
+    int32_t k = 0;
+    for (int32_t dy = 0; dy < 5; ++dy) {
+      for (int32_t dx = -2; dx <= 2; ++dx) {
+        if (dy == 2 && dx == 0) {
+          continue;
+        }
+        __m128i n = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[dy] + x + dx));
+        __m128i not_darker = _mm_cmpeq_epi8(_mm_subs_epu8(center, n), zero);
+        planes[k >> 3] = _mm_or_si128(planes[k >> 3], _mm_andnot_si128(not_darker, _mm_set1_epi8(static_cast<char>(1 << (k & 7)))));
+        ++k;
+      }
+    }
+    __m128i p01_lo = _mm_unpacklo_epi8(planes[0], planes[1]);
+    __m128i p01_hi = _mm_unpackhi_epi8(planes[0], planes[1]);
+    __m128i p2_lo = _mm_unpacklo_epi8(planes[2], zero);
+    __m128i p2_hi = _mm_unpackhi_epi8(planes[2], zero);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), _mm_unpacklo_epi16(p01_lo, p2_lo));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x + 4), _mm_unpackhi_epi16(p01_lo, p2_lo));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x + 8), _mm_unpacklo_epi16(p01_hi, p2_hi));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x + 12), _mm_unpackhi_epi16(p01_hi, p2_hi));
+  }
+#elif defined(MAGIC_SIMD_NEON)
+  for (; x + 18 <= width; x += 16) {
+    const uint8x16_t center = vld1q_u8(rows[2] + x);
+    uint8x16x4_t planes = {{vdupq_n_u8(0), vdupq_n_u8(0), vdupq_n_u8(0), vdupq_n_u8(0)}};
+    int32_t k = 0;
+    for (int32_t dy = 0; dy < 5; ++dy) {
+      for (int32_t dx = -2; dx <= 2; ++dx) {
+        if (dy == 2 && dx == 0) {
+          continue;
+        }
+        uint8x16_t darker = vcltq_u8(vld1q_u8(rows[dy] + x + dx), center);
+        planes.val[k >> 3] = vorrq_u8(planes.val[k >> 3], vandq_u8(darker, vdupq_n_u8(static_cast<uint8_t>(1 << (k & 7)))));
+        ++k;
+      }
+    }
+    vst4q_u8(reinterpret_cast<uint8_t*>(out + x), planes);
+  }
+#endif
+  for (; x < width - 2; ++x) {
+    uint8_t center = rows[2][x];
+    uint32_t signature = 0;
+    int32_t k = 0;
+    for (int32_t dy = 0; dy < 5; ++dy) {
+      for (int32_t dx = -2; dx <= 2; ++dx) {
+        if (dy == 2 && dx == 0) {
+          continue;
+        }
+        signature |= static_cast<uint32_t>(rows[dy][x + dx] < center) << k;
+        ++k;
+      }
+    }
+    out[x] = signature;
+  }
+  for (; x < width; ++x) {
+    out[x] = 0;
+  }
+}
+
+/// Per-pixel SAD cost of one row for all disparities; right_reversed holds the right row mirrored and padded
+/// with num_disp zeros, so disparities of one pixel are contiguous
+inline void SadCostRow(const uint8_t* left, const uint8_t* right_reversed, int32_t width, int32_t num_disp, uint8_t* cost) {
+  for (int32_t x = 0; x < width; ++x) {
+    const uint8_t* r = right_reversed + (width - 1 - x);
+    uint8_t* c = cost + static_cast<size_t>(x) * num_disp;
+    int32_t d = 0;
+#if defined(MAGIC_SIMD_AVX2)
+    const __m256i l = _mm256_set1_epi8(static_cast<char>(left[x]));
+    for (; d + 32 <= num_disp; d += 32) {
+      __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(r + d));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(c + d), _mm256_or_si256(_mm256_subs_epu8(l, v), _mm256_subs_epu8(v, l)));
+    }
+    for (; d + 16 <= num_disp; d += 16) {
+      __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r + d));
+      __m128i l128 = _mm256_castsi256_si128(l);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(c + d), _mm_or_si128(_mm_subs_epu8(l128, v), _mm_subs_epu8(v, l128)));
+    }
+#elif defined(MAGIC_SIMD_NEON)
+    const uint8x16_t l = vdupq_n_u8(left[x]);
+    for (; d + 16 <= num_disp; d += 16) {
+      vst1q_u8(c + d, vabdq_u8(l, vld1q_u8(r + d)));
+    }
+#endif
+    for (; d < num_disp; ++d) {
+      c[d] = static_cast<uint8_t>(left[x] > r[d] ? left[x] - r[d] : r[d] - left[x]);
+    }
+  }
+}
+
+/// Per-pixel census cost (Hamming distance) of one row for all disparities, layout as in SadCostRow
+inline void CensusCostRow(const uint32_t* left, const uint32_t* right_reversed, int32_t width, int32_t num_disp, uint8_t* cost) {
+#if defined(MAGIC_SIMD_AVX2)
+  const __m256i nibble_counts = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+  const __m256i low_nibble = _mm256_set1_epi8(0x0F);
+  const __m256i ones8 = _mm256_set1_epi8(1);
+  const __m256i ones16 = _mm256_set1_epi16(1);
+  auto popcount32 = [&](__m256i v) {
+    __m256i lo = _mm256_shuffle_epi8(nibble_counts, _mm256_and_si256(v, low_nibble));
+    __m256i hi = _mm256_shuffle_epi8(nibble_counts, _mm256_and_si256(_mm256_srli_epi16(v, 4), low_nibble));
+    return _mm256_madd_epi16(_mm256_maddubs_epi16(_mm256_add_epi8(lo, hi), ones8), ones16);
+  };
+#endif
+  for (int32_t x = 0; x < width; ++x) {
+    const uint32_t* r = right_reversed + (width - 1 - x);
+    uint8_t* c = cost + static_cast<size_t>(x) * num_disp;
+    int32_t d = 0;
+#if defined(MAGIC_SIMD_AVX2)
+    const __m256i l = _mm256_set1_epi32(static_cast<int32_t>(left[x]));
+    for (; d + 16 <= num_disp; d += 16) {
+      __m256i a = popcount32(_mm256_xor_si256(l, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(r + d))));
+      __m256i b = popcount32(_mm256_xor_si256(l, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(r + d + 8))));
+      __m256i words = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xD8);
+      __m128i bytes = _mm_packus_epi16(_mm256_castsi256_si128(words), _mm256_extracti128_si256(words, 1));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(c + d), bytes);
+    }
+#elif defined(MAGIC_SIMD_NEON)
+    const uint32x4_t l = vdupq_n_u32(left[x]);
+    for (; d + 16 <= num_disp; d += 16) {
+      uint32x4_t counts[4];
+      for (int32_t i = 0; i < 4; ++i) {
+        uint8x16_t bits = vcntq_u8(vreinterpretq_u8_u32(veorq_u32(l, vld1q_u32(r + d + 4 * i))));
+        counts[i] = vpaddlq_u16(vpaddlq_u8(bits));
+      }
+      uint16x8_t lo = vcombine_u16(vmovn_u32(counts[0]), vmovn_u32(counts[1]));
+      uint16x8_t hi = vcombine_u16(vmovn_u32(counts[2]), vmovn_u32(counts[3]));
+      vst1q_u8(c + d, vcombine_u8(vmovn_u16(lo), vmovn_u16(hi)));
+    }
+#endif
+    for (; d < num_disp; ++d) {
+      c[d] = static_cast<uint8_t>(__builtin_popcount(left[x] ^ r[d]));
+    }
+  }
+}
+
+/// sums += add - sub, widening the 8-bit per-pixel costs; sub may be null
+inline void UpdateColumnSums(uint16_t* sums, const uint8_t* add, const uint8_t* sub, size_t n) {
+  size_t i = 0;
+#if defined(MAGIC_SIMD_AVX2)
+  for (; sub && i + 16 <= n; i += 16) {
+    __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sums + i));
+    __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(add + i)));
+    __m256i b = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(sub + i)));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(sums + i), _mm256_sub_epi16(_mm256_add_epi16(s, a), b));
+  }
+#elif defined(MAGIC_SIMD_NEON)
+  for (; sub && i + 16 <= n; i += 16) {
+    uint8x16_t a = vld1q_u8(add + i);
+    uint8x16_t b = vld1q_u8(sub + i);
+    vst1q_u16(sums + i, vsubw_u8(vaddw_u8(vld1q_u16(sums + i), vget_low_u8(a)), vget_low_u8(b)));
+    vst1q_u16(sums + i + 8, vsubw_u8(vaddw_u8(vld1q_u16(sums + i + 8), vget_high_u8(a)), vget_high_u8(b)));
+  }
+#endif
+  for (; i < n; ++i) {
+    sums[i] = static_cast<uint16_t>(sums[i] + add[i] - (sub ? sub[i] : 0));
+  }
+}
+
+/// box += add - sub over one pixel's disparities; sub may be null
+inline void SlideBox(uint16_t* box, const uint16_t* add, const uint16_t* sub, int32_t n) {
+  int32_t i = 0;
+#if defined(MAGIC_SIMD_AVX2)
+  for (; sub && i + 16 <= n; i += 16) {
+    __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(box + i));
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(add + i));
+    __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sub + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(box + i), _mm256_sub_epi16(_mm256_add_epi16(b, a), s));
+  }
+#elif defined(MAGIC_SIMD_NEON)
+  for (; sub && i + 8 <= n; i += 8) {
+    vst1q_u16(box + i, vsubq_u16(vaddq_u16(vld1q_u16(box + i), vld1q_u16(add + i)), vld1q_u16(sub + i)));
+  }
+#endif
+  for (; i < n; ++i) {
+    box[i] = static_cast<uint16_t>(box[i] + add[i] - (sub ? sub[i] : 0));
+  }
+}
+
+/**
+ * Winner-takes-all over disparities 0..max_disp with a uniqueness test and parabolic sub-pixel refinement.
+ * Returns 0 when no disparity is unique enough.
+ */
+inline float SelectDisparity(const uint16_t* cost, int32_t num_disp, int32_t max_disp, uint32_t uniqueness_ratio) {
+  uint32_t best = 0xFFFF;
+  int32_t best_d = -1;
+  bool ambiguous = false;
+#if defined(MAGIC_SIMD_AVX2)
+  // Disparities beyond max_disp are masked to 0xFFFF, a value real costs never reach
+  const __m256i limit_d = _mm256_set1_epi16(static_cast<int16_t>(max_disp));
+  __m256i lanes = _mm256_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+  __m256i blocks[16];
+  int32_t count = num_disp / 16;
+  __m256i minimum = _mm256_set1_epi16(-1);
+  for (int32_t k = 0; k < count; ++k) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cost + 16 * k));
+    blocks[k] = _mm256_or_si256(v, _mm256_cmpgt_epi16(lanes, limit_d));
+    minimum = _mm256_min_epu16(minimum, blocks[k]);
+    lanes = _mm256_add_epi16(lanes, _mm256_set1_epi16(16));
+  }
+  __m128i half = _mm_min_epu16(_mm256_castsi256_si128(minimum), _mm256_extracti128_si256(minimum, 1));
+  best = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_minpos_epu16(half))) & 0xFFFF;
+  if (best == 0xFFFF) {
+    return 0.0f;
+  }
+  const __m256i best_v = _mm256_set1_epi16(static_cast<int16_t>(best));
+  for (int32_t k = 0; k < count; ++k) {
+    uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi16(blocks[k], best_v)));
+    if (mask != 0) {
+      best_d = 16 * k + __builtin_ctz(mask) / 2;
+      break;
+    }
+  }
+  uint32_t limit = std::min<uint32_t>(best + best * uniqueness_ratio / 100, 0xFFFE);
+  const __m256i limit_v = _mm256_set1_epi16(static_cast<int16_t>(limit));
+  for (int32_t k = 0; k < count && !ambiguous; ++k) {
+    uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi16(_mm256_min_epu16(blocks[k], limit_v), blocks[k])));
+    for (int32_t d = std::max(best_d - 1, 16 * k); d <= std::min(best_d + 1, 16 * k + 15); ++d) {
+      mask &= ~(3u << (2 * (d - 16 * k)));
+    }
+    ambiguous = mask != 0;
+  }
+#elif defined(MAGIC_SIMD_NEON)
+  const uint16x8_t limit_d = vdupq_n_u16(static_cast<uint16_t>(max_disp));
+  const uint16x8_t step = vdupq_n_u16(8);
+  static const uint16_t kLanes[8] = {0, 1, 2, 3, 4, 5, 6, 7};
+  uint16x8_t lanes = vld1q_u16(kLanes);
+  uint16x8_t blocks[32];
+  int32_t count = num_disp / 8;
+  uint16x8_t minimum = vdupq_n_u16(0xFFFF);
+  for (int32_t k = 0; k < count; ++k) {
+    blocks[k] = vorrq_u16(vld1q_u16(cost + 8 * k), vcgtq_u16(lanes, limit_d));
+    minimum = vminq_u16(minimum, blocks[k]);
+    lanes = vaddq_u16(lanes, step);
+  }
+  best = vminvq_u16(minimum);
+  if (best == 0xFFFF) {
+    return 0.0f;
+  }
+  const uint16x8_t best_v = vdupq_n_u16(static_cast<uint16_t>(best));
+  for (int32_t k = 0; k < count; ++k) {
+    uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vceqq_u16(blocks[k], best_v), 4)), 0);
+    if (mask != 0) {
+      best_d = 8 * k + __builtin_ctzll(mask) / 8;
+      break;
+    }
+  }
+  uint32_t limit = std::min<uint32_t>(best + best * uniqueness_ratio / 100, 0xFFFE);
+  const uint16x8_t limit_v = vdupq_n_u16(static_cast<uint16_t>(limit));
+  for (int32_t k = 0; k < count && !ambiguous; ++k) {
+    uint64_t mask = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vcleq_u16(blocks[k], limit_v), 4)), 0);
+    for (int32_t d = std::max(best_d - 1, 8 * k); d <= std::min(best_d + 1, 8 * k + 7); ++d) {
+      mask &= ~(uint64_t{0xFF} << (8 * (d - 8 * k)));
+    }
+    ambiguous = mask != 0;
+  }
+#else
+  (void)num_disp;
+  for (int32_t d = 0; d <= max_disp; ++d) {
+    if (cost[d] < best) {
+      best = cost[d];
+      best_d = d;
+    }
+  }
+  if (best_d < 0) {
+    return 0.0f;
+  }
+  uint32_t limit = std::min<uint32_t>(best + best * uniqueness_ratio / 100, 0xFFFE);
+  for (int32_t d = 0; d <= max_disp && !ambiguous; ++d) {
+    ambiguous = (d < best_d - 1 || d > best_d + 1) && cost[d] <= limit;
+  }
+#endif
+  if (ambiguous || best_d <= 0) {
+    return 0.0f;
+  }
+  float disparity = static_cast<float>(best_d);
+  if (best_d < max_disp) {
+    int32_t c0 = cost[best_d - 1];
+    int32_t c1 = cost[best_d];
+    int32_t c2 = cost[best_d + 1];
+    int32_t denominator = c0 + c2 - 2 * c1;
+    if (denominator > 0) {
+      disparity += static_cast<float>(c0 - c2) / static_cast<float>(2 * denominator);
+    }
+  }
+  return disparity;
+}
+
+/// Elapsed milliseconds since start
+inline double StereoElapsedMs(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+}  // namespace detail
+
+/**
+ * @class StereoMatcher
+ * @brief CPU stereo depth for the binocular low-resolution pair: rectification followed by block matching.
+ *
+ * Rectification maps are built once from the calibration of both cameras (ROS stereo conventions: R rotates each
+ * camera into the common rectified frame, P_right[3] = -fx' * baseline) and rebuilt only when the input size
+ * changes; inputs smaller than the calibration, e.g. the low-resolution stream, are handled by scaling the
+ * intrinsics. Matching aggregates SAD or census costs over a square window with running sums, selects the
+ * disparity by winner-takes-all with a uniqueness test and refines it to sub-pixel precision. Every stage is
+ * vectorised (AVX2 / NEON) and split into horizontal bands run on a WorkerPool.
+ *
+ * The SDK delivers the pair as JPEG CompressedImage messages; decode them (e.g. with the application's JPEG
+ * library) into mono8, rgb8 or bgr8 Image messages before calling Compute. Without calibration the inputs are
+ * assumed to be rectified already and only disparity output is available.
+ *
+ * Example:
+ * @code
+ *   StereoConfig config;
+ *   config.output = StereoOutput::DEPTH;
+ *   StereoMatcher matcher(config);
+ *   matcher.SetCalibration(left_info, right_info);
+ *   Image depth;
+ *   if (matcher.Compute(left_gray, right_gray, depth)) {
+ *     printf("stereo frame %.1f ms\n", matcher.GetLastTiming().total_ms);
+ *   }
+ * @endcode
+ */
+class StereoMatcher final : public NonCopyable {
+ public:
+  explicit StereoMatcher(const StereoConfig& config = {}) : config_(config), pool_(config.threads) {
+    config_.num_disparities = std::clamp((config_.num_disparities + 15) / 16 * 16, 16, 256);
+    config_.block_size = std::clamp(config_.block_size | 1, 3, 15);
+    config_.uniqueness_ratio = std::clamp(config_.uniqueness_ratio, 0, 100);
+  }
+
+  /// Effective configuration after rounding and clamping
+  const StereoConfig& GetConfig() const { return config_; }
+
+  /**
+   * @brief Set the stereo calibration.
+   * @param left Left camera: K, D (plumb_bob or rational_polynomial), R and P.
+   * @param right Right camera, its P carries the baseline.
+   * @return false if the calibration is incomplete or the baseline is zero.
+   */
+  bool SetCalibration(const CameraInfo& left, const CameraInfo& right) {
+    calibrated_ = false;
+    map_width_ = map_height_ = 0;
+    if (left.width <= 0 || left.height <= 0 || left.K[0] <= 0.0 || left.K[4] <= 0.0 || left.P[0] <= 0.0 || left.P[5] <= 0.0 ||
+        right.P[0] <= 0.0 || right.P[3] == 0.0 || !IsSupportedDistortion(left) || !IsSupportedDistortion(right) ||
+        right.width != left.width || right.height != left.height || right.K[0] <= 0.0 || right.K[4] <= 0.0) {
+      return false;
+    }
+    left_info_ = left;
+    right_info_ = right;
+    baseline_ = -right.P[3] / right.P[0];
+    calibrated_ = true;
+    return true;
+  }
+
+  /// Whether a calibration is set
+  bool IsCalibrated() const { return calibrated_; }
+
+  /// Baseline in meters derived from the right projection matrix, 0 without calibration
+  double GetBaseline() const { return calibrated_ ? std::abs(baseline_) : 0.0; }
+
+  /**
+   * @brief Intrinsics of the rectified left image at a given resolution, for DepthProjector.
+   * @param width Width of the images passed to Compute.
+   * @param height Height of the images passed to Compute.
+   * @param[out] info K and P from the rectified left projection, R identity, no distortion.
+   * @return false without calibration.
+   */
+  bool GetRectifiedCameraInfo(int32_t width, int32_t height, CameraInfo& info) const {
+    if (!calibrated_ || width <= 0 || height <= 0) {
+      return false;
+    }
+    double sx = static_cast<double>(width) / left_info_.width;
+    double sy = static_cast<double>(height) / left_info_.height;
+    info = CameraInfo{};
+    info.header = left_info_.header;
+    info.width = width;
+    info.height = height;
+    info.distortion_model = "plumb_bob";
+    info.D.assign(5, 0.0);
+    info.K = {left_info_.P[0] * sx, 0.0, left_info_.P[2] * sx, 0.0, left_info_.P[5] * sy, left_info_.P[6] * sy, 0.0, 0.0, 1.0};
+    info.R = {1.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 1.0};
+    info.P = {info.K[0], 0.0, info.K[2], 0.0, 0.0, info.K[4], info.K[5], 0.0, 0.0, 0.0, 1.0, 0.0};
+    info.binning_x = info.binning_y = 0;
+    return true;
+  }
+
+  /**
+   * @brief Compute disparity or depth for one stereo pair.
+   * @param left Left image, mono8, rgb8 or bgr8.
+   * @param right Right image with the same size and encoding.
+   * @param[out] output "32FC1" image of the left view with the left header; 0 marks pixels without a match.
+   * @return false on mismatched or unsupported images, or DEPTH output without calibration.
+   * @note Not thread-safe, use one matcher per stereo stream.
+   */
+  bool Compute(const Image& left, const Image& right, Image& output) {
+    auto start = std::chrono::steady_clock::now();
+    ImageEncoding encoding = GetImageEncoding(left);
+    if (encoding != GetImageEncoding(right) || left.width != right.width || left.height != right.height ||
+        (encoding != ImageEncoding::MONO8 && encoding != ImageEncoding::RGB8 && encoding != ImageEncoding::BGR8)) {
+      return false;
+    }
+    int32_t pixel_size = ImageEncodingPixelSize(encoding);
+    if (!detail::IsValidImage(left, pixel_size) || !detail::IsValidImage(right, pixel_size)) {
+      return false;
+    }
+    int32_t width = left.width;
+    int32_t height = left.height;
+    if ((config_.output == StereoOutput::DEPTH && !calibrated_) || width < config_.block_size || height < std::max(config_.block_size, 5)) {
+      return false;
+    }
+    if (calibrated_ && (map_width_ != width || map_height_ != height)) {
+      BuildMaps(width, height);
+    }
+    Prepare(width, height);
+
+    RectifyImages(left, right, encoding);
+    auto rectified = std::chrono::steady_clock::now();
+    timing_.rectify_ms = detail::StereoElapsedMs(start);
+
+    if (config_.cost == StereoCost::CENSUS) {
+      // The two rows at each border have no full census window
+      for (std::vector<uint32_t>& census : census_) {
+        std::fill(census.begin(), census.begin() + 2 * width, 0);
+        std::fill(census.end() - 2 * width, census.end(), 0);
+      }
+      pool_.ParallelFor(bands_.size(), [&](size_t band) {
+        auto [begin, end] = BandRows(band, 2, height - 2);
+        for (int32_t y = begin; y < end; ++y) {
+          detail::CensusRow(rectified_[0].data(), width, y, census_[0].data() + static_cast<size_t>(y) * width);
+          detail::CensusRow(rectified_[1].data(), width, y, census_[1].data() + static_cast<size_t>(y) * width);
+        }
+      });
+    }
+    output.header = left.header;
+    output.height = height;
+    output.width = width;
+    output.encoding = "32FC1";
+    output.is_bigendian = false;
+    output.step = width * static_cast<int32_t>(sizeof(float));
+    output.data.resize(static_cast<size_t>(output.step) * height);
+    float* out = reinterpret_cast<float*>(output.data.data());
+    std::fill(out, out + static_cast<size_t>(width) * height, 0.0f);
+    // Depth = f * B / d with the rectified focal length at this resolution
+    float depth_scale = 0.0f;
+    if (config_.output == StereoOutput::DEPTH) {
+      depth_scale = static_cast<float>(left_info_.P[0] * width / left_info_.width * std::abs(baseline_));
+    }
+    int32_t radius = config_.block_size / 2;
+    pool_.ParallelFor(bands_.size(), [&](size_t band) {
+      auto [begin, end] = BandRows(band, radius, height - radius);
+      if (begin < end) {
+        MatchBand(bands_[band], begin, end, depth_scale, out);
+      }
+    });
+
+    timing_.match_ms = detail::StereoElapsedMs(rectified);
+    timing_.total_ms = detail::StereoElapsedMs(start);
+    frame_time_.Record(static_cast<int64_t>(timing_.total_ms * 1000.0));
+    return true;
+  }
+
+  /// Timing of the last successful Compute
+  const StereoTiming& GetLastTiming() const { return timing_; }
+
+  /// Distribution of Compute times since construction or ResetFrameTimeStats
+  LatencySummary GetFrameTimeStats() const { return frame_time_.Summary(); }
+
+  /// Clear the frame time distribution
+  void ResetFrameTimeStats() { frame_time_.Reset(); }
+
+ private:
+  // Per-band working memory, reused across frames
+  struct BandBuffers {
+    std::vector<uint8_t> pixel_costs;    // (block_size + 1) rows of width * num_disp
+    std::vector<uint16_t> column_sums;   // width * num_disp
+    std::vector<uint16_t> box;           // num_disp
+    std::vector<uint8_t> reversed;       // width + num_disp
+    std::vector<uint32_t> reversed_census;
+  };
+
+  static bool IsSupportedDistortion(const CameraInfo& info) {
+    return info.D.empty() || info.distortion_model == "plumb_bob" || info.distortion_model == "rational_polynomial";
+  }
+
+  std::pair<int32_t, int32_t> BandRows(size_t band, int32_t first, int32_t last) const {
+    int32_t rows = std::max(last - first, 0);
+    int32_t count = static_cast<int32_t>(bands_.size());
+    int32_t i = static_cast<int32_t>(band);
+    return {first + rows * i / count, first + rows * (i + 1) / count};
+  }
+
+  void Prepare(int32_t width, int32_t height) {
+    width_ = width;
+    size_t pixels = static_cast<size_t>(width) * height;
+    for (int32_t i = 0; i < 2; ++i) {
+      gray_[i].resize(pixels);
+      rectified_[i].resize(pixels);
+      if (config_.cost == StereoCost::CENSUS) {
+        census_[i].resize(pixels);
+      }
+    }
+    size_t num_disp = static_cast<size_t>(config_.num_disparities);
+    size_t row_costs = static_cast<size_t>(width) * num_disp;
+    bands_.resize(pool_.Size());
+    for (BandBuffers& band : bands_) {
+      band.pixel_costs.resize(row_costs * (config_.block_size + 1));
+      band.column_sums.resize(row_costs);
+      band.box.resize(num_disp);
+      band.reversed.resize(width + num_disp);
+      if (config_.cost == StereoCost::CENSUS) {
+        band.reversed_census.resize(width + num_disp);
+      }
+    }
+  }
+
+  // Grayscale conversion and remapping of both images into rectified_
+  void RectifyImages(const Image& left, const Image& right, ImageEncoding encoding) {
+    int32_t width = left.width;
+    int32_t height = left.height;
+    const Image* images[2] = {&left, &right};
+    pool_.ParallelFor(bands_.size(), [&](size_t band) {
+      auto [begin, end] = BandRows(band, 0, height);
+      for (int32_t i = 0; i < 2; ++i) {
+        std::vector<uint8_t>& gray = calibrated_ ? gray_[i] : rectified_[i];
+        for (int32_t y = begin; y < end; ++y) {
+          const uint8_t* in = images[i]->data.data() + static_cast<size_t>(y) * images[i]->step;
+          uint8_t* o = gray.data() + static_cast<size_t>(y) * width;
+          if (encoding == ImageEncoding::MONO8) {
+            std::memcpy(o, in, width);
+          } else if (encoding == ImageEncoding::RGB8) {
+            detail::ThreeChannelToGray(in, o, width, 77, 150, 29);
+          } else {
+            detail::ThreeChannelToGray(in, o, width, 29, 150, 77);
+          }
+        }
+      }
+    });
+    if (!calibrated_) {
+      return;
+    }
+    pool_.ParallelFor(bands_.size(), [&](size_t band) {
+      auto [begin, end] = BandRows(band, 0, height);
+      for (int32_t i = 0; i < 2; ++i) {
+        for (int32_t y = begin; y < end; ++y) {
+          size_t row = static_cast<size_t>(y) * width;
+          detail::RemapRow(gray_[i].data(), width, map_offsets_[i].data() + row, map_weights_[i].data() + 2 * row, width,
+                           rectified_[i].data() + row);
+        }
+      }
+    });
+  }
+
+  // Inverse mapping from rectified to raw pixels, as in the standard undistort-rectify model
+  void BuildMaps(int32_t width, int32_t height) {
+    const CameraInfo* infos[2] = {&left_info_, &right_info_};
+    double sx = static_cast<double>(width) / left_info_.width;
+    double sy = static_cast<double>(height) / left_info_.height;
+    for (int32_t i = 0; i < 2; ++i) {
+      const CameraInfo& info = *infos[i];
+      double fx = info.K[0] * sx, fy = info.K[4] * sy, cx = info.K[2] * sx, cy = info.K[5] * sy;
+      double pfx = info.P[0] * sx, pfy = info.P[5] * sy, pcx = info.P[2] * sx, pcy = info.P[6] * sy;
+      std::array<double, 8> k{};
+      for (size_t j = 0; j < std::min<size_t>(info.D.size(), k.size()); ++j) {
+        k[j] = info.D[j];
+      }
+      const std::array<double, 9>& r = info.R;
+      // An all-zero R means the rotation was not filled in and is treated as identity
+      bool identity = r == std::array<double, 9>{};
+      size_t pixels = static_cast<size_t>(width) * height;
+      map_offsets_[i].resize(pixels);
+      map_weights_[i].resize(2 * pixels);
+      for (int32_t v = 0; v < height; ++v) {
+        for (int32_t u = 0; u < width; ++u) {
+          double x = (u - pcx) / pfx;
+          double y = (v - pcy) / pfy;
+          double w = 1.0;
+          if (!identity) {
+            // R^T applied to the rectified ray gives the ray in the raw camera frame
+            double rx = r[0] * x + r[3] * y + r[6];
+            double ry = r[1] * x + r[4] * y + r[7];
+            w = r[2] * x + r[5] * y + r[8];
+            x = rx;
+            y = ry;
+          }
+          size_t index = static_cast<size_t>(v) * width + u;
+          map_offsets_[i][index] = -1;
+          if (w <= 0.0) {
+            continue;
+          }
+          x /= w;
+          y /= w;
+          double r2 = x * x + y * y;
+          double radial = (1.0 + r2 * (k[0] + r2 * (k[1] + r2 * k[4]))) / (1.0 + r2 * (k[5] + r2 * (k[6] + r2 * k[7])));
+          double xd = x * radial + 2.0 * k[2] * x * y + k[3] * (r2 + 2.0 * x * x);
+          double yd = y * radial + k[2] * (r2 + 2.0 * y * y) + 2.0 * k[3] * x * y;
+          double su = fx * xd + cx;
+          double sv = fy * yd + cy;
+          if (!(su >= 0.0 && sv >= 0.0 && su <= width - 1 && sv <= height - 1) || width < 2 || height < 2) {
+            continue;
+          }
+          int32_t fixed_u = static_cast<int32_t>(std::lround(su * 32.0));
+          int32_t fixed_v = static_cast<int32_t>(std::lround(sv * 32.0));
+          int32_t x0 = std::min(fixed_u >> 5, width - 2);
+          int32_t y0 = std::min(fixed_v >> 5, height - 2);
+          map_offsets_[i][index] = y0 * width + x0;
+          map_weights_[i][2 * index] = static_cast<uint8_t>(fixed_u - x0 * 32);
+          map_weights_[i][2 * index + 1] = static_cast<uint8_t>(fixed_v - y0 * 32);
+        }
+      }
+    }
+    map_width_ = width;
+    map_height_ = height;
+  }
+
+  // Per-pixel cost row for image row y, written to the ring slot of that row
+  uint8_t* PixelCostRow(BandBuffers& band, int32_t y) {
+    int32_t width = width_;
+    int32_t num_disp = config_.num_disparities;
+    size_t row_costs = static_cast<size_t>(width) * num_disp;
+    uint8_t* cost = band.pixel_costs.data() + row_costs * (y % (config_.block_size + 1));
+    size_t row = static_cast<size_t>(y) * width;
+    if (config_.cost == StereoCost::CENSUS) {
+      const uint32_t* right = census_[1].data() + row;
+      uint32_t* reversed = band.reversed_census.data();
+      for (int32_t x = 0; x < width; ++x) {
+        reversed[x] = right[width - 1 - x];
+      }
+      detail::CensusCostRow(census_[0].data() + row, reversed, width, num_disp, cost);
+    } else {
+      const uint8_t* right = rectified_[1].data() + row;
+      uint8_t* reversed = band.reversed.data();
+      for (int32_t x = 0; x < width; ++x) {
+        reversed[x] = right[width - 1 - x];
+      }
+      detail::SadCostRow(rectified_[0].data() + row, reversed, width, num_disp, cost);
+    }
+    return cost;
+  }
+
+  // Output rows [begin, end), each at least radius rows away from the image border
+  void MatchBand(BandBuffers& band, int32_t begin, int32_t end, float depth_scale, float* out) {
+    int32_t width = width_;
+    int32_t num_disp = config_.num_disparities;
+    int32_t radius = config_.block_size / 2;
+    size_t row_costs = static_cast<size_t>(width) * num_disp;
+    uint16_t* sums = band.column_sums.data();
+    std::fill(sums, sums + row_costs, 0);
+    for (int32_t y = begin - radius; y <= begin + radius; ++y) {
+      detail::UpdateColumnSums(sums, PixelCostRow(band, y), nullptr, row_costs);
+    }
+    uint16_t* box = band.box.data();
+    uint32_t uniqueness = static_cast<uint32_t>(config_.uniqueness_ratio);
+    for (int32_t y = begin; y < end; ++y) {
+      if (y > begin) {
+        const uint8_t* removed = band.pixel_costs.data() + row_costs * ((y - radius - 1) % (config_.block_size + 1));
+        detail::UpdateColumnSums(sums, PixelCostRow(band, y + radius), removed, row_costs);
+      }
+      std::fill(box, box + num_disp, 0);
+      for (int32_t x = 0; x < 2 * radius + 1; ++x) {
+        detail::SlideBox(box, sums + static_cast<size_t>(x) * num_disp, nullptr, num_disp);
+      }
+      float* o = out + static_cast<size_t>(y) * width;
+      for (int32_t x = radius; x < width - radius; ++x) {
+        if (x > radius) {
+          detail::SlideBox(box, sums + static_cast<size_t>(x + radius) * num_disp, sums + static_cast<size_t>(x - radius - 1) * num_disp,
+                           num_disp);
+        }
+        int32_t max_disp = std::min(num_disp - 1, x - radius);
+        float disparity = detail::SelectDisparity(box, num_disp, max_disp, uniqueness);
+        if (disparity > 0.0f) {
+          o[x] = depth_scale > 0.0f ? depth_scale / disparity : disparity;
+        }
+      }
+    }
+  }
+
+  StereoConfig config_;
+  WorkerPool pool_;
+  CameraInfo left_info_{};
+  CameraInfo right_info_{};
+  double baseline_{0.0};
+  bool calibrated_{false};
+  int32_t map_width_{0};
+  int32_t map_height_{0};
+  int32_t width_{0};
+  std::array<std::vector<int32_t>, 2> map_offsets_;
+  std::array<std::vector<uint8_t>, 2> map_weights_;
+  std::array<std::vector<uint8_t>, 2> gray_;
+  std::array<std::vector<uint8_t>, 2> rectified_;
+  std::array<std::vector<uint32_t>, 2> census_;
+  std::vector<BandBuffers> bands_;
+  StereoTiming timing_;
+  detail::LatencyHistogram frame_time_;
+};
+
+}  // namespace magic::dog::sensor
@@ -0,0 +1,110 @@
+#pragma once
+
+#include "magic_image_ops.h"
+#include "magic_type.h"
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+
+namespace magic::dog::sensor {
+
+/**
+ * @brief Delivery parameters of one camera or lidar stream
+ */
+struct StreamConfig {
+  double target_fps = 0.0;  ///< Maximum delivery rate, 0 means unlimited
+  int32_t decimation = 1;   ///< Deliver every N-th message, applied before target_fps
+  ImageRoi roi;             ///< Crop applied to Image messages, default is the full image
+};
+
+/**
+ * @class StreamThrottle
+ * @brief Applies a StreamConfig to a subscription: decimation, rate limiting and ROI cropping.
+ *
+ * The robot service currently streams every device at its native rate, so throttling happens on receipt;
+ * it spares the consumer callbacks, not the link. The configuration can be changed at runtime from any thread.
+ *
+ * Example:
+ * @code
+ *   StreamThrottle throttle({5.0, 1, {0, 240, 0, 240}});  // 5 fps, lower half of the image
+ *   controller.SubscribeRgbdDepthImage(throttle.Wrap<Image>(on_depth));
+ * @endcode
+ */
+class StreamThrottle final : public NonCopyable {
+ public:
+  explicit StreamThrottle(const StreamConfig& config = {}) : config_(config) {}
+
+  /// Change the delivery parameters at runtime
+  void SetConfig(const StreamConfig& config) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    config_ = config;
+    counter_ = 0;
+  }
+
+  /// Current delivery parameters
+  StreamConfig GetConfig() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return config_;
+  }
+
+  /**
+   * @brief Decide whether a message received now should be delivered.
+   * @return true if the message passes decimation and the rate limit.
+   */
+  bool Accept() {
+    int64_t now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    std::lock_guard<std::mutex> lock(mutex_);
+    int32_t decimation = config_.decimation > 1 ? config_.decimation : 1;
+    if (counter_++ % decimation != 0) {
+      return false;
+    }
+    if (config_.target_fps > 0.0) {
+      // 10% tolerance so that e.g. 30 fps -> 10 fps keeps every third frame despite jitter
+      int64_t period = static_cast<int64_t>(0.9e9 / config_.target_fps);
+      if (has_delivered_ && now - last_delivery_ < period) {
+        return false;
+      }
+    }
+    has_delivered_ = true;
+    last_delivery_ = now;
+    return true;
+  }
+
+  /**
+   * @brief Wrap a subscription callback with this throttle; Image messages are also cropped to the ROI.
+   * @note The throttle must outlive the subscription.
+   */
+  template <typename T>
+  std::function<void(const std::shared_ptr<T>)> Wrap(std::function<void(const std::shared_ptr<T>)> callback) {
+    return [this, callback = std::move(callback)](const std::shared_ptr<T> msg) {
+      if (!msg || !Accept()) {
+        return;
+      }
+      if constexpr (std::is_same_v<T, Image>) {
+        ImageRoi roi = GetConfig().roi;
+        if (roi.x_offset != 0 || roi.y_offset != 0 || roi.width != 0 || roi.height != 0) {
+          auto cropped = std::make_shared<Image>();
+          if (!CropImage(*msg, roi, *cropped)) {
+            return;
+          }
+          callback(cropped);
+          return;
+        }
+      }
+      callback(msg);
+    };
+  }
+
+ private:
+  mutable std::mutex mutex_;
+  StreamConfig config_;
+  uint64_t counter_{0};
+  bool has_delivered_{false};
+  int64_t last_delivery_{0};
+};
+
+}  // namespace magic::dog::sensor
@@ -0,0 +1,323 @@
+#pragma once
+
+#include "magic_type.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace magic::dog::sensor {
+
+/**
+ * @brief Percentiles of a latency distribution, in milliseconds
+ */
+struct LatencySummary {
+  uint64_t count = 0;  ///< Number of samples
+  double p50_ms = 0.0;
+  double p90_ms = 0.0;
+  double p99_ms = 0.0;
+  double max_ms = 0.0;
+};
+
+/**
+ * @brief Statistics of one subscribed topic
+ */
+struct TopicStats {
+  std::string topic;                  ///< Topic name given to Instrument
+  uint64_t messages = 0;              ///< Messages received since start
+  uint64_t bytes = 0;                 ///< Payload bytes received since start
+  double rate_hz = 0.0;               ///< Receive rate since the previous GetTopicStats call
+  double bytes_per_second = 0.0;      ///< Payload throughput since the previous GetTopicStats call
+  LatencySummary transport_latency;   ///< Header stamp to callback invocation
+  LatencySummary callback_time;       ///< Execution time of the user callback
+  uint64_t gaps = 0;                  ///< Stamp gaps longer than 1.5 nominal periods
+  uint64_t dropped_estimate = 0;      ///< Messages estimated missing inside those gaps
+};
+
+namespace detail {
+
+/// Lock-free log-linear histogram of microsecond values, about 12% relative resolution
+class LatencyHistogram {
+ public:
+  static constexpr size_t kBuckets = 8 + 8 * 40;
+
+  void Record(int64_t value_us) {
+    uint64_t v = value_us < 0 ? 0 : static_cast<uint64_t>(value_us);
+    buckets_[Bucket(v)].fetch_add(1, std::memory_order_relaxed);
+    uint64_t current = max_.load(std::memory_order_relaxed);
+    while (v > current && !max_.compare_exchange_weak(current, v, std::memory_order_relaxed)) {
+    }
+  }
+
+  LatencySummary Summary() const {
+    std::array<uint64_t, kBuckets> counts;
+    LatencySummary summary;
+    for (size_t i = 0; i < kBuckets; ++i) {
+      counts[i] = buckets_[i].load(std::memory_order_relaxed);
+      summary.count += counts[i];
+    }
+    if (summary.count == 0) {
+      return summary;
+    }
+    summary.p50_ms = Percentile(counts, summary.count, 0.50);
+    summary.p90_ms = Percentile(counts, summary.count, 0.90);
+    summary.p99_ms = Percentile(counts, summary.count, 0.99);
+    summary.max_ms = static_cast<double>(max_.load(std::memory_order_relaxed)) * 1e-3;
+    return summary;
+  }
+
+  void Reset() {
+    for (auto& bucket : buckets_) {
+      bucket.store(0, std::memory_order_relaxed);
+    }
+    max_.store(0, std::memory_order_relaxed);
+  }
+
+ private:
+  static size_t Bucket(uint64_t v) {
+    if (v < 8) {
+      return static_cast<size_t>(v);
+    }
+    int msb = 63 - __builtin_clzll(v);
+    size_t bucket = static_cast<size_t>(msb - 2) * 8 + ((v >> (msb - 3)) & 7);
+    return bucket < kBuckets ? bucket : kBuckets - 1;
+  }
+
+  /// Midpoint of the bucket range, in milliseconds
+  static double BucketValueMs(size_t bucket) {
+    if (bucket < 8) {
+      return static_cast<double>(bucket) * 1e-3;
+    }
+    int msb = static_cast<int>(bucket / 8) + 2;
+    uint64_t sub = bucket % 8;
+    double low = std::ldexp(static_cast<double>(8 + sub), msb - 3);
+    double width = std::ldexp(1.0, msb - 3);
+    return (low + 0.5 * width) * 1e-3;
+  }
+
+  static double Percentile(const std::array<uint64_t, kBuckets>& counts, uint64_t total, double quantile) {
+    uint64_t rank = static_cast<uint64_t>(std::ceil(quantile * static_cast<double>(total)));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBuckets; ++i) {
+      seen += counts[i];
+      if (seen >= rank) {
+        return BucketValueMs(i);
+      }
+    }
+    return BucketValueMs(kBuckets - 1);
+  }
+
+  std::array<std::atomic<uint64_t>, kBuckets> buckets_{};
+  std::atomic<uint64_t> max_{0};
+};
+
+inline int64_t StatsNowNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// Message stamp (ns, 0 if the type has none) and payload size used by the statistics
+inline int64_t MessageStamp(const Imu& msg) { return msg.timestamp; }
+inline int64_t MessageStamp(const LaserScan& msg) { return msg.header.stamp; }
+inline int64_t MessageStamp(const Image& msg) { return msg.header.stamp; }
+inline int64_t MessageStamp(const CameraInfo& msg) { return msg.header.stamp; }
+inline int64_t MessageStamp(const CompressedImage& msg) { return msg.header.stamp; }
+inline int64_t MessageStamp(const PointCloud2& msg) { return msg.header.stamp; }
+inline int64_t MessageStamp(const TrinocularCameraFrame& msg) { return msg.header.stamp; }
+inline int64_t MessageStamp(const Float32MultiArray&) { return 0; }
+inline int64_t MessageStamp(const ByteMultiArray&) { return 0; }
+inline int64_t MessageStamp(const Int8&) { return 0; }
+
+inline size_t MessageBytes(const Imu& msg) { return sizeof(msg); }
+inline size_t MessageBytes(const LaserScan& msg) { return (msg.ranges.size() + msg.intensities.size()) * sizeof(double); }
+inline size_t MessageBytes(const Image& msg) { return msg.data.size(); }
+inline size_t MessageBytes(const CameraInfo& msg) { return sizeof(msg) + msg.D.size() * sizeof(double); }
+inline size_t MessageBytes(const CompressedImage& msg) { return msg.data.size(); }
+inline size_t MessageBytes(const PointCloud2& msg) { return msg.data.size(); }
+inline size_t MessageBytes(const TrinocularCameraFrame& msg) { return msg.imgfl_array.size() + msg.imgf_array.size() + msg.imgfr_array.size(); }
+inline size_t MessageBytes(const Float32MultiArray& msg) { return msg.data.size() * sizeof(float); }
+inline size_t MessageBytes(const ByteMultiArray& msg) { return msg.data.size(); }
+inline size_t MessageBytes(const Int8& msg) { return sizeof(msg); }
+
+}  // namespace detail
+
+/**
+ * @class TopicStatsCollector
+ * @brief Measures rate, throughput, latency and gaps of subscribed topics.
+ *
+ * Instrument wraps a subscription callback; per message it costs a handful of relaxed atomic updates and two
+ * clock reads. Transport latency is the difference between the receipt time and the message stamp, so it assumes
+ * the robot and the host clocks are synchronized (e.g. via NTP/PTP).
+ *
+ * Example:
+ * @code
+ *   TopicStatsCollector stats;
+ *   controller.SubscribeRgbdDepthImage(stats.Instrument<Image>("rgbd_depth", on_depth));
+ *   ...
+ *   for (const auto& topic : stats.GetTopicStats()) { ... }
+ * @endcode
+ */
+class TopicStatsCollector final : public NonCopyable {
+ public:
+  TopicStatsCollector() = default;
+
+  /**
+   * @brief Wrap a subscription callback with statistics collection.
+   * @param topic Name reported in TopicStats.
+   * @param callback User callback, may be empty to only measure the stream.
+   * @note The collector must outlive the subscription.
+   */
+  template <typename T>
+  std::function<void(const std::shared_ptr<T>)> Instrument(const std::string& topic, std::function<void(const std::shared_ptr<T>)> callback) {
+    Counters* counters = AddTopic(topic);
+    return [counters, callback = std::move(callback)](const std::shared_ptr<T> msg) {
+      if (!msg) {
+        return;
+      }
+      int64_t now = detail::StatsNowNs();
+      int64_t stamp = detail::MessageStamp(*msg);
+      counters->OnMessage(now, stamp, detail::MessageBytes(*msg));
+      if (callback) {
+        auto start = std::chrono::steady_clock::now();
+        callback(msg);
+        counters->callback_time.Record(
+            std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count());
+      }
+    };
+  }
+
+  /**
+   * @brief Snapshot the statistics of every instrumented topic.
+   *
+   * Rates are computed over the interval since the previous call (since the first message on the first call).
+   */
+  std::vector<TopicStats> GetTopicStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int64_t now = detail::StatsNowNs();
+    std::vector<TopicStats> result;
+    result.reserve(topics_.size());
+    for (auto& counters : topics_) {
+      TopicStats stats;
+      stats.topic = counters->name;
+      stats.messages = counters->messages.load(std::memory_order_relaxed);
+      stats.bytes = counters->bytes.load(std::memory_order_relaxed);
+      stats.transport_latency = counters->transport_latency.Summary();
+      stats.callback_time = counters->callback_time.Summary();
+      stats.gaps = counters->gaps.load(std::memory_order_relaxed);
+      stats.dropped_estimate = counters->dropped.load(std::memory_order_relaxed);
+
+      int64_t window_start = counters->snapshot_time != 0 ? counters->snapshot_time : counters->first_receipt.load(std::memory_order_relaxed);
+      if (window_start != 0 && now > window_start) {
+        double seconds = static_cast<double>(now - window_start) * 1e-9;
+        stats.rate_hz = static_cast<double>(stats.messages - counters->snapshot_messages) / seconds;
+        stats.bytes_per_second = static_cast<double>(stats.bytes - counters->snapshot_bytes) / seconds;
+      }
+      counters->snapshot_time = now;
+      counters->snapshot_messages = stats.messages;
+      counters->snapshot_bytes = stats.bytes;
+      result.push_back(std::move(stats));
+    }
+    return result;
+  }
+
+  /// Reset all counters, topics stay registered
+  void Reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto& counters : topics_) {
+      counters->Reset();
+    }
+  }
+
+ private:
+  struct Counters {
+    std::string name;
+    std::atomic<uint64_t> messages{0};
+    std::atomic<uint64_t> bytes{0};
+    std::atomic<uint64_t> gaps{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<int64_t> first_receipt{0};
+    detail::LatencyHistogram transport_latency;
+    detail::LatencyHistogram callback_time;
+
+    // Written by the callback thread only
+    int64_t last_stamp{0};
+    double period_ns{0.0};
+    uint32_t consecutive_gaps{0};
+
+    // Guarded by the collector mutex
+    int64_t snapshot_time{0};
+    uint64_t snapshot_messages{0};
+    uint64_t snapshot_bytes{0};
+
+    void OnMessage(int64_t now, int64_t stamp, size_t size) {
+      uint64_t count = messages.fetch_add(1, std::memory_order_relaxed);
+      bytes.fetch_add(size, std::memory_order_relaxed);
+      if (count == 0) {
+        first_receipt.store(now, std::memory_order_relaxed);
+      }
+      if (stamp != 0) {
+        transport_latency.Record((now - stamp) / 1000);
+      } else {
+        stamp = now;
+      }
+      TrackGap(stamp, count);
+    }
+
+    /// Estimate the nominal period with an EMA and count deltas above 1.5 periods as gaps
+    void TrackGap(int64_t stamp, uint64_t count) {
+      int64_t delta = stamp - last_stamp;
+      last_stamp = stamp;
+      if (count == 0 || delta <= 0) {
+        return;
+      }
+      double sample = static_cast<double>(delta);
+      if (count > 8 && period_ns > 0.0 && sample > 1.5 * period_ns) {
+        gaps.fetch_add(1, std::memory_order_relaxed);
+        dropped.fetch_add(static_cast<uint64_t>(std::llround(sample / period_ns)) - 1, std::memory_order_relaxed);
+        // A few gaps in a row mean the rate itself dropped: restart the estimate from the new period. Otherwise
+        // keep tracking with the sample clamped, so a single long gap barely moves the estimate
+        if (++consecutive_gaps >= 4) {
+          period_ns = sample;
+          consecutive_gaps = 0;
+          return;
+        }
+        sample = 1.5 * period_ns;
+      } else {
+        consecutive_gaps = 0;
+      }
+      period_ns = period_ns == 0.0 ? sample : 0.9 * period_ns + 0.1 * sample;
+    }
+
+    void Reset() {
+      messages.store(0, std::memory_order_relaxed);
+      bytes.store(0, std::memory_order_relaxed);
+      gaps.store(0, std::memory_order_relaxed);
+      dropped.store(0, std::memory_order_relaxed);
+      first_receipt.store(0, std::memory_order_relaxed);
+      transport_latency.Reset();
+      callback_time.Reset();
+      snapshot_time = 0;
+      snapshot_messages = 0;
+      snapshot_bytes = 0;
+    }
+  };
+
+  Counters* AddTopic(const std::string& topic) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    topics_.push_back(std::make_unique<Counters>());
+    topics_.back()->name = topic;
+    return topics_.back().get();
+  }
+
+  std::mutex mutex_;
+  std::deque<std::unique_ptr<Counters>> topics_;
+};
+
+}  // namespace magic::dog::sensor
@@ -0,0 +1,213 @@
+#pragma once
+
+#include "magic_topic_stats.h"
+#include "magic_type.h"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <span>
+#include <vector>
+
+namespace magic::dog::sensor {
+
+namespace detail {
+
+constexpr size_t kFrameAlign = 64;
+
+struct AlignedBufferDelete {
+  void operator()(uint8_t* data) const { ::operator delete[](data, std::align_val_t{kFrameAlign}); }
+};
+
+}  // namespace detail
+
+/**
+ * @brief TrinocularCameraFrame with the three images stored back to back in one pooled buffer
+ */
+class PackedTrinocularFrame final {
+ public:
+  Header header;              ///< Common message header
+  int64_t vin_time = 0;       ///< Image acquisition timestamp (ns)
+  int64_t decode_time = 0;    ///< Image decoding completion timestamp (ns)
+  int64_t receipt_time = 0;   ///< Time the frame was received by this process (ns, system clock)
+
+  /// Left image data
+  std::span<const uint8_t> left() const { return View(0); }
+  /// Middle image data
+  std::span<const uint8_t> middle() const { return View(1); }
+  /// Right image data
+  std::span<const uint8_t> right() const { return View(2); }
+
+  /// Whole buffer holding the three images, each starting on a 64-byte boundary
+  std::span<const uint8_t> buffer() const { return {buffer_.get(), used_}; }
+
+ private:
+  friend class TrinocularFramePool;
+
+  std::span<const uint8_t> View(size_t i) const { return {buffer_.get() + offsets_[i], sizes_[i]}; }
+
+  std::unique_ptr<uint8_t[], detail::AlignedBufferDelete> buffer_;  // 64-byte aligned
+  size_t capacity_{0};
+  size_t used_{0};
+  std::array<size_t, 3> offsets_{};
+  std::array<size_t, 3> sizes_{};
+};
+
+/**
+ * @class TrinocularFramePool
+ * @brief Converts TrinocularCameraFrame messages into PackedTrinocularFrame objects recycled through a pool.
+ *
+ * Once the pool is warm a frame costs one copy per image and no buffer allocation; frames return to the pool
+ * when their last shared_ptr is released, even if the pool itself was destroyed first.
+ *
+ * Example:
+ * @code
+ *   TrinocularFramePool pool;
+ *   TrinocularLatencyTracker latency;
+ *   auto on_frame = [&](const std::shared_ptr<TrinocularCameraFrame> msg) {
+ *     auto frame = pool.Pack(*msg);
+ *     latency.Record(*frame);
+ *     Process(frame->left(), frame->middle(), frame->right());
+ *   };
+ * @endcode
+ */
+class TrinocularFramePool final : public NonCopyable {
+ public:
+  using FramePtr = std::shared_ptr<const PackedTrinocularFrame>;
+
+  /// @param max_pooled Maximum number of idle frames kept for reuse
+  explicit TrinocularFramePool(size_t max_pooled = 4) : state_(std::make_shared<State>()) { state_->max_pooled = max_pooled; }
+
+  /**
+   * @brief Copy a frame into a pooled contiguous buffer and stamp its receipt time.
+   * @param msg Received frame.
+   * @return Packed frame, returned to the pool when released.
+   */
+  FramePtr Pack(const TrinocularCameraFrame& msg) {
+    int64_t receipt_time = detail::StatsNowNs();
+    std::unique_ptr<PackedTrinocularFrame> frame = Acquire();
+    frame->header = msg.header;
+    frame->vin_time = msg.vin_time;
+    frame->decode_time = msg.decode_time;
+    frame->receipt_time = receipt_time;
+    const std::array<const std::vector<uint8_t>*, 3> images = {&msg.imgfl_array, &msg.imgf_array, &msg.imgfr_array};
+    size_t used = 0;
+    for (size_t i = 0; i < images.size(); ++i) {
+      frame->offsets_[i] = used;
+      frame->sizes_[i] = images[i]->size();
+      used = AlignUp(used + images[i]->size());
+    }
+    // Growing only: the capacity settles at the largest frame seen; the old bytes are all overwritten below
+    if (frame->capacity_ < used) {
+      frame->buffer_.reset(static_cast<uint8_t*>(::operator new[](used, std::align_val_t{detail::kFrameAlign})));
+      frame->capacity_ = used;
+    }
+    for (size_t i = 0; i < images.size(); ++i) {
+      if (!images[i]->empty()) {
+        std::memcpy(frame->buffer_.get() + frame->offsets_[i], images[i]->data(), images[i]->size());
+      }
+    }
+    frame->used_ = used;
+    std::shared_ptr<State> state = state_;
+    return FramePtr(frame.release(), [state](const PackedTrinocularFrame* released) {
+      state->Release(std::unique_ptr<PackedTrinocularFrame>(const_cast<PackedTrinocularFrame*>(released)));
+    });
+  }
+
+  /// Number of idle frames currently pooled
+  size_t IdleCount() const {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    return state_->idle.size();
+  }
+
+ private:
+  struct State {
+    std::mutex mutex;
+    std::vector<std::unique_ptr<PackedTrinocularFrame>> idle;
+    size_t max_pooled = 4;
+
+    void Release(std::unique_ptr<PackedTrinocularFrame> frame) {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (idle.size() < max_pooled) {
+        idle.push_back(std::move(frame));
+      }
+    }
+  };
+
+  static size_t AlignUp(size_t n) { return (n + detail::kFrameAlign - 1) & ~(detail::kFrameAlign - 1); }
+
+  std::unique_ptr<PackedTrinocularFrame> Acquire() {
+    {
+      std::lock_guard<std::mutex> lock(state_->mutex);
+      if (!state_->idle.empty()) {
+        std::unique_ptr<PackedTrinocularFrame> frame = std::move(state_->idle.back());
+        state_->idle.pop_back();
+        return frame;
+      }
+    }
+    return std::make_unique<PackedTrinocularFrame>();
+  }
+
+  std::shared_ptr<State> state_;
+};
+
+/**
+ * @brief Per-stage latency of trinocular frames
+ */
+struct TrinocularLatencyStats {
+  LatencySummary capture_to_decode;   ///< decode_time - vin_time
+  LatencySummary decode_to_receipt;   ///< receipt_time - decode_time, includes transport and SDK dispatch
+  LatencySummary capture_to_receipt;  ///< receipt_time - vin_time
+};
+
+/**
+ * @class TrinocularLatencyTracker
+ * @brief Lock-free per-stage latency histograms built from vin_time, decode_time and receipt time.
+ * @note decode_to_receipt and capture_to_receipt compare robot and local clocks, which must be synchronized.
+ */
+class TrinocularLatencyTracker final : public NonCopyable {
+ public:
+  TrinocularLatencyTracker() = default;
+
+  /// Record a packed frame
+  void Record(const PackedTrinocularFrame& frame) { Record(frame.vin_time, frame.decode_time, frame.receipt_time); }
+
+  /// Record a raw frame received at receipt_time (ns, system clock)
+  void Record(const TrinocularCameraFrame& frame, int64_t receipt_time) { Record(frame.vin_time, frame.decode_time, receipt_time); }
+
+  /// Summaries of the three stages
+  TrinocularLatencyStats GetStats() const {
+    return {capture_to_decode_.Summary(), decode_to_receipt_.Summary(), capture_to_receipt_.Summary()};
+  }
+
+  /// Clear all histograms
+  void Reset() {
+    capture_to_decode_.Reset();
+    decode_to_receipt_.Reset();
+    capture_to_receipt_.Reset();
+  }
+
+ private:
+  void Record(int64_t vin_time, int64_t decode_time, int64_t receipt_time) {
+    // Frames without stage timestamps would only pollute the histograms
+    if (vin_time > 0 && decode_time > 0) {
+      capture_to_decode_.Record((decode_time - vin_time) / 1000);
+    }
+    if (decode_time > 0) {
+      decode_to_receipt_.Record((receipt_time - decode_time) / 1000);
+    }
+    if (vin_time > 0) {
+      capture_to_receipt_.Record((receipt_time - vin_time) / 1000);
+    }
+  }
+
+  detail::LatencyHistogram capture_to_decode_;
+  detail::LatencyHistogram decode_to_receipt_;
+  detail::LatencyHistogram capture_to_receipt_;
+};
+
+}  // namespace magic::dog::sensor
@@ -0,0 +1,469 @@
+#pragma once
+
+#include "magic_audio_encoder.h"
+#include "magic_type.h"
+#include "magic_worker_pool.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace magic::dog::audio {
+
+/**
+ * @brief Identity of a synthesized phrase: the same text with another voice or speed is another clip
+ */
+struct TtsCacheKey {
+  std::string text;        ///< Text to speak
+  std::string speaker_id;  ///< Speaker ID (SpeakerConfigSelected::speaker_id)
+  std::string region;      ///< Speaker region (SpeakerConfigSelected::region)
+  float speed = 1.0f;      ///< Speaking speed (SpeakerConfig::speaker_speed)
+};
+
+/**
+ * @brief Synthesized speech as mono or interleaved S16 PCM
+ */
+struct TtsClip {
+  int32_t sample_rate = 16000;  ///< Sample rate (Hz)
+  int32_t channels = 1;         ///< Interleaved channels
+  std::vector<int16_t> samples;  ///< S16 samples
+
+  /// Playback duration (ms)
+  double DurationMs() const { return channels > 0 && sample_rate > 0 ? 1000.0 * static_cast<double>(samples.size()) / channels / sample_rate : 0.0; }
+};
+
+/**
+ * @brief Cache counters
+ */
+struct TtsCacheStats {
+  uint64_t hits = 0;         ///< Lookups served from memory or disk
+  uint64_t misses = 0;       ///< Lookups that had to synthesize
+  uint64_t failures = 0;     ///< Failed syntheses
+  size_t entries = 0;        ///< Clips held in memory
+  size_t bytes = 0;          ///< Sample bytes held in memory
+};
+
+/// Renders one phrase; runs on the calling or a warm-up thread and may block on the network
+using TtsSynthesizer = std::function<Status(const TtsCacheKey& key, TtsClip& clip)>;
+
+/**
+ * @brief Build a cache key for text spoken with the voice currently configured on the robot.
+ * @param text Text to speak.
+ * @param config Voice configuration from AudioController::GetVoiceConfig.
+ */
+inline TtsCacheKey MakeTtsCacheKey(const std::string& text, const GetSpeechConfig& config) {
+  return {text, config.speaker_config.selected.speaker_id, config.speaker_config.selected.region, config.speaker_config.speaker_speed};
+}
+
+namespace detail {
+
+/// Unambiguous string form of a key, also stored in cache files to guard against hash collisions
+inline std::string SerializeTtsKey(const TtsCacheKey& key) {
+  char speed[32];
+  std::snprintf(speed, sizeof(speed), "%.3f", key.speed);
+  std::string out;
+  out.reserve(key.text.size() + key.speaker_id.size() + key.region.size() + 16);
+  out.append(key.speaker_id).push_back('\x1f');
+  out.append(key.region).push_back('\x1f');
+  out.append(speed).push_back('\x1f');
+  out.append(key.text);
+  return out;
+}
+
+/// 64-bit FNV-1a, stable across runs and platforms (unlike std::hash)
+inline uint64_t Fnv1a64(const std::string& data) {
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (unsigned char c : data) {
+    hash = (hash ^ c) * 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+/// Clip as a RIFF/WAVE file with the serialized key in a private "mkey" chunk
+inline bool WriteTtsClipFile(const std::string& path, const std::string& key, const TtsClip& clip) {
+  std::vector<uint8_t> header;
+  uint32_t data_bytes = static_cast<uint32_t>(clip.samples.size() * sizeof(int16_t));
+  uint32_t key_bytes = static_cast<uint32_t>(key.size() + (key.size() & 1));
+  header.insert(header.end(), {'R', 'I', 'F', 'F'});
+  AppendLe(header, 4 + (8 + 16) + (8 + key_bytes) + (8 + data_bytes), 4);
+  header.insert(header.end(), {'W', 'A', 'V', 'E'});
+  AppendWavFormat(header, clip.sample_rate, clip.channels);
+  header.insert(header.end(), {'m', 'k', 'e', 'y'});
+  AppendLe(header, key_bytes, 4);
+  header.insert(header.end(), key.begin(), key.end());
+  if (key.size() & 1) {
+    header.push_back(0);
+  }
+  header.insert(header.end(), {'d', 'a', 't', 'a'});
+  AppendLe(header, data_bytes, 4);
+  // Write to a temporary name and rename, so a concurrent reader never sees a partial file; the name is unique
+  // per process and call, so writers of the same entry in other processes or threads cannot clobber it
+  static std::atomic<uint64_t> counter{0};
+  std::string temp = path + "." + std::to_string(::getpid()) + "." + std::to_string(counter.fetch_add(1)) + ".tmp";
+  FILE* file = std::fopen(temp.c_str(), "wb");
+  if (file == nullptr) {
+    return false;
+  }
+  bool ok = std::fwrite(header.data(), 1, header.size(), file) == header.size() &&
+            std::fwrite(clip.samples.data(), 1, data_bytes, file) == data_bytes;
+  ok = std::fclose(file) == 0 && ok;
+  ok = ok && std::rename(temp.c_str(), path.c_str()) == 0;
+  if (!ok) {
+    std::remove(temp.c_str());
+  }
+  return ok;
+}
+
+/// Load a clip written by WriteTtsClipFile; false if missing, malformed or stored under another key
+inline bool ReadTtsClipFile(const std::string& path, const std::string& key, TtsClip& clip) {
+  FILE* file = std::fopen(path.c_str(), "rb");
+  if (file == nullptr) {
+    return false;
+  }
+  std::vector<uint8_t> bytes;
+  uint8_t buffer[1 << 16];
+  size_t n;
+  while ((n = std::fread(buffer, 1, sizeof(buffer), file)) > 0) {
+    bytes.insert(bytes.end(), buffer, buffer + n);
+  }
+  std::fclose(file);
+  if (bytes.size() < 12 || std::memcmp(bytes.data(), "RIFF", 4) != 0 || std::memcmp(bytes.data() + 8, "WAVE", 4) != 0) {
+    return false;
+  }
+  bool has_format = false;
+  bool key_matches = false;
+  for (size_t pos = 12; pos + 8 <= bytes.size();) {
+    const uint8_t* chunk = bytes.data() + pos;
+    size_t size = ReadLe(chunk + 4, 4);
+    if (pos + 8 + size > bytes.size()) {
+      return false;
+    }
+    if (std::memcmp(chunk, "fmt ", 4) == 0 && size >= 16) {
+      if (ReadLe(chunk + 8, 2) != 1 || ReadLe(chunk + 22, 2) != 16) {
+        return false;
+      }
+      clip.channels = static_cast<int32_t>(ReadLe(chunk + 10, 2));
+      clip.sample_rate = static_cast<int32_t>(ReadLe(chunk + 12, 4));
+      has_format = true;
+    } else if (std::memcmp(chunk, "mkey", 4) == 0) {
+      key_matches = size >= key.size() && std::memcmp(chunk + 8, key.data(), key.size()) == 0 && (size == key.size() || size == key.size() + 1);
+    } else if (std::memcmp(chunk, "data", 4) == 0) {
+      if (!has_format || !key_matches) {
+        return false;
+      }
+      clip.samples.resize(size / sizeof(int16_t));
+      std::memcpy(clip.samples.data(), chunk + 8, clip.samples.size() * sizeof(int16_t));
+      return true;
+    }
+    pos += 8 + size + (size & 1);
+  }
+  return false;
+}
+
+}  // namespace detail
+
+/**
+ * @class TtsCache
+ * @brief Cache of synthesized phrases so repeated announcements start without synthesis latency.
+ *
+ * Speech synthesis itself happens inside the robot's voice service, which only accepts text through
+ * AudioController::Play and never returns audio. The cache therefore renders phrases through a user-supplied
+ * TtsSynthesizer (for example the same cloud TTS endpoint the voice service is configured for) and keeps the PCM
+ * in memory (LRU, bounded by bytes) and optionally on disk as WAV files, so a restart does not re-synthesize.
+ * Concurrent requests for the same phrase share one synthesis. Warmup pre-renders a phrase list in the background.
+ *
+ * Example:
+ * @code
+ *   TtsCache cache(MyCloudSynthesizer, 64 << 20, "/var/cache/betago_tts");
+ *   cache.Warmup(greeting_keys);
+ *   std::shared_ptr<const TtsClip> clip;
+ *   if (cache.Get(MakeTtsCacheKey("你好！", voice_config), clip).code == ErrorCode::OK) { player.Play(*clip); }
+ * @endcode
+ */
+class TtsCache final : public NonCopyable {
+ public:
+  using ClipPtr = std::shared_ptr<const TtsClip>;
+
+  /**
+   * @brief Constructor
+   * @param synthesizer Renders phrases that are not cached.
+   * @param capacity_bytes Memory budget for sample data; the least recently used clips are evicted beyond it.
+   * @param directory Directory for persistent cache files, empty to keep clips in memory only. Must exist.
+   * @param warmup_threads Phrases synthesized concurrently during warm-up.
+   */
+  explicit TtsCache(TtsSynthesizer synthesizer, size_t capacity_bytes = 64 << 20, std::string directory = "", size_t warmup_threads = 2)
+      : synthesizer_(std::move(synthesizer)), capacity_bytes_(capacity_bytes), directory_(std::move(directory)), warmup_threads_(std::max<size_t>(warmup_threads, 1)) {
+    if (!directory_.empty() && directory_.back() != '/') {
+      directory_.push_back('/');
+    }
+  }
+
+  ~TtsCache() {
+    {
+      std::lock_guard<std::mutex> lock(warmup_mutex_);
+      stop_ = true;
+    }
+    warmup_cv_.notify_all();
+    if (warmup_thread_.joinable()) {
+      warmup_thread_.join();
+    }
+  }
+
+  /**
+   * @brief Look a phrase up in memory, then on disk, without synthesizing.
+   * @return The clip, or nullptr on a miss.
+   */
+  ClipPtr Find(const TtsCacheKey& key) {
+    std::string id = detail::SerializeTtsKey(key);
+    if (ClipPtr clip = FindInMemory(id)) {
+      return clip;
+    }
+    return LoadFromDisk(id);
+  }
+
+  /**
+   * @brief Get a phrase, synthesizing it on a miss (blocking).
+   * @param key Phrase and voice.
+   * @param[out] clip Cached or freshly synthesized clip.
+   * @return The synthesizer's status on a failed miss, OK otherwise.
+   */
+  Status Get(const TtsCacheKey& key, ClipPtr& clip) {
+    std::string id = detail::SerializeTtsKey(key);
+    if ((clip = FindInMemory(id)) || (clip = LoadFromDisk(id))) {
+      return {ErrorCode::OK, ""};
+    }
+    std::promise<std::pair<Status, ClipPtr>> promise;
+    std::shared_future<std::pair<Status, ClipPtr>> pending;
+    bool owner = false;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      auto it = pending_.find(id);
+      if (it != pending_.end()) {
+        pending = it->second;
+      } else if ((clip = FindInMemoryLocked(id))) {
+        // Another caller finished synthesizing it since the unlocked lookup
+        return {ErrorCode::OK, ""};
+      } else {
+        pending = promise.get_future().share();
+        pending_.emplace(id, pending);
+        owner = true;
+        ++stats_.misses;
+      }
+    }
+    if (owner) {
+      auto rendered = std::make_shared<TtsClip>();
+      Status status = synthesizer_ ? synthesizer_(key, *rendered) : Status{ErrorCode::SERVICE_NOT_READY, "no synthesizer"};
+      ClipPtr result;
+      if (status.code == ErrorCode::OK && !rendered->samples.empty()) {
+        result = rendered;
+        if (!directory_.empty()) {
+          detail::WriteTtsClipFile(FilePath(id), id, *rendered);
+        }
+      } else if (status.code == ErrorCode::OK) {
+        status = {ErrorCode::SERVICE_ERROR, "synthesizer returned no audio"};
+      }
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (result) {
+          InsertLocked(id, result);
+        } else {
+          ++stats_.failures;
+        }
+        pending_.erase(id);
+      }
+      promise.set_value({status, result});
+    }
+    auto [status, result] = pending.get();
+    clip = result;
+    return status;
+  }
+
+  /// Store an externally rendered clip
+  void Insert(const TtsCacheKey& key, TtsClip clip) {
+    std::string id = detail::SerializeTtsKey(key);
+    auto stored = std::make_shared<const TtsClip>(std::move(clip));
+    if (!directory_.empty()) {
+      detail::WriteTtsClipFile(FilePath(id), id, *stored);
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    InsertLocked(id, stored);
+  }
+
+  /**
+   * @brief Pre-render phrases in the background; keys already cached are only loaded.
+   *
+   * May be called repeatedly, later lists are queued behind earlier ones.
+   */
+  void Warmup(const std::vector<TtsCacheKey>& keys) {
+    {
+      std::lock_guard<std::mutex> lock(warmup_mutex_);
+      warmup_queue_.insert(warmup_queue_.end(), keys.begin(), keys.end());
+      warmup_outstanding_ += keys.size();
+      if (!warmup_thread_.joinable()) {
+        warmup_thread_ = std::thread([this] { WarmupLoop(); });
+      }
+    }
+    warmup_cv_.notify_all();
+  }
+
+  /// Pre-render texts with one voice
+  void Warmup(const std::vector<std::string>& texts, const GetSpeechConfig& config) {
+    std::vector<TtsCacheKey> keys;
+    keys.reserve(texts.size());
+    for (const std::string& text : texts) {
+      keys.push_back(MakeTtsCacheKey(text, config));
+    }
+    Warmup(keys);
+  }
+
+  /// Wait until every queued warm-up phrase has been rendered or has failed
+  bool WaitForWarmup(std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(warmup_mutex_);
+    return warmup_done_cv_.wait_for(lock, timeout, [this] { return warmup_outstanding_ == 0; });
+  }
+
+  TtsCacheStats GetStats() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    TtsCacheStats stats = stats_;
+    stats.entries = entries_.size();
+    stats.bytes = bytes_;
+    return stats;
+  }
+
+  /// Drop all clips held in memory; cache files are kept
+  void Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    lru_.clear();
+    bytes_ = 0;
+  }
+
+ private:
+  struct Entry {
+    ClipPtr clip;
+    std::list<std::string>::iterator lru;
+  };
+
+  std::string FilePath(const std::string& id) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx.wav", static_cast<unsigned long long>(detail::Fnv1a64(id)));
+    return directory_ + name;
+  }
+
+  ClipPtr FindInMemory(const std::string& id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return FindInMemoryLocked(id);
+  }
+
+  ClipPtr FindInMemoryLocked(const std::string& id) {
+    auto it = entries_.find(id);
+    if (it == entries_.end()) {
+      return nullptr;
+    }
+    lru_.splice(lru_.begin(), lru_, it->second.lru);
+    ++stats_.hits;
+    return it->second.clip;
+  }
+
+  ClipPtr LoadFromDisk(const std::string& id) {
+    if (directory_.empty()) {
+      return nullptr;
+    }
+    auto clip = std::make_shared<TtsClip>();
+    if (!detail::ReadTtsClipFile(FilePath(id), id, *clip)) {
+      return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    ++stats_.hits;
+    InsertLocked(id, clip);
+    return clip;
+  }
+
+  void InsertLocked(const std::string& id, const ClipPtr& clip) {
+    auto it = entries_.find(id);
+    if (it != entries_.end()) {
+      bytes_ -= it->second.clip->samples.size() * sizeof(int16_t);
+      lru_.erase(it->second.lru);
+      entries_.erase(it);
+    }
+    lru_.push_front(id);
+    entries_.emplace(id, Entry{clip, lru_.begin()});
+    bytes_ += clip->samples.size() * sizeof(int16_t);
+    // Never evict the clip just inserted, even if it alone exceeds the budget
+    while (bytes_ > capacity_bytes_ && lru_.size() > 1) {
+      auto victim = entries_.find(lru_.back());
+      bytes_ -= victim->second.clip->samples.size() * sizeof(int16_t);
+      entries_.erase(victim);
+      lru_.pop_back();
+    }
+  }
+
+  void WarmupLoop() {
+    WorkerPool pool(warmup_threads_);
+    while (true) {
+      std::vector<TtsCacheKey> batch;
+      {
+        std::unique_lock<std::mutex> lock(warmup_mutex_);
+        warmup_cv_.wait(lock, [this] { return stop_ || !warmup_queue_.empty(); });
+        if (stop_) {
+          return;
+        }
+        batch.swap(warmup_queue_);
+      }
+      pool.ParallelFor(batch.size(), [&](size_t i) {
+        ClipPtr clip;
+        bool stopping;
+        {
+          std::lock_guard<std::mutex> lock(warmup_mutex_);
+          stopping = stop_;
+        }
+        if (!stopping) {
+          Get(batch[i], clip);
+        }
+      });
+      {
+        std::lock_guard<std::mutex> lock(warmup_mutex_);
+        warmup_outstanding_ -= batch.size();
+      }
+      warmup_done_cv_.notify_all();
+    }
+  }
+
+  TtsSynthesizer synthesizer_;
+  size_t capacity_bytes_;
+  std::string directory_;
+  size_t warmup_threads_;
+
+  mutable std::mutex mutex_;
+  std::unordered_map<std::string, Entry> entries_;
+  std::list<std::string> lru_;
+  std::unordered_map<std::string, std::shared_future<std::pair<Status, ClipPtr>>> pending_;
+  size_t bytes_{0};
+  TtsCacheStats stats_;
+
+  std::mutex warmup_mutex_;
+  std::condition_variable warmup_cv_;
+  std::condition_variable warmup_done_cv_;
+  std::vector<TtsCacheKey> warmup_queue_;
+  size_t warmup_outstanding_{0};
+  bool stop_{false};
+  std::thread warmup_thread_;
+};
+
+}  // namespace magic::dog::audio
@@ -0,0 +1,462 @@
+#pragma once
+
+#include "magic_audio.h"
+#include "magic_audio_ring.h"
+#include "magic_type.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace magic::dog::audio {
+
+/**
+ * @brief Lifecycle state of one TTS command
+ */
+enum class TtsState : int8_t {
+  QUEUED = 0,       ///< Accepted by the voice service, waiting behind other playback
+  STARTED = 1,      ///< Playback started
+  FINISHED = 2,     ///< Playback completed
+  INTERRUPTED = 3,  ///< Dropped or cut off by Stop, a higher priority or a clearing mode
+  FAILED = 4        ///< Rejected by the voice service
+};
+
+/**
+ * @brief One lifecycle transition of a TTS command
+ */
+struct TtsStatusEvent {
+  std::string id;                          ///< TtsCommand::id
+  TtsState state = TtsState::QUEUED;       ///< New state
+  TtsPriority priority = TtsPriority::LOW;  ///< Priority of the command
+  int64_t timestamp = 0;                   ///< Time of the transition (ns since epoch)
+  std::string message;                     ///< Error message for FAILED, reason for INTERRUPTED
+};
+
+/// Receives lifecycle events in order, on the tracker's event thread
+using TtsStatusCallback = std::function<void(const TtsStatusEvent& event)>;
+
+/**
+ * @brief Timing model used to infer playback progress
+ */
+struct TtsTrackerConfig {
+  int start_latency_ms = 300;       ///< Synthesis and output latency between Play and audible start
+  int ms_per_cjk_char = 260;        ///< Speaking time of one CJK character at speed 1.0
+  int ms_per_latin_char = 75;       ///< Speaking time of one ASCII letter or digit at speed 1.0
+  int ms_per_pause = 250;           ///< Pause at sentence or clause punctuation
+  float speed = 1.0f;               ///< Speaking speed (SpeakerConfig::speaker_speed)
+  size_t history_size = 256;        ///< Finished plays remembered for WaitForTts; pending ones are always kept
+};
+
+/**
+ * @brief Estimate how long the voice service takes to speak a text.
+ * @param content TtsCommand::content.
+ * @param config Timing model.
+ * @return Estimated duration (ms), or -1 for a local_music: path whose length is unknown.
+ */
+inline int64_t EstimateTtsDurationMs(const std::string& content, const TtsTrackerConfig& config) {
+  if (content.rfind("local_music:", 0) == 0) {
+    return -1;
+  }
+  double ms = 0.0;
+  for (size_t i = 0; i < content.size();) {
+    auto c = static_cast<unsigned char>(content[i]);
+    if (c < 0x80) {
+      if ((c >= '0' && c <= '9') || (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z')) {
+        ms += config.ms_per_latin_char;
+      } else if (c == ',' || c == '.' || c == '!' || c == '?' || c == ';' || c == ':') {
+        ms += config.ms_per_pause;
+      }
+      ++i;
+      continue;
+    }
+    size_t length = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC0 ? 2 : 1;
+    // U+3000..U+303F (CJK punctuation) and U+FF00..U+FF1F (full-width ，！？ etc.) are pauses, not syllables
+    bool pause = length == 3 && i + 2 < content.size() &&
+                 ((c == 0xE3 && static_cast<unsigned char>(content[i + 1]) == 0x80) ||
+                  (c == 0xEF && static_cast<unsigned char>(content[i + 1]) == 0xBC && static_cast<unsigned char>(content[i + 2]) <= 0x9F));
+    ms += pause ? config.ms_per_pause : config.ms_per_cjk_char;
+    i += length;
+  }
+  return static_cast<int64_t>(ms / (config.speed > 0.1f ? config.speed : 0.1f));
+}
+
+/**
+ * @class TtsTracker
+ * @brief Tracks the lifecycle of TTS commands so callers can wait for speech instead of sleeping.
+ *
+ * The voice service accepts a TtsCommand and returns once it is queued; it reports neither start nor completion.
+ * TtsTracker issues Play and Stop on behalf of the caller and mirrors the service's scheduling rules locally:
+ * a higher TtsPriority interrupts lower-priority playback, CLEARTOP drops the queue and current playback of its
+ * priority, CLEARBUFFER drops only the queued commands and ADD appends. Playback progress is inferred from
+ * TtsTrackerConfig (or an exact duration, e.g. TtsClip::DurationMs) and reported per TtsCommand::id as
+ * QUEUED/STARTED/FINISHED/INTERRUPTED/FAILED events. Commands without a known duration (local_music: paths)
+ * stay STARTED until something interrupts them or Complete is called.
+ *
+ * Example:
+ * @code
+ *   TtsTracker tracker(controller);
+ *   tracker.SubscribeTtsStatus([](const TtsStatusEvent& e) { std::cout << e.id << " " << int(e.state) << std::endl; });
+ *   tracker.Play(tts);
+ *   tracker.WaitForTts(tts.id, 10000);
+ *   motion.ExecuteGait(...);
+ * @endcode
+ */
+class TtsTracker final : public NonCopyable {
+ public:
+  using PlayFunction = std::function<Status(const TtsCommand& cmd)>;
+  using StopFunction = std::function<Status()>;
+
+  /**
+   * @brief Track commands sent through an AudioController.
+   * @param controller Initialized audio controller; must outlive the tracker.
+   * @param config Timing model.
+   */
+  explicit TtsTracker(AudioController& controller, TtsTrackerConfig config = {})
+      : TtsTracker([&controller](const TtsCommand& cmd) { return controller.Play(cmd); },
+                   [&controller] { return controller.Stop(); }, config) {}
+
+  /**
+   * @brief Track commands sent through arbitrary play/stop functions.
+   * @param play Issues a TtsCommand, e.g. to a remote controller.
+   * @param stop Stops all playback.
+   * @param config Timing model.
+   */
+  TtsTracker(PlayFunction play, StopFunction stop, TtsTrackerConfig config = {})
+      : play_(std::move(play)), stop_function_(std::move(stop)), config_(config), thread_([this] { Run(); }) {}
+
+  ~TtsTracker() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+  }
+
+  /**
+   * @brief Subscribe to lifecycle events; replaces a previous subscription.
+   * @param callback Called in order on the event thread; must not block for long.
+   */
+  void SubscribeTtsStatus(const TtsStatusCallback callback) {
+    std::lock_guard<std::mutex> lock(callback_mutex_);
+    callback_ = callback;
+  }
+
+  /**
+   * @brief Update the speaking speed after SetVoiceConfig changed it.
+   * @param speed SpeakerConfig::speaker_speed.
+   */
+  void SetSpeed(float speed) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    config_.speed = speed;
+  }
+
+  /**
+   * @brief Play a command and start tracking it.
+   * @param cmd Command; id should be unique among commands still being tracked.
+   * @param duration_ms Exact playback duration if known (ms); negative to estimate from the text.
+   * @return Status of AudioController::Play.
+   */
+  Status Play(const TtsCommand& cmd, int64_t duration_ms = -1) {
+    Status status = play_(cmd);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto now = Clock::now();
+    if (status.code != ErrorCode::OK) {
+      Emit(cmd.id, TtsState::FAILED, cmd.priority, status.message);
+      cv_.notify_all();
+      return status;
+    }
+    int level = Level(cmd.priority);
+    if (cmd.mode == TtsMode::CLEARTOP || cmd.mode == TtsMode::CLEARBUFFER) {
+      InterruptQueue(level, cmd.mode == TtsMode::CLEARTOP ? "cleared by CLEARTOP" : "cleared by CLEARBUFFER");
+      if (cmd.mode == TtsMode::CLEARTOP && current_.active && Level(current_.priority) == level) {
+        InterruptCurrent("cleared by CLEARTOP");
+      }
+    }
+    if (current_.active && level < Level(current_.priority)) {
+      InterruptCurrent("preempted by higher priority");
+    }
+    Item item;
+    item.id = cmd.id;
+    item.priority = cmd.priority;
+    item.duration_ms = duration_ms >= 0 ? duration_ms : EstimateTtsDurationMs(cmd.content, config_);
+    item.enqueued = now;
+    queues_[level].push_back(std::move(item));
+    Emit(cmd.id, TtsState::QUEUED, cmd.priority, "");
+    cv_.notify_all();
+    return status;
+  }
+
+  /**
+   * @brief Stop all playback; the current and all queued commands become INTERRUPTED.
+   * @return Status of AudioController::Stop.
+   */
+  Status Stop() {
+    Status status = stop_function_();
+    if (status.code != ErrorCode::OK) {
+      return status;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (int level = 0; level < kLevels; ++level) {
+      InterruptQueue(level, "stopped");
+    }
+    if (current_.active) {
+      InterruptCurrent("stopped");
+    }
+    cv_.notify_all();
+    return status;
+  }
+
+  /**
+   * @brief Mark a playing command as finished, e.g. a music file whose end was detected elsewhere.
+   * @param id TtsCommand::id.
+   * @return True if the command was playing.
+   */
+  bool Complete(const std::string& id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!current_.active || current_.id != id) {
+      return false;
+    }
+    Emit(current_.id, TtsState::FINISHED, current_.priority, "");
+    current_.active = false;
+    cv_.notify_all();
+    return true;
+  }
+
+  /**
+   * @brief Block until a command reaches FINISHED, INTERRUPTED or FAILED.
+   * @param id TtsCommand::id.
+   * @param timeout_ms Maximum wait (ms).
+   * @param state Receives the last known state of the command; may be null.
+   * @return OK when finished, SERVICE_ERROR when interrupted or failed, TIMEOUT when still pending,
+   *         INTERNAL_ERROR for an id that was never played.
+   */
+  Status WaitForTts(const std::string& id, int timeout_ms, TtsState* state = nullptr) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    auto terminal = [this, &id] {
+      auto it = states_.find(id);
+      return it == states_.end() || IsTerminal(it->second.state);
+    };
+    bool done = cv_.wait_for(lock, std::chrono::milliseconds(timeout_ms), terminal);
+    auto it = states_.find(id);
+    if (it == states_.end()) {
+      return {ErrorCode::INTERNAL_ERROR, "unknown tts id: " + id};
+    }
+    if (state != nullptr) {
+      *state = it->second.state;
+    }
+    if (!done) {
+      return {ErrorCode::TIMEOUT, "tts still pending: " + id};
+    }
+    if (it->second.state != TtsState::FINISHED) {
+      return {ErrorCode::SERVICE_ERROR, it->second.state == TtsState::FAILED ? "tts failed: " + id : "tts interrupted: " + id};
+    }
+    return {ErrorCode::OK, ""};
+  }
+
+  /**
+   * @brief Last known state of a command.
+   * @param id TtsCommand::id.
+   * @param state Receives the state.
+   * @return False if the id is unknown or has been forgotten.
+   */
+  bool GetTtsState(const std::string& id, TtsState& state) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = states_.find(id);
+    if (it == states_.end()) {
+      return false;
+    }
+    state = it->second.state;
+    return true;
+  }
+
+  /**
+   * @brief Whether any command is playing or queued.
+   */
+  bool IsBusy() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (current_.active) {
+      return true;
+    }
+    for (const auto& queue : queues_) {
+      if (!queue.empty()) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+ private:
+  using Clock = std::chrono::steady_clock;
+  static constexpr int kLevels = 3;
+
+  struct Item {
+    std::string id;
+    TtsPriority priority = TtsPriority::LOW;
+    int64_t duration_ms = -1;
+    Clock::time_point enqueued;
+  };
+
+  struct Playing {
+    bool active = false;
+    bool started = false;
+    std::string id;
+    TtsPriority priority = TtsPriority::LOW;
+    int64_t duration_ms = -1;
+    Clock::time_point start;
+  };
+
+  struct TrackedState {
+    TtsState state = TtsState::QUEUED;
+    uint64_t generation = 0;  // Play of the id this state belongs to
+  };
+
+  static int Level(TtsPriority priority) {
+    int level = static_cast<int>(priority);
+    return level < 0 ? 0 : level >= kLevels ? kLevels - 1 : level;
+  }
+
+  void InterruptQueue(int level, const char* reason) {
+    for (const auto& item : queues_[level]) {
+      Emit(item.id, TtsState::INTERRUPTED, item.priority, reason);
+    }
+    queues_[level].clear();
+  }
+
+  void InterruptCurrent(const char* reason) {
+    Emit(current_.id, TtsState::INTERRUPTED, current_.priority, reason);
+    current_.active = false;
+  }
+
+  static bool IsTerminal(TtsState state) {
+    return state == TtsState::FINISHED || state == TtsState::INTERRUPTED || state == TtsState::FAILED;
+  }
+
+  /// Record a transition and queue it for delivery; caller holds mutex_
+  void Emit(const std::string& id, TtsState state, TtsPriority priority, std::string message) {
+    TrackedState& tracked = states_[id];
+    // Each play of an id is a new generation, so evicting an older play of a replayed id keeps the newer state
+    if (tracked.generation == 0 || state == TtsState::QUEUED) {
+      tracked.generation = ++generation_;
+    }
+    tracked.state = state;
+    // Only finished plays enter the history; pending ids stay until they finish
+    if (IsTerminal(state)) {
+      history_.emplace_back(id, tracked.generation);
+    }
+    while (history_.size() > config_.history_size) {
+      auto old = states_.find(history_.front().first);
+      if (old != states_.end() && old->second.generation == history_.front().second) {
+        states_.erase(old);
+      }
+      history_.pop_front();
+    }
+    events_.push_back({id, state, priority, detail::AudioNowNs(), std::move(message)});
+  }
+
+  /// Advance the playback model to now; returns the next time it changes
+  Clock::time_point Advance(Clock::time_point now) {
+    Clock::time_point free_at = now;
+    for (;;) {
+      if (!current_.active) {
+        int level = 0;
+        while (level < kLevels && queues_[level].empty()) {
+          ++level;
+        }
+        if (level == kLevels) {
+          return Clock::time_point::max();
+        }
+        Item item = std::move(queues_[level].front());
+        queues_[level].pop_front();
+        current_.active = true;
+        current_.started = false;
+        current_.id = std::move(item.id);
+        current_.priority = item.priority;
+        current_.duration_ms = item.duration_ms;
+        // Synthesis of a queued command overlaps the previous playback; only the first pays the full latency
+        auto ready = item.enqueued + std::chrono::milliseconds(config_.start_latency_ms);
+        current_.start = std::max(ready, free_at);
+      }
+      if (!current_.started) {
+        if (now < current_.start) {
+          return current_.start;
+        }
+        current_.started = true;
+        Emit(current_.id, TtsState::STARTED, current_.priority, "");
+      }
+      if (current_.duration_ms < 0) {
+        return Clock::time_point::max();
+      }
+      auto end = current_.start + std::chrono::milliseconds(current_.duration_ms);
+      if (now < end) {
+        return end;
+      }
+      Emit(current_.id, TtsState::FINISHED, current_.priority, "");
+      current_.active = false;
+      // The next command starts where this one ended, not when the tracker noticed
+      free_at = end;
+    }
+  }
+
+  void Run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    std::vector<TtsStatusEvent> events;
+    while (!stop_) {
+      auto next = Advance(Clock::now());
+      if (!events_.empty()) {
+        events.swap(events_);
+        cv_.notify_all();
+        lock.unlock();
+        {
+          std::lock_guard<std::mutex> callback_lock(callback_mutex_);
+          if (callback_) {
+            for (const auto& event : events) {
+              callback_(event);
+            }
+          }
+        }
+        events.clear();
+        lock.lock();
+        continue;
+      }
+      if (next == Clock::time_point::max()) {
+        cv_.wait(lock);
+      } else {
+        cv_.wait_until(lock, next);
+      }
+    }
+  }
+
+  PlayFunction play_;
+  StopFunction stop_function_;
+  TtsTrackerConfig config_;
+
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  std::array<std::deque<Item>, kLevels> queues_;
+  Playing current_;
+  std::unordered_map<std::string, TrackedState> states_;
+  std::deque<std::pair<std::string, uint64_t>> history_;  // Finished plays, oldest first
+  uint64_t generation_{0};
+  std::vector<TtsStatusEvent> events_;
+  bool stop_{false};
+
+  std::mutex callback_mutex_;
+  TtsStatusCallback callback_;
+
+  std::thread thread_;
+};
+
+}  // namespace magic::dog::audio
@@ -381,6 +381,20 @@ struct Header {
   std::string frame_id;  ///< Coordinate frame name
 };
 
+/**
+ * @brief Point field data type constants, same values as ROS2 sensor_msgs::msg::PointField.
+ */
+enum PointFieldDataType : int8_t {
+  POINT_FIELD_INT8 = 1,
+  POINT_FIELD_UINT8 = 2,
+  POINT_FIELD_INT16 = 3,
+  POINT_FIELD_UINT16 = 4,
+  POINT_FIELD_INT32 = 5,
+  POINT_FIELD_UINT32 = 6,
+  POINT_FIELD_FLOAT32 = 7,
+  POINT_FIELD_FLOAT64 = 8,
+};
+
 /**
  * @brief Point cloud field description structure, corresponding to ROS2 sensor_msgs::msg::PointField.
  */
@@ -0,0 +1,396 @@
+#pragma once
+
+#include "magic_audio_ring.h"
+#include "magic_simd.h"
+#include "magic_type.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace magic::dog::audio {
+
+/**
+ * @brief Voice activity detection and utterance segmentation parameters
+ */
+struct VadConfig {
+  int32_t sample_rate = 16000;        ///< Sample rate of the stream (Hz); the BF voice stream is 16 kHz mono S16LE
+  int32_t frame_ms = 10;              ///< Analysis frame length (ms)
+  float min_energy_db = -50.0f;       ///< Frames quieter than this (dBFS) are never speech
+  float noise_margin_db = 12.0f;      ///< Speech must exceed the tracked noise floor by this margin (dB)
+  float max_zero_crossing_rate = 0.4f;  ///< Frames crossing zero more often are treated as noise unless clearly loud
+  int32_t onset_ms = 60;              ///< Consecutive speech needed to open an utterance (ms)
+  int32_t hangover_ms = 500;          ///< Silence after speech before the utterance is closed (ms)
+  int32_t pre_roll_ms = 200;          ///< Audio kept before the detected onset (ms)
+  int32_t post_roll_ms = 150;         ///< Audio kept after the last speech frame (ms)
+  int32_t min_speech_ms = 200;        ///< Utterances with less speech are dropped (ms)
+  int32_t max_utterance_ms = 15000;   ///< Longer utterances are split (ms)
+};
+
+/**
+ * @brief One complete utterance as contiguous mono PCM
+ */
+struct Utterance {
+  int64_t start_time = 0;        ///< Capture time of the first sample (ns, system clock)
+  int64_t end_time = 0;          ///< Capture time just after the last sample (ns, system clock)
+  int32_t sample_rate = 16000;   ///< Sample rate (Hz)
+  std::vector<int16_t> samples;  ///< S16 samples including pre- and post-roll
+};
+
+namespace detail {
+
+/// Per-frame sums for energy and zero-crossing rate
+struct FrameFeatures {
+  int64_t sum = 0;          ///< Sum of samples
+  uint64_t sum_squares = 0; ///< Sum of squared samples
+  int32_t crossings = 0;    ///< Sign changes between consecutive samples, including previous -> samples[0]
+};
+
+/// Energy and zero-crossing sums of one frame; previous is the sample preceding the frame
+inline FrameFeatures ComputeFrameFeatures(const int16_t* samples, size_t n, int16_t previous) {
+  FrameFeatures features;
+  if (n == 0) {
+    return features;
+  }
+  features.crossings = (previous < 0) != (samples[0] < 0);
+  size_t i = 0;
+#if defined(MAGIC_SIMD_AVX2)
+  const __m256i ones = _mm256_set1_epi16(1);
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i sums = zero;
+  __m256i squares = zero;
+  int32_t crossings = 0;
+  // Lane 0 compares against samples[-1], so the vector loop starts at 1
+  for (i = 1; i + 16 <= n; i += 16) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(samples + i));
+    __m256i before = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(samples + i - 1));
+    sums = _mm256_add_epi32(sums, _mm256_madd_epi16(v, ones));
+    // Pair sums reach 2^31 only for two -32768 samples, which is still exact when read as unsigned
+    __m256i pairs = _mm256_madd_epi16(v, v);
+    squares = _mm256_add_epi64(squares, _mm256_add_epi64(_mm256_unpacklo_epi32(pairs, zero), _mm256_unpackhi_epi32(pairs, zero)));
+    __m256i changed = _mm256_xor_si256(_mm256_cmpgt_epi16(zero, v), _mm256_cmpgt_epi16(zero, before));
+    crossings += __builtin_popcount(static_cast<uint32_t>(_mm256_movemask_epi8(changed))) / 2;
+  }
+  alignas(32) int32_t sum_lanes[8];
+  alignas(32) uint64_t square_lanes[4];
+  _mm256_store_si256(reinterpret_cast<__m256i*>(sum_lanes), sums);
+  _mm256_store_si256(reinterpret_cast<__m256i*>(square_lanes), squares);
+  for (int32_t lane = 0; lane < 8; ++lane) {
+    features.sum += sum_lanes[lane];
+  }
+  for (int32_t lane = 0; lane < 4; ++lane) {
+    features.sum_squares += square_lanes[lane];
+  }
+  features.crossings += crossings;
+  features.sum += samples[0];
+  features.sum_squares += static_cast<uint64_t>(static_cast<int32_t>(samples[0]) * samples[0]);
+#elif defined(MAGIC_SIMD_NEON)
+  int32x4_t sums = vdupq_n_s32(0);
+  uint64x2_t squares = vdupq_n_u64(0);
+  int16x8_t crossings = vdupq_n_s16(0);
+  const int16x8_t zero = vdupq_n_s16(0);
+  for (i = 1; i + 8 <= n; i += 8) {
+    int16x8_t v = vld1q_s16(samples + i);
+    int16x8_t before = vld1q_s16(samples + i - 1);
+    sums = vpadalq_s16(sums, v);
+    uint32x4_t low = vreinterpretq_u32_s32(vmull_s16(vget_low_s16(v), vget_low_s16(v)));
+    uint32x4_t high = vreinterpretq_u32_s32(vmull_s16(vget_high_s16(v), vget_high_s16(v)));
+    squares = vpadalq_u32(vpadalq_u32(squares, low), high);
+    uint16x8_t changed = veorq_u16(vcltq_s16(v, zero), vcltq_s16(before, zero));
+    crossings = vsubq_s16(crossings, vreinterpretq_s16_u16(changed));
+  }
+  features.sum = vaddvq_s32(sums) + samples[0];
+  features.sum_squares = vgetq_lane_u64(squares, 0) + vgetq_lane_u64(squares, 1) + static_cast<uint64_t>(static_cast<int32_t>(samples[0]) * samples[0]);
+  features.crossings += vaddlvq_s16(crossings);
+#else
+  features.sum = samples[0];
+  features.sum_squares = static_cast<uint64_t>(static_cast<int32_t>(samples[0]) * samples[0]);
+  i = 1;
+#endif
+  for (; i < n; ++i) {
+    int32_t s = samples[i];
+    features.sum += s;
+    features.sum_squares += static_cast<uint64_t>(s * s);
+    features.crossings += (samples[i - 1] < 0) != (s < 0);
+  }
+  return features;
+}
+
+}  // namespace detail
+
+/**
+ * @class UtteranceSegmenter
+ * @brief Streaming voice activity detection that turns the BF voice stream into complete utterances.
+ *
+ * The stream is cut into fixed analysis frames. A frame counts as speech when its DC-free energy exceeds both an
+ * absolute floor and an adaptive noise floor by a margin, and its zero-crossing rate is speech-like (noise-like
+ * frames only pass when clearly loud). An utterance opens after onset_ms of speech, closes after hangover_ms of
+ * silence, and is delivered as one contiguous buffer with pre- and post-roll and capture timestamps.
+ *
+ * Capture times are derived from the sample count with the same sample clock as AudioRingBuffer (anchored to chunk
+ * arrival times, re-anchored after gaps). Energy and zero-crossing sums are vectorised
+ * (AVX2 / NEON).
+ *
+ * Example:
+ * @code
+ *   UtteranceSegmenter segmenter;
+ *   segmenter.SetUtteranceCallback([](std::shared_ptr<const Utterance> utterance) {
+ *     queue.Push(utterance);  // upload from a worker thread
+ *   });
+ *   controller.SubscribeBfVoiceData(segmenter.Callback());
+ * @endcode
+ */
+class UtteranceSegmenter final : public NonCopyable {
+ public:
+  using UtterancePtr = std::shared_ptr<const Utterance>;
+  using UtteranceCallback = std::function<void(const UtterancePtr)>;
+  using ByteMultiArrayCallback = std::function<void(const std::shared_ptr<ByteMultiArray>)>;
+
+  explicit UtteranceSegmenter(const VadConfig& config = {}) : config_(config) {
+    config_.sample_rate = std::max(config_.sample_rate, 1000);
+    config_.frame_ms = std::clamp(config_.frame_ms, 5, 100);
+    clock_ = detail::SampleClock(config_.sample_rate);
+    frame_size_ = static_cast<size_t>(config_.sample_rate) * config_.frame_ms / 1000;
+    frame_.reserve(frame_size_);
+    Reset();
+  }
+
+  /// Set the callback receiving completed utterances; it runs on the thread calling Process
+  void SetUtteranceCallback(const UtteranceCallback callback) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    callback_ = callback;
+  }
+
+  /**
+   * @brief Feed mono S16 samples.
+   * @param samples Samples following the previously fed ones.
+   * @param count Number of samples.
+   * @param arrival_time Time the chunk was received (ns, system clock), 0 for now.
+   */
+  void Process(const int16_t* samples, size_t count, int64_t arrival_time = 0) {
+    std::vector<UtterancePtr> completed;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      // samples_total_ only counts completed frames; the buffered partial frame precedes this chunk
+      clock_.Update(samples_total_ + static_cast<int64_t>(frame_.size() + count), arrival_time != 0 ? arrival_time : detail::AudioNowNs());
+      for (size_t i = 0; i < count;) {
+        size_t take = std::min(count - i, frame_size_ - frame_.size());
+        frame_.insert(frame_.end(), samples + i, samples + i + take);
+        i += take;
+        if (frame_.size() == frame_size_) {
+          ProcessFrame(completed);
+          frame_.clear();
+        }
+      }
+    }
+    Deliver(completed);
+  }
+
+  /// Feed one BF voice message (S16LE mono bytes)
+  void Process(const ByteMultiArray& msg, int64_t arrival_time = 0) {
+    thread_local std::vector<int16_t> samples;
+    samples.resize(msg.data.size() / 2);
+    if (!samples.empty()) {
+      std::memcpy(samples.data(), msg.data.data(), samples.size() * 2);
+    }
+    Process(samples.data(), samples.size(), arrival_time);
+  }
+
+  /// Callback for SubscribeBfVoiceData; the segmenter must outlive the subscription
+  ByteMultiArrayCallback Callback() {
+    return [this](const std::shared_ptr<ByteMultiArray> msg) {
+      if (msg) {
+        Process(*msg);
+      }
+    };
+  }
+
+  /// Close and deliver the current utterance, e.g. at the end of a push-to-talk window
+  void Flush() {
+    std::vector<UtterancePtr> completed;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (in_utterance_) {
+        FinishUtterance(completed);
+      }
+    }
+    Deliver(completed);
+  }
+
+  /// Drop all state, including the noise floor estimate and the sample clock
+  void Reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    frame_.clear();
+    history_.clear();
+    current_.reset();
+    in_utterance_ = false;
+    speech_run_ = 0;
+    silence_run_ = 0;
+    speech_frames_ = 0;
+    noise_db_ = 0.0f;
+    noise_initialized_ = false;
+    previous_sample_ = 0;
+    samples_total_ = 0;
+    clock_.Reset();
+    speech_active_ = false;
+  }
+
+  /// Whether the last analysed frame was speech
+  bool IsSpeechActive() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return speech_active_;
+  }
+
+  /// Current noise floor estimate (dBFS)
+  float GetNoiseFloorDb() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return noise_db_;
+  }
+
+ private:
+  int64_t FramesFor(int32_t ms) const { return (static_cast<int64_t>(ms) + config_.frame_ms - 1) / config_.frame_ms; }
+
+  bool IsSpeechFrame(const detail::FrameFeatures& features) {
+    double n = static_cast<double>(frame_size_);
+    double mean = static_cast<double>(features.sum) / n;
+    double power = std::max(static_cast<double>(features.sum_squares) / n - mean * mean, 1e-3);
+    float energy_db = static_cast<float>(10.0 * std::log10(power / (32768.0 * 32768.0)));
+    float zcr = static_cast<float>(features.crossings) / static_cast<float>(frame_size_);
+    if (!noise_initialized_) {
+      noise_db_ = energy_db;
+      noise_initialized_ = true;
+    }
+    float threshold = std::max(config_.min_energy_db, noise_db_ + config_.noise_margin_db);
+    bool speech = energy_db > threshold && (zcr < config_.max_zero_crossing_rate || energy_db > threshold + 10.0f);
+    // The floor follows drops immediately and rises slowly, and only on non-speech frames
+    if (energy_db < noise_db_) {
+      noise_db_ = energy_db;
+    } else if (!speech) {
+      noise_db_ += 0.02f * (energy_db - noise_db_);
+    } else {
+      noise_db_ += 0.001f * (energy_db - noise_db_);
+    }
+    return speech;
+  }
+
+  void ProcessFrame(std::vector<UtterancePtr>& completed) {
+    detail::FrameFeatures features = detail::ComputeFrameFeatures(frame_.data(), frame_.size(), previous_sample_);
+    previous_sample_ = frame_.back();
+    int64_t frame_start = samples_total_;
+    samples_total_ += static_cast<int64_t>(frame_.size());
+    bool speech = IsSpeechFrame(features);
+    speech_active_ = speech;
+
+    if (!in_utterance_) {
+      history_.insert(history_.end(), frame_.begin(), frame_.end());
+      history_start_ = samples_total_ - static_cast<int64_t>(history_.size());
+      speech_run_ = speech ? speech_run_ + 1 : 0;
+      if (speech_run_ >= FramesFor(config_.onset_ms)) {
+        StartUtterance(frame_start);
+      } else {
+        // Keep the pre-roll plus the frames of a possible onset
+        size_t keep = static_cast<size_t>(config_.sample_rate) * config_.pre_roll_ms / 1000 + frame_size_ * FramesFor(config_.onset_ms);
+        if (history_.size() > keep + frame_size_ * 8) {
+          history_.erase(history_.begin(), history_.end() - keep);
+          history_start_ = samples_total_ - static_cast<int64_t>(history_.size());
+        }
+      }
+      return;
+    }
+
+    current_->samples.insert(current_->samples.end(), frame_.begin(), frame_.end());
+    if (speech) {
+      ++speech_frames_;
+      silence_run_ = 0;
+      last_speech_end_ = samples_total_;
+    } else {
+      ++silence_run_;
+    }
+    int64_t length = samples_total_ - utterance_start_;
+    if (silence_run_ >= FramesFor(config_.hangover_ms) ||
+        length >= static_cast<int64_t>(config_.sample_rate) * config_.max_utterance_ms / 1000) {
+      FinishUtterance(completed);
+    }
+  }
+
+  void StartUtterance(int64_t frame_start) {
+    int64_t onset = frame_start - static_cast<int64_t>(frame_size_) * (speech_run_ - 1);
+    int64_t start = std::max(onset - static_cast<int64_t>(config_.sample_rate) * config_.pre_roll_ms / 1000, history_start_);
+    auto utterance = std::make_shared<Utterance>();
+    utterance->sample_rate = config_.sample_rate;
+    utterance->samples.reserve(static_cast<size_t>(config_.sample_rate) * 4);
+    utterance->samples.assign(history_.begin() + (start - history_start_), history_.end());
+    current_ = std::move(utterance);
+    utterance_start_ = start;
+    last_speech_end_ = samples_total_;
+    speech_frames_ = speech_run_;
+    silence_run_ = 0;
+    in_utterance_ = true;
+    history_.clear();
+  }
+
+  void FinishUtterance(std::vector<UtterancePtr>& completed) {
+    int64_t end = std::min(last_speech_end_ + static_cast<int64_t>(config_.sample_rate) * config_.post_roll_ms / 1000,
+                           utterance_start_ + static_cast<int64_t>(current_->samples.size()));
+    int64_t speech_ms = speech_frames_ * config_.frame_ms;
+    in_utterance_ = false;
+    speech_run_ = 0;
+    silence_run_ = 0;
+    // Audio after the cut stays available as pre-roll of the next utterance
+    history_.assign(current_->samples.begin() + (end - utterance_start_), current_->samples.end());
+    history_start_ = end;
+    if (speech_ms >= config_.min_speech_ms) {
+      current_->samples.resize(static_cast<size_t>(end - utterance_start_));
+      current_->start_time = clock_.TimeAt(utterance_start_);
+      current_->end_time = clock_.TimeAt(end);
+      completed.push_back(std::move(current_));
+    }
+    current_.reset();
+  }
+
+  void Deliver(const std::vector<UtterancePtr>& completed) {
+    if (completed.empty()) {
+      return;
+    }
+    UtteranceCallback callback;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      callback = callback_;
+    }
+    if (callback) {
+      for (const UtterancePtr& utterance : completed) {
+        callback(utterance);
+      }
+    }
+  }
+
+  VadConfig config_;
+  size_t frame_size_{160};
+  mutable std::mutex mutex_;
+  UtteranceCallback callback_;
+  std::vector<int16_t> frame_;
+  std::vector<int16_t> history_;
+  int64_t history_start_{0};
+  std::shared_ptr<Utterance> current_;
+  bool in_utterance_{false};
+  bool speech_active_{false};
+  int64_t speech_run_{0};
+  int64_t silence_run_{0};
+  int64_t speech_frames_{0};
+  int64_t utterance_start_{0};
+  int64_t last_speech_end_{0};
+  float noise_db_{0.0f};
+  bool noise_initialized_{false};
+  int16_t previous_sample_{0};
+  int64_t samples_total_{0};
+  detail::SampleClock clock_;
+};
+
+}  // namespace magic::dog::audio
@@ -0,0 +1,436 @@
+#pragma once
+
+#include "magic_audio.h"
+#include "magic_type.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+
+namespace magic::dog::audio {
+
+/**
+ * @brief Parts of GetSpeechConfig, as a bit mask of what changed
+ */
+enum VoiceConfigField : uint32_t {
+  VOICE_CONFIG_SPEAKER = 1u << 0,     ///< Selected speaker or region
+  VOICE_CONFIG_SPEED = 1u << 1,       ///< Speaker speed
+  VOICE_CONFIG_BOT = 1u << 2,         ///< Selected bot
+  VOICE_CONFIG_CUSTOM_BOT = 1u << 3,  ///< Custom bots
+  VOICE_CONFIG_WAKEUP = 1u << 4,      ///< Wakeup name
+  VOICE_CONFIG_DIALOG = 1u << 5,      ///< Dialog switches
+  VOICE_CONFIG_TTS_TYPE = 1u << 6,    ///< Speech model
+  VOICE_CONFIG_CATALOG = 1u << 7,     ///< Available speakers, bots or wakeup words
+};
+
+/**
+ * @brief Partial voice configuration update; unset fields keep their current value
+ */
+struct VoiceConfigPatch {
+  std::optional<std::string> speaker_id{};      ///< Speaker id
+  std::optional<std::string> region{};          ///< Speaker region
+  std::optional<std::string> bot_id{};          ///< Bot id
+  std::optional<bool> is_front_doa{};           ///< Force front direction recognition
+  std::optional<bool> is_fullduplex_enable{};   ///< Natural conversation
+  std::optional<bool> is_enable{};              ///< Speech switch
+  std::optional<bool> is_doa_enable{};          ///< Wakeup direction head turning
+  std::optional<float> speaker_speed{};         ///< TTS playback speed [1, 2]
+  std::optional<std::string> wakeup_name{};     ///< Wakeup name
+  std::optional<CustomBotMap> custom_bot{};     ///< Custom bots, replaced as a whole
+};
+
+/// Receives the new configuration and the VoiceConfigField bits that changed
+using VoiceConfigCallback = std::function<void(const GetSpeechConfig& config, uint32_t changed)>;
+
+namespace detail {
+
+inline bool SameCustomBots(const CustomBotMap& a, const CustomBotMap& b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (auto i = a.begin(), j = b.begin(); i != a.end(); ++i, ++j) {
+    if (i->first != j->first || i->second.name != j->second.name || i->second.workflow != j->second.workflow ||
+        i->second.token != j->second.token) {
+      return false;
+    }
+  }
+  return true;
+}
+
+inline bool SameBots(const std::map<std::string, BotInfo>& a, const std::map<std::string, BotInfo>& b) {
+  if (a.size() != b.size()) {
+    return false;
+  }
+  for (auto i = a.begin(), j = b.begin(); i != a.end(); ++i, ++j) {
+    if (i->first != j->first || i->second.name != j->second.name || i->second.workflow != j->second.workflow) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/// Apply a patch to a full configuration, returning the VoiceConfigField bits it actually changes
+inline uint32_t ApplyVoiceConfigPatch(const VoiceConfigPatch& patch, GetSpeechConfig& config) {
+  uint32_t changed = 0;
+  auto assign = [&changed](auto& field, const auto& value, uint32_t bit) {
+    if (value && !(field == *value)) {
+      field = *value;
+      changed |= bit;
+    }
+  };
+  assign(config.speaker_config.selected.speaker_id, patch.speaker_id, VOICE_CONFIG_SPEAKER);
+  assign(config.speaker_config.selected.region, patch.region, VOICE_CONFIG_SPEAKER);
+  assign(config.speaker_config.speaker_speed, patch.speaker_speed, VOICE_CONFIG_SPEED);
+  assign(config.bot_config.selected.bot_id, patch.bot_id, VOICE_CONFIG_BOT);
+  assign(config.wakeup_config.name, patch.wakeup_name, VOICE_CONFIG_WAKEUP);
+  assign(config.dialog_config.is_front_doa, patch.is_front_doa, VOICE_CONFIG_DIALOG);
+  assign(config.dialog_config.is_fullduplex_enable, patch.is_fullduplex_enable, VOICE_CONFIG_DIALOG);
+  assign(config.dialog_config.is_enable, patch.is_enable, VOICE_CONFIG_DIALOG);
+  assign(config.dialog_config.is_doa_enable, patch.is_doa_enable, VOICE_CONFIG_DIALOG);
+  if (patch.custom_bot && !SameCustomBots(config.bot_config.custom_data, *patch.custom_bot)) {
+    config.bot_config.custom_data = *patch.custom_bot;
+    changed |= VOICE_CONFIG_CUSTOM_BOT;
+  }
+  return changed;
+}
+
+/// Patch that sets every field of a complete configuration
+inline VoiceConfigPatch MakeVoiceConfigPatch(const SetSpeechConfig& to) {
+  VoiceConfigPatch patch;
+  patch.speaker_id = to.speaker_id;
+  patch.region = to.region;
+  patch.bot_id = to.bot_id;
+  patch.is_front_doa = to.is_front_doa;
+  patch.is_fullduplex_enable = to.is_fullduplex_enable;
+  patch.is_enable = to.is_enable;
+  patch.is_doa_enable = to.is_doa_enable;
+  patch.speaker_speed = to.speaker_speed;
+  patch.wakeup_name = to.wakeup_name;
+  patch.custom_bot = to.custom_bot;
+  return patch;
+}
+
+}  // namespace detail
+
+/**
+ * @brief Compare two voice configurations.
+ * @return VoiceConfigField bits of the parts that differ; 0 if equal.
+ */
+inline uint32_t DiffVoiceConfig(const GetSpeechConfig& a, const GetSpeechConfig& b) {
+  uint32_t changed = 0;
+  if (a.speaker_config.selected.speaker_id != b.speaker_config.selected.speaker_id ||
+      a.speaker_config.selected.region != b.speaker_config.selected.region) {
+    changed |= VOICE_CONFIG_SPEAKER;
+  }
+  if (a.speaker_config.speaker_speed != b.speaker_config.speaker_speed) {
+    changed |= VOICE_CONFIG_SPEED;
+  }
+  if (a.bot_config.selected.bot_id != b.bot_config.selected.bot_id) {
+    changed |= VOICE_CONFIG_BOT;
+  }
+  if (!detail::SameCustomBots(a.bot_config.custom_data, b.bot_config.custom_data)) {
+    changed |= VOICE_CONFIG_CUSTOM_BOT;
+  }
+  if (a.wakeup_config.name != b.wakeup_config.name) {
+    changed |= VOICE_CONFIG_WAKEUP;
+  }
+  if (a.dialog_config.is_front_doa != b.dialog_config.is_front_doa ||
+      a.dialog_config.is_fullduplex_enable != b.dialog_config.is_fullduplex_enable ||
+      a.dialog_config.is_enable != b.dialog_config.is_enable || a.dialog_config.is_doa_enable != b.dialog_config.is_doa_enable) {
+    changed |= VOICE_CONFIG_DIALOG;
+  }
+  if (a.tts_type != b.tts_type) {
+    changed |= VOICE_CONFIG_TTS_TYPE;
+  }
+  if (a.speaker_config.data != b.speaker_config.data || !detail::SameBots(a.bot_config.data, b.bot_config.data) ||
+      a.wakeup_config.data != b.wakeup_config.data) {
+    changed |= VOICE_CONFIG_CATALOG;
+  }
+  return changed;
+}
+
+/**
+ * @class VoiceConfigCache
+ * @brief Local copy of the robot's voice configuration with change notifications and patch-style updates.
+ *
+ * GetVoiceConfig is a blocking RPC returning the full configuration including the speaker, bot and wakeup word
+ * catalogs, and SetVoiceConfig only accepts a complete SetSpeechConfig. The cache fetches the configuration once
+ * and answers Get from memory. Update takes a VoiceConfigPatch, merges it into the cached configuration and
+ * issues SetVoiceConfig only if something actually changes; on success the cache is updated in place, so toggling
+ * one switch costs a single Set instead of a Get plus a Set, and re-applying the current value costs nothing.
+ * The service protocol has no partial update, so the Set itself still carries every settable field.
+ *
+ * Changes made elsewhere (e.g. from the phone app) are picked up by Refresh, called explicitly or every
+ * refresh_interval_ms. Subscribers are told which VoiceConfigField parts changed.
+ *
+ * Example:
+ * @code
+ *   VoiceConfigCache voice(controller, 30000);
+ *   voice.SubscribeVoiceConfig([](const GetSpeechConfig& config, uint32_t changed) {
+ *     if (changed & VOICE_CONFIG_SPEED) { tracker.SetSpeed(config.speaker_config.speaker_speed); }
+ *   });
+ *   voice.Update({.is_fullduplex_enable = true});
+ * @endcode
+ */
+class VoiceConfigCache final : public NonCopyable {
+ public:
+  using GetFunction = std::function<Status(GetSpeechConfig& config, int timeout_ms)>;
+  using SetFunction = std::function<Status(const SetSpeechConfig& config, int timeout_ms)>;
+  using SwitchFunction = std::function<Status(TtsType tts_type, GetSpeechConfig& config, int timeout_ms)>;
+
+  /**
+   * @brief Cache the configuration of an AudioController.
+   * @param controller Initialized audio controller; must outlive the cache.
+   * @param refresh_interval_ms Period of background Refresh; 0 disables it.
+   */
+  explicit VoiceConfigCache(AudioController& controller, int refresh_interval_ms = 0)
+      : VoiceConfigCache([&controller](GetSpeechConfig& config, int timeout_ms) { return controller.GetVoiceConfig(config, timeout_ms); },
+                         [&controller](const SetSpeechConfig& config, int timeout_ms) { return controller.SetVoiceConfig(config, timeout_ms); },
+                         [&controller](TtsType tts_type, GetSpeechConfig& config, int timeout_ms) {
+                           return controller.SwitchTtsVoiceModel(tts_type, config, timeout_ms);
+                         },
+                         refresh_interval_ms) {}
+
+  /**
+   * @brief Cache a configuration reached through arbitrary functions.
+   * @param get Fetches the full configuration.
+   * @param set Applies a full configuration.
+   * @param switch_model Switches the speech model and returns the new configuration; may be empty.
+   * @param refresh_interval_ms Period of background Refresh; 0 disables it.
+   */
+  VoiceConfigCache(GetFunction get, SetFunction set, SwitchFunction switch_model, int refresh_interval_ms = 0)
+      : get_(std::move(get)), set_(std::move(set)), switch_(std::move(switch_model)), refresh_interval_ms_(refresh_interval_ms) {
+    if (refresh_interval_ms_ > 0) {
+      thread_ = std::thread([this] { RefreshLoop(); });
+    }
+  }
+
+  ~VoiceConfigCache() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+    if (thread_.joinable()) {
+      thread_.join();
+    }
+  }
+
+  /**
+   * @brief Subscribe to configuration changes; replaces a previous subscription.
+   * @param callback Called after the cache changed, on the thread that caused the change; may call Update.
+   */
+  void SubscribeVoiceConfig(const VoiceConfigCallback callback) {
+    std::lock_guard<std::mutex> lock(callback_mutex_);
+    callback_ = callback;
+  }
+
+  /**
+   * @brief Current configuration, fetched only if the cache is empty.
+   * @param config Receives the configuration.
+   * @param timeout_ms Timeout of the fetch.
+   * @return Status of the fetch, OK when served from the cache.
+   */
+  Status Get(GetSpeechConfig& config, int timeout_ms = 5000) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (valid_) {
+        config = config_;
+        return {ErrorCode::OK, ""};
+      }
+    }
+    Status status = Refresh(timeout_ms);
+    if (status.code == ErrorCode::OK) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      config = config_;
+    }
+    return status;
+  }
+
+  /**
+   * @brief Fetch the configuration from the robot and notify if it differs from the cache.
+   * @param timeout_ms Timeout of the fetch.
+   * @return Status of the fetch.
+   */
+  Status Refresh(int timeout_ms = 5000) {
+    GetSpeechConfig copy;
+    uint32_t changed = 0;
+    Status status;
+    {
+      std::lock_guard<std::mutex> rpc_lock(rpc_mutex_);
+      GetSpeechConfig fresh;
+      status = get_(fresh, timeout_ms);
+      if (status.code != ErrorCode::OK) {
+        return status;
+      }
+      changed = Store(std::move(fresh), 0, copy);
+    }
+    Notify(copy, changed);
+    return status;
+  }
+
+  /**
+   * @brief Change some fields, sending SetVoiceConfig only if the patch changes anything.
+   * @param patch Fields to change.
+   * @param timeout_ms Timeout of each RPC.
+   * @return OK if applied or already in effect; otherwise the status of the failed RPC.
+   */
+  Status Update(const VoiceConfigPatch& patch, int timeout_ms = 5000) {
+    GetSpeechConfig fetched;
+    uint32_t fetched_changed = 0;
+    GetSpeechConfig copy;
+    uint32_t changed = 0;
+    Status status{ErrorCode::OK, ""};
+    {
+      std::lock_guard<std::mutex> rpc_lock(rpc_mutex_);
+      GetSpeechConfig next;
+      if (!IsValid()) {
+        status = get_(next, timeout_ms);
+        if (status.code != ErrorCode::OK) {
+          return status;
+        }
+        fetched_changed = Store(next, 0, fetched);
+      } else {
+        std::lock_guard<std::mutex> lock(mutex_);
+        next = config_;
+      }
+      changed = detail::ApplyVoiceConfigPatch(patch, next);
+      if (changed == 0) {
+        ++skipped_updates_;
+      } else {
+        status = set_(ToSetSpeechConfig(next), timeout_ms);
+        if (status.code == ErrorCode::OK) {
+          Store(std::move(next), changed, copy);
+        } else if (status.code == ErrorCode::TIMEOUT) {
+          // The robot may or may not have applied it; fetch again on next use
+          Invalidate();
+        }
+      }
+    }
+    Notify(fetched, fetched_changed);
+    if (status.code == ErrorCode::OK) {
+      Notify(copy, changed);
+    }
+    return status;
+  }
+
+  /**
+   * @brief Apply a complete configuration, skipping the RPC if it is already in effect.
+   * @param config Configuration to set.
+   * @param timeout_ms Timeout of each RPC.
+   */
+  Status Set(const SetSpeechConfig& config, int timeout_ms = 5000) { return Update(detail::MakeVoiceConfigPatch(config), timeout_ms); }
+
+  /**
+   * @brief Switch the speech model; the configuration returned by the robot replaces the cache.
+   * @param tts_type Speech model.
+   * @param timeout_ms Timeout of the RPC.
+   */
+  Status SwitchTtsVoiceModel(TtsType tts_type, int timeout_ms = 5000) {
+    if (!switch_) {
+      return {ErrorCode::SERVICE_NOT_READY, "switching the speech model is not supported"};
+    }
+    GetSpeechConfig copy;
+    uint32_t changed = 0;
+    Status status;
+    {
+      std::lock_guard<std::mutex> rpc_lock(rpc_mutex_);
+      GetSpeechConfig fresh;
+      status = switch_(tts_type, fresh, timeout_ms);
+      if (status.code != ErrorCode::OK) {
+        Invalidate();
+        return status;
+      }
+      changed = Store(std::move(fresh), 0, copy);
+    }
+    Notify(copy, changed);
+    return status;
+  }
+
+  /// Drop the cached configuration; the next Get or Update fetches it again
+  void Invalidate() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    valid_ = false;
+  }
+
+  /// Whether a configuration is cached
+  bool IsValid() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return valid_;
+  }
+
+  /// Updates answered without an RPC because nothing changed
+  uint64_t GetSkippedUpdates() const { return skipped_updates_; }
+
+ private:
+  /**
+   * @brief Replace the cache.
+   * @param changed Bits known to change; 0 to diff against the cache.
+   * @param copy Receives the new configuration when something changed, for Notify outside the RPC lock.
+   * @return Bits that changed; all bits for the first configuration.
+   */
+  uint32_t Store(GetSpeechConfig config, uint32_t changed, GetSpeechConfig& copy) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (changed == 0) {
+      changed = valid_ ? DiffVoiceConfig(config_, config) : ~0u;
+    }
+    config_ = std::move(config);
+    valid_ = true;
+    if (changed != 0) {
+      copy = config_;
+    }
+    return changed;
+  }
+
+  void Notify(const GetSpeechConfig& config, uint32_t changed) {
+    if (changed == 0) {
+      return;
+    }
+    VoiceConfigCallback callback;
+    {
+      std::lock_guard<std::mutex> lock(callback_mutex_);
+      callback = callback_;
+    }
+    // Invoked unlocked so the callback may call Update
+    if (callback) {
+      callback(config, changed);
+    }
+  }
+
+  void RefreshLoop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!cv_.wait_for(lock, std::chrono::milliseconds(refresh_interval_ms_), [this] { return stop_; })) {
+      lock.unlock();
+      Refresh();
+      lock.lock();
+    }
+  }
+
+  GetFunction get_;
+  SetFunction set_;
+  SwitchFunction switch_;
+  int refresh_interval_ms_;
+
+  std::mutex rpc_mutex_;
+  mutable std::mutex mutex_;
+  std::condition_variable cv_;
+  GetSpeechConfig config_;
+  bool valid_{false};
+  bool stop_{false};
+  std::atomic<uint64_t> skipped_updates_{0};
+
+  std::mutex callback_mutex_;
+  VoiceConfigCallback callback_;
+
+  std::thread thread_;
+};
+
+}  // namespace magic::dog::audio
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "magic_type.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace magic::dog {
+
+/**
+ * @class WorkerPool
+ * @brief Fixed set of worker threads running data-parallel loops for the processing helpers.
+ *
+ * ParallelFor hands out task indices dynamically to the workers and the calling thread, and returns once all
+ * of them have finished. Threads are started once and sleep between loops, so a loop costs a wake-up rather
+ * than a thread creation. Calls to ParallelFor from several threads are serialized.
+ *
+ * Example:
+ * @code
+ *   WorkerPool pool;
+ *   pool.ParallelFor(bands, [&](size_t band) { ProcessRows(band * rows_per_band, rows_per_band); });
+ * @endcode
+ */
+class WorkerPool final : public NonCopyable {
+ public:
+  /// @param threads Total number of threads including the caller, 0 for the hardware concurrency
+  explicit WorkerPool(size_t threads = 0) {
+    if (threads == 0) {
+      threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    workers_.reserve(threads - 1);
+    for (size_t i = 1; i < threads; ++i) {
+      workers_.emplace_back([this] { WorkerLoop(); });
+    }
+  }
+
+  ~WorkerPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread& worker : workers_) {
+      worker.join();
+    }
+  }
+
+  /// Number of threads taking part in a loop, including the caller
+  size_t Size() const { return workers_.size() + 1; }
+
+  /**
+   * @brief Run task(i) for every i in [0, count) and wait for completion.
+   * @param count Number of task indices.
+   * @param task Called concurrently from the workers and the calling thread; must not call ParallelFor.
+   */
+  void ParallelFor(size_t count, const std::function<void(size_t)>& task) {
+    if (count == 0) {
+      return;
+    }
+    if (workers_.empty() || count == 1) {
+      for (size_t i = 0; i < count; ++i) {
+        task(i);
+      }
+      return;
+    }
+    std::lock_guard<std::mutex> call_lock(call_mutex_);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      task_ = &task;
+      count_ = count;
+      next_.store(0, std::memory_order_relaxed);
+      active_ = workers_.size();
+      ++generation_;
+    }
+    wake_.notify_all();
+    RunTasks(task, count);
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_.wait(lock, [this] { return active_ == 0; });
+    task_ = nullptr;
+  }
+
+ private:
+  void RunTasks(const std::function<void(size_t)>& task, size_t count) {
+    for (size_t i = next_.fetch_add(1, std::memory_order_relaxed); i < count; i = next_.fetch_add(1, std::memory_order_relaxed)) {
+      task(i);
+    }
+  }
+
+  void WorkerLoop() {
+    uint64_t seen = 0;
+    while (true) {
+      const std::function<void(size_t)>* task = nullptr;
+      size_t count = 0;
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        wake_.wait(lock, [&] { return stop_ || generation_ != seen; });
+        if (stop_) {
+          return;
+        }
+        seen = generation_;
+        task = task_;
+        count = count_;
+      }
+      RunTasks(*task, count);
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--active_ == 0) {
+          done_.notify_one();
+        }
+      }
+    }
+  }
+
+  std::vector<std::thread> workers_;
+  std::mutex call_mutex_;
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable done_;
+  const std::function<void(size_t)>* task_{nullptr};
+  size_t count_{0};
+  size_t active_{0};
+  uint64_t generation_{0};
+  bool stop_{false};
+  std::atomic<size_t> next_{0};
+};
+
+}  // namespace magic::dog